@@ -389,7 +389,7 @@ const UInt16	ACAppleIMA4Codec::kPredictorMask = 0xFF80;
 const UInt16	ACAppleIMA4Codec::kStepTableIndexMask = 0x007F;
 const SInt32	ACAppleIMA4Codec::kPredictorTolerance = 0x0000007F;
 const SInt16	ACAppleIMA4Codec::sIndexTable[16] = { -1,-1,-1,-1, 2, 4, 6, 8, -1,-1,-1,-1, 2, 4, 6, 8 };
-const SInt16	ACAppleIMA4Codec::sStepTable[89] = {	    7,     8,     9,    10,    11,    12,    13,    14,    16,    17,
+const SInt16	ACAppleIMA4Codec::sStepTable[kStepTableSize] = {	    7,     8,     9,    10,    11,    12,    13,    14,    16,    17,
 														   19,    21,    23,    25,    28,    31,    34,    37,    41,    45,
 														   50,    55,    60,    66,    73,    80,    88,    97,   107,   118,
 														  130,   143,   157,   173,   190,   209,   230,   253,   279,   307,
@@ -110,13 +110,14 @@ protected:
 		kBytesPerChannelPerPacket = 32,
 		kHeaderBytes = 2,
 		kInputBufferPackets = 32,
-		kIMA4PacketBytes = kHeaderBytes + kBytesPerChannelPerPacket
+		kIMA4PacketBytes = kHeaderBytes + kBytesPerChannelPerPacket,
+		kStepTableSize = 89
 	};
 	static const UInt16	kPredictorMask;
 	static const UInt16	kStepTableIndexMask;
 	static const SInt32	kPredictorTolerance;
 	static const SInt16	sIndexTable[16];
-	static const SInt16	sStepTable[89];
+	static const SInt16	sStepTable[kStepTableSize];
 
 };
 
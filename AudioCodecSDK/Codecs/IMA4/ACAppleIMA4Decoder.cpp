@@ -303,13 +303,6 @@ UInt32	ACAppleIMA4Decoder::ProduceOutputPackets(void* outOutputData, UInt32& ioO
 		theAnswer = kAudioCodecProduceOutputPacketNeedsMoreInputData;
 	}
 	
-	// We only produce 1 at a time
-	if (ioNumberPackets > 1 && numberOfInputPackets > 1)
-	{
-		numberOfInputPackets = ioNumberPackets = 1;
-		theAnswer = kAudioCodecProduceOutputPacketSuccessHasMore;
-	}
-	
 	UInt32 inputByteSize = numberOfInputPackets * inputPacketSize;
 	
 	if(ioNumberPackets > 0)
@@ -322,17 +315,11 @@ UInt32	ACAppleIMA4Decoder::ProduceOutputPackets(void* outOutputData, UInt32& ioO
 		//	set the return value
 		ioOutputDataByteSize = theOutputByteSize;
 		
-		//	decode the input data for each channel
+		//	decode all the channels of all the packets in one pass
 		Byte* theInputData = GetBytes(inputByteSize);
 		SInt16* theOutputData = reinterpret_cast<SInt16*>(outOutputData);
 
-		ChannelStateList::iterator theIterator = mChannelStateList.begin();
-		for(UInt32 theChannelIndex = 0; theChannelIndex < mOutputFormat.mChannelsPerFrame; ++theChannelIndex)
-		{
-			//printf("->DecodeChannel %d %d %d %08X %08X\n", mOutputFormat.mChannelsPerFrame, theChannelIndex, ioNumberPackets, theInputData, theOutputData);
-			DecodeChannelSInt16(*theIterator, mOutputFormat.mChannelsPerFrame, theChannelIndex, ioNumberPackets, theInputData, theOutputData);
-			std::advance(theIterator, 1);
-		}
+		DecodePacketsSInt16(&mChannelStateList[0], mOutputFormat.mChannelsPerFrame, ioNumberPackets, theInputData, theOutputData);
         
 		ConsumeInputData(inputByteSize);
 	}
@@ -352,92 +339,127 @@ UInt32	ACAppleIMA4Decoder::ProduceOutputPackets(void* outOutputData, UInt32& ioO
 	return theAnswer;
 }
 
-void	ACAppleIMA4Decoder::DecodeChannelSInt16(ChannelState& ioChannelState, UInt32 inNumberChannels, UInt32 inDecodeChannel, UInt32 inNumberPacketsToDecode, const Byte* inInputData, SInt16* outOutputData)
-{
-	//	This decoder can only decode one channel at a time.
-	//	Each channel in a packet of frames is encoded separately and
-	//	the resulting channel packets are interleaved in channel order.
-
-	//	We need to figure out how to skip through the input and output buffers
-	//	and point at the appropriate place in the data to start off
-	UInt32	theInputStride	= (inNumberChannels - 1) * kIMA4PacketBytes + 2;
-	Byte*	theInputData	= const_cast<Byte*>(inInputData) + (inDecodeChannel * kIMA4PacketBytes);
-	UInt32	theOutputStride	= inNumberChannels;
-
-	SInt32 theDifference;
-	SInt32 theCode = 0;
-	UInt32 theTemporaryInputData = 0;					/* initialize so warnings go away */
-
-	SInt16*	theOutputData	= const_cast<SInt16*>(outOutputData) + inDecodeChannel;
-
-	if (inNumberPacketsToDecode == 0)
-		return;
-
-	CheckState(theInputData, ioChannelState);						/* make sure state predictors match stream */
-	theInputData += 2;										/* skip first predictor */
+const ACAppleIMA4Decoder::DecodeTable	ACAppleIMA4Decoder::sDecodeTable;
 
-	SInt32 thePredictedSample = ioChannelState.mPredictedSample;					/* continue where we left off last time */
-	SInt32	theStepTableIndex = ioChannelState.mStepTableIndex;
-	SInt32	theStep = sStepTable[theStepTableIndex];
-
-	for (; inNumberPacketsToDecode > 0; --inNumberPacketsToDecode)
+ACAppleIMA4Decoder::DecodeTable::DecodeTable()
+{
+	for(SInt32 theStepTableIndex = 0; theStepTableIndex < kStepTableSize; ++theStepTableIndex)
 	{
-		//printf("inNumberPacketsToDecode %d\n", inNumberPacketsToDecode);
-		for(UInt32 theNumberSamplesLeft = kIMAFramesPerPacket; theNumberSamplesLeft > 0; --theNumberSamplesLeft)
+		SInt32 theStep = sStepTable[theStepTableIndex];
+		for(SInt32 theCode = 0; theCode < 16; ++theCode)
 		{
-			if	(theNumberSamplesLeft & 1)						/* two samples per input char */
-				theCode = theTemporaryInputData >> 4;
-			else
-			{
-				//printf("IN %02X\n", *theInputData & 255);
-				theTemporaryInputData = *theInputData++;					/* buffer two ADPCM nibbles */
-				theCode = theTemporaryInputData & 0x0F;
-			}
-			
-			theDifference = 0;								/* compute new sample estimate thePredictedSample */
+			SInt32 theDifference = theStep >> 3;
 			if (theCode & 4)
 				theDifference += theStep;
 			if (theCode & 2)
 				theDifference += theStep >> 1;
 			if (theCode & 1)
 				theDifference += theStep >> 2;
-				
-			theDifference += theStep >> 3;
 			if (theCode & 8)
 				theDifference = -theDifference;
+			
+			SInt32 theNextIndex = theStepTableIndex + sIndexTable[theCode];
+			if (theNextIndex < 0)
+				theNextIndex = 0;
+			else if (theNextIndex > kStepTableSize - 1)
+				theNextIndex = kStepTableSize - 1;
+			
+			DecodeTableEntry& theEntry = mEntries[theStepTableIndex * 16 + theCode];
+			theEntry.mDifference = theDifference;
+			theEntry.mNextRow = theNextIndex * 16;
+		}
+	}
+}
 
-			thePredictedSample += theDifference;
+inline SInt16	ACAppleIMA4Decoder::DecodeNibble(const DecodeTableEntry* inTable, SInt32& ioPredictedSample, UInt32& ioRow, UInt32 inCode)
+{
+	const DecodeTableEntry& theEntry = inTable[ioRow + inCode];
+	SInt32 thePredictedSample = ioPredictedSample + theEntry.mDifference;
+	
+	//	check for overflow
+	thePredictedSample = thePredictedSample > 32767 ? 32767 : thePredictedSample;
+	thePredictedSample = thePredictedSample < -32768 ? -32768 : thePredictedSample;
+	
+	ioPredictedSample = thePredictedSample;
+	ioRow = theEntry.mNextRow;
+	return static_cast<SInt16>(thePredictedSample);
+}
 
-			//	check for overflow
-			if(thePredictedSample > 32767)
+void	ACAppleIMA4Decoder::DecodePacketsSInt16(ChannelState* ioChannelStates, UInt32 inNumberChannels, UInt32 inNumberPacketsToDecode, const Byte* inInputData, SInt16* outOutputData)
+{
+	//	Each channel in a packet of frames is encoded separately and the
+	//	resulting channel packets are interleaved in channel order. Every byte
+	//	holds two successive samples, the earlier one in the low nibble.
+	//	Each channel packet's header is checked against the running state, just
+	//	as it would be if the packets were decoded one at a time. The channels
+	//	of a stereo packet are decoded together, which both interleaves the
+	//	output as it is written and lets the two channels' independent
+	//	dependency chains overlap.
+	const DecodeTableEntry* theTable = sDecodeTable.mEntries;
+	const Byte* theInputData = inInputData;
+	SInt16* theOutputData = outOutputData;
+
+	if (inNumberChannels == 2)
+	{
+		SInt32 thePredictedSample0 = ioChannelStates[0].mPredictedSample;
+		SInt32 thePredictedSample1 = ioChannelStates[1].mPredictedSample;
+		
+		for (; inNumberPacketsToDecode > 0; --inNumberPacketsToDecode)
+		{
+			const Byte* theInputData0 = theInputData;
+			const Byte* theInputData1 = theInputData + kIMA4PacketBytes;
+			
+			ioChannelStates[0].mPredictedSample = thePredictedSample0;
+			ioChannelStates[1].mPredictedSample = thePredictedSample1;
+			CheckState(theInputData0, ioChannelStates[0]);			/* make sure state predictors match stream */
+			CheckState(theInputData1, ioChannelStates[1]);
+			thePredictedSample0 = ioChannelStates[0].mPredictedSample;
+			thePredictedSample1 = ioChannelStates[1].mPredictedSample;
+			UInt32 theRow0 = ioChannelStates[0].mStepTableIndex * 16;
+			UInt32 theRow1 = ioChannelStates[1].mStepTableIndex * 16;
+			
+			theInputData0 += kHeaderBytes;
+			theInputData1 += kHeaderBytes;
+			for (UInt32 theByte = 0; theByte < kBytesPerChannelPerPacket; ++theByte)
 			{
-				thePredictedSample = 32767;
+				UInt32 theCodes0 = theInputData0[theByte];
+				UInt32 theCodes1 = theInputData1[theByte];
+				theOutputData[0] = DecodeNibble(theTable, thePredictedSample0, theRow0, theCodes0 & 0x0F);
+				theOutputData[1] = DecodeNibble(theTable, thePredictedSample1, theRow1, theCodes1 & 0x0F);
+				theOutputData[2] = DecodeNibble(theTable, thePredictedSample0, theRow0, theCodes0 >> 4);
+				theOutputData[3] = DecodeNibble(theTable, thePredictedSample1, theRow1, theCodes1 >> 4);
+				theOutputData += 4;
 			}
-			else if(thePredictedSample < -32768)
+			
+			ioChannelStates[0].mStepTableIndex = theRow0 / 16;
+			ioChannelStates[1].mStepTableIndex = theRow1 / 16;
+			theInputData += 2 * kIMA4PacketBytes;
+		}
+		
+		ioChannelStates[0].mPredictedSample = thePredictedSample0;
+		ioChannelStates[1].mPredictedSample = thePredictedSample1;
+	}
+	else
+	{
+		for (; inNumberPacketsToDecode > 0; --inNumberPacketsToDecode)
+		{
+			CheckState(theInputData, ioChannelStates[0]);			/* make sure state predictors match stream */
+			SInt32 thePredictedSample = ioChannelStates[0].mPredictedSample;
+			UInt32 theRow = ioChannelStates[0].mStepTableIndex * 16;
+			
+			const Byte* theCodes = theInputData + kHeaderBytes;
+			for (UInt32 theByte = 0; theByte < kBytesPerChannelPerPacket; ++theByte)
 			{
-				thePredictedSample = -32768;
+				theOutputData[0] = DecodeNibble(theTable, thePredictedSample, theRow, theCodes[theByte] & 0x0F);
+				theOutputData[1] = DecodeNibble(theTable, thePredictedSample, theRow, theCodes[theByte] >> 4);
+				theOutputData += 2;
 			}
-
-			//printf("   theCode %02X  theDifference %d\n", theCode, theDifference);
-			//printf("OUT %02X %d   \n", thePredictedSample & 255, thePredictedSample);
-
-			*theOutputData = thePredictedSample;
-			theOutputData += theOutputStride;
 			
-			theStepTableIndex += sIndexTable[theCode];				/* compute new stepsize step */
-			if (theStepTableIndex < 0)
-				theStepTableIndex = 0;
-			else if (theStepTableIndex > 88)
-				theStepTableIndex = 88;
-			theStep = sStepTable[theStepTableIndex];
-			//printf("   theStep %d  theStepTableIndex %d\n", theStep, theStepTableIndex);
+			ioChannelStates[0].mPredictedSample = thePredictedSample;
+			ioChannelStates[0].mStepTableIndex = theRow / 16;
+			theInputData += kIMA4PacketBytes;
 		}
-
-		theInputData += theInputStride;
 	}
-
-	ioChannelState.mPredictedSample = thePredictedSample;
-	ioChannelState.mStepTableIndex = theStepTableIndex;
 }
 
 UInt32	ACAppleIMA4Decoder::GetVersion() const
@@ -463,6 +485,8 @@ void ACAppleIMA4Decoder::CheckState(const Byte *inInputData, ChannelState& ioCha
 {
 	SInt16 s = CFSwapInt16BigToHost(*((short *) inInputData));
 	SInt16 theStepTableIndex = s & kIndexMask;					// get stored index
+	if (theStepTableIndex > kStepTableSize - 1)				// a damaged header must not index past the tables
+		theStepTableIndex = kStepTableSize - 1;
 	s &= kPredictorMask;					// get stored thePredictedSample
 	SInt32 thePredictedSample = s;							// make sure it gets sign-extended!
 
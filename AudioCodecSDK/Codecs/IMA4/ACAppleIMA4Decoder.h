@@ -84,10 +84,30 @@ public:
 
 //	Implementation
 private:
-	static void		DecodeChannelSInt16(ChannelState& ioChannelState, UInt32 inNumberChannels, UInt32 inDecodeChannel, UInt32 inNumberPacketsToDecode, const Byte* inInputData, SInt16* outOutputData);
+	static void		DecodePacketsSInt16(ChannelState* ioChannelStates, UInt32 inNumberChannels, UInt32 inNumberPacketsToDecode, const Byte* inInputData, SInt16* outOutputData);
 	
 	static void CheckState(const Byte *inInputData, ChannelState& ioChannelState);
 
+	//	The result of decoding every nibble at every step table index, indexed by
+	//	(step table index * 16) + nibble. mNextRow is the row to use for the
+	//	following nibble, that is the new step table index times 16.
+	struct	DecodeTableEntry
+	{
+		SInt32			mDifference;
+		UInt32			mNextRow;
+	};
+	
+	struct	DecodeTable
+	{
+		DecodeTable();
+		DecodeTableEntry	mEntries[kStepTableSize * 16];
+	};
+	
+	static const DecodeTable	sDecodeTable;
+	
+	//	decodes one nibble, updating the channel's predicted sample and table row
+	static SInt16	DecodeNibble(const DecodeTableEntry* inTable, SInt32& ioPredictedSample, UInt32& ioRow, UInt32 inCode);
+
 	virtual void		FixFormats();
 };
 
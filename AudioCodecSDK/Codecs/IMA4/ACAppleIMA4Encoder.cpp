@@ -54,6 +54,8 @@ Copyright (C) 2012 Apple Inc. All Rights Reserved.
 #include "CAStreamBasicDescription.h"
 #include "CADebugMacros.h"
 #include "CABundleLocker.h"
+#include "CARealtimeThreadPool.h"
+#include <algorithm>
 
 //=============================================================================
 //	ACAppleIMA4Encoder
@@ -62,7 +64,7 @@ Copyright (C) 2012 Apple Inc. All Rights Reserved.
 ACAppleIMA4Encoder::ACAppleIMA4Encoder(OSType theSubType)
 :
 	ACAppleIMA4Codec(kInputBufferPackets * kIMAFramesPerPacket * SizeOf32(SInt16), theSubType), 
-	mEndOfInput(false), mZeroPaddedOnce(false), mZeroesPadded(0)
+	mEndOfInput(false), mZeroPaddedOnce(false), mZeroesPadded(0), mParallelSegments(1), mParallelBitExact(true), mPacketEndStates(), mSegmentPool(NULL)
 {
 	//	This encoder only accepts 16 bit native endian signed integer as it's input,
 	//	but can handle any sample rate and any number of channels
@@ -102,6 +104,39 @@ ACAppleIMA4Encoder::ACAppleIMA4Encoder(OSType theSubType)
 
 ACAppleIMA4Encoder::~ACAppleIMA4Encoder()
 {
+	delete mSegmentPool;
+}
+
+void	ACAppleIMA4Encoder::Initialize(const AudioStreamBasicDescription* inInputFormat, const AudioStreamBasicDescription* inOutputFormat, const void* inMagicCookie, UInt32 inMagicCookieByteSize)
+{
+	ACAppleIMA4Codec::Initialize(inInputFormat, inOutputFormat, inMagicCookie, inMagicCookieByteSize);
+	
+	if(mParallelSegments > 1)
+	{
+		//	one end state per channel per packet that the input buffer can hold,
+		//	which is the same number whatever the number of channels
+		mPacketEndStates.resize(GetInputBufferByteSize() / (kIMAFramesPerPacket * SizeOf32(SInt16)));
+		
+		if(mSegmentPool == NULL)
+		{
+			mSegmentPool = new CARealtimeThreadPool(std::min(CARealtimeThreadPool::DefaultNumWorkers(), mParallelSegments - 1));
+			if(mSegmentPool->GetNumWorkers() == 0)
+			{
+				//	no threads on this platform
+				delete mSegmentPool;
+				mSegmentPool = NULL;
+			}
+		}
+	}
+}
+
+void	ACAppleIMA4Encoder::Uninitialize()
+{
+	delete mSegmentPool;
+	mSegmentPool = NULL;
+	ChannelStateList().swap(mPacketEndStates);
+	
+	ACAppleIMA4Codec::Uninitialize();
 }
 
 void	ACAppleIMA4Encoder::GetPropertyInfo(AudioCodecPropertyID inPropertyID, UInt32& outPropertyDataSize, Boolean& outWritable)
@@ -132,6 +167,12 @@ void	ACAppleIMA4Encoder::GetPropertyInfo(AudioCodecPropertyID inPropertyID, UInt
 			outPropertyDataSize = SizeOf32(AudioCodecPrimeInfo);
 			outWritable = false;
 			break;
+			
+		case kIMA4EncoderPropertyParallelSegments:
+		case kIMA4EncoderPropertyParallelBitExact:
+			outPropertyDataSize = SizeOf32(UInt32);
+			outWritable = !mIsInitialized;
+			break;
             		            		
 		default:
 			ACAppleIMA4Codec::GetPropertyInfo(inPropertyID, outPropertyDataSize, outWritable);
@@ -210,6 +251,26 @@ void	ACAppleIMA4Encoder::GetProperty(AudioCodecPropertyID inPropertyID, UInt32&
 				CODEC_THROW(kAudioCodecBadPropertySizeError);
 			}
 			break;
+		case kIMA4EncoderPropertyParallelSegments:
+			if(ioPropertyDataSize == sizeof(UInt32))
+			{
+				*reinterpret_cast<UInt32*>(outPropertyData) = mParallelSegments;
+			}
+			else
+			{
+				CODEC_THROW(kAudioCodecBadPropertySizeError);
+			}
+			break;
+		case kIMA4EncoderPropertyParallelBitExact:
+			if(ioPropertyDataSize == sizeof(UInt32))
+			{
+				*reinterpret_cast<UInt32*>(outPropertyData) = mParallelBitExact ? 1 : 0;
+			}
+			else
+			{
+				CODEC_THROW(kAudioCodecBadPropertySizeError);
+			}
+			break;
 		default:
 			ACAppleIMA4Codec::GetProperty(inPropertyID, ioPropertyDataSize, outPropertyData);
 	}
@@ -225,6 +286,42 @@ void ACAppleIMA4Encoder::SetProperty(AudioCodecPropertyID inPropertyID, UInt32 i
 		case kAudioCodecPropertyPrimeInfo:
 			CODEC_THROW(kAudioCodecIllegalOperationError);
 			break;
+		case kIMA4EncoderPropertyParallelSegments:
+			if(mIsInitialized)
+			{
+				CODEC_THROW(kAudioCodecStateError);
+			}
+			if(inPropertyDataSize == sizeof(UInt32))
+			{
+				UInt32 theSegments = *reinterpret_cast<const UInt32*>(inPropertyData);
+				mParallelSegments = std::max(UInt32(1), std::min(theSegments, UInt32(kMaxParallelSegments)));
+				
+				//	buffer enough input for every segment to get a worthwhile share of a request
+				UInt32 theInputBufferByteSize = mParallelSegments * kParallelSegmentBufferPackets * kIMAFramesPerPacket * kMaxIMA4Channels * SizeOf32(SInt16);
+				if(mParallelSegments > 1 && GetInputBufferByteSize() < theInputBufferByteSize)
+				{
+					ReallocateInputBuffer(theInputBufferByteSize);
+				}
+			}
+			else
+			{
+				CODEC_THROW(kAudioCodecBadPropertySizeError);
+			}
+			break;
+		case kIMA4EncoderPropertyParallelBitExact:
+			if(mIsInitialized)
+			{
+				CODEC_THROW(kAudioCodecStateError);
+			}
+			if(inPropertyDataSize == sizeof(UInt32))
+			{
+				mParallelBitExact = (*reinterpret_cast<const UInt32*>(inPropertyData) != 0);
+			}
+			else
+			{
+				CODEC_THROW(kAudioCodecBadPropertySizeError);
+			}
+			break;
 		default:
 			ACAppleIMA4Codec::SetProperty(inPropertyID, inPropertyDataSize, inPropertyData);
 			break;            
@@ -420,17 +517,24 @@ UInt32	ACAppleIMA4Encoder::ProduceOutputPackets(
 		//	encode the input data for each channel
 		SInt16* theInputData = reinterpret_cast<SInt16*>(GetBytes(inputByteSize));
 		Byte* theOutputData = reinterpret_cast<Byte*>(outOutputData);
-		ChannelStateList::iterator theIterator = mChannelStateList.begin();
-		for(UInt32 theChannelIndex = 0; theChannelIndex < mOutputFormat.mChannelsPerFrame; ++theChannelIndex)
+		if((mParallelSegments > 1) && (ioNumberPackets >= 2 * kMinPacketsPerParallelSegment))
 		{
-			EncodeChannel(
-				*theIterator, 
-				mOutputFormat.mChannelsPerFrame, 
-				theChannelIndex, 
-				ioNumberPackets, 
-				theInputData, 
-				theOutputData);
-			std::advance(theIterator, 1);
+			EncodePacketsInParallel(ioNumberPackets, theInputData, theOutputData);
+		}
+		else
+		{
+			ChannelStateList::iterator theIterator = mChannelStateList.begin();
+			for(UInt32 theChannelIndex = 0; theChannelIndex < mOutputFormat.mChannelsPerFrame; ++theChannelIndex)
+			{
+				EncodeChannel(
+					*theIterator, 
+					mOutputFormat.mChannelsPerFrame, 
+					theChannelIndex, 
+					ioNumberPackets, 
+					theInputData, 
+					theOutputData);
+				std::advance(theIterator, 1);
+			}
 		}
 
 		ConsumeInputData(inputByteSize);
@@ -591,6 +695,147 @@ void	ACAppleIMA4Encoder::EncodeChannel(
 	ioChannelState.mStepTableIndex = theStepTableIndex;
 }
 
+//	A parallel encode splits the request into runs of whole packets. The first
+//	run starts from the encoder's state, like a serial encode. Each later run
+//	can't know its start state until the one before it is done, so it guesses:
+//	it encodes the few packets just ahead of it from a neutral state and
+//	throws that output away. The step size adapts within a few samples, so
+//	the guess usually matches the real state exactly. All the runs are
+//	encoded at once, recording the state at the end of every packet.
+//
+//	The seams are then reconciled in order, each channel on its own. Where a
+//	run's guess was right, its output is already what the serial encoder
+//	would have written. Where it was wrong, the run is encoded again from the
+//	real state, one packet at a time. This stops once the state matches what
+//	the first pass recorded, because from then on both encodes are the same.
+//	Either way the output is identical to a serial encode. Without
+//	kIMA4EncoderPropertyParallelBitExact the seams are left as they are.
+
+void	ACAppleIMA4Encoder::EncodePacketsInParallel(UInt32 inNumberPackets, const SInt16* inInputData, Byte* outOutputData)
+{
+	UInt32 theNumberChannels = mOutputFormat.mChannelsPerFrame;
+	UInt32 theNumberSegments = std::min(mParallelSegments, inNumberPackets / kMinPacketsPerParallelSegment);
+	Assert(inNumberPackets * theNumberChannels <= mPacketEndStates.size(), "ACAppleIMA4Encoder::EncodePacketsInParallel: more packets than the input buffer holds");
+	
+	Segment theSegments[kMaxParallelSegments];
+	UInt32 theFirstPacket = 0;
+	for(UInt32 theSegmentIndex = 0; theSegmentIndex < theNumberSegments; ++theSegmentIndex)
+	{
+		Segment& theSegment = theSegments[theSegmentIndex];
+		theSegment.mNumberChannels = theNumberChannels;
+		theSegment.mFirstPacket = theFirstPacket;
+		theSegment.mNumberPackets = inNumberPackets / theNumberSegments + ((theSegmentIndex < inNumberPackets % theNumberSegments) ? 1 : 0);
+		theSegment.mInputData = inInputData;
+		theSegment.mOutputData = outOutputData;
+		theSegment.mPacketEndStates = &mPacketEndStates[0];
+		theSegment.mGuessStartStates = (theSegmentIndex > 0);
+		for(UInt32 theChannelIndex = 0; theChannelIndex < theNumberChannels; ++theChannelIndex)
+		{
+			theSegment.mStartStates[theChannelIndex] = mChannelStateList[theChannelIndex];
+		}
+		theFirstPacket += theSegment.mNumberPackets;
+	}
+	
+	//	encode the segments on the pool's workers and this thread, or one after another without a pool
+	if((mSegmentPool == NULL) || (mSegmentPool->Run(EncodeSegmentTask, theSegments, theNumberSegments) != noErr))
+	{
+		for(UInt32 theSegmentIndex = 0; theSegmentIndex < theNumberSegments; ++theSegmentIndex)
+		{
+			EncodeSegment(theSegments[theSegmentIndex]);
+		}
+	}
+
+	//	carry the real state across each seam
+	for(UInt32 theChannelIndex = 0; theChannelIndex < theNumberChannels; ++theChannelIndex)
+	{
+		if(mParallelBitExact)
+		{
+			ChannelState theState = mPacketEndStates[(theSegments[0].mNumberPackets - 1) * theNumberChannels + theChannelIndex];
+			for(UInt32 theSegmentIndex = 1; theSegmentIndex < theNumberSegments; ++theSegmentIndex)
+			{
+				ReconcileSegment(theSegments[theSegmentIndex], theChannelIndex, theState);
+			}
+			mChannelStateList[theChannelIndex] = theState;
+		}
+		else
+		{
+			mChannelStateList[theChannelIndex] = mPacketEndStates[(inNumberPackets - 1) * theNumberChannels + theChannelIndex];
+		}
+	}
+}
+
+void	ACAppleIMA4Encoder::EncodeSegment(Segment& ioSegment)
+{
+	UInt32 thePacketFrames = kIMAFramesPerPacket * ioSegment.mNumberChannels;
+	UInt32 thePacketBytes = kIMA4PacketBytes * ioSegment.mNumberChannels;
+	
+	if(ioSegment.mGuessStartStates)
+	{
+		//	start from the first warm up sample with the smallest step
+		UInt32 theWarmUpPackets = std::min(ioSegment.mFirstPacket, UInt32(kWarmUpPackets));
+		UInt32 theWarmUpPacket = ioSegment.mFirstPacket - theWarmUpPackets;
+		Byte theScratch[kMaxIMA4Channels * kIMA4PacketBytes];
+		for(UInt32 theChannelIndex = 0; theChannelIndex < ioSegment.mNumberChannels; ++theChannelIndex)
+		{
+			ChannelState& theState = ioSegment.mStartStates[theChannelIndex];
+			theState.mPredictedSample = ioSegment.mInputData[theWarmUpPacket * thePacketFrames + theChannelIndex];
+			theState.mStepTableIndex = 0;
+			for(UInt32 thePacket = theWarmUpPacket; thePacket < ioSegment.mFirstPacket; ++thePacket)
+			{
+				EncodeChannel(theState, ioSegment.mNumberChannels, theChannelIndex, 1, ioSegment.mInputData + thePacket * thePacketFrames, theScratch);
+			}
+		}
+	}
+	
+	ChannelState theStates[kMaxIMA4Channels];
+	for(UInt32 theChannelIndex = 0; theChannelIndex < ioSegment.mNumberChannels; ++theChannelIndex)
+	{
+		theStates[theChannelIndex] = ioSegment.mStartStates[theChannelIndex];
+	}
+	
+	UInt32 theEndPacket = ioSegment.mFirstPacket + ioSegment.mNumberPackets;
+	for(UInt32 thePacket = ioSegment.mFirstPacket; thePacket < theEndPacket; ++thePacket)
+	{
+		for(UInt32 theChannelIndex = 0; theChannelIndex < ioSegment.mNumberChannels; ++theChannelIndex)
+		{
+			EncodeChannel(theStates[theChannelIndex], ioSegment.mNumberChannels, theChannelIndex, 1, ioSegment.mInputData + thePacket * thePacketFrames, ioSegment.mOutputData + thePacket * thePacketBytes);
+			ioSegment.mPacketEndStates[thePacket * ioSegment.mNumberChannels + theChannelIndex] = theStates[theChannelIndex];
+		}
+	}
+}
+
+void	ACAppleIMA4Encoder::EncodeSegmentTask(void* inSegments, UInt32 inSegmentIndex, UInt32 /*inThreadIndex*/)
+{
+	EncodeSegment(static_cast<Segment*>(inSegments)[inSegmentIndex]);
+}
+
+void	ACAppleIMA4Encoder::ReconcileSegment(const Segment& inSegment, UInt32 inChannel, ChannelState& ioChannelState)
+{
+	//	on entry ioChannelState is the real state at the start of the segment,
+	//	on exit the real state at its end
+	UInt32 theNumberChannels = inSegment.mNumberChannels;
+	UInt32 theLastPacket = inSegment.mFirstPacket + inSegment.mNumberPackets - 1;
+	const ChannelState& theGuess = inSegment.mStartStates[inChannel];
+	
+	if((ioChannelState.mPredictedSample != theGuess.mPredictedSample) || (ioChannelState.mStepTableIndex != theGuess.mStepTableIndex))
+	{
+		for(UInt32 thePacket = inSegment.mFirstPacket; thePacket <= theLastPacket; ++thePacket)
+		{
+			EncodeChannel(ioChannelState, theNumberChannels, inChannel, 1, inSegment.mInputData + thePacket * kIMAFramesPerPacket * theNumberChannels, inSegment.mOutputData + thePacket * kIMA4PacketBytes * theNumberChannels);
+			
+			ChannelState& theRecordedState = inSegment.mPacketEndStates[thePacket * theNumberChannels + inChannel];
+			bool theStatesMatch = (ioChannelState.mPredictedSample == theRecordedState.mPredictedSample) && (ioChannelState.mStepTableIndex == theRecordedState.mStepTableIndex);
+			theRecordedState = ioChannelState;
+			if(theStatesMatch)
+			{
+				break;
+			}
+		}
+	}
+	
+	ioChannelState = inSegment.mPacketEndStates[theLastPacket * theNumberChannels + inChannel];
+}
+
 UInt32	ACAppleIMA4Encoder::GetVersion() const
 {
 	return kIMA4aencVersion;
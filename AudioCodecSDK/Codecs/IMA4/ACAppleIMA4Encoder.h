@@ -54,6 +54,29 @@ Copyright (C) 2012 Apple Inc. All Rights Reserved.
 
 #include "ACAppleIMA4Codec.h"
 
+class CARealtimeThreadPool;
+
+//=============================================================================
+//	Properties
+//=============================================================================
+
+enum
+{
+	//	UInt32, read/write while uninitialized. The number of segments a large
+	//	ProduceOutputPackets request is split into and encoded concurrently, for
+	//	offline conversions. 0 or 1, the default, encodes serially.
+	kIMA4EncoderPropertyParallelSegments = 'pseg',
+	
+	//	UInt32, read/write while uninitialized. Nonzero, the default, makes a
+	//	parallel encode identical to a serial one. Zero skips reconciling the
+	//	seams between segments: the packets just after a seam are then encoded
+	//	from an estimated state and can differ from the serial encoder's until
+	//	the two states converge, typically within a few hundred packets. Each
+	//	packet's header still records the state it was encoded from, so the
+	//	stream stays valid.
+	kIMA4EncoderPropertyParallelBitExact = 'pexa'
+};
+
 //=============================================================================
 //	ACAppleIMA4Encoder
 //
@@ -76,6 +99,11 @@ public:
 
 	virtual void		AppendInputData(const void* inInputData, UInt32& ioInputDataByteSize, UInt32& ioNumberPackets, const AudioStreamPacketDescription* inPacketDescription);
 
+//	Data Handling
+public:
+	virtual void		Initialize(const AudioStreamBasicDescription* inInputFormat, const AudioStreamBasicDescription* inOutputFormat, const void* inMagicCookie, UInt32 inMagicCookieByteSize);
+	virtual void		Uninitialize();
+
 //	Format Information
 public:
 	virtual void	SetCurrentInputFormat(const AudioStreamBasicDescription& inInputFormat);
@@ -90,6 +118,33 @@ public:
 private:
 	static void		EncodeChannel(ChannelState& ioChannelState, UInt32 inNumberChannels, UInt32 inEncodeChannel, UInt32 inNumberPacketsToEncode, const SInt16* inInputData, Byte* outOutputData);
 
+	//	One run of packets of a parallel encode. The input, output and end state
+	//	pointers address the whole request, not just the segment.
+	struct	Segment
+	{
+		UInt32				mNumberChannels;
+		UInt32				mFirstPacket;
+		UInt32				mNumberPackets;
+		const SInt16*		mInputData;
+		Byte*				mOutputData;
+		ChannelState*		mPacketEndStates;		//	per packet, per channel
+		ChannelState		mStartStates[kMaxIMA4Channels];
+		bool				mGuessStartStates;
+	};
+
+	void			EncodePacketsInParallel(UInt32 inNumberPackets, const SInt16* inInputData, Byte* outOutputData);
+	static void		EncodeSegment(Segment& ioSegment);
+	static void		EncodeSegmentTask(void* inSegments, UInt32 inSegmentIndex, UInt32 inThreadIndex);
+	static void		ReconcileSegment(const Segment& inSegment, UInt32 inChannel, ChannelState& ioChannelState);
+
+	enum
+	{
+		kMaxParallelSegments = 32,
+		kMinPacketsPerParallelSegment = 256,	//	smaller requests aren't worth splitting
+		kParallelSegmentBufferPackets = 1024,	//	input buffered per segment
+		kWarmUpPackets = 32						//	encoded ahead of a segment to guess its start state
+	};
+
 	virtual void		FixFormats();
 
 	UInt32 mSupportedChannelTotals[kMaxIMA4Channels];
@@ -98,6 +153,11 @@ private:
 	Boolean mZeroPaddedOnce;
 	Boolean mEncoderPadding[2];
 	UInt32 mZeroesPadded;
+
+	UInt32 mParallelSegments;
+	Boolean mParallelBitExact;
+	std::vector<ChannelState> mPacketEndStates;		//	sized for a full input buffer when initialized
+	CARealtimeThreadPool* mSegmentPool;				//	NULL if the segments are encoded one after another
 };
 
 #endif
@@ -50,6 +50,9 @@
 
 #include "ACSimpleCodec.h"
 #include <string.h>
+#if TARGET_OS_MAC
+	#include <mach/mach.h>
+#endif
 
 //=============================================================================
 //	ACSimpleCodec
@@ -57,24 +60,57 @@
 
 static const UInt32 kBufferPad = 64; // this is used to prevent end from passing start.
 
+#if TARGET_OS_MAC
+//	Maps inByteSize bytes (a multiple of the page size) twice, back to back, so that
+//	reading or writing past the end of the first copy lands at the start of it.
+static Byte*	AllocateMirroredBuffer(UInt32 inByteSize)
+{
+	vm_address_t theBuffer = 0;
+	if(vm_allocate(mach_task_self(), &theBuffer, 2 * inByteSize, VM_FLAGS_ANYWHERE) != KERN_SUCCESS)
+	{
+		return NULL;
+	}
+	
+	//	replace the second half with a view of the first
+	vm_address_t theMirror = theBuffer + inByteSize;
+	vm_prot_t theCurrentProtection, theMaxProtection;
+	if(vm_deallocate(mach_task_self(), theMirror, inByteSize) != KERN_SUCCESS)
+	{
+		//	the whole reservation is still ours
+		vm_deallocate(mach_task_self(), theBuffer, 2 * inByteSize);
+		return NULL;
+	}
+	if(vm_remap(mach_task_self(), &theMirror, inByteSize, 0, VM_FLAGS_FIXED, mach_task_self(), theBuffer, false, &theCurrentProtection, &theMaxProtection, VM_INHERIT_COPY) != KERN_SUCCESS)
+	{
+		//	another thread may have taken the upper half in between, so give up on it and let the caller use a plain buffer
+		vm_deallocate(mach_task_self(), theBuffer, inByteSize);
+		return NULL;
+	}
+	
+	return reinterpret_cast<Byte*>(theBuffer);
+}
+#endif
+
 ACSimpleCodec::ACSimpleCodec(UInt32 inInputBufferByteSize, AudioComponentInstance inInstance)
 :
 	ACBaseCodec(inInstance),
 	mInputBuffer(NULL),
 	mInputBufferByteSize(inInputBufferByteSize+kBufferPad),
+	mInputBufferRequestedByteSize(inInputBufferByteSize),
 	mInputBufferStart(0),
-	mInputBufferEnd(0)
+	mInputBufferEnd(0),
+	mInputBufferIsMirrored(false)
 {
 }
 
 ACSimpleCodec::~ACSimpleCodec()
 {
-	delete[] mInputBuffer;
+	FreeInputBuffer();
 }
 
 void	ACSimpleCodec::Initialize(const AudioStreamBasicDescription* inInputFormat, const AudioStreamBasicDescription* inOutputFormat, const void* inMagicCookie, UInt32 inMagicCookieByteSize)
 {
-	ReallocateInputBuffer(mInputBufferByteSize - kBufferPad);
+	ReallocateInputBuffer(mInputBufferRequestedByteSize);
 
 	// By definition CBR has this greater than 0. We must avoid a div by 0 error in AppendInputData()
 	// Note this will cause us to fail initialization which is intended
@@ -89,8 +125,7 @@ void	ACSimpleCodec::Initialize(const AudioStreamBasicDescription* inInputFormat,
 void	ACSimpleCodec::Uninitialize()
 {
 	//	get rid of the buffer
-	delete[] mInputBuffer;
-	mInputBuffer = NULL;
+	FreeInputBuffer();
 	
 	//	reset the ring buffer state
 	mInputBufferStart = 0;
@@ -115,7 +150,9 @@ void	ACSimpleCodec::Reset()
 
 UInt32	ACSimpleCodec::GetInputBufferByteSize() const
 {
-	return mInputBufferByteSize - kBufferPad; // minus kBufferPad to prevent end moving past start
+	//	the ring is at least kBufferPad larger, to prevent end moving past start; a mirrored ring
+	//	can be larger still, but clients are told the size they asked for
+	return mInputBufferRequestedByteSize;
 }
 
 UInt32	ACSimpleCodec::GetUsedInputBufferByteSize() const
@@ -171,7 +208,16 @@ void	ACSimpleCodec::AppendInputData(const void* inInputData, UInt32& ioInputData
 	// <<jamesmcc 
 	
 	//	now we have to copy the data taking into account the wrap around and where the start is
-	if(mInputBufferEnd + ioInputDataByteSize < mInputBufferByteSize)
+	if(mInputBufferIsMirrored)
+	{
+		//	whatever runs past the end goes through the mirror to the start
+		memcpy(mInputBuffer + mInputBufferEnd, theInputData, ioInputDataByteSize);
+		
+		//	adjust the end point
+		mInputBufferEnd += ioInputDataByteSize;
+		if(mInputBufferEnd >= mInputBufferByteSize) mInputBufferEnd -= mInputBufferByteSize;
+	}
+	else if(mInputBufferEnd + ioInputDataByteSize < mInputBufferByteSize)
 	{
 		//	no wrap around here
 		memcpy(mInputBuffer + mInputBufferEnd, theInputData, ioInputDataByteSize);
@@ -265,8 +311,9 @@ void	ACSimpleCodec::ConsumeInputData(UInt32 inConsumedByteSize)
 		//	clear the consumed bits
 		memset(mInputBuffer + mInputBufferStart, 0, inConsumedByteSize);
 		
-		//	adjust the start
+		//	adjust the start; with a mirrored ring the region may have run through the mirror
 		mInputBufferStart += inConsumedByteSize;
+		if(mInputBufferStart >= mInputBufferByteSize) mInputBufferStart -= mInputBufferByteSize;
 	}
 	else
 	{
@@ -298,7 +345,7 @@ Byte* ACSimpleCodec::GetBytes(UInt32& ioNumberBytes) const
 		
 	SInt32 leftOver = mInputBufferStart + ioNumberBytes - mInputBufferByteSize;
 	
-	if(leftOver > 0)
+	if(leftOver > 0 && !mInputBufferIsMirrored)
 	{
 		// need to copy beginning of buffer to the end. 
 		// We cleverly over allocated our buffer space to make this possible.
@@ -311,23 +358,53 @@ Byte* ACSimpleCodec::GetBytes(UInt32& ioNumberBytes) const
 
 void	ACSimpleCodec::ReallocateInputBuffer(UInt32 inInputBufferByteSize)
 {
-	mInputBufferByteSize = inInputBufferByteSize + kBufferPad;
-	
 	//	toss the old buffer
-	delete[] mInputBuffer;
-	mInputBuffer = NULL;
+	FreeInputBuffer();
+	
+	mInputBufferByteSize = inInputBufferByteSize + kBufferPad;
+	mInputBufferRequestedByteSize = inInputBufferByteSize;
 	
 	//	allocate the new one
-	// allocate extra in order to allow making contiguous data.
-	UInt32 allocSize = 2*inInputBufferByteSize + kBufferPad;
-	mInputBuffer = new Byte[allocSize];
-	memset(mInputBuffer, 0, allocSize);
+#if TARGET_OS_MAC
+	//	the mirror works in whole pages, so the ring grows to the next page boundary
+	UInt32 theMirroredByteSize = (mInputBufferByteSize + (UInt32)vm_page_size - 1) & ~((UInt32)vm_page_size - 1);
+	mInputBuffer = AllocateMirroredBuffer(theMirroredByteSize);
+	if(mInputBuffer != NULL)
+	{
+		//	vm_allocate hands out zeroed pages
+		mInputBufferByteSize = theMirroredByteSize;
+		mInputBufferIsMirrored = true;
+	}
+#endif
+	if(mInputBuffer == NULL)
+	{
+		// allocate extra in order to allow making contiguous data.
+		UInt32 allocSize = 2*inInputBufferByteSize + kBufferPad;
+		mInputBuffer = new Byte[allocSize];
+		memset(mInputBuffer, 0, allocSize);
+	}
 	
 	//	reset the ring buffer state
 	mInputBufferStart = 0;
 	mInputBufferEnd = 0;
 }
 
+void	ACSimpleCodec::FreeInputBuffer()
+{
+#if TARGET_OS_MAC
+	if(mInputBufferIsMirrored)
+	{
+		vm_deallocate(mach_task_self(), reinterpret_cast<vm_address_t>(mInputBuffer), 2 * mInputBufferByteSize);
+	}
+	else
+#endif
+	{
+		delete[] mInputBuffer;
+	}
+	mInputBuffer = NULL;
+	mInputBufferIsMirrored = false;
+}
+
 void	ACSimpleCodec::GetPropertyInfo(AudioCodecPropertyID inPropertyID, UInt32& outPropertyDataSize, Boolean& outWritable)
 {
 	switch(inPropertyID)
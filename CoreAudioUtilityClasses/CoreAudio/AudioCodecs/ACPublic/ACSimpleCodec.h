@@ -58,6 +58,9 @@
 //
 //	This extension of ACBaseCodec provides for a simple ring buffer to handle
 //	input data.
+//	Where the VM system allows it, the ring is followed by a second mapping of
+//	the same pages, so data that wraps around its end is still contiguous in
+//	memory and neither AppendInputData nor GetBytes has to split or move it.
 //=============================================================================
 
 class ACSimpleCodec
@@ -86,8 +89,10 @@ public:
 protected:
 	void				ConsumeInputData(UInt32 inConsumedByteSize);	
 	Byte*				GetInputBufferStart() const { return mInputBuffer + mInputBufferStart; }
-	UInt32				GetInputBufferContiguousByteSize() const { return (mInputBufferStart <= mInputBufferEnd) ? (mInputBufferEnd - mInputBufferStart) : (mInputBufferByteSize - mInputBufferStart); }
+	//	with a mirrored ring all of the used input is contiguous, even when it wraps
+	UInt32				GetInputBufferContiguousByteSize() const { return (mInputBufferStart <= mInputBufferEnd) ? (mInputBufferEnd - mInputBufferStart) : mInputBufferIsMirrored ? (mInputBufferByteSize - mInputBufferStart + mInputBufferEnd) : (mInputBufferByteSize - mInputBufferStart); }
 	virtual void		ReallocateInputBuffer(UInt32 inInputBufferByteSize);
+	bool				InputBufferIsMirrored() const { return mInputBufferIsMirrored; }
 	
 	// returns a pointer to contiguous bytes. 
 	// will do some copying if the request wraps around the internal buffer.
@@ -95,10 +100,14 @@ protected:
 	Byte*				GetBytes(UInt32& ioNumberBytes) const;
 
 private:	
+	void				FreeInputBuffer();
+
 	Byte*				mInputBuffer;
 	UInt32				mInputBufferByteSize;
+	UInt32				mInputBufferRequestedByteSize;
 	UInt32				mInputBufferStart;
 	UInt32				mInputBufferEnd;
+	bool				mInputBufferIsMirrored;
 
 };
 
@@ -406,18 +406,15 @@ OSStatus AudioFileObject::FrameToPacket(SInt64 inFrame, SInt64& outPacket, UInt3
 			return kAudioFileInvalidPacketOffsetError;
 			
 		// search packet table
-		AudioStreamPacketDescriptionExtended pext;
-		memset(&pext, 0, sizeof(pext));
-		pext.mFrameOffset = inFrame;
-		CompressedPacketTable::iterator iter = std::lower_bound(packetTable->begin(), packetTable->end(), pext);
+		SInt64 packet = packetTable->FirstPacketAtOrAfterFrame(inFrame);
 		
-		if (iter == packetTable->end())
+		if (packet == packetTable->size())
 			return kAudioFileInvalidPacketOffsetError;
 		
-		if (iter > packetTable->begin()) --iter;
+		if (packet > 0) --packet;
 		
-		outPacket = iter - packetTable->begin();
-		outFrameOffsetInPacket = (UInt32)(inFrame - iter->mFrameOffset);
+		outPacket = packet;
+		outFrameOffsetInPacket = (UInt32)(inFrame - (*packetTable)[packet].mFrameOffset);
 	}
 	else
 	{
@@ -465,11 +462,6 @@ OSStatus AudioFileObject::PacketToByte(AudioBytePacketTranslation* abpt)
 
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
-inline bool byte_less_than (const AudioStreamPacketDescriptionExtended& a, const AudioStreamPacketDescriptionExtended& b)
-{
-	return a.mStartOffset < b.mStartOffset;
-}
-
 OSStatus AudioFileObject::ByteToPacket(AudioBytePacketTranslation* abpt)
 {
 	if (mDataFormat.mBytesPerPacket == 0)
@@ -478,12 +470,9 @@ OSStatus AudioFileObject::ByteToPacket(AudioBytePacketTranslation* abpt)
 		if (!packetTable)
 			return kAudioFileInvalidPacketOffsetError;
 			// search packet table
-		AudioStreamPacketDescriptionExtended pext;
-		memset(&pext, 0, sizeof(pext));
-		pext.mStartOffset = abpt->mByte;
-		CompressedPacketTable::iterator iter = std::lower_bound(packetTable->begin(), packetTable->end(), pext, byte_less_than);
+		SInt64 packet = packetTable->FirstPacketAtOrAfterByte(abpt->mByte);
 		
-		if (iter == packetTable->end()) {
+		if (packet == packetTable->size()) {
 			SInt64 numPackets = packetTable->size();
 			if (numPackets < 8) 
 				return 'more' /*kAudioFileStreamError_DataUnavailable*/ ;
@@ -498,9 +487,9 @@ OSStatus AudioFileObject::ByteToPacket(AudioBytePacketTranslation* abpt)
 			abpt->mFlags = kBytePacketTranslationFlag_IsEstimate;
 			
 		} else {
-			if (iter > packetTable->begin()) --iter;
-			abpt->mPacket = iter - packetTable->begin();
-			abpt->mByteOffsetInPacket = (UInt32)(abpt->mByte - iter->mStartOffset);
+			if (packet > 0) --packet;
+			abpt->mPacket = packet;
+			abpt->mByteOffsetInPacket = (UInt32)(abpt->mByte - packetTable->ByteForPacket(packet));
 			abpt->mFlags = 0;
 		}
 	}
@@ -698,6 +687,85 @@ Bail:
 
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
+OSStatus AudioFileObject::ReadPacketDataNoCopy(	
+								UInt32							*ioNumBytes,
+								AudioStreamPacketDescription	*outPacketDescriptions,
+								SInt64							inStartingPacket, 
+								UInt32  						*ioNumPackets, 
+								const void						**outData)
+{
+	OSStatus		err = noErr;
+	SInt64			startingByte = 0;
+	UInt32			numBytes, numPackets;
+	const void*		data;
+	FailWithAction(ioNumPackets == NULL || *ioNumPackets < 1, err = kAudio_ParamError, Bail, "invalid ioNumPackets parameter");
+	FailWithAction(ioNumBytes   == NULL || *ioNumBytes   < 1, err = kAudio_ParamError, Bail, "invalid ioNumBytes parameter");
+	FailWithAction(outData      == NULL, err = kAudio_ParamError, Bail, "NULL outData");
+
+	numBytes = *ioNumBytes;
+	numPackets = *ioNumPackets;
+	if (mDataFormat.mBytesPerPacket) {
+	 	// CBR
+		UInt32 maxPackets = numBytes / mDataFormat.mBytesPerPacket;
+		if (numPackets > maxPackets) numPackets = maxPackets;
+		FailWithAction(numPackets == 0, err = kAudio_ParamError, Bail, "ioNumBytes smaller than one packet");
+
+		startingByte = inStartingPacket * mDataFormat.mBytesPerPacket;
+		if (startingByte >= GetNumBytes()) {
+			*ioNumBytes = 0;
+			*ioNumPackets = 0;
+			return kAudioFileEndOfFileError;
+		}
+		SInt64 packetsLeft = (GetNumBytes() - startingByte) / mDataFormat.mBytesPerPacket;
+		if (numPackets > packetsLeft) {
+			numPackets = (UInt32)packetsLeft;
+			err = kAudioFileEndOfFileError;
+		}
+		numBytes = numPackets * mDataFormat.mBytesPerPacket;
+	} else {
+		FailWithAction(outPacketDescriptions == NULL, err = kAudio_ParamError, Bail, "invalid outPacketDescriptions parameter");
+
+		// with the bytes in memory, scanning the whole request up front is cheap
+		err = ScanForPackets(inStartingPacket + numPackets);
+		if (err && err != kAudioFileEndOfFileError)
+			return err;
+		err = noErr;
+
+		CompressedPacketTable* packetTable = GetPacketTable();
+		if (!packetTable)
+			return kAudioFileInvalidFileError;
+		if (inStartingPacket >= GetPacketTableSize()) {
+			*ioNumBytes = 0;
+			*ioNumPackets = 0;
+			return kAudioFileEndOfFileError;
+		}
+
+		err = HowManyPacketsCanBeReadIntoBuffer(&numBytes, inStartingPacket, &numPackets);
+		if (err) return err;
+		startingByte = (*packetTable)[inStartingPacket].mStartOffset;
+	}
+
+	data = GetDataSource()->GetBytePointer(mDataOffset + startingByte, numBytes);
+	if (data == NULL)
+		return kAudioFileOperationNotSupportedError;
+
+	if (!mDataFormat.mBytesPerPacket) {
+		CompressedPacketTable* packetTable = GetPacketTable();
+		for (UInt32 i = 0; i < numPackets; i++) {
+			AudioStreamPacketDescription curPacket = (*packetTable)[i + inStartingPacket];
+			outPacketDescriptions[i] = curPacket;
+			outPacketDescriptions[i].mStartOffset = curPacket.mStartOffset - startingByte;
+		}
+	}
+	*outData = data;
+	*ioNumBytes = numBytes;
+	*ioNumPackets = numPackets;
+Bail:
+	return err;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
 OSStatus AudioFileObject::ReadPacketDataVBR(	
 								Boolean							inUseCache,
 								UInt32							*ioNumBytes,
@@ -1224,6 +1292,11 @@ OSStatus AudioFileObject::GetPropertyInfo	(
 			if (isWritable) *isWritable = 0;
 			break;
 
+		case kTEMPAudioFilePropertyDataSourceCacheStatistics :
+			if (outDataSize) *outDataSize = sizeof(DataSourceCacheStatistics);
+			writable = 0;
+			break;
+
 		case 'sbtd' /*kAudioFilePropertySourceBitDepth*/ :
 			if (outDataSize) *outDataSize = sizeof(SInt32);
 			if (isWritable) *isWritable = CanWrite();
@@ -1428,6 +1501,13 @@ OSStatus	AudioFileObject::GetProperty(
 			err = GetLyrics((CFStringRef*) ioPropertyData);
 			break;
 	
+		case kTEMPAudioFilePropertyDataSourceCacheStatistics :
+            FailWithAction(*ioDataSize != sizeof(DataSourceCacheStatistics), 
+				err = kAudioFileBadPropertySizeError, Bail, "inDataSize is wrong");
+			
+			err = GetDataSource()->GetCacheStatistics(*(DataSourceCacheStatistics*)ioPropertyData);
+			break;
+
 		case 'eof?' : 
 		{
             if (*ioDataSize != sizeof(UInt32))
@@ -1731,6 +1811,23 @@ OSStatus AudioFileObject::OpenFile(SInt8 inPermissions, int inFD)
 {
 	OSStatus err = noErr;
 
+#if !TARGET_OS_WIN32
+	// read-only files are mapped, and read ahead by the kernel. Those that can't be mapped are
+	// cached with the next block prefetched, since they are nearly always read front to back.
+	if (!(inPermissions & kAudioFileWritePermission)) {
+		MMap_DataSource* mapped = new MMap_DataSource(inFD, inPermissions, true);
+		if (mapped->IsMapped())
+			SetDataSource(mapped);
+		else {
+			mapped->SetCloseOnDelete(false);
+			delete mapped;
+				// UnixFile_DataSource reads with pread, so reading from the prefetch queue is safe
+			Cached_DataSource* cached = new Cached_DataSource(new UnixFile_DataSource(inFD, inPermissions, true));
+			cached->EnablePrefetch();
+			SetDataSource(cached);
+		}
+	} else
+#endif
 	SetDataSource(new Cached_DataSource(new UnixFile_DataSource(inFD, inPermissions, true)));
 	
 	mFileD = inFD;
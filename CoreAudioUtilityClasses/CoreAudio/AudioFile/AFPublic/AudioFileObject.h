@@ -120,7 +120,8 @@ enum {
 #endif
 
 enum {
-	kTEMPAudioFilePropertySoundCheckDictionary = 'scdc'
+	kTEMPAudioFilePropertySoundCheckDictionary = 'scdc',
+	kTEMPAudioFilePropertyDataSourceCacheStatistics = 'dscs'	// DataSourceCacheStatistics
 };
 
 const UInt32 kCopySoundDataBufferSize = 1024 * 1024;
@@ -302,6 +303,17 @@ public:
 									UInt32  						*ioNumPackets, 
 									void							*outBuffer);
 
+	// Like ReadPacketData, but instead of copying returns in *outData a pointer to the packets' bytes inside the
+	// data source (see DataSource::GetBytePointer), valid until the file is closed. Packet descriptions are relative
+	// to *outData. Returns kAudioFileOperationNotSupportedError, with the parameters left untouched, when the data
+	// source can't expose the bytes; fall back to ReadPacketData in that case.
+	virtual OSStatus ReadPacketDataNoCopy(	
+									UInt32							*ioNumBytes,
+									AudioStreamPacketDescription	*outPacketDescriptions,
+									SInt64							inStartingPacket, 
+									UInt32  						*ioNumPackets, 
+									const void						**outData);
+
 			OSStatus	HowManyPacketsCanBeReadIntoBuffer(UInt32* ioNumBytes, SInt64 inStartingPacket, UInt32 *ioNumPackets);
 
     virtual OSStatus	ReadPacketDataVBR_InTable(	
@@ -46,6 +46,7 @@
 */
 #include "CompressedPacketTable.h"
 #include "CAAutoDisposer.h"
+#include <algorithm>
 
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
@@ -74,6 +75,11 @@ void CompressedPacketTable::push_back(const AudioStreamPacketDescriptionExtended
 		newBase.mDescs = CA_malloc((kMask+1) * sizeof(AudioStreamPacketDescriptionExtended));
 		newBase.mDescType = kExtendedPacketDescription;
 		mBases.push_back(newBase);
+		
+		Checkpoint checkpoint;
+		checkpoint.mFrameOffset = inDesc.mFrameOffset;
+		checkpoint.mStartOffset = inDesc.mStartOffset;
+		mCheckpoints.push_back(checkpoint);
 	}
 	
 	PacketBase& base = mBases[(size_t)baseIndex];
@@ -135,6 +141,34 @@ const AudioStreamPacketDescriptionExtended CompressedPacketTable::operator[](SIn
 
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
+// The first checkpoint at or after the target tells us which sequence to look in: if it is the first
+// sequence the answer is packet 0, otherwise the answer is either within the preceding sequence or it is
+// the checkpoint's own packet. Only the preceding sequence's packets need to be decoded.
+#define FIRST_PACKET_AT_OR_AFTER(FIELD, TARGET, LESS) \
+	size_t checkpoint = std::lower_bound(mCheckpoints.begin(), mCheckpoints.end(), TARGET, LESS) - mCheckpoints.begin(); \
+	if (checkpoint == 0) \
+		return 0; \
+	SInt64 lo = ((SInt64)(checkpoint - 1) << kShift) + 1; \
+	SInt64 hi = std::min((SInt64)checkpoint << kShift, (SInt64)mSize); \
+	while (lo < hi) { \
+		SInt64 mid = lo + ((hi - lo) >> 1); \
+		if ((*this)[mid].FIELD < TARGET) lo = mid + 1; \
+		else hi = mid; \
+	} \
+	return lo;
+
+SInt64 CompressedPacketTable::FirstPacketAtOrAfterFrame(SInt64 inFrame) const
+{
+	FIRST_PACKET_AT_OR_AFTER(mFrameOffset, inFrame, FrameLess)
+}
+
+SInt64 CompressedPacketTable::FirstPacketAtOrAfterByte(SInt64 inByteOffset) const
+{
+	FIRST_PACKET_AT_OR_AFTER(mStartOffset, inByteOffset, ByteLess)
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
 bool CompressedPacketTable::isContiguous(PacketBase& base)
 {	
 	AudioStreamPacketDescriptionExtended* descs = (AudioStreamPacketDescriptionExtended*)base.mDescs;
@@ -82,6 +82,13 @@ public:
 	
 	//SInt64 PacketForByte(SInt64 inByteOffset) const;
 	SInt64 ByteForPacket(SInt64 inPacketIndex) const { return (*this)[inPacketIndex].mStartOffset; }
+	
+	// Equivalent to std::lower_bound over [begin(), end()) by mFrameOffset or mStartOffset: the index of the
+	// first packet at or after inFrame or inByteOffset, or size() if there is none. These binary search the
+	// checkpoints, which are small and contiguous, and then decode at most a few packets of one sequence,
+	// instead of decoding a packet description for every probe.
+	SInt64 FirstPacketAtOrAfterFrame(SInt64 inFrame) const;
+	SInt64 FirstPacketAtOrAfterByte(SInt64 inByteOffset) const;
 		
 	class iterator {
 		public:
@@ -160,6 +167,16 @@ private:
 		void* mDescs;
 	};
 	
+	// frame and byte offset of the first packet of each PacketBase, kept in their own array for searching
+	struct Checkpoint
+	{
+		SInt64 mFrameOffset;
+		SInt64 mStartOffset;
+	};
+	
+	static bool FrameLess(const Checkpoint& a, SInt64 inFrame) { return a.mFrameOffset < inFrame; }
+	static bool ByteLess(const Checkpoint& a, SInt64 inByteOffset) { return a.mStartOffset < inByteOffset; }
+	
 	enum {
 		kTinyContiguousPacketDescription,
 		kTinyDiscontiguousPacketDescription,
@@ -180,6 +197,7 @@ private:
 
 private:	
 	std::vector<PacketBase> mBases;
+	std::vector<Checkpoint> mCheckpoints;
 	UInt64 mSize;
 	UInt32 mFramesPerPacket;
 };
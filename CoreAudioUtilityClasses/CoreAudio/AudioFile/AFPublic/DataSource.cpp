@@ -50,6 +50,7 @@
 #else
 	#include <unistd.h>
 	#include <fcntl.h>
+	#include <sys/mman.h>
 #endif
 #include <sys/stat.h>
 #include <algorithm>
@@ -327,8 +328,308 @@ OSStatus	UnixFile_DataSource::WriteBytes(UInt16 positionMode,
 
 //////////////////////////////////////////////////////////////////////////////////////////
 
+#if !TARGET_OS_WIN32
+
+MMap_DataSource::MMap_DataSource( int inFD, SInt8 inPermissions, Boolean inCloseOnDelete)
+	: DataSource(false), mFile(inFD, inPermissions, inCloseOnDelete), mMapping(NULL), mMappedSize(0), mOffset(0),
+	  mNextSequentialOffset(-1), mSequentialReads(0), mReadAheadEnd(0), mAdvice(MADV_NORMAL)
+{
+	memset(&mStatistics, 0, sizeof(mStatistics));
+	
+	// a mapping of a file we may write to would go stale under our own writes
+	if (inPermissions & kAudioFileWritePermission) return;
+	
+	SInt64 size;
+	if (mFile.GetSize(size) || size <= 0 || (SInt64)(size_t)size != size) return;
+	
+	void* mapping = mmap(NULL, (size_t)size, PROT_READ, MAP_SHARED, inFD, 0);
+	if (mapping == MAP_FAILED) return;
+	
+	mMapping = (const UInt8*)mapping;
+	mMappedSize = size;
+}
+
+MMap_DataSource::~MMap_DataSource()
+{
+	if (mMapping) munmap((void*)mMapping, (size_t)mMappedSize);
+}
+
+void	MMap_DataSource::Advise(int inAdvice)
+{
+	if (inAdvice == mAdvice) return;
+	mAdvice = inAdvice;
+	madvise((void*)mMapping, (size_t)mMappedSize, inAdvice);
+}
+
+void	MMap_DataSource::NoteAccess(SInt64 inOffset, UInt32 inCount)
+{
+	if (inOffset == mNextSequentialOffset) {
+		if (mSequentialReads < kSequentialReadsBeforeHint) ++mSequentialReads;
+	} else {
+		mSequentialReads = 0;
+		mReadAheadEnd = 0;
+		Advise(MADV_NORMAL);
+	}
+	mNextSequentialOffset = inOffset + inCount;
+	
+	if (mSequentialReads < kSequentialReadsBeforeHint) return;
+	Advise(MADV_SEQUENTIAL);
+	
+		// ask for the next window once the reader is halfway into the current one, rather than on every read
+	if (mNextSequentialOffset + kReadAheadBytes / 2 < mReadAheadEnd) return;
+	
+	SInt64 pageSize = getpagesize();
+	SInt64 start = std::max(mNextSequentialOffset, mReadAheadEnd) & ~(pageSize - 1);
+	SInt64 end = std::min(mNextSequentialOffset + (SInt64)kReadAheadBytes, mMappedSize);
+	if (end > start) {
+		madvise((void*)(mMapping + start), (size_t)(end - start), MADV_WILLNEED);
+		++mStatistics.mPrefetches;
+	}
+	mReadAheadEnd = end;
+}
+
+OSStatus	MMap_DataSource::GetCacheStatistics(DataSourceCacheStatistics& outStatistics)
+{
+	outStatistics = mStatistics;
+	return noErr;
+}
+
+const void* MMap_DataSource::GetBytePointer(SInt64 inOffset, UInt32 inCount)
+{
+	if (!mMapping || inOffset < 0 || inOffset + inCount > mMappedSize) return NULL;
+	++mStatistics.mHits;
+	NoteAccess(inOffset, inCount);
+	return mMapping + inOffset;
+}
+
+OSStatus	MMap_DataSource::ReadBytes(	UInt16 positionMode, 
+								SInt64 positionOffset, 
+								UInt32 requestCount, 
+								void *buffer, 
+								UInt32* actualCount)
+{
+	if (actualCount) *actualCount = 0;
+	if (!buffer) return kAudio_ParamError;
+	
+	SInt64 offset = positionOffset;
+	if ((positionMode & kPositionModeMask) != SEEK_SET) {
+		SInt64 size;
+		OSStatus err = GetSize(size);
+		if (err) return err;
+		offset = CalcOffset(positionMode, positionOffset, mOffset, size);
+	}
+	if (offset < 0) return kAudioFilePositionError;
+	
+	if (!mMapping || (positionMode & kAudioFileNoCacheMask) || offset + requestCount > mMappedSize) {
+		++mStatistics.mMisses;
+		OSStatus err = mFile.ReadBytes((positionMode & ~kPositionModeMask) | SEEK_SET, offset, requestCount, buffer, actualCount);
+		mFile.GetPos(mOffset);
+		return err;
+	}
+	
+	++mStatistics.mHits;
+	NoteAccess(offset, requestCount);
+	memcpy(buffer, mMapping + offset, requestCount);
+	mOffset = offset + requestCount;
+	
+	if (actualCount) *actualCount = requestCount;
+	return noErr;
+}
+
+OSStatus	MMap_DataSource::WriteBytes(UInt16 positionMode, 
+								SInt64 positionOffset, 
+								UInt32 requestCount, 
+								const void *buffer, 
+								UInt32* actualCount)
+{
+	if ((positionMode & kPositionModeMask) == SEEK_CUR) {
+		positionMode = (positionMode & ~kPositionModeMask) | SEEK_SET;
+		positionOffset += mOffset;
+	}
+	OSStatus err = mFile.WriteBytes(positionMode, positionOffset, requestCount, buffer, actualCount);
+	mFile.GetPos(mOffset);
+	return err;
+}
+
+#endif
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
 #define NO_CACHE 0
 
+Cached_DataSource::Cached_DataSource(DataSource* inDataSource, UInt32 inHeaderCacheSize, UInt32 inBodyCacheSize, Boolean inOwnDataSource,
+					UInt32 inNumBodyBlocks)
+	: DataSource(false), 
+	mDataSource(inDataSource), mHeaderCacheSize(inHeaderCacheSize), 
+	mBodyCacheSize(inBodyCacheSize), mBodyBlocks(std::max(inNumBodyBlocks, (UInt32)1)), mUseCounter(0),
+	mOffset(0),
+	mOwnDataSource(inOwnDataSource),
+	mPrefetchMutex(NULL), mSourceMutex(NULL), mPrefetchOffset(-1), mPrefetchPending(false)
+#if !TARGET_OS_WIN32
+	, mPrefetchGroup(NULL)
+#endif
+{
+	memset(&mStatistics, 0, sizeof(mStatistics));
+	for (size_t i = 0; i < mBodyBlocks.size(); ++i) {
+		mBodyBlocks[i].mOffset = -1;
+		mBodyBlocks[i].mCurSize = 0;
+		mBodyBlocks[i].mLastUse = 0;
+		mBodyBlocks[i].mPrefetched = false;
+	}
+}
+
+Cached_DataSource::~Cached_DataSource()
+{
+#if !TARGET_OS_WIN32
+	if (mPrefetchGroup) {
+		dispatch_group_wait(mPrefetchGroup, DISPATCH_TIME_FOREVER);
+		dispatch_release(mPrefetchGroup);
+	}
+#endif
+	delete mPrefetchMutex;
+	delete mSourceMutex;
+	if (mOwnDataSource) delete mDataSource;
+}
+
+void Cached_DataSource::EnablePrefetch()
+{
+#if !TARGET_OS_WIN32
+	// the prefetched block replaces one the reader isn't using
+	if (mPrefetchMutex || mBodyBlocks.size() < 2) return;
+	mPrefetchMutex = new CAMutex("Cached_DataSource cache");
+	mSourceMutex = new CAMutex("Cached_DataSource source");
+	mPrefetchData.allocBytes(mBodyCacheSize);
+	mPrefetchGroup = dispatch_group_create();
+#endif
+}
+
+OSStatus Cached_DataSource::GetCacheStatistics(DataSourceCacheStatistics& outStatistics)
+{
+	CAMutex::Locker lock(mPrefetchMutex);
+	outStatistics = mStatistics;
+	return noErr;
+}
+
+OSStatus Cached_DataSource::SetSize(SInt64 inSize)
+{
+	CAMutex::Locker lock(mPrefetchMutex);
+	for (size_t i = 0; i < mBodyBlocks.size(); ++i)
+		mBodyBlocks[i].mOffset = -1;
+	mPrefetchOffset = -1;
+	CAMutex::Locker sourceLock(mSourceMutex);
+	return mDataSource->SetSize(inSize);
+}
+
+Cached_DataSource::BodyBlock* Cached_DataSource::FindBlock(SInt64 inBlockOffset)
+{
+	for (size_t i = 0; i < mBodyBlocks.size(); ++i)
+		if (mBodyBlocks[i].mOffset == inBlockOffset) return &mBodyBlocks[i];
+	return NULL;
+}
+
+Cached_DataSource::BodyBlock* Cached_DataSource::LeastRecentlyUsedBlock()
+{
+	BodyBlock* lru = &mBodyBlocks[0];
+	for (size_t i = 1; i < mBodyBlocks.size(); ++i) {
+		if (mBodyBlocks[i].mLastUse < lru->mLastUse) lru = &mBodyBlocks[i];
+	}
+	return lru;
+}
+
+OSStatus Cached_DataSource::FillBodyBlock(BodyBlock& inBlock, SInt64 inBlockOffset)
+{
+	if (!mBodyCache()) mBodyCache.allocBytes(mBodyCacheSize * mBodyBlocks.size(), true);
+	
+	inBlock.mOffset = inBlockOffset;
+	inBlock.mPrefetched = false;
+	CAMutex::Locker sourceLock(mSourceMutex);
+	OSStatus err = mDataSource->ReadBytes(SEEK_SET, inBlockOffset, mBodyCacheSize, BlockData(inBlock), &inBlock.mCurSize);
+	if (err == kAudioFileEndOfFileError) err = noErr;
+	if (err) {
+		inBlock.mOffset = -1;
+		inBlock.mCurSize = 0;
+	}
+	return err;
+}
+
+OSStatus Cached_DataSource::GetBodyBlock(SInt64 inOffset, BodyBlock*& outBlock)
+{
+	SInt64 blockOffset = inOffset - inOffset % mBodyCacheSize;
+	BodyBlock* block = FindBlock(blockOffset);
+	
+		// a short block may have been cut off by the end of a file that has grown since, so read it again
+	if (block && inOffset - blockOffset < block->mCurSize) {
+		++mStatistics.mHits;
+		block->mLastUse = ++mUseCounter;
+		if (block->mPrefetched) {
+			block->mPrefetched = false;
+			Prefetch(blockOffset + mBodyCacheSize);
+		}
+		outBlock = block;
+		return noErr;
+	}
+	
+	++mStatistics.mMisses;
+	if (!block)
+		block = LeastRecentlyUsedBlock();
+	
+	OSStatus err = FillBodyBlock(*block, blockOffset);
+	if (err) return err;
+	block->mLastUse = ++mUseCounter;
+	if (block->mCurSize == mBodyCacheSize)
+		Prefetch(blockOffset + mBodyCacheSize);
+	outBlock = block;
+	return noErr;
+}
+
+void Cached_DataSource::Prefetch(SInt64 inBlockOffset)
+{
+#if !TARGET_OS_WIN32
+	if (!mPrefetchMutex || mPrefetchPending || FindBlock(inBlockOffset)) return;
+	
+	mPrefetchOffset = inBlockOffset;
+	mPrefetchPending = true;
+	dispatch_group_async_f(mPrefetchGroup, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_LOW, 0), this, PrefetchProc);
+#endif
+}
+
+void Cached_DataSource::PrefetchProc(void* inRefCon)
+{
+	Cached_DataSource* THIS = static_cast<Cached_DataSource*>(inRefCon);
+	
+	SInt64 offset;
+	{
+		CAMutex::Locker lock(THIS->mPrefetchMutex);
+		offset = THIS->mPrefetchOffset;
+	}
+	
+		// read without holding the cache, so the reader can go on using the blocks it has
+	OSStatus err = noErr;
+	UInt32 size = 0;
+	if (offset >= 0) {
+		CAMutex::Locker sourceLock(THIS->mSourceMutex);
+		err = THIS->mDataSource->ReadBytes(SEEK_SET, offset, THIS->mBodyCacheSize, THIS->mPrefetchData(), &size);
+		if (err == kAudioFileEndOfFileError) err = noErr;
+	}
+	
+	CAMutex::Locker lock(THIS->mPrefetchMutex);
+	bool cancelled = THIS->mPrefetchOffset != offset;
+	THIS->mPrefetchOffset = -1;
+	THIS->mPrefetchPending = false;
+		// a write may have cancelled the prefetch, or the reader may have read the block itself, meanwhile
+	if (offset < 0 || cancelled || err || size == 0 || THIS->FindBlock(offset)) return;
+	
+	if (!THIS->mBodyCache()) THIS->mBodyCache.allocBytes(THIS->mBodyCacheSize * THIS->mBodyBlocks.size(), true);
+	BodyBlock* block = THIS->LeastRecentlyUsedBlock();
+	memcpy(THIS->BlockData(*block), THIS->mPrefetchData(), size);
+	block->mOffset = offset;
+	block->mCurSize = size;
+	block->mPrefetched = true;
+	block->mLastUse = ++THIS->mUseCounter;
+	++THIS->mStatistics.mPrefetches;
+}
+
+
 OSStatus Cached_DataSource::ReadFromHeaderCache(
 					SInt64 offset, 
 					UInt32 requestCount,
@@ -343,6 +644,7 @@ OSStatus Cached_DataSource::ReadFromHeaderCache(
 	printf("read from header %lld %lu   %lld %lu\n", offset, requestCount, 0LL, mHeaderCacheSize);
 #endif
 
+	CAMutex::Locker sourceLock(mSourceMutex);
 	if (!mHeaderCache()) 
 	{
 		mHeaderCache.allocBytes(mHeaderCacheSize, true);
@@ -383,6 +685,8 @@ OSStatus Cached_DataSource::ReadBytes(
 
 	if (!buffer) return kAudio_ParamError;
 
+	CAMutex::Locker lock(mPrefetchMutex);
+
 	if ((positionMode & kPositionModeMask) != SEEK_END) size = 0; // not used in this case
 	else 
 	{
@@ -402,90 +706,37 @@ OSStatus Cached_DataSource::ReadBytes(
 	mOffset = offset + theActualCount;
 #else
 
-	SInt64 cacheEnd = mBodyCacheOffset + mBodyCacheCurSize;
-	if (mBodyCache() && requestCount < mBodyCacheSize && offset >= mBodyCacheOffset && offset < cacheEnd)
+	if (requestCount > mBodyCacheSize)
 	{
-		if (offset + requestCount <= cacheEnd) 
-		{
-			// request is entirely within cache
 #if VERBOSE	
-			printf("request is entirely within cache %lld %lu   %lld %lu\n", offset, requestCount, mBodyCacheOffset, mBodyCacheCurSize);
+		printf("large request %lld %lu\n", offset, requestCount);
 #endif
-			memcpy(buffer, mBodyCache + (size_t)(offset - mBodyCacheOffset), requestCount);
-			theActualCount = requestCount;
-		}
-		else
-		{
-			// part of request is within cache. copy, read next cache block, copy.
-#if VERBOSE	
-			printf("part of request is within cache %lld %lu   %lld %lu\n", offset, requestCount, mBodyCacheOffset, mBodyCacheCurSize);
-#endif
-			
-			// copy first part.
-			ByteCount firstPart = (ByteCount)(cacheEnd - offset);
-			ByteCount secondPart = requestCount - firstPart;
-#if VERBOSE	
-			printf("memcpy   offset %lld  mBodyCacheOffset %lld  offset - mBodyCacheOffset %lld  firstPart %lu   requestCount %lu\n", 
-						offset, mBodyCacheOffset, offset - mBodyCacheOffset, firstPart, requestCount);
-#endif
-			memcpy(buffer, mBodyCache + (size_t)(offset - mBodyCacheOffset), firstPart);
-			
-			theActualCount = firstPart;
-			
-			// read new block
-			SInt64 nextOffset = mBodyCacheOffset + mBodyCacheCurSize;
-			err = mDataSource->ReadBytes(SEEK_SET, nextOffset, mBodyCacheSize, mBodyCache(), &mBodyCacheCurSize);
-			
-			if (err == kAudioFileEndOfFileError) err = noErr;
-			if (err) goto leave;
-
-			mBodyCacheOffset = nextOffset;
-
-			// copy second part
-			secondPart = std::min(secondPart, (ByteCount)mBodyCacheCurSize);
-			if (secondPart) memcpy((char*)buffer + firstPart, mBodyCache(), secondPart);
-			theActualCount = firstPart + secondPart;
-		}
+		// the request is larger than we normally cache, just do a read and don't cache.
+		CAMutex::Locker sourceLock(mSourceMutex);
+		err = mDataSource->ReadBytes(positionMode, positionOffset, requestCount, buffer, &theActualCount);
 	}
-	else 
+	else
 	{
-		if (requestCount > mBodyCacheSize)
-		{
-#if VERBOSE	
-			printf("large request %lld %lu   %lld %lu\n", offset, requestCount, mBodyCacheOffset, mBodyCacheCurSize);
-#endif
-			// the request is larger than we normally cache, just do a read and don't cache.
-			err = mDataSource->ReadBytes(positionMode, positionOffset, requestCount, buffer, &theActualCount);
-			mOffset = offset + theActualCount;
-		}
-		else
+		// copy block by block; an unaligned request spans at most two.
+		while (theActualCount < requestCount)
 		{
-			// request is outside cache. read new block.
-#if VERBOSE	
-			printf("request is outside cache %lld %lu   %lld %lu\n", offset, requestCount, mBodyCacheOffset, mBodyCacheCurSize);
-#endif
-			if (!mBodyCache()) 
-			{
-				mBodyCache.allocBytes(mBodyCacheSize, true);
-#if VERBOSE	
-				printf("alloc mBodyCache %08X\n", mBodyCache());
-#endif
-			}
-			mBodyCacheOffset = offset;
-			err = mDataSource->ReadBytes(SEEK_SET, mBodyCacheOffset, mBodyCacheSize, mBodyCache(), &mBodyCacheCurSize);
+			SInt64 curOffset = offset + theActualCount;
+			BodyBlock* block;
+			err = GetBodyBlock(curOffset, block);
+			if (err) break;
+			
+			SInt64 offsetInBlock = curOffset - block->mOffset;
+			if (offsetInBlock >= block->mCurSize) break; // end of file
 #if VERBOSE	
-			printf("read %08X %d    mBodyCacheOffset %lld   %lu %lu\n", err, err, mBodyCacheOffset, mBodyCacheSize, mBodyCacheCurSize);
+			printf("read from block %lld %lu   %lld %lu\n", curOffset, requestCount - theActualCount, block->mOffset, block->mCurSize);
 #endif
-			if (err == kAudioFileEndOfFileError) err = noErr;
-			if (err) return err;
-
-			theActualCount = std::min(requestCount, mBodyCacheCurSize);
-			memcpy(buffer, mBodyCache(), theActualCount);
+			UInt32 part = std::min(requestCount - theActualCount, (UInt32)(block->mCurSize - offsetInBlock));
+			memcpy((char*)buffer + theActualCount, BlockData(*block) + (size_t)offsetInBlock, part);
+			theActualCount += part;
 		}
-		
 	}
+	mOffset = offset + theActualCount;
 
-leave:
 #endif
 	if (actualCount) *actualCount = (UInt32)theActualCount;
 #if VERBOSE	
@@ -506,6 +757,8 @@ OSStatus Cached_DataSource::WriteBytes(
 
 	if (!buffer) return kAudio_ParamError;
 	
+	CAMutex::Locker lock(mPrefetchMutex);
+
 	if ((positionMode & kPositionModeMask) != SEEK_END) size = 0; // not used in this case
 	else 
 	{
@@ -530,18 +783,32 @@ OSStatus Cached_DataSource::WriteBytes(
 	printf("write %lld %lu    %lld %d %lld\n", offset, requestCount, mOffset, positionMode, positionOffset);
 #endif
 
-	SInt64 cacheEnd = mBodyCacheOffset + mBodyCacheCurSize;
-	if (mBodyCache() && offset >= mBodyCacheOffset && offset < cacheEnd)
+	SInt64 writeEnd = offset + requestCount;
+	if (mPrefetchOffset >= 0 && mPrefetchOffset < writeEnd && mPrefetchOffset + mBodyCacheSize > offset)
+		mPrefetchOffset = -1;	// the prefetch may read the old data
+	for (size_t i = 0; i < mBodyBlocks.size(); ++i)
 	{
+		BodyBlock& block = mBodyBlocks[i];
+		if (block.mOffset < 0 || block.mOffset >= writeEnd || block.mOffset + mBodyCacheSize <= offset) continue;
+		
+		if (block.mCurSize < mBodyCacheSize) {
+			// cut short by the end of file; read it again when needed
+			block.mOffset = -1;
+			block.mCurSize = 0;
+			continue;
+		}
+		
 		// body cache write through
-		ByteCount firstPart = std::min((SInt64)requestCount, cacheEnd - offset);
+		SInt64 start = std::max(offset, block.mOffset);
+		SInt64 end = std::min(writeEnd, block.mOffset + mBodyCacheSize);
 #if VERBOSE	
-		printf("body cache write through %lld %lu  %lld %lu\n", mBodyCacheOffset, mBodyCacheCurSize, offset, firstPart);
+		printf("body cache write through %lld %lu  %lld %lld\n", block.mOffset, block.mCurSize, start, end - start);
 #endif
-		memcpy(mBodyCache + (offset - mBodyCacheOffset), buffer, firstPart);
+		memcpy(BlockData(block) + (size_t)(start - block.mOffset), (const char*)buffer + (size_t)(start - offset), (size_t)(end - start));
 	}
 	
 	UInt32 theActualCount;
+	CAMutex::Locker sourceLock(mSourceMutex);
 	err = mDataSource->WriteBytes(positionMode, positionOffset, requestCount, buffer, &theActualCount);
 	
 	mOffset = offset + theActualCount;
@@ -56,10 +56,22 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdexcept>
+#include <vector>
 #include "CAAutoDisposer.h"
+#include "CAMutex.h"
+#if !TARGET_OS_WIN32
+	#include <dispatch/dispatch.h>
+#endif
 
 //////////////////////////////////////////////////////////////////////////////////////////
 
+struct DataSourceCacheStatistics
+{
+	UInt64	mHits;			// body block lookups served from the cache
+	UInt64	mMisses;		// body block lookups that read the wrapped source
+	UInt64	mPrefetches;	// blocks read ahead on the background queue
+};
+
 class DataSource
 {
 public:
@@ -102,6 +114,12 @@ public:
 	
 	virtual void SetCloseOnDelete(Boolean inFlag) { mCloseOnDelete = inFlag; }
 	
+	virtual OSStatus GetCacheStatistics(DataSourceCacheStatistics& /*outStatistics*/) { return kAudioFileUnsupportedPropertyError; }
+	
+	/* Returns a pointer to inCount bytes starting at absolute offset inOffset if the source holds them
+	   in memory, otherwise NULL. The pointer stays valid until the source is deleted. */
+	virtual const void* GetBytePointer(SInt64 /*inOffset*/, UInt32 /*inCount*/) { return NULL; }
+	
 	virtual Boolean CanSeek() const=0;
 	virtual Boolean CanGetSize() const=0;
 	virtual Boolean CanSetSize() const=0;
@@ -209,44 +227,136 @@ private:
 
 //////////////////////////////////////////////////////////////////////////////////////////
 
+#if !TARGET_OS_WIN32
+/*
+	Maps a file opened read-only and serves reads straight out of the mapping, so a read is a single
+	memcpy and GetBytePointer can hand out zero-copy slices of the file.
+	Paging is steered with madvise from the observed access pattern: after kSequentialReadsBeforeHint
+	reads that each start where the previous one ended, the mapping is marked MADV_SEQUENTIAL and the
+	next kReadAheadBytes are requested with MADV_WILLNEED; a seek drops it back to MADV_NORMAL.
+	Files that are writable, empty or can't be mapped, reads with kAudioFileNoCacheMask and reads
+	beyond the mapped length (the file grew after it was opened) go through pread.
+	GetCacheStatistics counts reads served from the mapping as hits, reads that went through pread
+	as misses, and read-ahead windows requested with MADV_WILLNEED as prefetches.
+	
+	The mapping is made when the file is opened. If another process truncates the file while it is
+	open, touching mapped pages past the new end raises SIGBUS, where pread would have returned a
+	short read. Only files opened read-only are mapped, but that does not stop other writers; a
+	client that must survive a file being cut short underneath it should open it with write
+	permission, which reads through Cached_DataSource instead.
+*/
+class MMap_DataSource : public DataSource
+{
+	UnixFile_DataSource mFile;
+	const UInt8* mMapping;
+	SInt64 mMappedSize;
+	SInt64 mOffset;
+	SInt64 mNextSequentialOffset;
+	UInt32 mSequentialReads;
+	SInt64 mReadAheadEnd;
+	int mAdvice;
+	DataSourceCacheStatistics mStatistics;
+	
+public:
+	enum {
+		kSequentialReadsBeforeHint	= 4,
+		kReadAheadBytes				= 1024 * 1024
+	};
+
+	MMap_DataSource( int inFD, SInt8 inPermissions, Boolean inCloseOnDelete);
+	virtual ~MMap_DataSource();
+	
+	virtual OSStatus GetSize(SInt64& outSize) { return mFile.GetSize(outSize); }
+	virtual OSStatus GetPos(SInt64& outPos) const { outPos = mOffset; return noErr; }
+	
+	virtual OSStatus SetSize(SInt64 inSize) { return mFile.SetSize(inSize); }
+	
+	virtual OSStatus ReadBytes(	UInt16 positionMode, 
+								SInt64 positionOffset, 
+								UInt32 requestCount, 
+								void *buffer, 
+								UInt32* actualCount);
+						
+	virtual OSStatus WriteBytes(UInt16 positionMode, 
+								SInt64 positionOffset, 
+								UInt32 requestCount, 
+								const void *buffer, 
+								UInt32* actualCount);
+	
+	virtual void SetCloseOnDelete(Boolean inFlag) { mFile.SetCloseOnDelete(inFlag); }
+	
+	virtual OSStatus GetCacheStatistics(DataSourceCacheStatistics& outStatistics);
+	
+	virtual const void* GetBytePointer(SInt64 inOffset, UInt32 inCount);
+	
+	virtual Boolean CanSeek() const { return true; }
+	virtual Boolean CanGetSize() const { return true; }
+	virtual Boolean CanSetSize() const { return mFile.CanSetSize(); }
+	
+	virtual Boolean CanRead() const { return mFile.CanRead(); }
+	virtual Boolean CanWrite() const { return mFile.CanWrite(); }
+	
+	Boolean IsMapped() const { return mMapping != NULL; }
+
+private:
+
+	void	NoteAccess(SInt64 inOffset, UInt32 inCount);
+	void	Advise(int inAdvice);
+};
+#endif
+
 //////////////////////////////////////////////////////////////////////////////////////////
 
 /*
-	A wrapper that caches the wrapped source's header.
+	A wrapper that caches the wrapped source's header, plus an LRU set of body blocks.
+	Body blocks are inBodyCacheSize bytes, aligned to multiples of that size, and there are inNumBodyBlocks
+	of them, so interleaved readers (packet table and audio data, several scrub positions) each keep
+	their own blocks instead of evicting a single window.
+	With EnablePrefetch, every fetched block schedules a read of the block after it on a background
+	queue. The wrapped source is then called from that queue too, serialized by its own mutex, so only
+	enable it for sources whose reads don't depend on the calling thread. The prefetch reads into a
+	private buffer without holding the cache's mutex, and only takes it to copy the result into the
+	least recently used block, so readers hitting the cache don't wait for the prefetch's I/O.
 */
 class Cached_DataSource : public DataSource
 {
+	struct BodyBlock {
+		SInt64	mOffset;		// -1 if empty
+		UInt32	mCurSize;
+		UInt64	mLastUse;
+		bool	mPrefetched;	// filled by a prefetch and not read yet
+	};
+
 	DataSource* mDataSource;
 	CAAutoFree<UInt8> mHeaderCache;
 	UInt32 mHeaderCacheSize;
 	CAAutoFree<UInt8> mBodyCache;
 	UInt32 mBodyCacheSize;
-	UInt32 mBodyCacheCurSize;
-	SInt64 mBodyCacheOffset;
+	std::vector<BodyBlock> mBodyBlocks;
+	UInt64 mUseCounter;
 	SInt64 mOffset;
 	Boolean mOwnDataSource;
+	DataSourceCacheStatistics mStatistics;
+	CAMutex* mPrefetchMutex;		// guards the cache; NULL unless prefetching
+	CAMutex* mSourceMutex;			// serializes calls to mDataSource; NULL unless prefetching
+	CAAutoFree<UInt8> mPrefetchData;	// mBodyCacheSize bytes the prefetch reads into
+	SInt64 mPrefetchOffset;			// the block the queued prefetch should read, or -1 if none or cancelled
+	bool mPrefetchPending;			// a prefetch is queued or running
+#if !TARGET_OS_WIN32
+	dispatch_group_t mPrefetchGroup;
+#endif
 	
 public:
+	enum { kDefaultNumBodyBlocks = 4 };
 
-	Cached_DataSource(DataSource* inDataSource, UInt32 inHeaderCacheSize = 4096, UInt32 inBodyCacheSize = 32768, Boolean inOwnDataSource = true)
-					: DataSource(false), 
-					mDataSource(inDataSource), mHeaderCacheSize(inHeaderCacheSize), 
-					mBodyCacheSize(inBodyCacheSize), mBodyCacheCurSize(0), mBodyCacheOffset(-1), 
-					mOffset(0),
-					mOwnDataSource(inOwnDataSource)
-				{
-				}
-				
-	virtual ~Cached_DataSource()
-				{
-					if (mOwnDataSource) delete mDataSource;
-				}
-
+	Cached_DataSource(DataSource* inDataSource, UInt32 inHeaderCacheSize = 4096, UInt32 inBodyCacheSize = 32768, Boolean inOwnDataSource = true,
+					UInt32 inNumBodyBlocks = kDefaultNumBodyBlocks);
+	virtual ~Cached_DataSource();
 	
-	virtual OSStatus GetSize(SInt64& outSize) { return mDataSource->GetSize(outSize); }
-	virtual OSStatus GetPos(SInt64& outPos) const { return mDataSource->GetPos(outPos); } 
+	virtual OSStatus GetSize(SInt64& outSize) { CAMutex::Locker lock(mSourceMutex); return mDataSource->GetSize(outSize); }
+	virtual OSStatus GetPos(SInt64& outPos) const { CAMutex::Locker lock(mSourceMutex); return mDataSource->GetPos(outPos); } 
 	
-	virtual OSStatus SetSize(SInt64 inSize) { return mDataSource->SetSize(inSize); }
+	virtual OSStatus SetSize(SInt64 inSize);
 	
 	virtual OSStatus ReadBytes(		UInt16 positionMode, 
 									SInt64 positionOffset, 
@@ -265,12 +375,28 @@ public:
 									void *buffer, 
 									UInt32* actualCount);
 	
+	virtual OSStatus GetCacheStatistics(DataSourceCacheStatistics& outStatistics);
+	
+	void EnablePrefetch();
+	
 	virtual Boolean CanSeek() const { return mDataSource->CanSeek(); }
 	virtual Boolean CanGetSize() const { return mDataSource->CanGetSize(); }
 	virtual Boolean CanSetSize() const { return mDataSource->CanSetSize(); }
 	
+	virtual const void* GetBytePointer(SInt64 inOffset, UInt32 inCount) { return mDataSource->GetBytePointer(inOffset, inCount); }
+	
 	virtual Boolean CanRead() const { return mDataSource->CanRead(); }
 	virtual Boolean CanWrite() const { return mDataSource->CanWrite(); }
+
+private:
+
+	UInt8*		BlockData(const BodyBlock& inBlock) { return mBodyCache() + (size_t)(&inBlock - &mBodyBlocks[0]) * mBodyCacheSize; }
+	OSStatus	GetBodyBlock(SInt64 inOffset, BodyBlock*& outBlock);
+	OSStatus	FillBodyBlock(BodyBlock& inBlock, SInt64 inBlockOffset);
+	BodyBlock*	FindBlock(SInt64 inBlockOffset);
+	BodyBlock*	LeastRecentlyUsedBlock();
+	void		Prefetch(SInt64 inBlockOffset);
+	static void	PrefetchProc(void* inRefCon);
 };
 
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -360,6 +486,13 @@ public:
 								const void *buffer, 
 								UInt32* actualCount) { throw std::runtime_error("not writable"); }
 
+	virtual const void* GetBytePointer(SInt64 inOffset, UInt32 inCount)
+	{
+		SInt64 offsetWithinBuffer = inOffset - mStartOffset;
+		if (offsetWithinBuffer < 0 || offsetWithinBuffer + inCount > mDataByteSize) return NULL;
+		return mData + offsetWithinBuffer;
+	}
+
 	virtual Boolean CanSeek() const { return true; }
 	virtual Boolean CanGetSize() const { return true; }
 	virtual Boolean CanSetSize() const { return false; }
@@ -49,10 +49,14 @@
 #include "AUInputElement.h"
 #include "AUOutputElement.h"
 #include <algorithm>
+#include "CAAtomic.h"
 #include "CAAudioChannelLayout.h"
 #include "CAHostTimeBase.h"
 #include "CAVectorUnit.h"
 #include "CAXException.h"
+#if TARGET_OS_MAC
+	#include <unistd.h>
+#endif
 
 
 
@@ -99,9 +103,17 @@ AUBase::AUBase(	AudioComponentInstance			inInstance,
 #if !CA_BASIC_AU_FEATURES
 	mInitNumGroupEls(numGroupElements),
 #endif
-	mRenderCallbacksTouched(false),
+	mRenderCallbacks(NULL),
+	mRenderEpoch(0),
+	mRenderCallbackLock("AUBase render notifications"),
 	mRenderThreadID (NULL),
 	mWantsRenderThreadID (false),
+	mMaxScheduledParameterEvents(0),
+	mDroppedParameterEvents(0),
+	mParameterWriteSequence(0),
+	mRenderProfiler(NULL),
+	mRenderProfilingEnabled(false),
+	mRenderProfileCursor(0),
 	mLastRenderError(0),
 	mBuffersAllocated(false),
 	mLogString (NULL)
@@ -111,6 +123,8 @@ AUBase::AUBase(	AudioComponentInstance			inInstance,
 	#endif
 {
 	ResetRenderTime ();
+	mRendersInEpoch[0] = mRendersInEpoch[1] = 0;
+	mRetiredRenderCallbacks.reserve(kMaxRetiredRenderCallbacks + 1);
 	
 	if(!sAUBaseCFStringsInitialized)
 	{
@@ -139,7 +153,7 @@ AUBase::AUBase(	AudioComponentInstance			inInstance,
 	GlobalScope().Initialize(this, kAudioUnitScope_Global, 1);
 	
 	if (mAudioUnitAPIVersion > 1) 
-		mParamList.reserve (24);
+		SetMaxScheduledParameterEvents(kAUDefaultMaxScheduledParameterEvents);
 
 #if !CA_NO_AU_UI_FEATURES
 	memset (&mHostCallbackInfo, 0, sizeof (mHostCallbackInfo));
@@ -160,6 +174,10 @@ AUBase::~AUBase()
 	if (mContextName) CFRelease (mContextName);
 #endif
 	if (mLogString) delete [] mLogString;
+	
+	ReclaimRenderCallbacks(true);
+	delete mRenderCallbacks;
+	delete mRenderProfiler;
 }
 
 //_____________________________________________________________________________
@@ -185,9 +203,40 @@ void	AUBase::SetMaxFramesPerSlice(UInt32 nFrames)
 	mMaxFramesPerSlice = nFrames;
 	if (mBuffersAllocated)
 		ReallocateBuffers();
+	for (ParameterRampList::iterator it = mParameterRamps.begin(); it != mParameterRamps.end(); ++it)
+		it->mValues.resize((nFrames + it->mFramesPerValue - 1) / it->mFramesPerValue);
 	PropertyChanged(kAudioUnitProperty_MaximumFramesPerSlice, kAudioUnitScope_Global, 0);
 }
 
+//_____________________________________________________________________________
+//
+void	AUBase::SetMaxScheduledParameterEvents(UInt32 nEvents)
+{
+	mMaxScheduledParameterEvents = nEvents;
+	// the queue's storage only ever grows, so ScheduleParameter() never reallocates it
+	if (mParamList.capacity() < nEvents)
+		mParamList.reserve(nEvents);
+	if (mParamListSequences.capacity() < nEvents)
+		mParamListSequences.reserve(nEvents);
+	if (mScheduledParamHeap.capacity() < nEvents)
+		mScheduledParamHeap.reserve(nEvents);
+	if (mActiveParamEvents.capacity() < nEvents)
+		mActiveParamEvents.reserve(nEvents);
+}
+
+//_____________________________________________________________________________
+//
+void	AUBase::SetRenderProfilingEnabled(bool inEnabled)
+{
+	if (inEnabled && mRenderProfiler == NULL) {
+		// the profiler is never deleted while the unit lives, so the render thread can't lose it
+		mRenderProfiler = new AURenderProfiler;
+		mRenderProfileCursor = 0;
+		CAMemoryBarrier();
+	}
+	mRenderProfilingEnabled = inEnabled;
+}
+
 //_____________________________________________________________________________
 //
 OSStatus			AUBase::CanSetMaxFrames() const
@@ -226,6 +275,8 @@ OSStatus			AUBase::DoInitialize()
 		if (result == noErr) {
 			mHasBegunInitializing = true;
 			ReallocateBuffers();	// calls CreateElements()
+			for (AudioUnitScope i = 0; i < kNumScopes; ++i)
+				GetScope(i).BuildParameterTables();
 			mInitialized = true;	// signal that it's okay to render
 			CAMemoryBarrier();
 		}
@@ -511,6 +562,18 @@ OSStatus			AUBase::DispatchGetPropertyInfo(AudioUnitPropertyID				inID,
 		outWritable = false;
 		break;
 	
+	case kAUBaseProperty_RenderProfilingEnabled:
+		ca_require(inScope == kAudioUnitScope_Global, InvalidScope);
+		outDataSize = sizeof(UInt32);
+		outWritable = true;
+		break;
+	
+	case kAUBaseProperty_RenderProfile:
+		ca_require(inScope == kAudioUnitScope_Global, InvalidScope);
+		outDataSize = sizeof(AURenderProfileData);
+		outWritable = false;
+		break;
+	
 	default:
 		result = GetPropertyInfo(inID, inScope, inElement, outDataSize, outWritable);
 		validateElement = false;
@@ -755,6 +818,20 @@ OSStatus			AUBase::DispatchGetProperty(	AudioUnitPropertyID 			inID,
 		*(Float64*)outData = mCurrentRenderTime.mSampleTime;
 		break;
 
+	case kAUBaseProperty_RenderProfilingEnabled:
+		*(UInt32 *)outData = mRenderProfilingEnabled;
+		break;
+
+	case kAUBaseProperty_RenderProfile:
+		{
+			AURenderProfileData *profile = (AURenderProfileData *)outData;
+			profile->mNumberSamples = 0;
+			profile->mLostSamples = 0;
+			if (mRenderProfiler != NULL)
+				profile->mNumberSamples = mRenderProfiler->Read(mRenderProfileCursor, profile->mSamples, kAURenderProfileMaxSamples, profile->mLostSamples);
+		}
+		break;
+
 	default:
 		result = GetProperty(inID, inScope, inElement, outData);
 		break;
@@ -961,6 +1038,13 @@ OSStatus			AUBase::DispatchSetProperty(	AudioUnitPropertyID 			inID,
 	}
 #endif // !CA_NO_AU_UI_FEATURES
 	
+	case kAUBaseProperty_RenderProfilingEnabled:
+		ca_require(inScope == kAudioUnitScope_Global, InvalidScope);
+		ca_require(inDataSize == sizeof(UInt32), InvalidPropertyValue);
+		SetRenderProfilingEnabled(*(UInt32 *)inData != 0);
+		PropertyChanged(inID, inScope, inElement);
+		break;
+	
 	default:
 		result = SetProperty(inID, inScope, inElement, inData, inDataSize);
 		if (result == noErr)
@@ -1143,9 +1227,19 @@ OSStatus			AUBase::SetRenderNotification(	AURenderCallback		 		inProc,
 	if (inProc == NULL)
 		return kAudio_ParamError;
 
-	mRenderCallbacksTouched = true;
-	mRenderCallbacks.deferred_add(RenderCallback(inProc, inRefCon));
-			// this will do nothing if it's already in the list
+	CAMutex::Locker lock(mRenderCallbackLock);
+	RenderCallback callback(inProc, inRefCon);
+	
+	const RenderCallbackArray *current = mRenderCallbacks;
+	if (current != NULL) {
+		for (RenderCallbackArray::const_iterator it = current->begin(); it != current->end(); ++it)
+			if (it->mRenderNotify == inProc && it->mRenderNotifyRefCon == inRefCon)
+				return noErr;	// already in the list
+	}
+	
+	RenderCallbackArray *callbacks = (current != NULL) ? new RenderCallbackArray(*current) : new RenderCallbackArray;
+	callbacks->push_back(callback);
+	PublishRenderCallbacks(callbacks);
 	return noErr;
 }
 
@@ -1154,8 +1248,104 @@ OSStatus			AUBase::SetRenderNotification(	AURenderCallback		 		inProc,
 OSStatus			AUBase::RemoveRenderNotification(	AURenderCallback			inProc,
 														void *						inRefCon)
 {
-	mRenderCallbacks.deferred_remove(RenderCallback(inProc, inRefCon));
-	return noErr;	// error?
+	CAMutex::Locker lock(mRenderCallbackLock);
+	
+	const RenderCallbackArray *current = mRenderCallbacks;
+	if (current == NULL)
+		return noErr;	// error?
+	
+	RenderCallbackArray::const_iterator found = current->begin();
+	while (found != current->end() && !(found->mRenderNotify == inProc && found->mRenderNotifyRefCon == inRefCon))
+		++found;
+	if (found == current->end())
+		return noErr;	// error?
+	
+	RenderCallbackArray *callbacks = NULL;
+	if (current->size() > 1) {
+		callbacks = new RenderCallbackArray(current->begin(), found);
+		callbacks->insert(callbacks->end(), found + 1, current->end());
+	}
+	PublishRenderCallbacks(callbacks);
+	return noErr;
+}
+
+//_____________________________________________________________________________
+//
+// Counts a render in the current epoch. The epoch is checked again once the render is counted, so
+// that a swap can't move on without seeing a render that may load the array it replaced.
+SInt32				AUBase::EnterRenderEpoch()
+{
+	while (true) {
+		SInt32 epoch = mRenderEpoch;
+		CAAtomicIncrement32Barrier(&mRendersInEpoch[epoch & 1]);
+		if (mRenderEpoch == epoch)
+			return epoch;
+		CAAtomicDecrement32Barrier(&mRendersInEpoch[epoch & 1]);
+	}
+}
+
+//_____________________________________________________________________________
+//
+void				AUBase::ExitRenderEpoch(SInt32 inEpoch)
+{
+	CAAtomicDecrement32Barrier(&mRendersInEpoch[inEpoch & 1]);
+}
+
+//_____________________________________________________________________________
+//
+// called with mRenderCallbackLock held
+void				AUBase::PublishRenderCallbacks(RenderCallbackArray *inCallbacks)
+{
+	RenderCallbackArray *previous = mRenderCallbacks;
+	
+	// the array must be complete before a render can see it
+	CAMemoryBarrier();
+	mRenderCallbacks = inCallbacks;
+	CAMemoryBarrier();
+	
+	if (previous != NULL) {
+		RetiredRenderCallbacks retired;
+		retired.mCallbacks = previous;
+		retired.mRenderEpoch = mRenderEpoch;
+		mRetiredRenderCallbacks.push_back(retired);
+	}
+	ReclaimRenderCallbacks(false);
+	
+	for (UInt32 waited = 0; mRetiredRenderCallbacks.size() > kMaxRetiredRenderCallbacks && waited < kMaxRetiredRenderCallbacksWaitMillis; ++waited) {
+#if TARGET_OS_WIN32
+		Sleep(1);
+#else
+		usleep(1000);
+#endif
+		ReclaimRenderCallbacks(false);
+	}
+}
+
+//_____________________________________________________________________________
+//
+// Called with mRenderCallbackLock held. The epoch only moves on once the renders that entered in the
+// epoch before the current one have all finished, so renders in progress are in at most two epochs,
+// one per counter. An array replaced in epoch e can be loaded only by renders that entered in e or
+// earlier: once the epoch is e + 1 they are all counted in e's counter, and at e + 2 they are done.
+void				AUBase::ReclaimRenderCallbacks(bool inAll)
+{
+	SInt32 epoch = mRenderEpoch;
+	if (mRendersInEpoch[(epoch + 1) & 1] == 0)
+		epoch = CAAtomicIncrement32Barrier(&mRenderEpoch);
+	
+	// a render that enters from now on loads the current array, so with none in progress every
+	// replaced array can go
+	bool idle = mRendersInEpoch[0] == 0 && mRendersInEpoch[1] == 0;
+	
+	RetiredRenderCallbackList::iterator keep = mRetiredRenderCallbacks.begin();
+	for (RetiredRenderCallbackList::iterator it = mRetiredRenderCallbacks.begin(); it != mRetiredRenderCallbacks.end(); ++it) {
+		SInt32 age = epoch - it->mRenderEpoch;
+		if (inAll || idle || age >= 2 || (age == 1 && mRendersInEpoch[it->mRenderEpoch & 1] == 0))
+			delete it->mCallbacks;
+		else
+			*keep++ = *it;
+	}
+	mRetiredRenderCallbacks.erase(keep, mRetiredRenderCallbacks.end());
 }
 
 //_____________________________________________________________________________
@@ -1181,9 +1371,38 @@ OSStatus 	AUBase::SetParameter(			AudioUnitParameterID			inID,
 {
 	AUElement *elem = SafeGetElement(inScope, inElement);
 	elem->SetParameter(inID, inValue);
+	
+	// a ramped parameter's element is rewritten at the end of each render; the sequence number
+	// tells RenderParameterRamps() this value is newer than the events already scheduled
+	ParameterRamp *ramp = FindParameterRamp(inID, inScope, inElement);
+	if (ramp)
+		ramp->mSetSequence = CAAtomicIncrement32(&mParameterWriteSequence);
 	return noErr;
 }
 
+// ____________________________________________________________________________
+//
+static inline SInt32 ParameterEventStartOffset(const AudioUnitParameterEvent &ev)
+{
+	return ev.eventType == kParameterEvent_Immediate ?  SInt32(ev.eventValues.immediate.bufferOffset) : ev.eventValues.ramp.startBufferOffset;
+}
+
+static bool SortParameterEventList(const AudioUnitParameterEvent &ev1, const AudioUnitParameterEvent &ev2 )
+{
+	return ParameterEventStartOffset(ev1) < ParameterEventStartOffset(ev2);
+}
+
+// lists filled by ScheduleParameter() are already in order, so this is normally just a linear check
+static void SortParameterEventListIfNeeded(std::vector<AudioUnitParameterEvent> &ioParamList)
+{
+	for (size_t i = 1; i < ioParamList.size(); ++i) {
+		if (SortParameterEventList(ioParamList[i], ioParamList[i - 1])) {
+			std::sort(ioParamList.begin(), ioParamList.end(), SortParameterEventList);
+			return;
+		}
+	}
+}
+
 //_____________________________________________________________________________
 //
 OSStatus 	AUBase::ScheduleParameter (	const AudioUnitParameterEvent 		*inParameterEvent,
@@ -1191,15 +1410,44 @@ OSStatus 	AUBase::ScheduleParameter (	const AudioUnitParameterEvent 		*inParamet
 {
 	for (UInt32 i = 0; i < inNumEvents; ++i) 
 	{
-		if (inParameterEvent[i].eventType == kParameterEvent_Immediate)
+		const AudioUnitParameterEvent &event = inParameterEvent[i];
+		
+		// never grow the queue here, as this is usually called from the render thread
+		const size_t numQueued = mParamList.size() + mScheduledParamHeap.size();
+		bool dropped = numQueued >= mMaxScheduledParameterEvents || numQueued >= mParamList.capacity()
+							|| numQueued >= mParamListSequences.capacity() || numQueued >= mScheduledParamHeap.capacity();
+		
+		if (event.eventType == kParameterEvent_Immediate)
 		{
-			SetParameter (inParameterEvent[i].parameter,
-							inParameterEvent[i].scope, 
-							inParameterEvent[i].element,
-							inParameterEvent[i].eventValues.immediate.value, 
-							inParameterEvent[i].eventValues.immediate.bufferOffset);
+			// RenderParameterRamps() applies a ramped parameter's immediate events at their offsets,
+			// so only write the element now if the event is not going to reach it
+			if (dropped || FindParameterRamp(event.parameter, event.scope, event.element) == NULL)
+				SetParameter (event.parameter,
+								event.scope, 
+								event.element,
+								event.eventValues.immediate.value, 
+								event.eventValues.immediate.bufferOffset);
 		} 
-		mParamList.push_back (inParameterEvent[i]);
+		
+		if (dropped) {
+			CAAtomicIncrement32(&mDroppedParameterEvents);
+			continue;
+		}
+		
+		// events normally arrive in time order and go straight onto the end of mParamList; one that
+		// starts before the last listed goes onto the heap, for DoRender() to merge in
+		SInt32 sequence = CAAtomicIncrement32(&mParameterWriteSequence);
+		if (mParamList.empty() || ParameterEventStartOffset(event) >= ParameterEventStartOffset(mParamList.back()))
+		{
+			mParamList.push_back(event);
+			mParamListSequences.push_back(sequence);
+		}
+		else
+		{
+			ScheduledParameterEvent scheduled = { event, sequence };
+			mScheduledParamHeap.push_back(scheduled);
+			std::push_heap(mScheduledParamHeap.begin(), mScheduledParamHeap.end(), ScheduledParameterEventIsLater);
+		}
 	}
 	
 	return noErr;
@@ -1207,15 +1455,49 @@ OSStatus 	AUBase::ScheduleParameter (	const AudioUnitParameterEvent 		*inParamet
 
 // ____________________________________________________________________________
 //
-static bool SortParameterEventList(const AudioUnitParameterEvent &ev1, const AudioUnitParameterEvent &ev2 )
+bool	AUBase::ScheduledParameterEventIsLater(	const ScheduledParameterEvent	&inEvent1,
+												const ScheduledParameterEvent	&inEvent2)
 {
-	int offset1 = ev1.eventType == kParameterEvent_Immediate ?  ev1.eventValues.immediate.bufferOffset : ev1.eventValues.ramp.startBufferOffset;
-	int offset2 = ev2.eventType == kParameterEvent_Immediate ?  ev2.eventValues.immediate.bufferOffset : ev2.eventValues.ramp.startBufferOffset;
-
-	if(offset1 < offset2) return true;
-	return false;
+	SInt32 start1 = ParameterEventStartOffset(inEvent1.mEvent), start2 = ParameterEventStartOffset(inEvent2.mEvent);
+	if (start1 != start2)
+		return start1 > start2;
+	return SInt32(inEvent1.mSequence - inEvent2.mSequence) > 0;	// the sequence may wrap
 }
 
+// ____________________________________________________________________________
+//
+void	AUBase::TakeScheduledParameterEvents()
+{
+	if (mScheduledParamHeap.empty())
+		return;
+	
+	// sort the heap latest first and merge it into mParamList from the back; ScheduleParameter()
+	// keeps the two together within the lists' reserved storage, so this doesn't allocate
+	std::sort_heap(mScheduledParamHeap.begin(), mScheduledParamHeap.end(), ScheduledParameterEventIsLater);
+	
+	size_t numListed = mParamList.size(), dest = numListed + mScheduledParamHeap.size();
+	mParamList.resize(dest);
+	mParamListSequences.resize(dest);
+	for (ScheduledParameterEventHeap::const_iterator it = mScheduledParamHeap.begin(); it != mScheduledParamHeap.end(); )
+	{
+		--dest;
+		if (numListed > 0)
+		{
+			ScheduledParameterEvent listed = { mParamList[numListed - 1], mParamListSequences[numListed - 1] };
+			if (ScheduledParameterEventIsLater(listed, *it))
+			{
+				--numListed;
+				mParamList[dest] = listed.mEvent;
+				mParamListSequences[dest] = listed.mSequence;
+				continue;
+			}
+		}
+		mParamList[dest] = it->mEvent;
+		mParamListSequences[dest] = it->mSequence;
+		++it;
+	}
+	mScheduledParamHeap.clear();
+}
 
 // ____________________________________________________________________________
 //
@@ -1233,78 +1515,89 @@ OSStatus 	AUBase::ProcessForScheduledParams(	ParameterEventList		&inParamList,
 
 
 
-	// sort the ParameterEventList by startBufferOffset
-	std::sort(inParamList.begin(), inParamList.end(), SortParameterEventList);
+	// ScheduleParameter() and DoRender() keep mParamList in time order; a list built some other way may need sorting
+	SortParameterEventListIfNeeded(inParamList);
 
-	ParameterEventList::iterator iter = inParamList.begin();
+	// A single cursor walks the list: the events before nextEvent start at or before the current
+	// slice, and those of them that can still affect a slice are kept, in time order, in
+	// mActiveParamEvents. Each slice then only visits the ramps in progress and the latest
+	// immediate event for each parameter, rather than the whole list.
+	const UInt32 numEvents = inParamList.size();
+	UInt32 nextEvent = 0;
 	
+	mActiveParamEvents.clear();
+	if (mActiveParamEvents.capacity() < numEvents)
+		mActiveParamEvents.reserve(numEvents);	// only for a list longer than the scheduling queue
 	
 	while(framesRemaining > 0 )
 	{
-		// first of all, go through the ramped automation events and find out where the next
-		// division of our whole buffer will be
+		// take on the events that have started by this slice
+		while (nextEvent < numEvents && ParameterEventStartOffset(inParamList[nextEvent]) <= (int)currentStartFrame)
+		{
+			AudioUnitParameterEvent &event = inParamList[nextEvent];
+			
+			if (event.eventType == kParameterEvent_Immediate)
+			{
+				// this event will be set after any earlier event for the same parameter in every
+				// remaining slice, so those can no longer take effect
+				for (ActiveParameterEventList::iterator it = mActiveParamEvents.begin(); it != mActiveParamEvents.end(); ++it)
+				{
+					AudioUnitParameterEvent &earlier = inParamList[it->mIndex];
+					if (earlier.parameter == event.parameter && earlier.scope == event.scope && earlier.element == event.element)
+						it->mApplies = false;
+				}
+			}
+			
+			ActiveParameterEvent active = { nextEvent, true };
+			mActiveParamEvents.push_back(active);
+			++nextEvent;
+		}
 		
+		// the next division of the whole buffer is the next event's start or the end of a ramp
+		// in progress, whichever comes first
 		int currentEndFrame = totalFramesToProcess;	// start out assuming we'll process all the way to
 													// the end of the buffer
 		
-		iter = inParamList.begin();
+		if (nextEvent < numEvents)
+			currentEndFrame = std::min(currentEndFrame, int(ParameterEventStartOffset(inParamList[nextEvent])));
 		
-		// find the next break point
-		while(iter != inParamList.end() )
+		// also drop the ramps that have finished and the events that have been overridden
+		ActiveParameterEventList::iterator keep = mActiveParamEvents.begin();
+		for (ActiveParameterEventList::iterator it = mActiveParamEvents.begin(); it != mActiveParamEvents.end(); ++it)
 		{
-			AudioUnitParameterEvent &event = *iter;
+			AudioUnitParameterEvent &event = inParamList[it->mIndex];
 			
-			int offset = event.eventType == kParameterEvent_Immediate ?  event.eventValues.immediate.bufferOffset : event.eventValues.ramp.startBufferOffset;
-
-			if(offset > (int)currentStartFrame && offset < currentEndFrame )
+			if (event.eventType == kParameterEvent_Ramped)
 			{
-				currentEndFrame = offset;
-				break;
-			}
-
-			// consider ramp end to be a possible choice (there may be gaps in the supplied ramp events)
-			if(event.eventType == kParameterEvent_Ramped )
-			{
-				offset = event.eventValues.ramp.startBufferOffset + event.eventValues.ramp.durationInFrames;
-	
-				if(offset > (int)currentStartFrame && offset < currentEndFrame )
-				{
+				int offset = event.eventValues.ramp.startBufferOffset + event.eventValues.ramp.durationInFrames;
+				if (offset <= (int)currentStartFrame)
+					continue;
+				if (offset < currentEndFrame)
 					currentEndFrame = offset;
-				}
 			}
-
-			iter++;
+			else if (!it->mApplies)
+				continue;
+			
+			*keep++ = *it;
 		}
+		mActiveParamEvents.erase(keep, mActiveParamEvents.end());
 	
 		int framesThisTime = currentEndFrame - currentStartFrame;
 
 		// next, setup the parameter maps to be current for the ramp parameters active during 
 		// this time segment...
 		
-		for(ParameterEventList::iterator iter2 = inParamList.begin(); iter2 != inParamList.end(); iter2++ )
+		for (ActiveParameterEventList::iterator it = mActiveParamEvents.begin(); it != mActiveParamEvents.end(); ++it)
 		{
-			AudioUnitParameterEvent &event = *iter2;
-			
-			bool eventFallsInSlice;
+			if (!it->mApplies) continue;
 			
-			
-			if(event.eventType == kParameterEvent_Ramped)
-				eventFallsInSlice = event.eventValues.ramp.startBufferOffset < currentEndFrame 
-					&& event.eventValues.ramp.startBufferOffset + event.eventValues.ramp.durationInFrames > currentStartFrame;
-			else /* kParameterEvent_Immediate */
-				// actually, for the same parameter, there may be future immediate events which override this one,
-				// but it's OK since the event list is sorted in time order, we're guaranteed to end up with the current one
-				eventFallsInSlice = event.eventValues.immediate.bufferOffset <= currentStartFrame;
+			AudioUnitParameterEvent &event = inParamList[it->mIndex];
+			AUElement *element = GetElement(event.scope, event.element );
 				
-			if(eventFallsInSlice)
-			{
-				AUElement *element = GetElement(event.scope, event.element );
-				
-				if(element) element->SetScheduledEvent(	event.parameter,
-														event,
-														currentStartFrame,
-														currentEndFrame - currentStartFrame );
-			}
+			if(element) element->SetScheduledEvent(	event.parameter,
+													event,
+													currentStartFrame,
+													currentEndFrame - currentStartFrame );
 		}
 
 
@@ -1325,6 +1618,197 @@ OSStatus 	AUBase::ProcessForScheduledParams(	ParameterEventList		&inParamList,
 	return result;
 }
 
+// ____________________________________________________________________________
+//
+void		AUBase::AddParameterRamp(	AudioUnitParameterID	inParamID,
+										AudioUnitScope			inScope,
+										AudioUnitElement		inElement,
+										UInt32					inFramesPerValue)
+{
+	if (inFramesPerValue == 0)
+		inFramesPerValue = 1;
+	
+	ParameterRamp ramp;
+	ramp.mParamID = inParamID;
+	ramp.mScope = inScope;
+	ramp.mElement = inElement;
+	ramp.mFramesPerValue = inFramesPerValue;
+	ramp.mSetSequence = mParameterWriteSequence;
+	ramp.mValues.resize((mMaxFramesPerSlice + inFramesPerValue - 1) / inFramesPerValue);
+	mParameterRamps.push_back(ramp);
+}
+
+// ____________________________________________________________________________
+//
+const AudioUnitParameterValue *	AUBase::GetParameterRamp(	AudioUnitParameterID	inParamID,
+															AudioUnitScope			inScope,
+															AudioUnitElement		inElement) const
+{
+	for (ParameterRampList::const_iterator it = mParameterRamps.begin(); it != mParameterRamps.end(); ++it) {
+		if (it->mParamID == inParamID && it->mScope == inScope && it->mElement == inElement)
+			return &it->mValues[0];
+	}
+	return NULL;
+}
+
+// ____________________________________________________________________________
+//
+AUBase::ParameterRamp *	AUBase::FindParameterRamp(	AudioUnitParameterID	inParamID,
+													AudioUnitScope			inScope,
+													AudioUnitElement		inElement)
+{
+	for (ParameterRampList::iterator it = mParameterRamps.begin(); it != mParameterRamps.end(); ++it) {
+		if (it->mParamID == inParamID && it->mScope == inScope && it->mElement == inElement)
+			return &*it;
+	}
+	return NULL;
+}
+
+// ____________________________________________________________________________
+//
+// store inValue for every value slot whose first frame falls in [inStartFrame, inEndFrame)
+static inline void	FillRampConstant(	AudioUnitParameterValue *	outValues,
+										UInt32						inFramesPerValue,
+										SInt32						inStartFrame,
+										SInt32						inEndFrame,
+										AudioUnitParameterValue		inValue)
+{
+	UInt32 i = (inStartFrame + inFramesPerValue - 1) / inFramesPerValue;
+	for (SInt32 frame = i * inFramesPerValue; frame < inEndFrame; frame += inFramesPerValue)
+		outValues[i++] = inValue;
+}
+
+// interpolate a linear ramp for every value slot whose first frame falls in [inStartFrame, inEndFrame)
+static inline void	FillRampLinear(		AudioUnitParameterValue *	outValues,
+										UInt32						inFramesPerValue,
+										SInt32						inStartFrame,
+										SInt32						inEndFrame,
+										const AudioUnitParameterEvent &inEvent)
+{
+	SInt32 rampStart = inEvent.eventValues.ramp.startBufferOffset;
+	AudioUnitParameterValue startValue = inEvent.eventValues.ramp.startValue;
+	AudioUnitParameterValue delta = (inEvent.eventValues.ramp.endValue - startValue) / inEvent.eventValues.ramp.durationInFrames;
+	
+	UInt32 i = (inStartFrame + inFramesPerValue - 1) / inFramesPerValue;
+	for (SInt32 frame = i * inFramesPerValue; frame < inEndFrame; frame += inFramesPerValue)
+		outValues[i++] = startValue + delta * (frame - rampStart);
+}
+
+// ____________________________________________________________________________
+//
+void	AUBase::RenderParameterRamps(	ParameterEventList		&inParamList,
+										UInt32					inFramesToProcess )
+{
+	const SInt32 numFrames = inFramesToProcess;
+	
+	// ScheduleParameter() and DoRender() keep mParamList in time order; a list built some other way may need sorting
+	SortParameterEventListIfNeeded(inParamList);
+	
+	// events in a list the subclass built itself carry no sequence, and are treated as newest
+	const SInt32 *sequences = (&inParamList == &mParamList && mParamListSequences.size() == inParamList.size() && !inParamList.empty())
+									? &mParamListSequences[0] : NULL;
+	
+	for (ParameterRampList::iterator rampIt = mParameterRamps.begin(); rampIt != mParameterRamps.end(); ++rampIt)
+	{
+		ParameterRamp &ramp = *rampIt;
+		AUElement *element = GetElement(ramp.mScope, ramp.mElement);
+		if (element == NULL) continue;
+		
+		// the element holds either the value the previous render ended on or a newer SetParameter();
+		// ScheduleParameter() leaves it alone for ramped parameters. SetParameter() bumps the
+		// sequence after writing the element, so read the sequence first.
+		const SInt32 setSequence = ramp.mSetSequence;
+		CAMemoryBarrier();
+		AudioUnitParameterValue currentValue = element->GetParameter(ramp.mParamID);
+		
+		AudioUnitParameterValue *values = &ramp.mValues[0];
+		const UInt32 framesPerValue = ramp.mFramesPerValue;
+		SInt32 currentFrame = 0;
+		
+		for (UInt32 index = 0; index < inParamList.size(); ++index)
+		{
+			AudioUnitParameterEvent &event = inParamList[index];
+			if (event.parameter != ramp.mParamID || event.scope != ramp.mScope || event.element != ramp.mElement)
+				continue;
+			
+			if (event.eventType == kParameterEvent_Immediate)
+			{
+				// superseded by a SetParameter() made after it was scheduled
+				if (sequences && SInt32(UInt32(sequences[index]) - UInt32(setSequence)) < 0)
+					continue;
+				
+				SInt32 offset = std::min(SInt32(event.eventValues.immediate.bufferOffset), numFrames);
+				if (offset > currentFrame) {
+					FillRampConstant(values, framesPerValue, currentFrame, offset, currentValue);
+					currentFrame = offset;
+				}
+				currentValue = event.eventValues.immediate.value;
+			}
+			else /* kParameterEvent_Ramped */
+			{
+				SInt32 rampStart = event.eventValues.ramp.startBufferOffset;
+				SInt32 rampEnd = rampStart + SInt32(event.eventValues.ramp.durationInFrames);
+				if (rampStart >= numFrames)
+					continue;
+				if (event.eventValues.ramp.durationInFrames == 0) {
+					// a zero-length ramp is a step to the end value
+					SInt32 offset = std::max(rampStart, SInt32(0));
+					if (offset > currentFrame) {
+						FillRampConstant(values, framesPerValue, currentFrame, offset, currentValue);
+						currentFrame = offset;
+					}
+					currentValue = event.eventValues.ramp.endValue;
+					continue;
+				}
+				
+				SInt32 segmentStart = std::max(rampStart, currentFrame);
+				if (segmentStart > currentFrame)
+					FillRampConstant(values, framesPerValue, currentFrame, segmentStart, currentValue);
+				
+				SInt32 segmentEnd = std::min(rampEnd, numFrames);
+				if (segmentEnd > segmentStart)
+					FillRampLinear(values, framesPerValue, segmentStart, segmentEnd, event);
+				currentFrame = std::max(currentFrame, segmentEnd);
+				
+				if (rampEnd <= numFrames)
+					currentValue = event.eventValues.ramp.endValue;
+				else	// the ramp continues into the next buffer
+					currentValue = event.eventValues.ramp.startValue + (event.eventValues.ramp.endValue - event.eventValues.ramp.startValue)
+										* (numFrames - rampStart) / event.eventValues.ramp.durationInFrames;
+			}
+		}
+		
+		FillRampConstant(values, framesPerValue, currentFrame, numFrames, currentValue);
+		
+		// leave the element holding the value at the end of this buffer, unless a SetParameter()
+		// arrived during the render, in which case the next render starts from that instead
+		CAMemoryBarrier();
+		if (ramp.mSetSequence == setSequence)
+			element->SetParameter(ramp.mParamID, currentValue);
+	}
+	
+	// events for parameters without a ramp are applied as one slice covering the whole buffer
+	for (ParameterEventList::iterator iter = inParamList.begin(); iter != inParamList.end(); ++iter)
+	{
+		AudioUnitParameterEvent &event = *iter;
+		if (GetParameterRamp(event.parameter, event.scope, event.element) != NULL)
+			continue;
+		
+		bool eventFallsInSlice;
+		if (event.eventType == kParameterEvent_Ramped)
+			eventFallsInSlice = event.eventValues.ramp.startBufferOffset < numFrames
+				&& event.eventValues.ramp.startBufferOffset + SInt32(event.eventValues.ramp.durationInFrames) > 0;
+		else /* kParameterEvent_Immediate */
+			eventFallsInSlice = true;
+		
+		if (eventFallsInSlice)
+		{
+			AUElement *element = GetElement(event.scope, event.element);
+			if (element) element->SetScheduledEvent(event.parameter, event, 0, inFramesToProcess);
+		}
+	}
+}
+
 //_____________________________________________________________________________
 //
 void				AUBase::SetWantsRenderThreadID (bool inFlag)
@@ -1349,9 +1833,15 @@ OSStatus			AUBase::DoRender(		AudioUnitRenderActionFlags &	ioActionFlags,
 											AudioBufferList &				ioData)
 {
 	OSStatus theError;
-	RenderCallbackList::iterator rcit;
+	const RenderCallbackArray *callbacks;
+	RenderCallbackArray::const_iterator rcit;
+	AURenderProfiler *profiler = GetActiveRenderProfiler();
+	Float64 outputSampleRate = 0.;
+	const SInt32 renderEpoch = EnterRenderEpoch();
 	
 	AUTRACE(kCATrace_AUBaseRenderStart, mComponentInstance, (intptr_t)this, inBusNumber, inFramesToProcess, 0);
+	if (profiler != NULL)
+		profiler->BeginRender();
 	DISABLE_DENORMALS
 	
 	try {
@@ -1365,6 +1855,7 @@ OSStatus			AUBase::DoRender(		AudioUnitRenderActionFlags &	ioActionFlags,
 				__FILE__, __LINE__, (unsigned)ioData.mNumberBuffers, (unsigned)output->GetStreamFormat().NumberChannelStreams());
 			goto ParamErr;
 		}
+		outputSampleRate = output->GetStreamFormat().mSampleRate;
 
 		unsigned expectedBufferByteSize = inFramesToProcess * output->GetStreamFormat().mBytesPerFrame;
 		for (unsigned ibuf = 0; ibuf < ioData.mNumberBuffers; ++ibuf) {
@@ -1395,12 +1886,15 @@ OSStatus			AUBase::DoRender(		AudioUnitRenderActionFlags &	ioActionFlags,
 			#endif
 		}
 		
+		// the same snapshot serves both the pre- and post-render notifications; it stays valid
+		// until this render leaves its epoch
+		callbacks = mRenderCallbacks;
+		
 		AudioUnitRenderActionFlags flags;
-		if (mRenderCallbacksTouched) {
-			mRenderCallbacks.update();
+		if (callbacks != NULL) {
 			flags = ioActionFlags | kAudioUnitRenderAction_PreRender;
-			for (rcit = mRenderCallbacks.begin(); rcit != mRenderCallbacks.end(); ++rcit) {
-				RenderCallback &rc = *rcit;
+			for (rcit = callbacks->begin(); rcit != callbacks->end(); ++rcit) {
+				const RenderCallback &rc = *rcit;
 				AUTRACE(kCATrace_AUBaseRenderCallbackStart, mComponentInstance, (intptr_t)this, (intptr_t)rc.mRenderNotify, 1, 0);
 				(*(AURenderCallback)rc.mRenderNotify)(rc.mRenderNotifyRefCon, 
 								&flags,
@@ -1409,6 +1903,10 @@ OSStatus			AUBase::DoRender(		AudioUnitRenderActionFlags &	ioActionFlags,
 			}
 		}
 		
+		// any events scheduled out of time order for this cycle, including from the pre-render
+		// notifications
+		TakeScheduledParameterEvents();
+		
 		theError = DoRenderBus(ioActionFlags, inTimeStamp, inBusNumber, output, inFramesToProcess, ioData);
 		
 		flags = ioActionFlags | kAudioUnitRenderAction_PostRender;
@@ -1417,9 +1915,9 @@ OSStatus			AUBase::DoRender(		AudioUnitRenderActionFlags &	ioActionFlags,
 			flags |= kAudioUnitRenderAction_PostRenderError;		
 		}
 		
-		if (mRenderCallbacksTouched) {
-			for (rcit = mRenderCallbacks.begin(); rcit != mRenderCallbacks.end(); ++rcit) {
-				RenderCallback &rc = *rcit;
+		if (callbacks != NULL) {
+			for (rcit = callbacks->begin(); rcit != callbacks->end(); ++rcit) {
+				const RenderCallback &rc = *rcit;
 				AUTRACE(kCATrace_AUBaseRenderCallbackStart, mComponentInstance, (intptr_t)this, (intptr_t)rc.mRenderNotify, 2, 0);
 				(*(AURenderCallback)rc.mRenderNotify)(rc.mRenderNotifyRefCon, 
 								&flags,
@@ -1434,6 +1932,8 @@ OSStatus			AUBase::DoRender(		AudioUnitRenderActionFlags &	ioActionFlags,
 		// parameters must be scheduled from the next pre-render callback.
 		if (!mParamList.empty())
 			mParamList.clear();
+		mParamListSequences.clear();
+		mScheduledParamHeap.clear();
 
 	}
 	catch (OSStatus err) {
@@ -1445,6 +1945,12 @@ OSStatus			AUBase::DoRender(		AudioUnitRenderActionFlags &	ioActionFlags,
 		goto errexit;
 	}
 done:	
+	// let the render notification snapshot this render used be reclaimed
+	ExitRenderEpoch(renderEpoch);
+	
+	if (profiler != NULL)
+		profiler->EndRender(inBusNumber, inFramesToProcess, outputSampleRate, ioActionFlags, theError);
+	
 	RESTORE_DENORMALS
 	AUTRACE(kCATrace_AUBaseRenderEnd, mComponentInstance, (intptr_t)this, theError, ioActionFlags, ioData.mBuffers[0].mData != NULL ? *(int64_t *)ioData.mBuffers[0].mData : 0);
 	
@@ -63,7 +63,9 @@
 #include "AUInputElement.h"
 #include "AUOutputElement.h"
 #include "AUBuffer.h"
+#include "AURenderProfiler.h"
 #include "CAMath.h"
+#include "CAMutex.h"
 #include "CAThreadSafeList.h"
 #include "CAVectorUnit.h"
 #if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
@@ -98,6 +100,10 @@
 #define kAUDefaultMaxFramesPerSlice	2048 
 #endif
 
+// the number of scheduled parameter events one render cycle can hold; ScheduleParameter()
+// drops any beyond this rather than allocating on the render thread
+#define kAUDefaultMaxScheduledParameterEvents	1024
+
 // ________________________________________________________________________
 
 /*! @class AUBase */
@@ -576,6 +582,29 @@ public:
 	/*! @method GetMaxFramesPerSlice */
 	UInt32						GetMaxFramesPerSlice() const { return mMaxFramesPerSlice; }
 	
+	/*! @method GetMaxScheduledParameterEvents */
+	UInt32						GetMaxScheduledParameterEvents() const { return mMaxScheduledParameterEvents; }
+	
+	/*! @method GetDroppedParameterEventCount */
+	// the number of events ScheduleParameter() has discarded because the render cycle's queue was full
+	UInt32						GetDroppedParameterEventCount() const { return mDroppedParameterEvents; }
+	
+	/*! @method SetRenderProfilingEnabled */
+	// while enabled, DoRender() records a sample for every render cycle (see AURenderProfiler.h).
+	// Hosts reach this through kAUBaseProperty_RenderProfilingEnabled and kAUBaseProperty_RenderProfile.
+	void						SetRenderProfilingEnabled(bool inEnabled);
+	
+	/*! @method IsRenderProfilingEnabled */
+	bool						IsRenderProfilingEnabled() const { return mRenderProfilingEnabled; }
+	
+	/*! @method GetRenderProfiler */
+	// NULL until profiling is first enabled; from then on valid for the life of the unit, so that
+	// in-process readers can follow it with their own cursors
+	const AURenderProfiler *	GetRenderProfiler() const { return mRenderProfiler; }
+	
+	/*! @method GetActiveRenderProfiler */
+	AURenderProfiler *			GetActiveRenderProfiler() const { return mRenderProfilingEnabled ? mRenderProfiler : NULL; }
+	
 	/*! @method GetVectorUnitType */
 	static SInt32				GetVectorUnitType() { return sVectorUnitType; }
 	/*! @method HasVectorUnit */
@@ -753,6 +782,10 @@ protected:
 	
 	/*! @method SetMaxFramesPerSlice */
 	virtual void				SetMaxFramesPerSlice(UInt32 nFrames);
+	
+	/*! @method SetMaxScheduledParameterEvents */
+	// preallocates the scheduled parameter queue; like SetMaxFramesPerSlice(), not to be called while rendering
+	void						SetMaxScheduledParameterEvents(UInt32 nEvents);
 
 	/*! @method CanSetMaxFrames */
 	virtual OSStatus			CanSetMaxFrames() const;
@@ -844,6 +877,16 @@ protected:
 	
 	// Scheduled parameter implementation:
 
+	//
+	// ScheduleParameter() appends each event to mParamList, which stays in time order (by bufferOffset
+	// or startBufferOffset, ties kept in arrival order) since events normally arrive in that order.
+	// An event that starts before the last one listed goes onto a binary heap instead, at O(log n);
+	// DoRender() merges the heap into mParamList after the pre-render notifications, so
+	// ProcessForScheduledParams() and subclasses always see one sorted list. An event scheduled out
+	// of order during the render itself is dropped with the rest of the cycle's events.
+	// Storage for GetMaxScheduledParameterEvents() events is reserved up front; once a render cycle
+	// holds that many, further events for it are dropped and counted in GetDroppedParameterEventCount().
+
 	typedef std::vector<AudioUnitParameterEvent> ParameterEventList;
 
 	// Usually, you won't override this method.  You only need to call this if your DSP code
@@ -873,6 +916,40 @@ protected:
 														UInt32				inSliceFramesToProcess,
 														UInt32				inTotalBufferFrames ) {return noErr;};	// default impl does nothing...
 	
+	// Sample-accurate scheduled parameters:
+	//
+	//	As an alternative to slicing the buffer with ProcessForScheduledParams(), a unit can register
+	//	parameters with AddParameterRamp(). Before each render, RenderParameterRamps() expands the
+	//	scheduled immediate and ramped events for those parameters into an array holding one value
+	//	per inFramesPerValue frames, and the DSP code reads the array with GetParameterRamp(). The
+	//	render then stays a single pass however many events arrive. AUEffectBase does this
+	//	automatically once any ramp has been registered.
+	//
+	//	Register ramps before the unit is initialized; the arrays are sized from the maximum frames
+	//	per slice and are never reallocated on the render thread.
+	void						AddParameterRamp(	AudioUnitParameterID	inParamID,
+													AudioUnitScope			inScope = kAudioUnitScope_Global,
+													AudioUnitElement		inElement = 0,
+													UInt32					inFramesPerValue = 1);
+	
+	bool						UsesParameterRamps() const { return !mParameterRamps.empty(); }
+	
+	// Value i applies to frames [i * inFramesPerValue, (i + 1) * inFramesPerValue) of the current
+	// render. Returns NULL if the parameter was not registered with AddParameterRamp().
+	const AudioUnitParameterValue *	GetParameterRamp(	AudioUnitParameterID	inParamID,
+														AudioUnitScope			inScope = kAudioUnitScope_Global,
+														AudioUnitElement		inElement = 0) const;
+	
+	// Fills the ramp arrays for a render of inFramesToProcess frames. Events for parameters that
+	// have no ramp are applied to their elements as a single slice spanning the whole buffer, so
+	// GetRampSliceStartEnd() still works for them.
+	//
+	// Immediate events for a ramped parameter are not applied to the element when scheduled, only
+	// here at their buffer offsets. A SetParameter() made after such an event was scheduled wins over it:
+	// the ramp starts from the newer value and the event is skipped.
+	void						RenderParameterRamps(	ParameterEventList		&inParamList,
+														UInt32					inFramesToProcess );
+	
 	
 	/*! @method CurrentRenderTime */
 	const AudioTimeStamp &		CurrentRenderTime () const { return mCurrentRenderTime; }
@@ -894,7 +971,33 @@ private:
 					this->mRenderNotifyRefCon == other.mRenderNotifyRefCon;
 		}
 	};
-	typedef TThreadSafeList<RenderCallback>	RenderCallbackList;
+	
+	// The render notifications are published as immutable snapshots. SetRenderNotification() and
+	// RemoveRenderNotification() copy the current array, change the copy and swap it in, so DoRender()
+	// needs a single load of mRenderCallbacks to walk a contiguous array.
+	// Before loading it, each render counts itself in mRendersInEpoch under the parity of the current
+	// mRenderEpoch, so renders on several threads at once are all accounted for. A swap moves the epoch
+	// on once no render is left from the epoch before, and a replaced array is freed as soon as every
+	// render that entered up to its swap has finished: at once if no render is in progress, otherwise
+	// by a later add or remove (or the destructor), never on the render thread. Past
+	// kMaxRetiredRenderCallbacks replaced arrays, an add or remove waits for the renders in progress.
+	typedef std::vector<RenderCallback>	RenderCallbackArray;
+	
+	struct RetiredRenderCallbacks {
+		RenderCallbackArray *		mCallbacks;
+		SInt32						mRenderEpoch;	// mRenderEpoch when the array was replaced
+	};
+	typedef std::vector<RetiredRenderCallbacks>	RetiredRenderCallbackList;
+	
+	enum {
+		kMaxRetiredRenderCallbacks = 8,
+		kMaxRetiredRenderCallbacksWaitMillis = 100	// an add or remove made from a notification can't wait for its own render
+	};
+	
+	SInt32						EnterRenderEpoch();
+	void						ExitRenderEpoch(SInt32 inEpoch);
+	void						PublishRenderCallbacks(RenderCallbackArray *inCallbacks);
+	void						ReclaimRenderCallbacks(bool inAll);
 	
 #if !CA_BASIC_AU_FEATURES
 	enum { kNumScopes = 4 };
@@ -925,8 +1028,15 @@ private:
 	AUScope						mScopes[kNumScopes];
 	
 	/*! @var mRenderCallbacks */
-	RenderCallbackList			mRenderCallbacks;
-	bool						mRenderCallbacksTouched;
+	RenderCallbackArray * volatile	mRenderCallbacks;		// NULL when there are none
+	/*! @var mRenderEpoch */
+	volatile SInt32				mRenderEpoch;			// advanced by the swaps of mRenderCallbacks
+	/*! @var mRendersInEpoch */
+	volatile SInt32				mRendersInEpoch[2];		// renders in progress that entered in an even or odd epoch
+	/*! @var mRenderCallbackLock */
+	CAMutex						mRenderCallbackLock;	// serializes adding and removing notifications
+	/*! @var mRetiredRenderCallbacks */
+	RetiredRenderCallbackList	mRetiredRenderCallbacks;
 	
 	/*! @var mRenderThreadID */
 #if TARGET_OS_MAC
@@ -944,6 +1054,22 @@ private:
 	/*! @var mMaxFramesPerSlice */
 	UInt32						mMaxFramesPerSlice;
 	
+	/*! @var mMaxScheduledParameterEvents */
+	UInt32						mMaxScheduledParameterEvents;
+	
+	/*! @var mDroppedParameterEvents */
+	volatile SInt32				mDroppedParameterEvents;
+	
+	/*! @var mParameterWriteSequence */
+	volatile SInt32				mParameterWriteSequence;	// orders scheduled events against SetParameter() on ramped parameters
+	
+	/*! @var mRenderProfiler */
+	AURenderProfiler *			mRenderProfiler;
+	/*! @var mRenderProfilingEnabled */
+	volatile bool				mRenderProfilingEnabled;
+	/*! @var mRenderProfileCursor */
+	UInt32						mRenderProfileCursor;	// kAUBaseProperty_RenderProfile's place in the ring
+	
 	/*! @var mLastRenderError */
 	OSStatus					mLastRenderError;
 	/*! @var mCurrentPreset */
@@ -959,6 +1085,56 @@ protected:
 
 	/*! @var mParamList */
 	ParameterEventList			mParamList;
+	
+	/*! @var mParamListSequences */
+	// the write sequence of each event in mParamList, at the same index
+	std::vector<SInt32>			mParamListSequences;
+	
+	// an event ScheduleParameter() received out of time order, waiting to be merged into mParamList
+	struct ScheduledParameterEvent {
+		AudioUnitParameterEvent					mEvent;
+		SInt32									mSequence;		// its write sequence, which breaks ties
+	};
+	typedef std::vector<ScheduledParameterEvent>	ScheduledParameterEventHeap;
+	
+	/*! @var mScheduledParamHeap */
+	ScheduledParameterEventHeap	mScheduledParamHeap;
+	
+	// orders mScheduledParamHeap so that its top is the earliest event, and of events at the same
+	// time, the first scheduled
+	static bool					ScheduledParameterEventIsLater(	const ScheduledParameterEvent	&inEvent1,
+																const ScheduledParameterEvent	&inEvent2);
+	// merges the events in mScheduledParamHeap into mParamList
+	void						TakeScheduledParameterEvents();
+	
+	// an event that has started by the current slice of ProcessForScheduledParams() and may still
+	// matter to later slices; mApplies is false once a later immediate event for the same
+	// parameter overrides it, though a ramp stays listed until it ends since it still splits the buffer
+	struct ActiveParameterEvent {
+		UInt32									mIndex;			// into the list being processed
+		bool									mApplies;
+	};
+	typedef std::vector<ActiveParameterEvent>	ActiveParameterEventList;
+	
+	/*! @var mActiveParamEvents */
+	ActiveParameterEventList	mActiveParamEvents;
+	
+	struct ParameterRamp {
+		AudioUnitParameterID					mParamID;
+		AudioUnitScope							mScope;
+		AudioUnitElement						mElement;
+		UInt32									mFramesPerValue;
+		volatile SInt32							mSetSequence;	// write sequence of the latest SetParameter()
+		std::vector<AudioUnitParameterValue>	mValues;
+	};
+	typedef std::vector<ParameterRamp>	ParameterRampList;
+	
+	ParameterRamp *				FindParameterRamp(	AudioUnitParameterID	inParamID,
+													AudioUnitScope			inScope,
+													AudioUnitElement		inElement);
+	
+	/*! @var mParameterRamps */
+	ParameterRampList			mParameterRamps;
 	/*! @var mPropertyListeners */
 	PropertyListeners			mPropertyListeners;
 	
@@ -991,6 +1167,8 @@ inline 	OSStatus	AUInputElement::PullInputWithBufferList(
 												AudioBufferList *				inBufferList)
 {
 	OSStatus theResult;
+	AURenderProfiler *profiler = GetAudioUnit()->GetActiveRenderProfiler();
+	UInt64 pullStartTime = (profiler != NULL) ? CAHostTimeBase::GetTheCurrentTime() : 0;
 	
 	if (HasConnection()) {
 			// only support connections for V2 audio units
@@ -1008,6 +1186,9 @@ inline 	OSStatus	AUInputElement::PullInputWithBufferList(
 							mInputProcRefCon, &ioActionFlags, &inTimeStamp, inElement, nFrames, inBufferList);
 	}
 	
+	if (profiler != NULL)
+		profiler->AddPullInputTime(CAHostTimeBase::GetTheCurrentTime() - pullStartTime);
+	
 	if (mInputType == kNoInput)	// defense: the guy upstream could have disconnected
 								// it's a horrible thing to do, but may happen!
 		return kAudioUnitErr_NoConnection;
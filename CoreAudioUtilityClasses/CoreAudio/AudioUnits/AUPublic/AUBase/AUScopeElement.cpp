@@ -46,6 +46,9 @@
 */
 #include "AUScopeElement.h"
 #include "AUBase.h"
+#include "CAAtomic.h"
+#include <new>
+#include <stdlib.h>
 
 //_____________________________________________________________________________
 //
@@ -61,6 +64,141 @@ void	AUElement::UseIndexedParameters(int inNumberOfParameters)
 	mUseIndexedParameters = true;
 }
 
+//_____________________________________________________________________________
+//
+//	Helper method.
+//	returns the slot of paramID in the flat parameter table, or kNoParameterSlot
+//
+inline UInt32	AUElement::FindParameterSlot(AudioUnitParameterID paramID) const
+{
+	if (mParameterTableIsDirect)
+		return (paramID < mParameterTableSize) ? paramID : (UInt32)kNoParameterSlot;
+	if (mParameterIndex == NULL)
+		return kNoParameterSlot;
+		
+	// multiplicative hash, then linear probing; the index is never more than half full
+	UInt32 mask = 0xFFFFFFFF >> mParameterIndexShift;
+	for (UInt32 h = (paramID * 2654435761U) >> mParameterIndexShift; ; h = (h + 1) & mask) {
+		const ParameterIndexEntry &entry = mParameterIndex[h];
+		if (entry.mSlot == kNoParameterSlot || entry.mID == paramID)
+			return entry.mSlot;
+	}
+}
+
+//_____________________________________________________________________________
+//
+inline void		AUElement::NoteParameterChanged(UInt32 inSlot)
+{
+	if (mParameterChangeFlags != NULL && inSlot < mParameterTableSize) {
+		// the value must be visible before the flag is
+		CAMemoryBarrier();
+		mParameterChangeFlags[inSlot] = 1;
+	}
+}
+
+//_____________________________________________________________________________
+//
+//	Builds the flat table of the parameters defined so far, and the change flags if they are used.
+//	Must not be called while rendering.
+//
+void	AUElement::BuildParameterTable()
+{
+	// the old table holds the current values of its parameters
+	if (mParameterTable != NULL) {
+		for (ParameterMap::iterator i = mParameters.begin(); i != mParameters.end(); ++i) {
+			UInt32 slot = FindParameterSlot((*i).first);
+			if (slot != kNoParameterSlot)
+				(*i).second = mParameterTable[slot];
+		}
+	}
+	FreeParameterTable();
+	
+	if (mUseIndexedParameters) {
+		// already flat: the ID is the slot
+		mParameterTableSize = mIndexedParameters.size();
+		mParameterTableIsDirect = true;
+	} else if (!mParameters.empty()) {
+		enum { kCacheLineSize = 64 };
+		UInt32 numParameters = mParameters.size();
+		mParameterTableStorage = malloc(numParameters * sizeof(ParameterMapEvent) + kCacheLineSize);
+		if (mParameterTableStorage == NULL)
+			throw std::bad_alloc();
+		mParameterTable = reinterpret_cast<ParameterMapEvent *>(
+								(reinterpret_cast<uintptr_t>(mParameterTableStorage) + kCacheLineSize - 1) & ~(uintptr_t)(kCacheLineSize - 1));
+		
+		bool isDirect = true;
+		UInt32 slot = 0;
+		for (ParameterMap::iterator i = mParameters.begin(); i != mParameters.end(); ++i, ++slot) {
+			new (&mParameterTable[slot]) ParameterMapEvent((*i).second);
+			if ((*i).first != slot)
+				isDirect = false;
+		}
+		mParameterTableSize = numParameters;
+		mParameterTableIsDirect = isDirect;
+		
+		if (!isDirect) {
+			UInt32 log2Buckets = 1;
+			while ((1U << log2Buckets) < 2 * numParameters)
+				++log2Buckets;
+			UInt32 numBuckets = 1U << log2Buckets;
+			mParameterIndexShift = 32 - log2Buckets;
+			mParameterIndex = static_cast<ParameterIndexEntry *>(malloc(numBuckets * sizeof(ParameterIndexEntry)));
+			if (mParameterIndex == NULL) {
+				FreeParameterTable();
+				throw std::bad_alloc();
+			}
+			for (UInt32 h = 0; h < numBuckets; ++h) {
+				mParameterIndex[h].mID = 0;
+				mParameterIndex[h].mSlot = kNoParameterSlot;
+			}
+			slot = 0;
+			for (ParameterMap::iterator i = mParameters.begin(); i != mParameters.end(); ++i, ++slot) {
+				UInt32 h = ((*i).first * 2654435761U) >> mParameterIndexShift;
+				while (mParameterIndex[h].mSlot != kNoParameterSlot)
+					h = (h + 1) & (numBuckets - 1);
+				mParameterIndex[h].mID = (*i).first;
+				mParameterIndex[h].mSlot = slot;
+			}
+		}
+	}
+	
+	if (mUseParameterChangeFlags && mParameterTableSize > 0) {
+		mParameterChangeFlags = static_cast<volatile SInt32 *>(calloc(mParameterTableSize, sizeof(SInt32)));
+		if (mParameterChangeFlags == NULL) {
+			FreeParameterTable();
+			throw std::bad_alloc();
+		}
+	}
+}
+
+//_____________________________________________________________________________
+//
+void	AUElement::FreeParameterTable()
+{
+	free(mParameterTableStorage);		// ParameterMapEvent has a trivial destructor
+	mParameterTableStorage = NULL;
+	mParameterTable = NULL;
+	mParameterTableSize = 0;
+	free(mParameterIndex);
+	mParameterIndex = NULL;
+	mParameterIndexShift = 0;
+	mParameterTableIsDirect = false;
+	free(const_cast<SInt32 *>(mParameterChangeFlags));
+	mParameterChangeFlags = NULL;
+}
+
+//_____________________________________________________________________________
+//
+bool	AUElement::TestAndClearParameterChanged(AudioUnitParameterID paramID)
+{
+	if (mParameterChangeFlags == NULL)
+		return false;
+	UInt32 slot = FindParameterSlot(paramID);
+	if (slot == kNoParameterSlot || slot >= mParameterTableSize)
+		return false;
+	return CAAtomicCompareAndSwap32Barrier(1, 0, &mParameterChangeFlags[slot]);
+}
+
 //_____________________________________________________________________________
 //
 //	Helper method.
@@ -79,6 +217,10 @@ inline ParameterMapEvent&	AUElement::GetParamEvent(AudioUnitParameterID paramID)
 	}
 	else
 	{
+		UInt32 slot = FindParameterSlot(paramID);
+		if (slot != kNoParameterSlot)
+			return mParameterTable[slot];
+			
 		ParameterMap::iterator i = mParameters.find(paramID);
 		if (i == mParameters.end())
 			COMPONENT_THROW(kAudioUnitErr_InvalidParameter);
@@ -134,9 +276,18 @@ void			AUElement::SetParameter(AudioUnitParameterID paramID, AudioUnitParameterV
 	{
 		ParameterMapEvent &event = GetParamEvent(paramID);
 		event.SetValue(inValue);
+		NoteParameterChanged(paramID);
 	}
 	else
 	{
+		// parameters in the table are changed there, without touching the map
+		UInt32 slot = FindParameterSlot(paramID);
+		if (slot != kNoParameterSlot) {
+			mParameterTable[slot].SetValue(inValue);
+			NoteParameterChanged(slot);
+			return;
+		}
+		
 		ParameterMap::iterator i = mParameters.find(paramID);
 	
 		if (i == mParameters.end())
@@ -180,6 +331,12 @@ void			AUElement::SetScheduledEvent(	AudioUnitParameterID 			paramID,
 	}
 	else
 	{
+		UInt32 slot = FindParameterSlot(paramID);
+		if (slot != kNoParameterSlot) {
+			mParameterTable[slot].SetScheduledEvent(inEvent, inSliceOffsetInBuffer, inSliceDurationFrames );
+			return;
+		}
+		
 		ParameterMap::iterator i = mParameters.find(paramID);
 	
 		if (i == mParameters.end())
@@ -268,7 +425,7 @@ void			AUElement::SaveState(CFMutableDataRef data)
 			
 			entry.paramID = CFSwapInt32HostToBig((*i).first);
 	
-			AudioUnitParameterValue v = (*i).second.GetValue();
+			AudioUnitParameterValue v = GetParamEvent((*i).first).GetValue();	// the table's value, if it is in there
 			entry.value = CFSwapInt32HostToBig(*(UInt32 *)&v );
 	
 			CFDataAppendBytes(data, (UInt8 *)&entry, sizeof(entry));
@@ -406,6 +563,18 @@ AUScope::~AUScope()
 		delete *it;
 }
 
+//_____________________________________________________________________________
+//
+void	AUScope::BuildParameterTables()
+{
+	UInt32 numElements = GetNumberOfElements();
+	for (UInt32 i = 0; i < numElements; ++i) {
+		AUElement *element = GetElement(i);
+		if (element)
+			element->BuildParameterTable();
+	}
+}
+
 //_____________________________________________________________________________
 //
 void	AUScope::SetNumberOfElements(UInt32 numElements)
@@ -200,10 +200,13 @@ class AUElement {
 public:
 /*! @ctor AUElement */
 								AUElement(AUBase *audioUnit) : mAudioUnit(audioUnit),
-									mUseIndexedParameters(false), mElementName(0) { }
+									mUseIndexedParameters(false), mElementName(0),
+									mParameterTableStorage(NULL), mParameterTable(NULL), mParameterTableSize(0),
+									mParameterIndex(NULL), mParameterIndexShift(0), mParameterTableIsDirect(false),
+									mUseParameterChangeFlags(false), mParameterChangeFlags(NULL) { }
 	
 /*! @dtor ~AUElement */
-	virtual						~AUElement() { if (mElementName) CFRelease (mElementName); }
+	virtual						~AUElement() { FreeParameterTable(); if (mElementName) CFRelease (mElementName); }
 	
 /*! @method GetNumberOfParameters */
 	virtual UInt32				GetNumberOfParameters()
@@ -255,6 +258,18 @@ public:
 /*! @method UseIndexedParameters */
 	virtual void				UseIndexedParameters(int inNumberOfParameters);
 
+/*! @method BuildParameterTable */
+	// Copies the parameters defined so far into a flat table, so that finding one costs a hash probe
+	// instead of a map walk. AUBase calls this from DoInitialize; parameters defined later stay in the map.
+	void						BuildParameterTable();
+
+/*! @method UseParameterChangeFlags */
+	// Keeps a flag per parameter that SetParameter raises. Takes effect at the next BuildParameterTable.
+	void						UseParameterChangeFlags(bool inUseFlags = true) { mUseParameterChangeFlags = inUseFlags; }
+/*! @method TestAndClearParameterChanged */
+	// true if SetParameter has changed the parameter since the last call; safe on any thread
+	bool						TestAndClearParameterChanged(AudioUnitParameterID paramID);
+
 /*! @method AsIOElement*/
 	virtual AUIOElement*		AsIOElement () { return NULL; }
 	
@@ -264,6 +279,18 @@ protected:
 private:
 	typedef std::map<AudioUnitParameterID, ParameterMapEvent, std::less<AudioUnitParameterID> > ParameterMap;
 	
+	enum { kNoParameterSlot = 0xFFFFFFFF };
+	
+	// one bucket of the open addressed index into mParameterTable
+	struct ParameterIndexEntry {
+		AudioUnitParameterID		mID;
+		UInt32						mSlot;		// kNoParameterSlot if the bucket is empty
+	};
+	
+	inline UInt32				FindParameterSlot(AudioUnitParameterID paramID) const;
+	inline void					NoteParameterChanged(UInt32 inSlot);
+	void						FreeParameterTable();
+	
 /*! @var mAudioUnit */
 	AUBase *						mAudioUnit;
 /*! @var mParameters */
@@ -276,6 +303,25 @@ private:
 	
 /*! @var mElementName */
 	CFStringRef						mElementName;
+	
+	// The flat parameter table. Once built it holds the values of the parameters in it; their map
+	// entries are only brought up to date when the table is rebuilt.
+/*! @var mParameterTableStorage */
+	void *							mParameterTableStorage;
+/*! @var mParameterTable */
+	ParameterMapEvent *				mParameterTable;		// cache line aligned, in parameter ID order
+/*! @var mParameterTableSize */
+	UInt32							mParameterTableSize;
+/*! @var mParameterIndex */
+	ParameterIndexEntry *			mParameterIndex;		// at least twice mParameterTableSize buckets
+/*! @var mParameterIndexShift */
+	UInt32							mParameterIndexShift;
+/*! @var mParameterTableIsDirect */
+	bool							mParameterTableIsDirect;	// the IDs are 0...size-1, so the ID is the slot
+/*! @var mUseParameterChangeFlags */
+	bool							mUseParameterChangeFlags;
+/*! @var mParameterChangeFlags */
+	volatile SInt32 *				mParameterChangeFlags;	// one per slot, or per indexed parameter
 };
 
 
@@ -485,6 +531,9 @@ public:
 		return mElements.size(); 
 	}
 	
+/*! @method BuildParameterTables */
+	void			BuildParameterTables();
+	
 /*! @method GetElement */
 	AUElement *		GetElement(UInt32 elementIndex) const
 	{
@@ -66,11 +66,14 @@ AUInstrumentBase::AUInstrumentBase(
 	: MusicDeviceBase(inInstance, numInputs, numOutputs, numGroups), 
 	mAbsoluteSampleFrame(0),
 	mEventQueue(kEventQueueSize),
+	mPendingEvents(kEventQueueSize),
 	mNumNotes(0),
 	mNumActiveNotes(0),
 	mMaxActiveNotes(0),
 	mNotes(0),
 	mNoteSize(0),
+	mVoicePool(0),
+	mRenderWorkers(0),
 	mInitNumPartEls(numParts)
 {
 #if DEBUG_PRINT
@@ -86,6 +89,7 @@ AUInstrumentBase::~AUInstrumentBase()
 #if DEBUG_PRINT
 	printf("delete AUInstrumentBase\n");
 #endif
+	delete mRenderWorkers;
 }
 
 AUElement *	AUInstrumentBase::CreateElement(AudioUnitScope inScope, AudioUnitElement element)
@@ -129,6 +133,31 @@ void		AUInstrumentBase::SetNotes(UInt32 inNumNotes, UInt32 inMaxActiveNotes, Syn
 			note->Reset();
 			mFreeNotes.AddNote(note);
 	}
+	
+	// let the sounding note lists keep their notes in heaps for voice stealing
+	UInt32 numGroups = Groups().GetNumberOfElements();
+	for (UInt32 j = 0; j < numGroups; ++j)
+	{
+		SynthGroupElement *group = (SynthGroupElement*)Groups().GetElement(j);
+		for (UInt32 i = 0; i < kNumberOfSoundingNoteStates; ++i)
+			group->mNoteList[i].SetCapacity(inNumNotes);
+	}
+}
+
+OSStatus	AUInstrumentBase::SetRenderWorkers(UInt32 inNumWorkers)
+{
+	delete mRenderWorkers;
+	mRenderWorkers = 0;
+	if (inNumWorkers == 0)
+		return noErr;
+	
+	mRenderWorkers = new SynthRenderWorkers;
+	OSStatus result = mRenderWorkers->Allocate(this, inNumWorkers, mNumNotes, GetMaxFramesPerSlice());
+	if (result) {
+		delete mRenderWorkers;
+		mRenderWorkers = 0;
+	}
+	return result;
 }
 
 UInt32		AUInstrumentBase::CountActiveNotes()
@@ -182,6 +211,8 @@ TO DO:
 
 void				AUInstrumentBase::Cleanup()
 {
+	delete mRenderWorkers;
+	mRenderWorkers = 0;
 }
 
 
@@ -205,6 +236,8 @@ OSStatus			AUInstrumentBase::Reset(			AudioUnitScope 					inScope,
 		}
 		mNumActiveNotes = 0;
 		mAbsoluteSampleFrame = 0;
+		if (mVoicePool)
+			mVoicePool->Reset();
 
 		// empty lists.
 		UInt32 numGroups = Groups().GetNumberOfElements();
@@ -217,6 +250,11 @@ OSStatus			AUInstrumentBase::Reset(			AudioUnitScope 					inScope,
 	return MusicDeviceBase::Reset(inScope, inElement);
 }
 
+static inline bool IsNoteEvent(const SynthEvent *inEvent)
+{
+	return inEvent->GetEventType() == SynthEvent::kEventType_NoteOn || inEvent->GetEventType() == SynthEvent::kEventType_NoteOff;
+}
+
 void		AUInstrumentBase::PerformEvents(const AudioTimeStamp& inTimeStamp)
 {
 #if DEBUG_PRINT_RENDER
@@ -225,8 +263,28 @@ void		AUInstrumentBase::PerformEvents(const AudioTimeStamp& inTimeStamp)
 	SynthEvent *event;
 	SynthGroupElement *group;
 	
-	while ((event = mEventQueue.ReadItem()) != NULL)
+	// Drain everything that is queued, then sort note events by sample offset. Events written concurrently
+	// by different threads can arrive out of order; events with the same offset keep their queue order.
+	// Pedal and controller events carry no offset and take effect where they were queued, so note events
+	// are never moved across them. The queue is usually already in order, so this insertion sort rarely
+	// moves anything.
+	UInt32 numEvents = 0;
+	UInt32 slot;
+	while (numEvents < mPendingEvents.size() && (event = mEventQueue.ReadItem(slot)) != NULL)
+	{
+		PendingEvent pending = { event, slot };
+		UInt32 i = numEvents++;
+		if (IsNoteEvent(event)) {
+			for ( ; i > 0 && IsNoteEvent(mPendingEvents[i - 1].mEvent) 
+					&& mPendingEvents[i - 1].mEvent->GetOffsetSampleFrame() > event->GetOffsetSampleFrame(); --i)
+				mPendingEvents[i] = mPendingEvents[i - 1];
+		}
+		mPendingEvents[i] = pending;
+	}
+	
+	for (UInt32 j = 0; j < numEvents; ++j)
 	{
+		event = mPendingEvents[j].mEvent;
 #if DEBUG_PRINT_RENDER
 		printf("event %08X %d\n", event, event->GetEventType());
 #endif
@@ -270,7 +328,7 @@ void		AUInstrumentBase::PerformEvents(const AudioTimeStamp& inTimeStamp)
 				break;
 		}
 		
-		mEventQueue.AdvanceReadPtr();
+		mEventQueue.AdvanceReadPtr(mPendingEvents[j].mSlot);
 	}
 }
 
@@ -293,17 +351,91 @@ OSStatus			AUInstrumentBase::Render(   AudioUnitRenderActionFlags &	ioActionFlag
 		}
 	}
 	
+	OSStatus parallelErr = noErr;
+	if (RenderNotesInParallel((SInt64)inTimeStamp.mSampleTime, inNumberFrames, outputs, parallelErr))
+	{
+		if (parallelErr) return parallelErr;
+	}
+	else
+	{
+		UInt32 numGroups = Groups().GetNumberOfElements();
+		for (UInt32 j = 0; j < numGroups; ++j)
+		{
+			SynthGroupElement *group = (SynthGroupElement*)Groups().GetElement(j);
+			OSStatus err = group->Render((SInt64)inTimeStamp.mSampleTime, inNumberFrames, outputs);
+			if (err) return err;
+		}
+	}
+	
+	// the notes' amplitudes have moved on, so the next voice steal must look at them again
 	UInt32 numGroups = Groups().GetNumberOfElements();
 	for (UInt32 j = 0; j < numGroups; ++j)
 	{
 		SynthGroupElement *group = (SynthGroupElement*)Groups().GetElement(j);
-		OSStatus err = group->Render((SInt64)inTimeStamp.mSampleTime, inNumberFrames, outputs);
-		if (err) return err;
+		for (UInt32 i = 0; i < kNumberOfSoundingNoteStates; ++i)
+			group->mNoteList[i].AmplitudesChanged();
+	}
+	
+	if (mVoicePool && numOutputs > 0)
+	{
+		// pooled notes render nothing themselves; render all of their voices together
+		AudioBufferList* buffArray[16];
+		if (numOutputs > 16) numOutputs = 16;
+		for (UInt32 outBus = 0; outBus < numOutputs; ++outBus)
+			buffArray[outBus] = &GetOutput(outBus)->GetBufferList();
+		mVoicePool->Render(buffArray, numOutputs, inNumberFrames, GetVoicePoolGain());
 	}
 	mAbsoluteSampleFrame += inNumberFrames;
 	return noErr;
 }
 
+// Gathers the sounding notes of every group and hands them to the render workers. Returns false,
+// having rendered nothing, if the notes should be rendered serially by the groups instead.
+bool				AUInstrumentBase::RenderNotesInParallel(	SInt64			inAbsoluteSampleFrame,
+																UInt32			inNumberFrames,
+																AUScope &		outputs,
+																OSStatus &		outErr)
+{
+	if (mRenderWorkers == 0 || mRenderWorkers->NumWorkers() == 0)
+		return false;
+	
+	SynthNote **jobs = mRenderWorkers->Jobs();
+	UInt32 maxJobs = mRenderWorkers->MaxJobs();
+	UInt32 numJobs = 0;
+	UInt32 numGroups = Groups().GetNumberOfElements();
+	for (UInt32 j = 0; j < numGroups; ++j)
+	{
+		SynthGroupElement *group = (SynthGroupElement*)Groups().GetElement(j);
+		if (inAbsoluteSampleFrame == group->mCurrentAbsoluteFrame)
+			continue;	// already rendered at this sample offset
+		for (UInt32 i = 0; i < kNumberOfSoundingNoteStates; ++i)
+		{
+			for (SynthNote *note = group->mNoteList[i].mHead; note; note = note->mNext)
+			{
+				if (numJobs == maxJobs) return false;
+				jobs[numJobs++] = note;
+			}
+		}
+	}
+	
+	AudioBufferList* buffArray[16];
+	UInt32 numOutputs = outputs.GetNumberOfElements();
+	if (numOutputs > 16) numOutputs = 16;
+	for (UInt32 outBus = 0; outBus < numOutputs; ++outBus)
+		buffArray[outBus] = &GetOutput(outBus)->GetBufferList();
+	
+	if (!mRenderWorkers->Render(numJobs, inAbsoluteSampleFrame, inNumberFrames, buffArray, numOutputs, outErr))
+		return false;
+	
+	for (UInt32 j = 0; j < numGroups; ++j)
+		((SynthGroupElement*)Groups().GetElement(j))->mCurrentAbsoluteFrame = inAbsoluteSampleFrame;
+	
+	// now that no other thread is rendering, apply the note ends deferred during the render
+	for (UInt32 i = 0; i < numJobs; ++i)
+		jobs[i]->GetGroup()->EndDeferredNote(jobs[i]);
+	return true;
+}
+
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 //	AUInstrumentBase::ValidFormat
 //
@@ -440,8 +572,9 @@ OSStatus			AUInstrumentBase::StartNote(	MusicDeviceInstrumentID 	inInstrument,
 	}
 	else
 	{
-		SynthEvent *event = mEventQueue.WriteItem();
-		if (!event) return -1; // queue full
+		UInt32 slot;
+		SynthEvent *event = mEventQueue.WriteItem(slot);
+		if (!event) return -1; // queue full; counted in GetEventQueueOverflowCount()
 
 		event->Set(
 			SynthEvent::kEventType_NoteOn,
@@ -451,7 +584,7 @@ OSStatus			AUInstrumentBase::StartNote(	MusicDeviceInstrumentID 	inInstrument,
 			&inParams
 		);
 		
-		mEventQueue.AdvanceWritePtr();
+		mEventQueue.AdvanceWritePtr(slot);
 	}
 	return err;
 }
@@ -474,8 +607,9 @@ OSStatus			AUInstrumentBase::StopNote( MusicDeviceGroupID 			inGroupID,
 	}
 	else
 	{
-		SynthEvent *event = mEventQueue.WriteItem();
-		if (!event) return -1; // queue full
+		UInt32 slot;
+		SynthEvent *event = mEventQueue.WriteItem(slot);
+		if (!event) return -1; // queue full; counted in GetEventQueueOverflowCount()
 
 		event->Set(
 			SynthEvent::kEventType_NoteOff,
@@ -485,7 +619,7 @@ OSStatus			AUInstrumentBase::StopNote( MusicDeviceGroupID 			inGroupID,
 			NULL
 		);
 		
-		mEventQueue.AdvanceWritePtr();
+		mEventQueue.AdvanceWritePtr(slot);
 	}
 	return err;
 }
@@ -528,12 +662,13 @@ OSStatus	AUInstrumentBase::SendPedalEvent(MusicDeviceGroupID inGroupID, UInt32 i
 	}
 	else
 	{
-		SynthEvent *event = mEventQueue.WriteItem();
-		if (!event) return -1; // queue full
+		UInt32 slot;
+		SynthEvent *event = mEventQueue.WriteItem(slot);
+		if (!event) return -1; // queue full; counted in GetEventQueueOverflowCount()
 
 		event->Set(inEventType, inGroupID, 0, 0, NULL);
 		
-		mEventQueue.AdvanceWritePtr();
+		mEventQueue.AdvanceWritePtr(slot);
 	}
 	return noErr;
 }
@@ -57,10 +57,12 @@
 #include "SynthEvent.h"
 #include "SynthNote.h"
 #include "SynthElement.h"
+#include "SynthVoicePool.h"
+#include "SynthRenderWorkers.h"
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-typedef LockFreeFIFOWithFree<SynthEvent> SynthEventQueue;
+typedef LockFreeMPMCFIFOWithFree<SynthEvent> SynthEventQueue;
 
 class AUInstrumentBase : public MusicDeviceBase
 {
@@ -164,6 +166,13 @@ public:
 	SynthNote*			GetAFreeNote(UInt32 inFrame);
 	void				AddFreeNote(SynthNote* inNote);
 	
+	SynthVoicePool*		GetVoicePool() const { return mVoicePool; }
+	
+	bool				IsRenderingNotesInParallel() const { return mRenderWorkers && mRenderWorkers->IsRendering(); }
+	
+	// number of note and pedal events refused since creation because the event queue was full
+	UInt32				GetEventQueueOverflowCount() const { return mEventQueue.OverflowCount(); }
+	
 	friend class SynthGroupElement;
 protected:
 
@@ -174,6 +183,19 @@ protected:
 	// number of active notes. inNoteData should be an array of size inMaxActiveNotes.
 	void				SetNotes(UInt32 inNumNotes, UInt32 inMaxActiveNotes, SynthNote* inNotes, UInt32 inNoteSize);
 	
+	// optionally call SetVoicePool in your Initialize() method if your notes derive from SynthPooledNote.
+	// Allocate the pool first, for as many output buses as the voices use; the base class renders it
+	// into the output buses after the groups render, scaled by GetVoicePoolGain().
+	void				SetVoicePool(SynthVoicePool* inPool) { mVoicePool = inPool; }
+	virtual Float32		GetVoicePoolGain() { return 1.f; }
+	
+	// optionally call SetRenderWorkers in your Initialize() method, after SetNotes, to render the notes
+	// of all groups on inNumWorkers threads in addition to the render thread. Your notes' Render methods
+	// must be safe to call concurrently, and SynthGroupElement::Render is bypassed while the parallel
+	// path is taken. Pass 0 to render serially again.
+	OSStatus			SetRenderWorkers(UInt32 inNumWorkers);
+	SynthRenderWorkers*	GetRenderWorkers() const { return mRenderWorkers; }
+	
 	void				PerformEvents(   const AudioTimeStamp &			inTimeStamp);
 	OSStatus			SendPedalEvent(MusicDeviceGroupID inGroupID, UInt32 inEventType, UInt32 inOffsetSampleFrame);
 	virtual SynthNote*  VoiceStealing(UInt32 inFrame, bool inKillIt);
@@ -193,17 +215,27 @@ protected:
 
 	
 private:
+	bool				RenderNotesInParallel(SInt64 inAbsoluteSampleFrame, UInt32 inNumberFrames, AUScope &outputs, OSStatus &outErr);
 				
 	SInt32 mNoteIDCounter;
 	
 	SynthEventQueue mEventQueue;
 	
+	// events drained by PerformEvents, held until they have been performed in sample offset order
+	struct PendingEvent {
+		SynthEvent *	mEvent;
+		UInt32			mSlot;
+	};
+	std::vector<PendingEvent> mPendingEvents;
+	
 	UInt32 mNumNotes;
 	UInt32 mNumActiveNotes;
 	UInt32 mMaxActiveNotes;
 	SynthNote* mNotes;	
 	SynthNoteList mFreeNotes;
 	UInt32 mNoteSize;
+	SynthVoicePool* mVoicePool;
+	SynthRenderWorkers* mRenderWorkers;
 	
 	AUScope			mPartScope;
 	const UInt32	mInitNumPartEls;
@@ -166,3 +166,102 @@ private:
 	ITEM *mItems;
 };
 
+
+
+
+// Bounded multi-producer, multi-consumer version of LockFreeFIFOWithFree, after Dmitry Vyukov's bounded
+// MPMC queue. Every slot carries a sequence number which tells writers and readers whether the slot is
+// free, filled, or still being read, so any number of threads may write (or read) concurrently without
+// locks. Writing and reading are two-step: WriteItem/ReadItem claim a slot and return its item, and
+// AdvanceWritePtr/AdvanceReadPtr hand it on. A reader may hold several claimed slots at once.
+//
+// As with LockFreeFIFOWithFree, items are freed on the writing thread: a writer calls Free() on the
+// stale contents of a slot before reusing it, so ITEM must be safe to Free() when default constructed.
+// When the queue is full WriteItem returns NULL and the overflow is counted.
+
+template <class ITEM>
+class LockFreeMPMCFIFOWithFree
+{
+	LockFreeMPMCFIFOWithFree(); // private, unimplemented.
+public:
+	LockFreeMPMCFIFOWithFree(UInt32 inMaxSize)
+		: mWriteIndex(0), mReadIndex(0), mOverflowCount(0)
+	{
+		//assert(IsPowerOfTwo(inMaxSize));
+		mSlots = new Slot[inMaxSize];
+		mMask = inMaxSize - 1;
+		for (UInt32 i = 0; i < inMaxSize; ++i)
+			mSlots[i].mSequence = i;
+	}
+	
+	~LockFreeMPMCFIFOWithFree()
+	{
+		for (UInt32 i = 0; i <= mMask; ++i)
+			mSlots[i].mItem.Free();
+		delete [] mSlots;
+	}
+	
+	// returns NULL if the queue is full; otherwise fill in the item and pass outSlot to AdvanceWritePtr
+	ITEM* WriteItem(UInt32 &outSlot)
+	{
+		UInt32 pos = mWriteIndex;
+		for (;;)
+		{
+			Slot &slot = mSlots[pos & mMask];
+			SInt32 diff = (SInt32)(slot.mSequence - pos);
+			if (diff == 0) {
+				if (OSAtomicCompareAndSwap32Barrier(pos, pos + 1, (volatile int32_t*)&mWriteIndex)) {
+					outSlot = pos;
+					slot.mItem.Free(); // free items on the write thread.
+					return &slot.mItem;
+				}
+			} else if (diff < 0) {
+				OSAtomicIncrement32Barrier((volatile int32_t*)&mOverflowCount);
+				return NULL;
+			}
+			pos = mWriteIndex;
+		}
+	}
+	
+	// returns NULL if the queue is empty; otherwise pass outSlot to AdvanceReadPtr when done with the item
+	ITEM* ReadItem(UInt32 &outSlot)
+	{
+		UInt32 pos = mReadIndex;
+		for (;;)
+		{
+			Slot &slot = mSlots[pos & mMask];
+			SInt32 diff = (SInt32)(slot.mSequence - (pos + 1));
+			if (diff == 0) {
+				if (OSAtomicCompareAndSwap32Barrier(pos, pos + 1, (volatile int32_t*)&mReadIndex)) {
+					outSlot = pos;
+					return &slot.mItem;
+				}
+			} else if (diff < 0) {
+				return NULL;
+			}
+			pos = mReadIndex;
+		}
+	}
+	
+	void AdvanceWritePtr(UInt32 inSlot) { OSMemoryBarrier(); mSlots[inSlot & mMask].mSequence = inSlot + 1; }
+	void AdvanceReadPtr(UInt32 inSlot)  { OSMemoryBarrier(); mSlots[inSlot & mMask].mSequence = inSlot + mMask + 1; }
+	
+	// number of writes refused because the queue was full
+	UInt32 OverflowCount() const { return mOverflowCount; }
+	
+private:
+	struct Slot
+	{
+		volatile UInt32	mSequence;
+		ITEM			mItem;
+	};
+	
+	// writers and readers each get their own cache line
+	volatile UInt32 mWriteIndex;
+	char			mPad0[64 - sizeof(UInt32)];
+	volatile UInt32 mReadIndex;
+	char			mPad1[64 - sizeof(UInt32)];
+	volatile UInt32 mOverflowCount;
+	UInt32 mMask;
+	Slot *mSlots;
+};
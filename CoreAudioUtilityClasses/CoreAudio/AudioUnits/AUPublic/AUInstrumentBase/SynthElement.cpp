@@ -213,6 +213,12 @@ void SynthGroupElement::NoteEnded(SynthNote *inNote, UInt32 inFrame)
 #if DEBUG_PRINT_NOTE
 	printf("SynthGroupElement::NoteEnded: id %d state %d\n", inNote->mNoteID, inNote->mState);
 #endif
+	// the note lists belong to the render thread; finish this once all render workers are done
+	if (GetAUInstrument()->IsRenderingNotesInParallel()) {
+		inNote->mDeferredEndFrame = inFrame;
+		return;
+	}
+	
 	if (inNote->IsSounding()) {
 		SynthNoteList *list = &mNoteList[inNote->GetState()];
 		list->RemoveNote(inNote);
@@ -221,6 +227,15 @@ void SynthGroupElement::NoteEnded(SynthNote *inNote, UInt32 inFrame)
 	GetAUInstrument()->AddFreeNote(inNote);
 }
 
+void SynthGroupElement::EndDeferredNote(SynthNote *inNote)
+{
+	if (inNote->mDeferredEndFrame >= 0) {
+		UInt32 frame = inNote->mDeferredEndFrame;
+		inNote->mDeferredEndFrame = -1;
+		NoteEnded(inNote, frame);
+	}
+}
+
 void SynthGroupElement::NoteFastReleased(SynthNote *inNote)
 {
 #if DEBUG_PRINT_NOTE
@@ -156,6 +156,7 @@ public:
 	void						SostenutoOff(UInt32 inFrame);
 
 	void						NoteEnded(SynthNote *inNote, UInt32 inFrame);
+	void						EndDeferredNote(SynthNote *inNote);
 	void						NoteFastReleased(SynthNote *inNote);
 	
 	virtual bool			ChannelMessage(UInt16 controlID, UInt16 controlValue);
@@ -73,7 +73,7 @@ public:
 	};
 
 
-	SynthEvent() {}
+	SynthEvent() : mNoteParams(NULL) {}
 	~SynthEvent() {}
 
 	void Set(   
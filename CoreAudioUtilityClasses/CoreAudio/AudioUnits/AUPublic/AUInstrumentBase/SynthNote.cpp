@@ -84,6 +84,7 @@ void SynthNote::Reset()
 	mRelativeStartFrame = 0;
 	mRelativeReleaseFrame = 0;
 	mRelativeKillFrame = 0;
+	mDeferredEndFrame = -1;
 }
 
 void SynthNote::Kill(UInt32 inFrame)
@@ -104,6 +104,10 @@ struct SynthNote
 		mRelativeStartFrame(0),
 		mRelativeReleaseFrame(-1),
 		mRelativeKillFrame(-1),
+		mDeferredEndFrame(-1),
+		mAgeHeapIndex(0),
+		mQuietHeapIndex(0),
+		mHeapAmplitude(0.0f),
 		mPitch(0.0f),
 		mVelocity(0.0f)
 	{
@@ -177,6 +181,12 @@ private:
 	SInt32					mRelativeStartFrame;
 	SInt32					mRelativeReleaseFrame;
 	SInt32					mRelativeKillFrame;
+	SInt32					mDeferredEndFrame;	// NoteEnded frame while rendering in parallel, else -1
+	
+	// position in the voice stealing heaps of the list the note is in; see SynthNoteList
+	UInt32					mAgeHeapIndex;
+	UInt32					mQuietHeapIndex;
+	Float32					mHeapAmplitude;
 	
 	Float32					mPitch;
 	Float32					mVelocity;
@@ -47,6 +47,92 @@
 #include "SynthNoteList.h"
 #include <stdexcept>
 
+void SynthNoteList::SetCapacity(UInt32 inMaxNotes)
+{
+	mAgeHeap.Allocate(inMaxNotes);
+	mQuietHeap.Allocate(inMaxNotes);
+	mQuietHeap.Invalidate();
+}
+
+void SynthNoteList::NoteHeap::Allocate(UInt32 inCapacity)
+{
+	free(mNotes);
+	mNotes = inCapacity ? (SynthNote **)calloc(inCapacity, sizeof(SynthNote *)) : NULL;
+	mCapacity = inCapacity;
+	mSize = 0;
+	mValid = false;	// rebuilt from the list on first use
+}
+
+void SynthNoteList::NoteHeap::Push(SynthNote *inNote)
+{
+	if (mSize == mCapacity) {
+		// more notes than expected; fall back to scanning until the list is emptied
+		mValid = false;
+		return;
+	}
+	Place(inNote, mSize++);
+	SiftUp(mSize - 1);
+}
+
+void SynthNoteList::NoteHeap::Remove(SynthNote *inNote)
+{
+	if (!mValid) return;
+	UInt32 pos = inNote->*mIndex;
+	if (pos >= mSize || mNotes[pos] != inNote) return;
+	
+	SynthNote *last = mNotes[--mSize];
+	if (pos < mSize) {
+		Place(last, pos);
+		if (pos > 0 && mLess(last, mNotes[(pos - 1) / 2]))
+			SiftUp(pos);
+		else
+			SiftDown(pos);
+	}
+}
+
+bool SynthNoteList::NoteHeap::Validate(SynthNote *inHead)
+{
+	if (mValid) return true;
+	if (mCapacity == 0) return false;
+	
+	mSize = 0;
+	for (SynthNote *note = inHead; note; note = note->mNext) {
+		if (mSize == mCapacity) return false;
+		Place(note, mSize++);
+	}
+	for (UInt32 pos = mSize / 2; pos-- > 0; )
+		SiftDown(pos);
+	mValid = true;
+	return true;
+}
+
+void SynthNoteList::NoteHeap::SiftUp(UInt32 inPos)
+{
+	SynthNote *note = mNotes[inPos];
+	while (inPos > 0) {
+		UInt32 parent = (inPos - 1) / 2;
+		if (!mLess(note, mNotes[parent])) break;
+		Place(mNotes[parent], inPos);
+		inPos = parent;
+	}
+	Place(note, inPos);
+}
+
+void SynthNoteList::NoteHeap::SiftDown(UInt32 inPos)
+{
+	SynthNote *note = mNotes[inPos];
+	for (;;) {
+		UInt32 child = 2 * inPos + 1;
+		if (child >= mSize) break;
+		if (child + 1 < mSize && mLess(mNotes[child + 1], mNotes[child]))
+			++child;
+		if (!mLess(mNotes[child], note)) break;
+		Place(mNotes[child], inPos);
+		inPos = child;
+	}
+	Place(note, inPos);
+}
+
 void SynthNoteList::SanityCheck() const
 {
 	if (mState >= kNoteState_Unset) {
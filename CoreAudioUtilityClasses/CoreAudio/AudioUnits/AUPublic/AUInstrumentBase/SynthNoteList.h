@@ -48,6 +48,7 @@
 #define __SynthNoteList__
 
 #include "SynthNote.h"
+#include <stdlib.h>
 
 #if DEBUG
 #ifndef DEBUG_PRINT
@@ -60,7 +61,17 @@
 
 struct SynthNoteList
 {
-	SynthNoteList() : mState(kNoteState_Unset), mHead(0), mTail(0) {}
+	SynthNoteList() : mState(kNoteState_Unset), mHead(0), mTail(0), 
+		mAgeHeap(StartsEarlier, &SynthNote::mAgeHeapIndex), mQuietHeap(IsQuieter, &SynthNote::mQuietHeapIndex) {}
+	
+	// Voice stealing support. Once SetCapacity has been called, the list also keeps its notes in two
+	// indexed binary heaps, one ordered by start frame and one by amplitude, so that FindOldestNote and
+	// FindMostQuietNote don't have to walk the list. The start frame heap is maintained incrementally by
+	// AddNote, RemoveNote and TransferAllFrom. Amplitudes change as notes render, so the amplitude heap is
+	// a snapshot: AmplitudesChanged() discards it and the next FindMostQuietNote rebuilds it once, after
+	// which further steals in the same slice are O(log n). Without a capacity the lists are scanned as before.
+	void SetCapacity(UInt32 inMaxNotes);
+	void AmplitudesChanged() { mQuietHeap.Invalidate(); }
 	
 	bool NotEmpty() const { return mHead != NULL; }
 	bool IsEmpty() const { return mHead == NULL; }
@@ -69,6 +80,8 @@ struct SynthNoteList
 		SanityCheck();
 #endif
 		mHead = mTail = NULL; 
+		mAgeHeap.Clear();
+		mQuietHeap.Clear();
 	}
 	
 	UInt32 Length() const {
@@ -95,6 +108,8 @@ struct SynthNoteList
 		
 		if (mHead) { mHead->mPrev = inNote; mHead = inNote; }
 		else mHead = mTail = inNote;
+		
+		AddToHeaps(inNote);
 #if USE_SANITY_CHECK
 		SanityCheck();
 #endif
@@ -116,6 +131,9 @@ struct SynthNoteList
 		
 		inNote->mPrev = 0;
 		inNote->mNext = 0;
+		
+		mAgeHeap.Remove(inNote);
+		mQuietHeap.Remove(inNote);
 #if USE_SANITY_CHECK
 		SanityCheck();
 #endif
@@ -141,6 +159,7 @@ struct SynthNoteList
 #endif
 				note->Release(inFrame);
 				note->SetState(mState);
+				AddToHeaps(note);
 			}
 		}
 		else
@@ -148,6 +167,7 @@ struct SynthNoteList
 			for (SynthNote* note = inNoteList->mHead; note; note = note->mNext)
 			{
 				note->SetState(mState);
+				AddToHeaps(note);
 			}
 		}
 		
@@ -160,6 +180,8 @@ struct SynthNoteList
 		
 		inNoteList->mHead = NULL;
 		inNoteList->mTail = NULL;
+		inNoteList->mAgeHeap.Clear();
+		inNoteList->mQuietHeap.Clear();
 #if USE_SANITY_CHECK
 		SanityCheck();
 		inNoteList->SanityCheck();
@@ -174,6 +196,9 @@ struct SynthNoteList
 #if USE_SANITY_CHECK
 		SanityCheck();
 #endif
+		if (mAgeHeap.Validate(mHead))
+			return mAgeHeap.Top();
+		
 		UInt64 minStartFrame = -1;
 		SynthNote* oldestNote = NULL;
 		for (SynthNote* note = mHead; note; note = note->mNext)
@@ -192,6 +217,13 @@ struct SynthNoteList
 #if DEBUG_PRINT
 		printf("FindMostQuietNote\n");
 #endif
+		if (mQuietHeap.IsAllocated() && !mQuietHeap.IsValid()) {
+			for (SynthNote* note = mHead; note; note = note->mNext)
+				note->mHeapAmplitude = note->Amplitude();
+		}
+		if (mQuietHeap.Validate(mHead))
+			return mQuietHeap.Top();
+		
 		Float32 minAmplitude = 1e9f;
 		UInt64 minStartFrame = -1;
 		SynthNote* mostQuietNote = NULL;
@@ -225,6 +257,67 @@ struct SynthNoteList
 	SynthNoteState	mState;
 	SynthNote *		mHead;
 	SynthNote *		mTail;
+
+private:
+	// a binary min-heap of notes; each note stores its position in the heap so it can be removed in O(log n)
+	struct NoteHeap
+	{
+		typedef bool (*LessFunc)(const SynthNote *a, const SynthNote *b);
+		
+		NoteHeap(LessFunc inLess, UInt32 SynthNote::*inIndex) 
+			: mNotes(0), mSize(0), mCapacity(0), mValid(false), mLess(inLess), mIndex(inIndex) {}
+		~NoteHeap() { free(mNotes); }
+		
+		void		Allocate(UInt32 inCapacity);
+		bool		IsAllocated() const { return mCapacity > 0; }
+		bool		IsValid() const { return mValid; }
+		void		Invalidate() { mValid = false; }
+		void		Clear() { mSize = 0; mValid = mCapacity > 0; }
+		
+		void		Push(SynthNote *inNote);
+		void		Remove(SynthNote *inNote);
+		SynthNote*	Top() const { return mSize ? mNotes[0] : NULL; }
+		
+		// rebuilds the heap from the list starting at inHead if necessary; false if it cannot be used
+		bool		Validate(SynthNote *inHead);
+		
+	private:
+		void		Place(SynthNote *inNote, UInt32 inPos) { mNotes[inPos] = inNote; inNote->*mIndex = inPos; }
+		void		SiftUp(UInt32 inPos);
+		void		SiftDown(UInt32 inPos);
+		
+		SynthNote **		mNotes;
+		UInt32				mSize;
+		UInt32				mCapacity;
+		bool				mValid;
+		LessFunc			mLess;
+		UInt32 SynthNote::*	mIndex;
+	};
+	
+	void AddToHeaps(SynthNote *inNote)
+	{
+		if (mAgeHeap.IsValid())
+			mAgeHeap.Push(inNote);
+		if (mQuietHeap.IsValid()) {
+			inNote->mHeapAmplitude = inNote->Amplitude();
+			mQuietHeap.Push(inNote);
+		}
+	}
+	
+	static bool StartsEarlier(const SynthNote *a, const SynthNote *b)
+	{
+		return a->mAbsoluteStartFrame < b->mAbsoluteStartFrame;
+	}
+	
+	// use earliest start time as a tie breaker
+	static bool IsQuieter(const SynthNote *a, const SynthNote *b)
+	{
+		return a->mHeapAmplitude < b->mHeapAmplitude 
+			|| (a->mHeapAmplitude == b->mHeapAmplitude && a->mAbsoluteStartFrame < b->mAbsoluteStartFrame);
+	}
+	
+	NoteHeap		mAgeHeap;
+	NoteHeap		mQuietHeap;
 };
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,253 @@
+/*
+     File: SynthRenderWorkers.cpp 
+ Abstract:  SynthRenderWorkers.h  
+  Version: 1.0.2 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2012 Apple Inc. All Rights Reserved. 
+  
+*/
+#include "SynthRenderWorkers.h"
+#include "AUInstrumentBase.h"
+#include "CAAtomic.h"
+#include "CAHostTimeBase.h"
+#include <stddef.h>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+SynthRenderWorkers::SynthRenderWorkers()
+	: mPool(NULL),
+	  mNumWorkers(0),
+	  mMinNotesPerPartition(kDefaultMinNotesPerPartition),
+	  mSampleRate(0.),
+	  mJobs(NULL),
+	  mMaxJobs(0),
+	  mMaxFrames(0),
+	  mNumBuses(0),
+	  mNumScratchBuses(0),
+	  mScratchBuses(NULL),
+	  mBusBytesPerFrame(NULL),
+	  mScratchData(NULL),
+	  mNumJobs(0),
+	  mNumPartitions(0),
+	  mAbsoluteSampleFrame(0),
+	  mNumFrames(0),
+	  mRendering(false)
+{
+	for (UInt32 i = 0; i <= kMaxWorkers; ++i)
+		mPartitionErr[i] = noErr;
+}
+
+SynthRenderWorkers::~SynthRenderWorkers()
+{
+	Deallocate();
+}
+
+OSStatus	SynthRenderWorkers::Allocate(AUInstrumentBase *inAU, UInt32 inNumWorkers, UInt32 inMaxNotes, UInt32 inMaxFrames)
+{
+	Deallocate();
+	
+	if (inNumWorkers > kMaxWorkers)
+		inNumWorkers = kMaxWorkers;
+	if (inNumWorkers == 0)
+		return noErr;
+	
+	UInt32 numPartitions = inNumWorkers + 1;
+	UInt32 numBuses = inAU->Outputs().GetNumberOfElements();
+	if (numBuses == 0)
+		return noErr;
+	
+	// the scratch buses are summed as Float32, in whatever layout the outputs use
+	mBusBytesPerFrame = (UInt32 *)calloc(numBuses, sizeof(UInt32));
+	UInt32 floatsPerFrame = 0;
+	for (UInt32 bus = 0; bus < numBuses; ++bus) {
+		const CAStreamBasicDescription &format = inAU->GetOutput(bus)->GetStreamFormat();
+		if (!(format.mFormatFlags & kAudioFormatFlagIsFloat) || format.mBitsPerChannel != 32) {
+			Deallocate();
+			return kAudioUnitErr_FormatNotSupported;
+		}
+		mBusBytesPerFrame[bus] = format.mBytesPerFrame;
+		floatsPerFrame += format.NumberChannelStreams() * format.mBytesPerFrame / sizeof(Float32);
+	}
+	
+	// the workers run with the same time constraints as an audio I/O thread rendering one slice
+	mSampleRate = inAU->GetOutput(0)->GetStreamFormat().mSampleRate;
+	UInt32 period = (UInt32)CAHostTimeBase::ConvertFromNanos((UInt64)(1.0e9 * inMaxFrames / mSampleRate));
+	mPool = new CARealtimeThreadPool(inNumWorkers, period, period / 2, period);
+	if (mPool->GetNumWorkers() == 0) {
+		// no real-time safe wakeup on this platform; notes are always rendered inline
+		Deallocate();
+		return noErr;
+	}
+	
+	mNumBuses = numBuses;
+	mMaxFrames = inMaxFrames;
+	mMaxJobs = inMaxNotes;
+	mJobs = (SynthNote **)calloc(inMaxNotes, sizeof(SynthNote *));
+	mScratchData = (Float32 *)calloc(numPartitions * floatsPerFrame * inMaxFrames, sizeof(Float32));
+	mNumScratchBuses = numPartitions * numBuses;
+	mScratchBuses = (AudioBufferList **)calloc(mNumScratchBuses, sizeof(AudioBufferList *));
+	
+	Float32 *data = mScratchData;
+	for (UInt32 partition = 0; partition < numPartitions; ++partition) {
+		for (UInt32 bus = 0; bus < numBuses; ++bus) {
+			const CAStreamBasicDescription &format = inAU->GetOutput(bus)->GetStreamFormat();
+			UInt32 numBuffers = format.NumberChannelStreams();
+			AudioBufferList *abl = (AudioBufferList *)calloc(1, offsetof(AudioBufferList, mBuffers) + numBuffers * sizeof(AudioBuffer));
+			abl->mNumberBuffers = numBuffers;
+			for (UInt32 i = 0; i < numBuffers; ++i) {
+				abl->mBuffers[i].mNumberChannels = format.NumberInterleavedChannels();
+				abl->mBuffers[i].mDataByteSize = inMaxFrames * format.mBytesPerFrame;
+				abl->mBuffers[i].mData = data;
+				data += inMaxFrames * format.mBytesPerFrame / sizeof(Float32);
+			}
+			mScratchBuses[partition * numBuses + bus] = abl;
+		}
+	}
+	
+	// the pool may have started fewer workers than asked for; the partitions are sized for the request
+	mNumWorkers = mPool->GetNumWorkers();
+	return noErr;
+}
+
+void	SynthRenderWorkers::Deallocate()
+{
+	delete mPool;
+	mPool = NULL;
+	mNumWorkers = 0;
+	
+	if (mScratchBuses) {
+		for (UInt32 i = 0; i < mNumScratchBuses; ++i)
+			free(mScratchBuses[i]);
+		free(mScratchBuses);
+		mScratchBuses = NULL;
+	}
+	free(mScratchData);
+	mScratchData = NULL;
+	free(mBusBytesPerFrame);
+	mBusBytesPerFrame = NULL;
+	free(mJobs);
+	mJobs = NULL;
+	mMaxJobs = 0;
+	mMaxFrames = 0;
+	mNumBuses = 0;
+	mNumScratchBuses = 0;
+}
+
+bool	SynthRenderWorkers::Render(	UInt32				inNumJobs,
+									UInt64				inAbsoluteSampleFrame,
+									UInt32				inNumFrames,
+									AudioBufferList **	ioOutputs,
+									UInt32				inNumOutputs,
+									OSStatus &			outErr)
+{
+	if (mNumWorkers == 0 || inNumFrames > mMaxFrames || inNumOutputs > mNumBuses || inNumJobs > mMaxJobs)
+		return false;
+	
+	UInt32 numPartitions = inNumJobs / mMinNotesPerPartition;
+	if (numPartitions > mNumWorkers + 1)
+		numPartitions = mNumWorkers + 1;
+	if (numPartitions < 2)
+		return false;
+	
+	mNumJobs = inNumJobs;
+	mNumPartitions = numPartitions;
+	mAbsoluteSampleFrame = inAbsoluteSampleFrame;
+	mNumFrames = inNumFrames;
+	for (UInt32 i = 0; i < numPartitions; ++i)
+		mPartitionErr[i] = noErr;
+	
+	// the render is due one buffer's duration from now
+	UInt64 deadline = CAHostTimeBase::GetTheCurrentTime() + CAHostTimeBase::ConvertFromNanos((UInt64)(1.0e9 * inNumFrames / mSampleRate));
+	
+	mRendering = true;
+	CAMemoryBarrier();
+	OSStatus err = mPool->Run(RenderPartitionTask, this, numPartitions, deadline);
+	CAMemoryBarrier();
+	mRendering = false;
+	if (err)
+		return false;	// nothing was rendered
+	
+	// mix down in partition order so that the result is deterministic
+	outErr = noErr;
+	for (UInt32 partition = 0; partition < numPartitions; ++partition) {
+		if (outErr == noErr)
+			outErr = mPartitionErr[partition];
+		for (UInt32 bus = 0; bus < inNumOutputs; ++bus) {
+			const AudioBufferList *src = mScratchBuses[partition * mNumBuses + bus];
+			AudioBufferList *dst = ioOutputs[bus];
+			UInt32 numFloats = inNumFrames * mBusBytesPerFrame[bus] / sizeof(Float32);
+			for (UInt32 i = 0; i < dst->mNumberBuffers && i < src->mNumberBuffers; ++i) {
+				const Float32 *in = (const Float32 *)src->mBuffers[i].mData;
+				Float32 *out = (Float32 *)dst->mBuffers[i].mData;
+				for (UInt32 j = 0; j < numFloats; ++j)
+					out[j] += in[j];
+			}
+		}
+	}
+	return true;
+}
+
+void	SynthRenderWorkers::RenderPartitionTask(void *inRefCon, UInt32 inPartition, UInt32 /*inThreadIndex*/)
+{
+	static_cast<SynthRenderWorkers *>(inRefCon)->RenderPartition(inPartition);
+}
+
+void	SynthRenderWorkers::RenderPartition(UInt32 inPartition)
+{
+	AudioBufferList **buses = &mScratchBuses[inPartition * mNumBuses];
+	for (UInt32 bus = 0; bus < mNumBuses; ++bus) {
+		AudioBufferList *abl = buses[bus];
+		for (UInt32 i = 0; i < abl->mNumberBuffers; ++i) {
+			abl->mBuffers[i].mDataByteSize = mNumFrames * mBusBytesPerFrame[bus];
+			memset(abl->mBuffers[i].mData, 0, abl->mBuffers[i].mDataByteSize);
+		}
+	}
+	
+	UInt32 firstJob = inPartition * mNumJobs / mNumPartitions;
+	UInt32 endJob = (inPartition + 1) * mNumJobs / mNumPartitions;
+	for (UInt32 job = firstJob; job < endJob; ++job) {
+		OSStatus err = mJobs[job]->Render(mAbsoluteSampleFrame, mNumFrames, buses, mNumBuses);
+		if (err) {
+			mPartitionErr[inPartition] = err;
+			break;
+		}
+	}
+}
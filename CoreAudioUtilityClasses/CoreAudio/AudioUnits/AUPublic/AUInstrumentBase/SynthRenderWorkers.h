@@ -0,0 +1,143 @@
+/*
+     File: SynthRenderWorkers.h 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.2 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2012 Apple Inc. All Rights Reserved. 
+  
+*/
+#ifndef __SynthRenderWorkers__
+#define __SynthRenderWorkers__
+
+#include <AudioUnit/AudioUnit.h>
+#include "SynthNote.h"
+#include "CARealtimeThreadPool.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// SynthRenderWorkers renders the sounding notes of an AUInstrumentBase on several threads.
+//
+// The notes to render are gathered into a flat job array and split into contiguous partitions,
+// one per thread (the render thread takes part too). Each partition renders into its own zeroed
+// scratch buses, and the scratch buses are then summed into the outputs in partition order, so the
+// output does not depend on which thread rendered which partition.
+//
+// The partitions are the tasks of a CARealtimeThreadPool job, so threads claim them with a
+// compare-and-swap; there are no locks and nothing is allocated after Allocate(). The render thread
+// never waits for a worker to wake up: once its own partition is done it claims and renders any
+// partition no worker has started, and then waits only for partitions already in progress, with a
+// short spin and then on a semaphore rather than by spinning for the rest of the slice. Each render
+// is given the buffer's duration as its deadline; GetMissedDeadlineCount() counts the overruns.
+//
+// Notes that end while rendering in parallel have their NoteEnded deferred until all partitions are
+// done (see SynthGroupElement::NoteEnded), so the note lists are only ever changed on the render thread.
+// Everything a note does in Render() must therefore be safe to run concurrently with other notes.
+class SynthRenderWorkers
+{
+public:
+	enum {
+		kMaxWorkers = 16,
+		kDefaultMinNotesPerPartition = 4
+	};
+	
+	SynthRenderWorkers();
+	~SynthRenderWorkers();
+	
+	// Creates a pool of inNumWorkers threads in addition to the render thread and allocates the job
+	// array and scratch buses for the output formats of inAU. Call once the formats and notes are set up.
+	// On platforms where the pool has no workers, NumWorkers() stays 0 and notes render inline.
+	OSStatus				Allocate(AUInstrumentBase *inAU, UInt32 inNumWorkers, UInt32 inMaxNotes, UInt32 inMaxFrames);
+	void					Deallocate();
+	
+	UInt32					NumWorkers() const { return mNumWorkers; }
+	
+	// below this many notes per partition it is cheaper to render inline
+	void					SetMinNotesPerPartition(UInt32 inNotes) { mMinNotesPerPartition = inNotes > 0 ? inNotes : 1; }
+	
+	SynthNote**				Jobs() { return mJobs; }
+	UInt32					MaxJobs() const { return mMaxJobs; }
+	
+	// Renders the first inNumJobs notes of Jobs() and adds them into ioOutputs. Returns false,
+	// having rendered nothing, if the notes should be rendered inline instead. outErr receives
+	// the first error returned by a note, in job order.
+	bool					Render(	UInt32				inNumJobs,
+									UInt64				inAbsoluteSampleFrame,
+									UInt32				inNumFrames,
+									AudioBufferList **	ioOutputs,
+									UInt32				inNumOutputs,
+									OSStatus &			outErr);
+	
+	// true while partitions may be rendering on other threads
+	bool					IsRendering() const { return mRendering; }
+	
+	// parallel renders that finished later than one buffer's duration after they started
+	UInt64					GetMissedDeadlineCount() const { return mPool ? mPool->GetMissedDeadlineCount() : 0; }
+	
+private:
+	static void				RenderPartitionTask(void *inRefCon, UInt32 inPartition, UInt32 inThreadIndex);
+	void					RenderPartition(UInt32 inPartition);
+	
+	CARealtimeThreadPool *	mPool;
+	UInt32					mNumWorkers;
+	UInt32					mMinNotesPerPartition;
+	Float64					mSampleRate;
+	
+	SynthNote **			mJobs;
+	UInt32					mMaxJobs;
+	UInt32					mMaxFrames;
+	
+	// scratch buses: mNumBuses AudioBufferLists per partition, laid out like the outputs
+	UInt32					mNumBuses;
+	UInt32					mNumScratchBuses;
+	AudioBufferList **		mScratchBuses;
+	UInt32 *				mBusBytesPerFrame;
+	Float32 *				mScratchData;
+	
+	// the current cycle; written by the render thread before the partitions are published
+	UInt32					mNumJobs;
+	UInt32					mNumPartitions;
+	UInt64					mAbsoluteSampleFrame;
+	UInt32					mNumFrames;
+	OSStatus				mPartitionErr[kMaxWorkers + 1];
+	volatile bool			mRendering;
+};
+
+#endif
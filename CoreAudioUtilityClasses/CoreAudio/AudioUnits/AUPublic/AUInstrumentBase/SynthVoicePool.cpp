@@ -0,0 +1,491 @@
+/*
+     File: SynthVoicePool.cpp 
+ Abstract:  SynthVoicePool.h  
+  Version: 1.0.2 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2012 Apple Inc. All Rights Reserved. 
+  
+*/
+#include "SynthVoicePool.h"
+#include "AUInstrumentBase.h"
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+#if TARGET_CPU_X86 || TARGET_CPU_X86_64
+	#include <emmintrin.h>
+	#define SYNTH_VOICE_POOL_SSE 1
+#else
+	#define SYNTH_VOICE_POOL_SSE 0
+#endif
+
+static const Float32 kPi = 3.14159265358979f;
+static const Float32 kTwoPi = 6.28318530717959f;
+
+// Parabolic sine approximation, valid for x in -pi..pi, maximum error about 0.001.
+// It needs only multiplies, adds and absolute values, so it vectorizes directly.
+static const Float32 kSinB = 4.f / kPi;
+static const Float32 kSinC = -4.f / (kPi * kPi);
+static const Float32 kSinP = 0.225f;
+
+static inline UInt32 RoundUpTo4(UInt32 n) { return (n + 3) & ~3U; }
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+SynthVoicePool::SynthVoicePool()
+	: mMaxVoices(0), mMaxFrames(0), mMaxBuses(0), mNumActive(0), mTracksPitchBend(true)
+{
+}
+
+SynthVoicePool::~SynthVoicePool()
+{
+}
+
+void	SynthVoicePool::Allocate(UInt32 inMaxVoices, UInt32 inMaxFramesPerSlice, UInt32 inMaxOutputBuses)
+{
+	UInt32 paddedVoices = RoundUpTo4(inMaxVoices);
+	mMaxVoices = inMaxVoices;
+	mMaxFrames = inMaxFramesPerSlice;
+	mMaxBuses = inMaxOutputBuses;
+	
+	mPhase.assign(paddedVoices, 0.f);
+	mPhaseIncrement.assign(paddedVoices, 0.f);
+	mAmp.assign(paddedVoices, 0.f);
+	mMaxAmp.assign(paddedVoices, 0.f);
+	mSlope.assign(paddedVoices, 0.f);
+	mBus.assign(paddedVoices, 0);
+	mOwners.assign(paddedVoices, (SynthPooledNote *)NULL);
+	mMix.assign(4 * inMaxFramesPerSlice * inMaxOutputBuses, 0.f);
+	mBusUsed.assign(inMaxOutputBuses, false);
+	// a start, a release and a fast release per voice
+	mPending.clear();
+	mPending.reserve(3 * inMaxVoices);
+	mEnded.clear();
+	mEnded.reserve(inMaxVoices);
+	mNumActive = 0;
+}
+
+void	SynthVoicePool::Reset()
+{
+	while (mNumActive > 0)
+		StopVoice(mOwners[mNumActive - 1]);
+	mPending.clear();
+}
+
+bool	SynthVoicePool::StartVoice(		SynthPooledNote *	inNote,
+										Float32				inPhaseIncrement,
+										Float32				inMaxAmp,
+										Float32				inAttackSlope,
+										UInt32				inStartFrame,
+										UInt32				inOutputBus)
+{
+	if (mNumActive >= mMaxVoices)
+		return false;
+	
+	// a voice whose start cannot be queued starts at the top of the slice instead
+	bool deferred = inStartFrame > 0 && mPending.size() < mPending.capacity();
+	
+	UInt32 index = mNumActive++;
+	mPhase[index] = 0.f;
+	mPhaseIncrement[index] = deferred ? 0.f : inPhaseIncrement;
+	mAmp[index] = 0.f;
+	mMaxAmp[index] = inMaxAmp;
+	mSlope[index] = deferred ? 0.f : inAttackSlope;
+	mBus[index] = inOutputBus;
+	mOwners[index] = inNote;
+	inNote->mVoiceIndex = index;
+	
+	if (deferred) {
+		PendingChange change = { inNote, inStartFrame, inAttackSlope, inPhaseIncrement, true };
+		AddChange(change);
+	}
+	return true;
+}
+
+void	SynthVoicePool::StopVoice(SynthPooledNote *inNote)
+{
+	UInt32 index = inNote->mVoiceIndex;
+	if (index >= mNumActive || mOwners[index] != inNote)
+		return;
+	
+	CancelChanges(inNote);
+	RemoveCancelledChanges();
+	
+	// keep the active voices packed by moving the last one into the hole
+	UInt32 last = --mNumActive;
+	if (index != last) {
+		mPhase[index] = mPhase[last];
+		mPhaseIncrement[index] = mPhaseIncrement[last];
+		mAmp[index] = mAmp[last];
+		mMaxAmp[index] = mMaxAmp[last];
+		mSlope[index] = mSlope[last];
+		mBus[index] = mBus[last];
+		mOwners[index] = mOwners[last];
+		mOwners[index]->mVoiceIndex = index;
+	}
+	
+	// unused lanes must render silence
+	mPhase[last] = 0.f;
+	mPhaseIncrement[last] = 0.f;
+	mAmp[last] = 0.f;
+	mMaxAmp[last] = 0.f;
+	mSlope[last] = 0.f;
+	mBus[last] = 0;
+	mOwners[last] = NULL;
+	inNote->mVoiceIndex = 0xFFFFFFFF;
+}
+
+void	SynthVoicePool::SetSlope(const SynthPooledNote *inNote, Float32 inSlope, UInt32 inFrame)
+{
+	if (inNote->mVoiceIndex >= mNumActive)
+		return;
+	
+	// a voice that has not started yet cannot change before it starts
+	PendingChange *start = FindPendingStart(inNote);
+	if (start && inFrame < start->mFrame)
+		inFrame = start->mFrame;
+	
+	if (inFrame > 0 && mPending.size() < mPending.capacity()) {
+		PendingChange change = { const_cast<SynthPooledNote *>(inNote), inFrame, inSlope, 0.f, false };
+		AddChange(change);
+	}
+	else if (start)
+		start->mSlope = inSlope;
+	else
+		mSlope[inNote->mVoiceIndex] = inSlope;
+}
+
+void	SynthVoicePool::SetPhaseIncrement(const SynthPooledNote *inNote, Float32 inPhaseIncrement)
+{
+	if (inNote->mVoiceIndex >= mNumActive)
+		return;
+	
+	PendingChange *start = FindPendingStart(inNote);
+	if (start)
+		start->mPhaseIncrement = inPhaseIncrement;
+	else
+		mPhaseIncrement[inNote->mVoiceIndex] = inPhaseIncrement;
+}
+
+Float32	SynthVoicePool::Amplitude(const SynthPooledNote *inNote) const
+{
+	return (inNote->mVoiceIndex < mNumActive) ? mAmp[inNote->mVoiceIndex] : 0.f;
+}
+
+// insert after any changes at the same frame, so they apply in the order they were made
+void	SynthVoicePool::AddChange(const PendingChange &inChange)
+{
+	std::vector<PendingChange>::iterator pos = mPending.end();
+	while (pos != mPending.begin() && (pos - 1)->mFrame > inChange.mFrame)
+		--pos;
+	mPending.insert(pos, inChange);
+}
+
+void	SynthVoicePool::ApplyChange(PendingChange &ioChange)
+{
+	SynthPooledNote *note = ioChange.mNote;
+	if (note == NULL)
+		return;
+	ioChange.mNote = NULL;
+	
+	UInt32 index = note->mVoiceIndex;
+	if (index >= mNumActive || mOwners[index] != note)
+		return;
+	if (ioChange.mStarts)
+		mPhaseIncrement[index] = ioChange.mPhaseIncrement;
+	mSlope[index] = ioChange.mSlope;
+}
+
+SynthVoicePool::PendingChange *	SynthVoicePool::FindPendingStart(const SynthPooledNote *inNote)
+{
+	for (std::vector<PendingChange>::iterator it = mPending.begin(); it != mPending.end(); ++it) {
+		if (it->mNote == inNote && it->mStarts)
+			return &*it;
+	}
+	return NULL;
+}
+
+void	SynthVoicePool::CancelChanges(const SynthPooledNote *inNote)
+{
+	for (std::vector<PendingChange>::iterator it = mPending.begin(); it != mPending.end(); ++it) {
+		if (it->mNote == inNote)
+			it->mNote = NULL;
+	}
+}
+
+void	SynthVoicePool::RemoveCancelledChanges()
+{
+	UInt32 kept = 0;
+	for (UInt32 i = 0; i < mPending.size(); ++i) {
+		if (mPending[i].mNote != NULL)
+			mPending[kept++] = mPending[i];
+	}
+	mPending.resize(kept);
+}
+
+void	SynthVoicePool::Render(AudioBufferList **inBufferList, UInt32 inNumBuses, UInt32 inNumFrames, Float32 inGain)
+{
+	if (mNumActive == 0)
+		return;
+	if (inNumBuses > mMaxBuses)
+		inNumBuses = mMaxBuses;
+	
+	if (mTracksPitchBend) {
+		for (UInt32 i = 0; i < mNumActive; ++i) {
+			SynthPooledNote *note = mOwners[i];
+			mPhaseIncrement[i] = Float32(note->Frequency() * (2. * M_PI / note->SampleRate()));
+		}
+		// voices that have not started yet keep still until their start frame
+		for (std::vector<PendingChange>::iterator it = mPending.begin(); it != mPending.end(); ++it) {
+			if (it->mNote && it->mStarts) {
+				UInt32 index = it->mNote->mVoiceIndex;
+				it->mPhaseIncrement = mPhaseIncrement[index];
+				mPhaseIncrement[index] = 0.f;
+			}
+		}
+	}
+	
+	std::fill(mBusUsed.begin(), mBusUsed.end(), false);
+	for (UInt32 i = 0; i < mNumActive; ++i) {
+		if (mBus[i] < inNumBuses)
+			mBusUsed[mBus[i]] = true;
+	}
+	for (UInt32 bus = 0; bus < inNumBuses; ++bus) {
+		if (mBusUsed[bus])
+			memset(&mMix[4 * mMaxFrames * bus], 0, 4 * inNumFrames * sizeof(Float32));
+	}
+	
+	// render up to each pending change, apply it, and carry on from there
+	mEnded.clear();
+	UInt32 frame = 0, next = 0;
+	while (frame < inNumFrames) {
+		for ( ; next < mPending.size() && mPending[next].mFrame <= frame; ++next)
+			ApplyChange(mPending[next]);
+		UInt32 segmentEnd = (next < mPending.size() && mPending[next].mFrame < inNumFrames) ? mPending[next].mFrame : inNumFrames;
+		RenderSegment(frame, segmentEnd - frame, inNumBuses);
+		frame = segmentEnd;
+	}
+	
+	// changes that fall beyond this slice move on to the next one
+	for (UInt32 i = next; i < mPending.size(); ++i)
+		mPending[i].mFrame -= inNumFrames;
+	RemoveCancelledChanges();
+	
+	for (UInt32 bus = 0; bus < inNumBuses; ++bus) {
+		if (!mBusUsed[bus])
+			continue;
+		// reduce the lanes in place; frame i's sum only overwrites partial sums already consumed
+		Float32 *mix = &mMix[4 * mMaxFrames * bus];
+		for (UInt32 i = 0; i < inNumFrames; ++i)
+			mix[i] = (mix[4 * i] + mix[4 * i + 1] + mix[4 * i + 2] + mix[4 * i + 3]) * inGain;
+		
+		AudioBufferList *abl = inBufferList[bus];
+		for (UInt32 k = 0; k < abl->mNumberBuffers; ++k) {
+			Float32 *out = (Float32 *)abl->mBuffers[k].mData;
+			for (UInt32 i = 0; i < inNumFrames; ++i)
+				out[i] += mix[i];
+		}
+	}
+	
+	// ending a voice repacks the arrays, so wait until everything has been rendered
+	for (std::vector<EndedVoice>::iterator it = mEnded.begin(); it != mEnded.end(); ++it)
+		it->mNote->NoteEnded(it->mFrame);
+}
+
+// renders frames [inStartFrame, inStartFrame + inNumFrames), during which no pending change applies
+void	SynthVoicePool::RenderSegment(UInt32 inStartFrame, UInt32 inNumFrames, UInt32 inNumBuses)
+{
+	// find the voices whose release will finish in this segment before the envelopes move. A voice
+	// with amplitude a and slope -s reaches zero on frame ceil(a / s) - 1.
+	UInt32 firstEnded = UInt32(mEnded.size());
+	for (UInt32 i = 0; i < mNumActive; ++i) {
+		if (mSlope[i] < 0.f) {
+			Float32 framesLeft = ceilf(mAmp[i] / -mSlope[i]);
+			if (framesLeft <= Float32(inNumFrames)) {
+				EndedVoice ended = { mOwners[i], inStartFrame + (framesLeft > 1.f ? UInt32(framesLeft) - 1 : 0) };
+				mEnded.push_back(ended);
+			}
+		}
+	}
+	
+	for (UInt32 i = 0; i < mNumActive; i += 4)
+		RenderBlock(i, inStartFrame, inNumFrames, inNumBuses);
+	
+	// an ended voice stays silent for the rest of the slice, whatever changes were still pending
+	for (UInt32 i = firstEnded; i < mEnded.size(); ++i) {
+		mSlope[mEnded[i].mNote->mVoiceIndex] = 0.f;
+		CancelChanges(mEnded[i].mNote);
+	}
+}
+
+// advance voices inFirstVoice..inFirstVoice+3 and add them into the per-lane mix buffers of their buses
+void	SynthVoicePool::RenderBlock(UInt32 inFirstVoice, UInt32 inStartFrame, UInt32 inNumFrames, UInt32 inNumBuses)
+{
+#if SYNTH_VOICE_POOL_SSE
+	// lanes on the same bus share one masked add; usually all four lanes are on one bus
+	Float32 *mixes[4];
+	SInt32 laneMasks[4][4];
+	UInt32 numMixes = 0;
+	memset(laneMasks, 0, sizeof(laneMasks));
+	for (UInt32 lane = 0; lane < 4; ++lane) {
+		UInt32 v = inFirstVoice + lane;
+		if (v >= mNumActive || mBus[v] >= inNumBuses)
+			continue;	// silent, or on a bus that is not being rendered
+		Float32 *mix = &mMix[4 * (mMaxFrames * mBus[v] + inStartFrame)];
+		UInt32 m = 0;
+		while (m < numMixes && mixes[m] != mix)
+			++m;
+		if (m == numMixes)
+			mixes[numMixes++] = mix;
+		laneMasks[m][lane] = -1;
+	}
+	__m128 masks[4];
+	for (UInt32 m = 0; m < numMixes; ++m)
+		masks[m] = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *)laneMasks[m]));
+	
+	__m128 phase = _mm_loadu_ps(&mPhase[inFirstVoice]);
+	__m128 amp = _mm_loadu_ps(&mAmp[inFirstVoice]);
+	const __m128 inc = _mm_loadu_ps(&mPhaseIncrement[inFirstVoice]);
+	const __m128 maxAmp = _mm_loadu_ps(&mMaxAmp[inFirstVoice]);
+	const __m128 slope = _mm_loadu_ps(&mSlope[inFirstVoice]);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 pi = _mm_set1_ps(kPi);
+	const __m128 twoPi = _mm_set1_ps(kTwoPi);
+	const __m128 sinB = _mm_set1_ps(kSinB);
+	const __m128 sinC = _mm_set1_ps(kSinC);
+	const __m128 sinP = _mm_set1_ps(kSinP);
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+	
+	for (UInt32 frame = 0; frame < inNumFrames; ++frame) {
+		__m128 y = _mm_add_ps(_mm_mul_ps(sinB, phase), _mm_mul_ps(sinC, _mm_mul_ps(phase, _mm_and_ps(phase, absMask))));
+		y = _mm_add_ps(_mm_mul_ps(sinP, _mm_sub_ps(_mm_mul_ps(y, _mm_and_ps(y, absMask)), y)), y);
+		
+		amp = _mm_min_ps(_mm_max_ps(_mm_add_ps(amp, slope), zero), maxAmp);
+		__m128 out = _mm_mul_ps(y, amp);
+		for (UInt32 m = 0; m < numMixes; ++m) {
+			Float32 *mix = mixes[m] + 4 * frame;
+			_mm_storeu_ps(mix, _mm_add_ps(_mm_loadu_ps(mix), _mm_and_ps(out, masks[m])));
+		}
+		
+		phase = _mm_add_ps(phase, inc);
+		phase = _mm_sub_ps(phase, _mm_and_ps(_mm_cmpge_ps(phase, pi), twoPi));
+	}
+	
+	_mm_storeu_ps(&mPhase[inFirstVoice], phase);
+	_mm_storeu_ps(&mAmp[inFirstVoice], amp);
+#else
+	for (UInt32 lane = 0; lane < 4; ++lane) {
+		UInt32 v = inFirstVoice + lane;
+		Float32 phase = mPhase[v], amp = mAmp[v];
+		const Float32 inc = mPhaseIncrement[v], maxAmp = mMaxAmp[v], slope = mSlope[v];
+		const bool heard = v < mNumActive && mBus[v] < inNumBuses;
+		Float32 *m = heard ? &mMix[4 * (mMaxFrames * mBus[v] + inStartFrame) + lane] : NULL;
+		for (UInt32 frame = 0; frame < inNumFrames; ++frame) {
+			Float32 y = kSinB * phase + kSinC * phase * fabsf(phase);
+			y = kSinP * (y * fabsf(y) - y) + y;
+			
+			amp += slope;
+			if (amp < 0.f) amp = 0.f;
+			else if (amp > maxAmp) amp = maxAmp;
+			if (m) m[4 * frame] += y * amp;
+			
+			phase += inc;
+			if (phase >= kPi) phase -= kTwoPi;
+		}
+		mPhase[v] = phase;
+		mAmp[v] = amp;
+	}
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool	SynthPooledNote::StartVoice(	Float32		inMaxAmp,
+										Float32		inAttackSlope,
+										Float32		inReleaseSlope,
+										Float32		inFastReleaseSlope,
+										UInt32		inOutputBus)
+{
+	mPool = GetAudioUnit()->GetVoicePool();
+	if (mPool == NULL)
+		return false;
+	if (HasVoice())
+		mPool->StopVoice(this);
+	
+	mReleaseSlope = inReleaseSlope;
+	mFastReleaseSlope = inFastReleaseSlope;
+	SInt32 startFrame = GetRelativeStartFrame();
+	return mPool->StartVoice(this, Float32(Frequency() * (2. * M_PI / SampleRate())), inMaxAmp, inAttackSlope,
+								startFrame > 0 ? UInt32(startFrame) : 0, inOutputBus);
+}
+
+void	SynthPooledNote::Kill(UInt32 inFrame)
+{
+	SynthNote::Kill(inFrame);
+	if (HasVoice())
+		mPool->StopVoice(this);
+}
+
+void	SynthPooledNote::Release(UInt32 inFrame)
+{
+	SynthNote::Release(inFrame);
+	if (HasVoice())
+		mPool->SetSlope(this, mReleaseSlope, inFrame);
+}
+
+void	SynthPooledNote::FastRelease(UInt32 inFrame)
+{
+	SynthNote::FastRelease(inFrame);
+	if (HasVoice())
+		mPool->SetSlope(this, mFastReleaseSlope, inFrame);
+}
+
+Float32	SynthPooledNote::Amplitude()
+{
+	return HasVoice() ? mPool->Amplitude(this) : 0.f;
+}
+
+void	SynthPooledNote::NoteEnded(UInt32 inFrame)
+{
+	if (HasVoice())
+		mPool->StopVoice(this);
+	SynthNote::NoteEnded(inFrame);
+}
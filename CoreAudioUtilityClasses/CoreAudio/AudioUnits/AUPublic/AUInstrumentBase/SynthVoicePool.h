@@ -0,0 +1,194 @@
+/*
+     File: SynthVoicePool.h 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.2 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2012 Apple Inc. All Rights Reserved. 
+  
+*/
+#ifndef __SynthVoicePool__
+#define __SynthVoicePool__
+
+#include <vector>
+#include "SynthNote.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct SynthPooledNote;
+
+// SynthVoicePool keeps the oscillator and envelope state of many simple voices in parallel arrays
+// (structure of arrays) rather than inside each SynthNote, so that Render can advance four voices
+// per vector instruction instead of making a virtual Render call and a scalar sin() per voice per
+// sample. Each voice is a sine oscillator with a linear attack/release envelope.
+//
+// The active voices are kept densely packed at the front of the arrays; stopping a voice moves the
+// last active voice into its slot. No memory is allocated after Allocate().
+//
+// Voice starts and slope changes can be given a frame offset into the next slice. Render splits
+// the slice at those offsets, so notes start and release on the frame their events asked for.
+//
+// To use it, derive your notes from SynthPooledNote, call AUInstrumentBase::SetVoicePool() in
+// Initialize() alongside SetNotes(), and the base class renders the pool into its output buses
+// after the groups have rendered.
+class SynthVoicePool
+{
+public:
+	SynthVoicePool();
+	~SynthVoicePool();
+	
+	// voices on an output bus at or above inMaxOutputBuses are rendered but not heard
+	void					Allocate(UInt32 inMaxVoices, UInt32 inMaxFramesPerSlice, UInt32 inMaxOutputBuses = 1);
+	void					Reset();
+	
+	UInt32					MaxVoices() const { return mMaxVoices; }
+	UInt32					NumActiveVoices() const { return mNumActive; }
+	
+	// inPhaseIncrement is in radians per sample. The amplitude ramps from 0 towards inMaxAmp
+	// by inAttackSlope per sample, starting inStartFrame frames into the next slice rendered.
+	// Returns false if all voices are in use.
+	bool					StartVoice(		SynthPooledNote *	inNote,
+											Float32				inPhaseIncrement,
+											Float32				inMaxAmp,
+											Float32				inAttackSlope,
+											UInt32				inStartFrame = 0,
+											UInt32				inOutputBus = 0);
+	void					StopVoice(SynthPooledNote *inNote);
+	
+	// A negative slope releases the voice; it ends when its amplitude reaches zero. The slope
+	// changes inFrame frames into the next slice rendered.
+	void					SetSlope(const SynthPooledNote *inNote, Float32 inSlope, UInt32 inFrame = 0);
+	void					SetPhaseIncrement(const SynthPooledNote *inNote, Float32 inPhaseIncrement);
+	Float32					Amplitude(const SynthPooledNote *inNote) const;
+	
+	// Mixes every active voice into the buffers of its output bus, scaled by inGain. Each voice
+	// is mono and is added to every buffer of its bus. Voices whose release finishes during this
+	// slice are ended via SynthNote::NoteEnded after all voices have been rendered.
+	void					Render(AudioBufferList **inBufferList, UInt32 inNumBuses, UInt32 inNumFrames, Float32 inGain);
+	
+	// If true (the default), each voice's phase increment is refreshed from its note's
+	// Frequency() once per Render, which tracks pitch bend.
+	void					SetTracksPitchBend(bool inFlag) { mTracksPitchBend = inFlag; }
+	
+private:
+	void					RenderSegment(UInt32 inStartFrame, UInt32 inNumFrames, UInt32 inNumBuses);
+	void					RenderBlock(UInt32 inFirstVoice, UInt32 inStartFrame, UInt32 inNumFrames, UInt32 inNumBuses);
+	
+	UInt32					mMaxVoices;
+	UInt32					mMaxFrames;
+	UInt32					mMaxBuses;
+	UInt32					mNumActive;
+	bool					mTracksPitchBend;
+	
+	// per voice, padded to a multiple of 4
+	std::vector<Float32>			mPhase;				// -pi..pi
+	std::vector<Float32>			mPhaseIncrement;	// radians per sample
+	std::vector<Float32>			mAmp;
+	std::vector<Float32>			mMaxAmp;
+	std::vector<Float32>			mSlope;				// amplitude change per sample
+	std::vector<UInt32>				mBus;
+	std::vector<SynthPooledNote *>	mOwners;
+	
+	// per bus, four partial sums per frame, one per vector lane, reduced once at the end of Render
+	std::vector<Float32>			mMix;
+	std::vector<bool>				mBusUsed;
+	
+	// a voice start or slope change waiting for its frame; a voice that has not started yet
+	// holds still with a zero slope and phase increment
+	struct PendingChange {
+		SynthPooledNote *	mNote;				// NULL once applied or cancelled
+		UInt32				mFrame;
+		Float32				mSlope;
+		Float32				mPhaseIncrement;	// only for a start
+		bool				mStarts;
+	};
+	std::vector<PendingChange>		mPending;			// in frame order, ties in arrival order
+	
+	void					AddChange(const PendingChange &inChange);
+	void					ApplyChange(PendingChange &ioChange);
+	PendingChange *			FindPendingStart(const SynthPooledNote *inNote);
+	void					CancelChanges(const SynthPooledNote *inNote);
+	void					RemoveCancelledChanges();
+	
+	struct EndedVoice {
+		SynthPooledNote *	mNote;
+		UInt32				mFrame;
+	};
+	std::vector<EndedVoice>			mEnded;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// A SynthNote whose sound is produced by a SynthVoicePool. Subclasses implement Attack() by calling
+// StartVoice(); release, kill and amplitude queries are forwarded to the pool, and Render() does
+// nothing since the pool renders all of its voices at once.
+struct SynthPooledNote : public SynthNote
+{
+	SynthPooledNote() : mPool(NULL), mVoiceIndex(0xFFFFFFFF), mReleaseSlope(0.f), mFastReleaseSlope(0.f) {}
+	virtual					~SynthPooledNote() {}
+	
+	bool					HasVoice() const { return mVoiceIndex != 0xFFFFFFFF; }
+	
+	virtual OSStatus		Render(UInt64 inAbsoluteSampleFrame, UInt32 inNumFrames, AudioBufferList** inBufferList, UInt32 inOutBusCount) { return noErr; }
+	virtual void			Kill(UInt32 inFrame);
+	virtual void			Release(UInt32 inFrame);
+	virtual void			FastRelease(UInt32 inFrame);
+	virtual Float32			Amplitude();
+	virtual void			NoteEnded(UInt32 inFrame);
+	
+protected:
+	// starts this note's voice in the audio unit's pool, at Frequency() and at the note's start
+	// frame; the release slopes are negative amplitude changes per sample
+	bool					StartVoice(		Float32		inMaxAmp,
+											Float32		inAttackSlope,
+											Float32		inReleaseSlope,
+											Float32		inFastReleaseSlope,
+											UInt32		inOutputBus = 0);
+	
+private:
+	friend class			SynthVoicePool;
+	
+	SynthVoicePool *		mPool;
+	UInt32					mVoiceIndex;
+	Float32					mReleaseSlope;
+	Float32					mFastReleaseSlope;
+};
+
+#endif
@@ -47,7 +47,6 @@
 #include "AUPannerBase.h"
 #include "CABundleLocker.h"
 #include <AudioToolbox/AudioToolbox.h>
-#include <Accelerate/Accelerate.h>
 
 static bool sLocalized = false;
 
@@ -130,6 +129,7 @@ void		AUPannerBase::AllocBypassMatrix()
 	UInt32 inChannels = GetNumberOfInputChannels();
 	UInt32 outChannels = GetNumberOfOutputChannels();
 	mBypassMatrix.alloc(inChannels * outChannels, true);
+	mBypassMixer.Allocate(inChannels, outChannels);
 }
 
 static AudioChannelLayoutTag DefaultTagForNumberOfChannels(UInt32 inNumberChannels)
@@ -216,6 +216,7 @@ OSStatus			AUPannerBase::UpdateBypassMatrix()
 			*amp = 1.;
 		}
 	}
+	mBypassMixer.SetMatrix(mBypassMatrix(), inChannels, outChannels);
 
     return noErr;
 }
@@ -478,29 +479,15 @@ OSStatus 	AUPannerBase::BypassRender(AudioUnitRenderActionFlags &		ioActionFlags
 {
 	AudioUnitRenderActionFlags xflags = 0;
 	OSStatus result = PullInput(0, xflags, inTimeStamp, inNumberFrames);
-	if (result) return false;
+	if (result) return result;
 	bool isSilent = xflags & kAudioUnitRenderAction_OutputIsSilence;
 
 	AudioBufferList& outputBufferList = GetOutput(0)->GetBufferList();
-	AUBufferList::ZeroBuffer(outputBufferList);
 	
-	if (!isSilent) 
-	{
-		UInt32 inChannels = GetNumberOfInputChannels();
-		UInt32 outChannels = GetNumberOfOutputChannels();
-		Float32* bypass = mBypassMatrix();
-		for (UInt32 outChan = 0; outChan < outChannels; ++outChan)
-		{
-			float* outData = GetOutput(0)->GetChannelData(outChan);	
-			
-			for (UInt32 inChan = 0; inChan < inChannels; ++inChan)
-			{
-				float* inData = GetInput(0)->GetChannelData(inChan);
-				float *amp = bypass + (inChan * outChannels + outChan);
-				vDSP_vsma(inData, 1, amp, outData, 1, outData, 1, inNumberFrames);
-			}
-		}
-	}
+	if (isSilent) 
+		AUBufferList::ZeroBuffer(outputBufferList);
+	else
+		mBypassMixer.Render(GetInput(0)->GetBufferList(), outputBufferList, inNumberFrames);
     return noErr;
 }
 
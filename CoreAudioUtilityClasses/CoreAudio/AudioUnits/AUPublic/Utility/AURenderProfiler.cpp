@@ -0,0 +1,136 @@
+/*
+     File: AURenderProfiler.cpp 
+ Abstract:  AURenderProfiler.h  
+  Version: 1.0.2 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2012 Apple Inc. All Rights Reserved. 
+  
+*/
+#include "AURenderProfiler.h"
+#include "CAAtomic.h"
+#include <string.h>
+
+static inline UInt32	ClampToUInt32(UInt64 inValue)
+{
+	return inValue > 0xFFFFFFFFULL ? 0xFFFFFFFFUL : UInt32(inValue);
+}
+
+AURenderProfiler::AURenderProfiler() :
+	mWriteCount(0),
+	mRenderStartTime(0),
+	mPullInputTime(0)
+{
+	memset(mSamples, 0, sizeof(mSamples));
+	// initialize the time base here rather than on the render thread
+	CAHostTimeBase::GetFrequency();
+}
+
+void	AURenderProfiler::EndRender(	UInt32						inBusNumber,
+										UInt32						inFrames,
+										Float64						inSampleRate,
+										AudioUnitRenderActionFlags	inActionFlags,
+										OSStatus					inError)
+{
+	UInt64 endTime = CAHostTimeBase::GetTheCurrentTime();
+	UInt32 writeCount = mWriteCount;
+	AURenderProfileSample &sample = mSamples[writeCount & (kAURenderProfileMaxSamples - 1)];
+	
+	sample.mHostTime = mRenderStartTime;
+	sample.mBusNumber = inBusNumber;
+	sample.mFrames = inFrames;
+	sample.mDurationNanos = ClampToUInt32(CAHostTimeBase::AbsoluteHostDeltaToNanos(mRenderStartTime, endTime));
+	sample.mPullInputNanos = ClampToUInt32(CAHostTimeBase::ConvertToNanos(mPullInputTime));
+	sample.mBufferNanos = inSampleRate > 0. ? ClampToUInt32(UInt64(inFrames * 1.0e9 / inSampleRate)) : 0;
+	sample.mFlags = 0;
+	if (sample.mBufferNanos != 0 && sample.mDurationNanos > sample.mBufferNanos)
+		sample.mFlags |= kAURenderProfileFlag_Overrun;
+	if (inError != noErr)
+		sample.mFlags |= kAURenderProfileFlag_RenderError;
+	if (inActionFlags & kAudioUnitRenderAction_OutputIsSilence)
+		sample.mFlags |= kAURenderProfileFlag_OutputIsSilence;
+	sample.mError = inError;
+	sample.mReserved = 0;
+	
+	// publish the sample only once it is complete
+	CAMemoryBarrier();
+	mWriteCount = writeCount + 1;
+}
+
+UInt32	AURenderProfiler::Read(	UInt32 &					ioCursor,
+								AURenderProfileSample *		outSamples,
+								UInt32						inMaxSamples,
+								UInt32 &					outLostSamples) const
+{
+	const UInt32 kMask = kAURenderProfileMaxSamples - 1;
+	UInt32 begin = ioCursor;
+	UInt32 end = mWriteCount;
+	CAMemoryBarrier();
+	
+	outLostSamples = 0;
+	if (UInt32(end - begin) > kAURenderProfileMaxSamples) {
+		outLostSamples = (end - begin) - kAURenderProfileMaxSamples;
+		begin = end - kAURenderProfileMaxSamples;
+	}
+	
+	UInt32 count = end - begin;
+	if (count > inMaxSamples)
+		count = inMaxSamples;
+	for (UInt32 i = 0; i < count; ++i)
+		outSamples[i] = mSamples[(begin + i) & kMask];
+	
+	// the writer may have come around the ring while we copied. With the write count at N, sample
+	// N - kAURenderProfileMaxSamples may be half overwritten already, so it and everything before it
+	// is discarded.
+	CAMemoryBarrier();
+	UInt32 written = mWriteCount;
+	if (UInt32(written - begin) >= kAURenderProfileMaxSamples) {
+		UInt32 overwritten = (written - begin) - kAURenderProfileMaxSamples + 1;
+		if (overwritten > count)
+			overwritten = count;
+		memmove(outSamples, outSamples + overwritten, (count - overwritten) * sizeof(AURenderProfileSample));
+		count -= overwritten;
+		begin += overwritten;
+		outLostSamples += overwritten;
+	}
+	
+	ioCursor = begin + count;
+	return count;
+}
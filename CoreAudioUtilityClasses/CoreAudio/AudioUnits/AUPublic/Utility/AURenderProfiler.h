@@ -0,0 +1,134 @@
+/*
+     File: AURenderProfiler.h 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.2 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2012 Apple Inc. All Rights Reserved. 
+  
+*/
+#ifndef __AURenderProfiler_h__
+#define __AURenderProfiler_h__
+
+#include <TargetConditionals.h>
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <AudioUnit/AudioUnit.h>
+#else
+	#include <AudioUnit.h>
+#endif
+
+#include "CAHostTimeBase.h"
+
+// Global scope properties through which AUBase exposes its render profiler to a host.
+enum {
+	kAUBaseProperty_RenderProfilingEnabled	= 'rpEn',	// UInt32, read/write: nonzero records a sample for every render
+	kAUBaseProperty_RenderProfile			= 'rpSm'	// AURenderProfileData, read only: the samples recorded since the last get
+};
+
+// AURenderProfileSample::mFlags
+enum {
+	kAURenderProfileFlag_Overrun			= (1 << 0),	// the render took longer than the audio it produced
+	kAURenderProfileFlag_RenderError		= (1 << 1),	// mError holds the error the render returned
+	kAURenderProfileFlag_OutputIsSilence	= (1 << 2)	// the render set kAudioUnitRenderAction_OutputIsSilence
+};
+
+// One render cycle. Durations are in nanoseconds; mDurationNanos includes mPullInputNanos.
+struct AURenderProfileSample {
+	UInt64		mHostTime;			// when the render began
+	UInt32		mBusNumber;
+	UInt32		mFrames;
+	UInt32		mDurationNanos;		// from entering to leaving AUBase::DoRender, render notifications included
+	UInt32		mPullInputNanos;	// the part of mDurationNanos spent pulling input
+	UInt32		mBufferNanos;		// the duration of mFrames at the output bus's sample rate
+	UInt32		mFlags;
+	OSStatus	mError;
+	UInt32		mReserved;
+};
+
+enum { kAURenderProfileMaxSamples = 1024 };		// the ring's capacity; must be a power of 2
+
+// the value of kAUBaseProperty_RenderProfile
+struct AURenderProfileData {
+	UInt32					mNumberSamples;		// valid entries in mSamples, oldest first
+	UInt32					mLostSamples;		// samples overwritten before they could be read
+	AURenderProfileSample	mSamples[kAURenderProfileMaxSamples];
+};
+
+// A ring of the most recent kAURenderProfileMaxSamples render cycles. The render thread is the only
+// writer and never blocks or allocates: each sample is filled in place and then published by
+// advancing the write count. Any number of readers may follow along, each with its own cursor;
+// a reader that falls more than a ring behind loses the oldest samples, and is told how many.
+class AURenderProfiler {
+public:
+							AURenderProfiler();
+
+	// render thread
+	void					BeginRender()
+							{
+								mRenderStartTime = CAHostTimeBase::GetTheCurrentTime();
+								mPullInputTime = 0;
+							}
+	void					AddPullInputTime(UInt64 inHostTimeDelta) { mPullInputTime += inHostTimeDelta; }
+	void					EndRender(	UInt32						inBusNumber,
+										UInt32						inFrames,
+										Float64						inSampleRate,
+										AudioUnitRenderActionFlags	inActionFlags,
+										OSStatus					inError);
+
+	// readers
+	// the number of samples written so far, modulo 2^32; a cursor set to this reads only what follows
+	UInt32					GetWriteCount() const { return mWriteCount; }
+	
+	// copies up to inMaxSamples samples, oldest first, starting at ioCursor, and advances ioCursor
+	// past them. outLostSamples is the number of samples that were overwritten before being read.
+	UInt32					Read(	UInt32 &					ioCursor,
+									AURenderProfileSample *		outSamples,
+									UInt32						inMaxSamples,
+									UInt32 &					outLostSamples) const;
+
+private:
+	AURenderProfileSample	mSamples[kAURenderProfileMaxSamples];
+	volatile UInt32			mWriteCount;
+	
+	UInt64					mRenderStartTime;
+	UInt64					mPullInputTime;		// host time units
+};
+
+#endif // __AURenderProfiler_h__
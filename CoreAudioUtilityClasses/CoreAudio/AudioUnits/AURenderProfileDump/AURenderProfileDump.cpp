@@ -0,0 +1,334 @@
+/*
+     File: AURenderProfileDump.cpp 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.2 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2012 Apple Inc. All Rights Reserved. 
+  
+*/
+// AURenderProfileDump renders an AUBase based audio unit offline with its render profiler
+// enabled (see AURenderProfiler.h), then prints latency histograms of the render cycles and
+// every cycle that overran the duration of the buffer it produced.
+
+#include <AudioToolbox/AudioToolbox.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+#include "CAXException.h"
+#include "CAStreamBasicDescription.h"
+#include "CAAudioUnit.h"
+#include "CAHostTimeBase.h"
+#include "AUOutputBL.h"
+#include "AURenderProfiler.h"
+
+typedef std::vector<AURenderProfileSample>	SampleList;
+
+// the profiler's ring holds kAURenderProfileMaxSamples cycles; drain it well before it wraps
+static const UInt32 kCyclesPerRead = kAURenderProfileMaxSamples / 4;
+
+void UsageString(int exitCode)
+{
+	printf ("Usage: AURenderProfileDump type subtype manufacturer [-f frames] [-r sampleRate] [-c channels] [-n cycles] [-p] [-v]\n");
+	printf ("    -f  frames per render (default 512)\n");
+	printf ("    -r  sample rate (default 44100)\n");
+	printf ("    -c  channels (default 2)\n");
+	printf ("    -n  render cycles (default 10000)\n");
+	printf ("    -p  pace the renders in real time instead of rendering back to back\n");
+	printf ("    -v  print every sample\n");
+	exit(exitCode);
+}
+
+static OSType StringToOSType (const char *inString)
+{
+	if (strlen(inString) != 4) UsageString(1);
+	return (OSType(UInt8(inString[0])) << 24) | (OSType(UInt8(inString[1])) << 16)
+			| (OSType(UInt8(inString[2])) << 8) | OSType(UInt8(inString[3]));
+}
+
+// feeds silence to an effect's inputs
+static OSStatus SilentInputProc (void *							inRefCon,
+								AudioUnitRenderActionFlags *	ioActionFlags,
+								const AudioTimeStamp *			inTimeStamp,
+								UInt32							inBusNumber,
+								UInt32							inNumberFrames,
+								AudioBufferList *				ioData)
+{
+	for (UInt32 i = 0; i < ioData->mNumberBuffers; ++i)
+		memset (ioData->mBuffers[i].mData, 0, ioData->mBuffers[i].mDataByteSize);
+	*ioActionFlags |= kAudioUnitRenderAction_OutputIsSilence;
+	return noErr;
+}
+
+// appends the samples recorded since the last read; returns the number the ring lost
+static UInt32 ReadProfile (CAAudioUnit &au, AURenderProfileData &profile, SampleList &samples)
+{
+	UInt32 size = sizeof(profile);
+	XThrowIfError (au.GetProperty (kAUBaseProperty_RenderProfile, kAudioUnitScope_Global, 0, &profile, &size), "kAUBaseProperty_RenderProfile");
+	samples.insert (samples.end(), profile.mSamples, profile.mSamples + profile.mNumberSamples);
+	return profile.mLostSamples;
+}
+
+static UInt32 Percentile (const std::vector<UInt32> &inSorted, double inFraction)
+{
+	if (inSorted.empty()) return 0;
+	size_t index = size_t(inFraction * (inSorted.size() - 1) + 0.5);
+	return inSorted[index];
+}
+
+static void PrintBar (const char *inLabel, UInt32 inCount, UInt32 inTotal)
+{
+	const int kBarWidth = 50;
+	int width = inTotal ? int((UInt64(inCount) * kBarWidth + inTotal - 1) / inTotal) : 0;
+	printf ("  %-16s %8u  %6.2f%%  ", inLabel, (unsigned)inCount, inTotal ? 100. * inCount / inTotal : 0.);
+	for (int i = 0; i < width; ++i) putchar ('#');
+	putchar ('\n');
+}
+
+static void PrintDurationSummary (const char *inName, std::vector<UInt32> &ioNanos)
+{
+	std::sort (ioNanos.begin(), ioNanos.end());
+	UInt64 total = 0;
+	for (size_t i = 0; i < ioNanos.size(); ++i)
+		total += ioNanos[i];
+	printf ("%s (usec): min %.1f  mean %.1f  p50 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n", inName,
+			ioNanos.empty() ? 0. : ioNanos.front() / 1000.,
+			ioNanos.empty() ? 0. : double(total) / ioNanos.size() / 1000.,
+			Percentile (ioNanos, 0.5) / 1000., Percentile (ioNanos, 0.99) / 1000.,
+			Percentile (ioNanos, 0.999) / 1000., ioNanos.empty() ? 0. : ioNanos.back() / 1000.);
+}
+
+static void PrintReport (const SampleList &samples, UInt32 lostSamples, bool verbose)
+{
+	if (samples.empty()) {
+		printf ("no samples were recorded\n");
+		return;
+	}
+	
+	const UInt64 firstHostTime = samples.front().mHostTime;
+	const UInt32 total = UInt32(samples.size());
+	std::vector<UInt32> durations, pullInputs;
+	durations.reserve (total);
+	pullInputs.reserve (total);
+	
+	// render time in power of 2 microsecond buckets, and as a fraction of the buffer's duration
+	enum { kNumTimeBuckets = 18, kNumLoadBuckets = 12 };
+	UInt32 timeBuckets[kNumTimeBuckets] = { 0 };
+	UInt32 loadBuckets[kNumLoadBuckets] = { 0 };
+	UInt32 overruns = 0, errors = 0;
+	
+	for (UInt32 i = 0; i < total; ++i) {
+		const AURenderProfileSample &s = samples[i];
+		durations.push_back (s.mDurationNanos);
+		pullInputs.push_back (s.mPullInputNanos);
+		
+		UInt32 micros = s.mDurationNanos / 1000, bucket = 0;
+		while (micros > 1 && bucket < kNumTimeBuckets - 1) {
+			micros >>= 1;
+			++bucket;
+		}
+		++timeBuckets[bucket];
+		
+		if (s.mBufferNanos) {
+			UInt32 load = UInt32(UInt64(s.mDurationNanos) * 10 / s.mBufferNanos);
+			++loadBuckets[std::min(load, UInt32(kNumLoadBuckets - 1))];
+		}
+		if (s.mFlags & kAURenderProfileFlag_Overrun) ++overruns;
+		if (s.mFlags & kAURenderProfileFlag_RenderError) ++errors;
+		
+		if (verbose)
+			printf ("%8u  t=%10.3f ms  bus %u  %5u frames  render %9.1f us  pull %9.1f us  buffer %9.1f us  flags 0x%x  err %d\n",
+					(unsigned)i, CAHostTimeBase::AbsoluteHostDeltaToNanos (firstHostTime, s.mHostTime) / 1.0e6,
+					(unsigned)s.mBusNumber, (unsigned)s.mFrames, s.mDurationNanos / 1000., s.mPullInputNanos / 1000.,
+					s.mBufferNanos / 1000., (unsigned)s.mFlags, (int)s.mError);
+	}
+	
+	printf ("\n%u render cycles, %u overruns, %u errors, %u samples lost\n\n",
+			(unsigned)total, (unsigned)overruns, (unsigned)errors, (unsigned)lostSamples);
+	PrintDurationSummary ("render    ", durations);
+	PrintDurationSummary ("pull input", pullInputs);
+	
+	printf ("\nrender time:\n");
+	char label[32];
+	for (UInt32 b = 0; b < kNumTimeBuckets; ++b) {
+		if (timeBuckets[b] == 0) continue;
+		if (b == 0)
+			snprintf (label, sizeof(label), "< 2 us");
+		else if (b == kNumTimeBuckets - 1)
+			snprintf (label, sizeof(label), ">= %u us", 1U << b);
+		else
+			snprintf (label, sizeof(label), "%u - %u us", 1U << b, (1U << (b + 1)) - 1);
+		PrintBar (label, timeBuckets[b], total);
+	}
+	
+	printf ("\nrender time / buffer duration:\n");
+	for (UInt32 b = 0; b < kNumLoadBuckets; ++b) {
+		if (b < 10)
+			snprintf (label, sizeof(label), "%3u - %3u%%", b * 10, b * 10 + 10);
+		else if (b == 10)
+			snprintf (label, sizeof(label), "100 - 110%%");
+		else
+			snprintf (label, sizeof(label), ">= 110%%");
+		PrintBar (label, loadBuckets[b], total);
+	}
+	
+	if (overruns) {
+		printf ("\noverruns:\n");
+		for (UInt32 i = 0; i < total; ++i) {
+			const AURenderProfileSample &s = samples[i];
+			if (!(s.mFlags & kAURenderProfileFlag_Overrun)) continue;
+			printf ("  cycle %8u  t=%10.3f ms  render %9.1f us (pull %9.1f us) for a %9.1f us buffer\n",
+					(unsigned)i, CAHostTimeBase::AbsoluteHostDeltaToNanos (firstHostTime, s.mHostTime) / 1.0e6,
+					s.mDurationNanos / 1000., s.mPullInputNanos / 1000., s.mBufferNanos / 1000.);
+		}
+	}
+}
+
+int main (int argc, char * const argv[]) 
+{
+	if (argc < 4) UsageString(1);
+	
+	CAComponentDescription desc (StringToOSType (argv[1]), StringToOSType (argv[2]), StringToOSType (argv[3]));
+	UInt32 numFrames = 512;
+	Float64 sampleRate = 44100.;
+	UInt32 numChannels = 2;
+	UInt32 numCycles = 10000;
+	bool pace = false;
+	bool verbose = false;
+	
+	for (int i = 4; i < argc; ++i) {
+		const char *arg = argv[i];
+		if (!strcmp (arg, "-p")) pace = true;
+		else if (!strcmp (arg, "-v")) verbose = true;
+		else if (i + 1 < argc && !strcmp (arg, "-f")) numFrames = atoi (argv[++i]);
+		else if (i + 1 < argc && !strcmp (arg, "-r")) sampleRate = atof (argv[++i]);
+		else if (i + 1 < argc && !strcmp (arg, "-c")) numChannels = atoi (argv[++i]);
+		else if (i + 1 < argc && !strcmp (arg, "-n")) numCycles = atoi (argv[++i]);
+		else UsageString(1);
+	}
+	if (numFrames == 0 || numChannels == 0 || sampleRate <= 0.) UsageString(1);
+	
+	try {
+		CAComponent comp (desc);
+		if (!comp.IsValid()) {
+			printf ("can't find the audio unit: "); desc.Print();
+			exit(1);
+		}
+		CAAudioUnit au;
+		XThrowIfError (CAAudioUnit::Open (comp, au), "CAAudioUnit::Open");
+		
+		CAStreamBasicDescription format (sampleRate, numChannels, CAStreamBasicDescription::kPCMFormatFloat32, false);
+		UInt32 numInputs = 0;
+		XThrowIfError (au.GetElementCount (kAudioUnitScope_Input, numInputs), "GetElementCount");
+		if (numInputs > 0) {
+			XThrowIfError (au.SetFormat (kAudioUnitScope_Input, 0, format), "SetFormat (input)");
+			AURenderCallbackStruct input = { SilentInputProc, NULL };
+			XThrowIfError (au.SetProperty (kAudioUnitProperty_SetRenderCallback, kAudioUnitScope_Input, 0, &input, sizeof(input)),
+							"kAudioUnitProperty_SetRenderCallback");
+		}
+		XThrowIfError (au.SetFormat (kAudioUnitScope_Output, 0, format), "SetFormat (output)");
+		XThrowIfError (au.SetMaxFramesPerSlice (numFrames), "SetMaxFramesPerSlice");
+		XThrowIfError (au.Initialize(), "Initialize");
+		
+		UInt32 enable = 1;
+		if (au.SetProperty (kAUBaseProperty_RenderProfilingEnabled, kAudioUnitScope_Global, 0, &enable, sizeof(enable))) {
+			printf ("this audio unit has no render profiler (it must be built on an AUBase that supports kAUBaseProperty_RenderProfilingEnabled)\n");
+			exit(1);
+		}
+		
+		printf ("profiling %u renders of %u frames at %.0f Hz, %u channels%s\n",
+				(unsigned)numCycles, (unsigned)numFrames, sampleRate, (unsigned)numChannels, pace ? ", paced" : "");
+		
+		AUOutputBL outputList (format, numFrames);
+		outputList.Allocate (numFrames);
+		AURenderProfileData *profile = new AURenderProfileData;
+		SampleList samples;
+		samples.reserve (numCycles);
+		UInt32 lostSamples = 0;
+		
+		AudioTimeStamp timeStamp;
+		memset (&timeStamp, 0, sizeof(timeStamp));
+		timeStamp.mFlags = kAudioTimeStampSampleTimeValid | kAudioTimeStampHostTimeValid;
+		
+		const UInt64 bufferHostTime = CAHostTimeBase::ConvertFromNanos (UInt64(numFrames * 1.0e9 / sampleRate));
+		UInt64 nextHostTime = CAHostTimeBase::GetTheCurrentTime();
+		
+		for (UInt32 cycle = 0; cycle < numCycles; ++cycle) {
+			if (pace) {
+				UInt64 now = CAHostTimeBase::GetTheCurrentTime();
+				if (nextHostTime > now)
+					usleep (useconds_t(CAHostTimeBase::AbsoluteHostDeltaToNanos (now, nextHostTime) / 1000));
+			}
+			timeStamp.mHostTime = pace ? nextHostTime : CAHostTimeBase::GetTheCurrentTime();
+			nextHostTime += bufferHostTime;
+			
+			AudioUnitRenderActionFlags flags = 0;
+			outputList.Prepare();
+			au.Render (&flags, &timeStamp, 0, numFrames, outputList.ABL());	// errors are in the profile
+			timeStamp.mSampleTime += numFrames;
+			
+			if ((cycle + 1) % kCyclesPerRead == 0)
+				lostSamples += ReadProfile (au, *profile, samples);
+		}
+		lostSamples += ReadProfile (au, *profile, samples);
+		
+		enable = 0;
+		au.SetProperty (kAUBaseProperty_RenderProfilingEnabled, kAudioUnitScope_Global, 0, &enable, sizeof(enable));
+		delete profile;
+		
+		PrintReport (samples, lostSamples, verbose);
+		
+		au.Uninitialize();
+	}
+	catch (CAXException &e) {
+		char buf[256];
+		fprintf (stderr, "Error: %s (%s)\n", e.mOperation, e.FormatError(buf));
+		return 1;
+	}
+	catch (...) {
+		fprintf (stderr, "An unknown error occurred\n");
+		return 1;
+	}
+	
+	return 0;
+}
@@ -94,6 +94,23 @@ CAGuard::CAGuard(const char* inName)
 #endif
 }
 
+CAGuard::CAGuard(const char* inName, UInt32 inOptions)
+:
+	CAMutex(inName, inOptions)
+#if	Log_Average_Latency
+	,mAverageLatencyAccumulator(0.0),
+	mAverageLatencyCount(0)
+#endif
+{
+#if TARGET_OS_MAC
+	OSStatus theError = pthread_cond_init(&mCondVar, NULL);
+	ThrowIf(theError != 0, CAException(theError), "CAGuard::CAGuard: Could not init the cond var");
+#elif TARGET_OS_WIN32
+	mEvent = CreateEvent(NULL, true, false, NULL);
+	ThrowIfNULL(mEvent, CAException(GetLastError()), "CAGuard::CAGuard: Could not create the event");
+#endif
+}
+
 CAGuard::~CAGuard()
 {
 #if TARGET_OS_MAC
@@ -111,6 +128,7 @@ void	CAGuard::Wait()
 #if TARGET_OS_MAC
 	ThrowIf(!pthread_equal(pthread_self(), mOwner), CAException(1), "CAGuard::Wait: A thread has to have locked a guard before it can wait");
 
+	StatisticsWillUnlock();
 	mOwner = 0;
 
 	#if	Log_WaitOwnership
@@ -120,6 +138,7 @@ void	CAGuard::Wait()
 	OSStatus theError = pthread_cond_wait(&mCondVar, &mMutex);
 	ThrowIf(theError != 0, CAException(theError), "CAGuard::Wait: Could not wait for a signal");
 	mOwner = pthread_self();
+	StatisticsDidRelock();
 
 	#if	Log_WaitOwnership
 		DebugPrintfRtn(DebugPrintfFileComma "%p %.4f: CAGuard::Wait: thread %p waited on %s, owner: %p\n", pthread_self(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), pthread_self(), mName, mOwner);
@@ -127,6 +146,7 @@ void	CAGuard::Wait()
 #elif TARGET_OS_WIN32
 	ThrowIf(GetCurrentThreadId() != mOwner, CAException(1), "CAGuard::Wait: A thread has to have locked a guard before it can wait");
 
+	StatisticsWillUnlock();
 	mOwner = 0;
 
 	#if	Log_WaitOwnership
@@ -138,6 +158,7 @@ void	CAGuard::Wait()
 	OSStatus theError = WaitForMultipleObjects(2, theHandles, true, INFINITE);
 	ThrowIfError(theError, CAException(GetLastError()), "CAGuard::Wait: Could not wait for the signal");
 	mOwner = GetCurrentThreadId();
+	StatisticsDidRelock();
 	ResetEvent(mEvent);
 
 	#if	Log_WaitOwnership
@@ -174,6 +195,7 @@ bool	CAGuard::WaitFor(UInt64 inNanos)
 		UInt64	theStartNanos = CAHostTimeBase::GetCurrentTimeInNanos();
 	#endif
 
+	StatisticsWillUnlock();
 	mOwner = 0;
 
 	#if	Log_WaitOwnership
@@ -183,6 +205,7 @@ bool	CAGuard::WaitFor(UInt64 inNanos)
 	OSStatus theError = pthread_cond_timedwait_relative_np(&mCondVar, &mMutex, &theTimeSpec);
 	ThrowIf((theError != 0) && (theError != ETIMEDOUT), CAException(theError), "CAGuard::WaitFor: Wait got an error");
 	mOwner = pthread_self();
+	StatisticsDidRelock();
 	
 	#if	Log_TimedWaits || Log_Latency || Log_Average_Latency
 		UInt64	theEndNanos = CAHostTimeBase::GetCurrentTimeInNanos();
@@ -226,6 +249,7 @@ bool	CAGuard::WaitFor(UInt64 inNanos)
 		UInt64	theStartNanos = CAHostTimeBase::GetCurrentTimeInNanos();
 	#endif
 
+	StatisticsWillUnlock();
 	mOwner = 0;
 
 	#if	Log_WaitOwnership
@@ -237,6 +261,7 @@ bool	CAGuard::WaitFor(UInt64 inNanos)
 	OSStatus theError = WaitForMultipleObjects(2, theHandles, true, theWaitTime);
 	ThrowIf((theError != WAIT_OBJECT_0) && (theError != WAIT_TIMEOUT), CAException(GetLastError()), "CAGuard::WaitFor: Wait got an error");
 	mOwner = GetCurrentThreadId();
+	StatisticsDidRelock();
 	ResetEvent(mEvent);
 	
 	#if	Log_TimedWaits || Log_Latency || Log_Average_Latency
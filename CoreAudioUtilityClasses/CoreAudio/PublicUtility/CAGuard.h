@@ -76,6 +76,7 @@ class	CAGuard : public CAMutex
 //	Construction/Destruction
 public:
 					CAGuard(const char* inName);
+					CAGuard(const char* inName, UInt32 inOptions);
 	virtual			~CAGuard();
 
 //	Actions
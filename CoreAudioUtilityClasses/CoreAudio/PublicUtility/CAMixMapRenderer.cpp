@@ -0,0 +1,251 @@
+/*
+     File: CAMixMapRenderer.cpp 
+ Abstract:  CAMixMapRenderer.h  
+  Version: 1.0.2 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2012 Apple Inc. All Rights Reserved. 
+  
+*/
+//=============================================================================
+//	Includes
+//=============================================================================
+
+#include "CAMixMapRenderer.h"
+#include "CAVectorDSP.h"
+
+//=============================================================================
+//	CAMixMapRenderer
+//=============================================================================
+
+CAMixMapRenderer::CAMixMapRenderer()
+	: mNumIns(0), mNumOuts(0), mKind(kMix_Silent), mRampFrames(0), mRampPos(0)
+{
+}
+
+CAMixMapRenderer::~CAMixMapRenderer()
+{
+}
+
+void	CAMixMapRenderer::Allocate(UInt32 inNumIns, UInt32 inNumOuts)
+{
+	mNumIns = inNumIns;
+	mNumOuts = inNumOuts;
+	mMatrix.alloc(inNumIns * inNumOuts, true);
+	mScratchMatrix.alloc(inNumIns * inNumOuts, true);
+	mTerms.alloc(inNumIns * inNumOuts, false);
+	mOutputTerms.alloc(inNumOuts + 1, true);
+	mInputPointers.alloc(inNumIns, true);
+	mOutputPointers.alloc(inNumOuts, true);
+	mKind = kMix_Silent;
+	mRampFrames = 0;
+	mRampPos = 0;
+}
+
+void	CAMixMapRenderer::SetMatrix(const Float32* inMatrix, UInt32 inNumIns, UInt32 inNumOuts, UInt32 inRampFrames)
+{
+	if (inNumIns != mNumIns || inNumOuts != mNumOuts || !mMatrix()) {
+		Allocate(inNumIns, inNumOuts);
+		inRampFrames = 0;
+	}
+	
+	// a ramp starts from wherever the gains are now, which may be part way through another ramp
+	if (inRampFrames > 0)
+		GetCurrentGains(mScratchMatrix());
+	memcpy(mMatrix(), inMatrix, inNumIns * inNumOuts * sizeof(Float32));
+	Analyse();
+	BuildTerms(inRampFrames > 0 ? mScratchMatrix() : NULL);
+	mRampFrames = inRampFrames;
+	mRampPos = 0;
+}
+
+void	CAMixMapRenderer::Analyse()
+{
+	bool silent = true, diagonal = true, identity = true;
+	const Float32* matrix = mMatrix();
+	for (UInt32 in = 0; in < mNumIns; ++in) {
+		for (UInt32 out = 0; out < mNumOuts; ++out) {
+			Float32 gain = matrix[in * mNumOuts + out];
+			if (gain != 0.f)
+				silent = false;
+			if (in == out) {
+				if (gain != 1.f)
+					identity = false;
+			} else if (gain != 0.f) {
+				diagonal = identity = false;
+			}
+		}
+	}
+	if (silent)
+		mKind = kMix_Silent;
+	else if (identity)
+		mKind = kMix_Identity;
+	else if (diagonal)
+		mKind = kMix_Diagonal;
+	else
+		mKind = kMix_Sparse;
+}
+
+void	CAMixMapRenderer::BuildTerms(const Float32* inFrom)
+{
+	const Float32* to = mMatrix();
+	UInt32 numTerms = 0;
+	for (UInt32 out = 0; out < mNumOuts; ++out) {
+		mOutputTerms[out] = numTerms;
+		for (UInt32 in = 0; in < mNumIns; ++in) {
+			UInt32 index = in * mNumOuts + out;
+			Float32 from = inFrom ? inFrom[index] : to[index];
+			if (from != 0.f || to[index] != 0.f) {
+				Term& term = mTerms[numTerms++];
+				term.mInput = in;
+				term.mFrom = from;
+				term.mTo = to[index];
+			}
+		}
+	}
+	mOutputTerms[mNumOuts] = numTerms;
+}
+
+void	CAMixMapRenderer::GetCurrentGains(Float32* outMatrix) const
+{
+	if (mRampFrames == 0) {
+		memcpy(outMatrix, mMatrix(), mNumIns * mNumOuts * sizeof(Float32));
+		return;
+	}
+	memset(outMatrix, 0, mNumIns * mNumOuts * sizeof(Float32));
+	Float32 position = (Float32)mRampPos / (Float32)mRampFrames;
+	for (UInt32 out = 0; out < mNumOuts; ++out) {
+		for (UInt32 t = mOutputTerms[out]; t < mOutputTerms[out + 1]; ++t) {
+			const Term& term = mTerms[t];
+			outMatrix[term.mInput * mNumOuts + out] = term.mFrom + (term.mTo - term.mFrom) * position;
+		}
+	}
+}
+
+void	CAMixMapRenderer::Render(const AudioBufferList& inInput, AudioBufferList& outOutput, UInt32 inNumFrames)
+{
+	for (UInt32 in = 0; in < mNumIns; ++in)
+		mInputPointers[in] = (const Float32*)inInput.mBuffers[in].mData;
+	for (UInt32 out = 0; out < mNumOuts; ++out)
+		mOutputPointers[out] = (Float32*)outOutput.mBuffers[out].mData;
+	Render(mInputPointers(), mOutputPointers(), inNumFrames);
+}
+
+void	CAMixMapRenderer::Render(const Float32* const* inInputs, Float32* const* outOutputs, UInt32 inNumFrames)
+{
+	UInt32 frame = 0;
+	while (mRampFrames > 0 && frame < inNumFrames) {
+		UInt32 numFrames = std::min(std::min(inNumFrames - frame, mRampFrames - mRampPos), (UInt32)kBlockFrames);
+		RenderRamp(inInputs, outOutputs, frame, numFrames);
+		frame += numFrames;
+		mRampPos += numFrames;
+		if (mRampPos == mRampFrames) {
+			// the ramp has arrived: drop the terms that were only there to fade out
+			mRampFrames = 0;
+			mRampPos = 0;
+			BuildTerms(NULL);
+		}
+	}
+	if (frame < inNumFrames)
+		RenderSteady(inInputs, outOutputs, frame, inNumFrames - frame);
+}
+
+void	CAMixMapRenderer::RenderSteady(const Float32* const* inInputs, Float32* const* outOutputs, UInt32 inOffset, UInt32 inNumFrames)
+{
+	const Float32* matrix = mMatrix();
+	switch (mKind) {
+		case kMix_Silent:
+			for (UInt32 out = 0; out < mNumOuts; ++out)
+				memset(outOutputs[out] + inOffset, 0, inNumFrames * sizeof(Float32));
+			break;
+			
+		case kMix_Identity:
+		case kMix_Diagonal:
+			for (UInt32 out = 0; out < mNumOuts; ++out) {
+				Float32* dest = outOutputs[out] + inOffset;
+				Float32 gain = (out < mNumIns) ? matrix[out * mNumOuts + out] : 0.f;
+				if (gain == 0.f) {
+					memset(dest, 0, inNumFrames * sizeof(Float32));
+				} else if (gain == 1.f) {
+					const Float32* src = inInputs[out] + inOffset;
+					if (src != dest)
+						memcpy(dest, src, inNumFrames * sizeof(Float32));
+				} else {
+					CAVectorDSP::Scale(inInputs[out] + inOffset, gain, dest, inNumFrames);
+				}
+			}
+			break;
+			
+		case kMix_Sparse:
+			for (UInt32 block = 0; block < inNumFrames; block += kBlockFrames) {
+				UInt32 offset = inOffset + block;
+				UInt32 numFrames = std::min(inNumFrames - block, (UInt32)kBlockFrames);
+				for (UInt32 out = 0; out < mNumOuts; ++out) {
+					Float32* dest = outOutputs[out] + offset;
+					UInt32 t = mOutputTerms[out], end = mOutputTerms[out + 1];
+					if (t == end) {
+						memset(dest, 0, numFrames * sizeof(Float32));
+						continue;
+					}
+					// the first term writes the output, so it never needs clearing
+					CAVectorDSP::Scale(inInputs[mTerms[t].mInput] + offset, mTerms[t].mTo, dest, numFrames);
+					for (++t; t < end; ++t)
+						CAVectorDSP::ScaleAdd(inInputs[mTerms[t].mInput] + offset, mTerms[t].mTo, dest, dest, numFrames);
+				}
+			}
+			break;
+	}
+}
+
+void	CAMixMapRenderer::RenderRamp(const Float32* const* inInputs, Float32* const* outOutputs, UInt32 inOffset, UInt32 inNumFrames)
+{
+	Float32 position = (Float32)mRampPos / (Float32)mRampFrames;
+	Float32 perFrame = 1.f / (Float32)mRampFrames;
+	for (UInt32 out = 0; out < mNumOuts; ++out) {
+		Float32* dest = outOutputs[out] + inOffset;
+		memset(dest, 0, inNumFrames * sizeof(Float32));
+		for (UInt32 t = mOutputTerms[out]; t < mOutputTerms[out + 1]; ++t) {
+			const Term& term = mTerms[t];
+			Float32 delta = term.mTo - term.mFrom;
+			Float32 gain = term.mFrom + delta * position;
+			CAVectorDSP::RampMultiplyAdd(inInputs[term.mInput] + inOffset, gain, delta * perFrame, dest, inNumFrames);
+		}
+	}
+}
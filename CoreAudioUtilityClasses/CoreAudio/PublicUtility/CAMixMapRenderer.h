@@ -0,0 +1,141 @@
+/*
+     File: CAMixMapRenderer.h 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.2 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2012 Apple Inc. All Rights Reserved. 
+  
+*/
+#ifndef __CAMixMapRenderer_h__
+#define __CAMixMapRenderer_h__
+
+#include <TargetConditionals.h>
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <CoreAudio/CoreAudioTypes.h>
+#else
+	#include <CoreAudioTypes.h>
+#endif
+#include <stdio.h>
+#include <string.h>
+#include "CAAutoDisposer.h"
+#include "CAMixMap.h"
+
+//	CAMixMapRenderer mixes planar input channels into planar output channels through a CAMixMap style
+//	matrix (NumIns rows of NumOuts gains).
+//
+//	The matrix is analysed when it is set: a silent, identity or diagonal matrix is rendered with one
+//	copy, scale or clear per output, and any other matrix is reduced to a list of the non-zero gains of
+//	each output, so zero cross points and silent outputs cost nothing. The general case is rendered in
+//	blocks of kBlockFrames so that each output block stays in cache while its inputs are summed into it.
+//	A new matrix can be ramped to linearly, per sample, to avoid zipper noise.
+
+class CAMixMapRenderer
+{
+public:
+	enum {
+		kBlockFrames = 256
+	};
+	
+	enum MixKind {
+		kMix_Silent,
+		kMix_Identity,
+		kMix_Diagonal,
+		kMix_Sparse
+	};
+	
+							CAMixMapRenderer();
+							~CAMixMapRenderer();
+	
+	// Allocates for a matrix of this size and sets it to silence. Not real-time safe.
+	void					Allocate(UInt32 inNumIns, UInt32 inNumOuts);
+	
+	// Copies the matrix. When inRampFrames is not 0, each gain moves linearly from its current value to
+	// the new one over that many frames. Real-time safe unless the size differs from the allocated one,
+	// in which case it allocates and doesn't ramp.
+	void					SetMatrix(const Float32* inMatrix, UInt32 inNumIns, UInt32 inNumOuts, UInt32 inRampFrames = 0);
+	void					SetMixMap(const CAMixMap& inMixMap, UInt32 inRampFrames = 0)
+							{
+								SetMatrix(inMixMap.MM(), inMixMap.NumIns(), inMixMap.NumOuts(), inRampFrames);
+							}
+	
+	// Replaces the outputs with the mix of the inputs. Outputs must not alias inputs unless the matrix is
+	// an identity or diagonal one and nothing is ramping.
+	void					Render(const Float32* const* inInputs, Float32* const* outOutputs, UInt32 inNumFrames);
+	// one buffer per channel on each side
+	void					Render(const AudioBufferList& inInput, AudioBufferList& outOutput, UInt32 inNumFrames);
+	
+	UInt32					NumIns() const { return mNumIns; }
+	UInt32					NumOuts() const { return mNumOuts; }
+	MixKind					Kind() const { return mKind; }
+	bool					IsRamping() const { return mRampFrames > 0; }
+	
+private:
+							CAMixMapRenderer(const CAMixMapRenderer&);
+	CAMixMapRenderer&		operator=(const CAMixMapRenderer&);
+	
+	// a non-zero cross point of one output; mFrom is only used while ramping
+	struct Term
+	{
+		UInt32		mInput;
+		Float32		mFrom;
+		Float32		mTo;
+	};
+	
+	void					Analyse();
+	void					BuildTerms(const Float32* inFrom);
+	void					GetCurrentGains(Float32* outMatrix) const;
+	void					RenderSteady(const Float32* const* inInputs, Float32* const* outOutputs, UInt32 inOffset, UInt32 inNumFrames);
+	void					RenderRamp(const Float32* const* inInputs, Float32* const* outOutputs, UInt32 inOffset, UInt32 inNumFrames);
+	
+	UInt32					mNumIns;
+	UInt32					mNumOuts;
+	MixKind					mKind;
+	UInt32					mRampFrames;		// 0 when not ramping
+	UInt32					mRampPos;
+	CAAutoFree<Float32>		mMatrix;			// the target matrix
+	CAAutoFree<Float32>		mScratchMatrix;
+	CAAutoFree<Term>		mTerms;				// the terms of each output, one output after the other
+	CAAutoFree<UInt32>		mOutputTerms;		// NumOuts + 1 offsets into mTerms
+	CAAutoFree<const Float32*>	mInputPointers;
+	CAAutoFree<Float32*>	mOutputPointers;
+};
+
+#endif // __CAMixMapRenderer_h__
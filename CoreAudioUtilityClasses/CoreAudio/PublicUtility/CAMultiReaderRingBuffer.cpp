@@ -0,0 +1,377 @@
+/*
+     File: CAMultiReaderRingBuffer.cpp 
+ Abstract:  CAMultiReaderRingBuffer.h  
+  Version: 1.0.2 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2012 Apple Inc. All Rights Reserved. 
+  
+*/
+#include "CAMultiReaderRingBuffer.h"
+#include "CABitOperations.h"
+#include "CAAutoDisposer.h"
+#include "CAAtomic.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+CAMultiReaderRingBuffer::CAMultiReaderRingBuffer() :
+	mBuffers(NULL), mNumberChannels(0), mBytesPerFrame(0), mCapacityFrames(0), mCapacityFramesMask(0), mCapacityBytes(0),
+	mBoundsSequence(0), mStartTime(0), mEndTime(0), mReaderStorage(NULL), mReaders(NULL)
+{
+	const UInt32 cursorBytes = kCAMultiReaderRingBufferMaxReaders * sizeof(ReaderCursor);
+	mReaderStorage = CA_malloc(cursorBytes + kCacheLineSize);
+	mReaders = reinterpret_cast<ReaderCursor *>((reinterpret_cast<uintptr_t>(mReaderStorage) + kCacheLineSize - 1) & ~uintptr_t(kCacheLineSize - 1));
+	memset(mReaders, 0, cursorBytes);
+}
+
+CAMultiReaderRingBuffer::~CAMultiReaderRingBuffer()
+{
+	Deallocate();
+	free(mReaderStorage);
+}
+
+void	CAMultiReaderRingBuffer::Allocate(int nChannels, UInt32 bytesPerFrame, UInt32 capacityFrames)
+{
+	Deallocate();
+	
+	capacityFrames = NextPowerOfTwo(capacityFrames);
+	
+	mNumberChannels = nChannels;
+	mBytesPerFrame = bytesPerFrame;
+	mCapacityFrames = capacityFrames;
+	mCapacityFramesMask = capacityFrames - 1;
+	mCapacityBytes = bytesPerFrame * capacityFrames;
+
+	// put everything in one memory allocation, first the pointers, then the deinterleaved channels
+	UInt32 allocSize = (mCapacityBytes + sizeof(Byte *)) * nChannels;
+	Byte *p = (Byte *)CA_malloc(allocSize);
+	memset(p, 0, allocSize);
+	mBuffers = (Byte **)p;
+	p += nChannels * sizeof(Byte *);
+	for (int i = 0; i < nChannels; ++i) {
+		mBuffers[i] = p;
+		p += mCapacityBytes;
+	}
+	
+	mBoundsSequence = 0;
+	mStartTime = 0;
+	mEndTime = 0;
+	
+	// registered readers stay registered, but their cursors start over
+	for (UInt32 i = 0; i < kCAMultiReaderRingBufferMaxReaders; ++i) {
+		mReaders[i].mPosition = 0;
+		mReaders[i].mOverruns = 0;
+	}
+	CAMemoryBarrier();
+}
+
+void	CAMultiReaderRingBuffer::Deallocate()
+{
+	if (mBuffers) {
+		free(mBuffers);
+		mBuffers = NULL;
+	}
+	mNumberChannels = 0;
+	mCapacityBytes = 0;
+	mCapacityFrames = 0;
+}
+
+// The helpers below treat an array of buffer lists as one list of channels, and never
+// touch more than the ring's channel count.
+
+static void	MRZeroRange(Byte **buffers, int nchannels, int offset, int nbytes)
+{
+	while (--nchannels >= 0) {
+		memset(*buffers + offset, 0, nbytes);
+		++buffers;
+	}
+}
+
+static void	MRStoreABLs(Byte **buffers, int nchannels, int destOffset, const AudioBufferList * const *abls, UInt32 numABLs, int srcOffset, int nbytes)
+{
+	for (UInt32 i = 0; i < numABLs && nchannels > 0; ++i) {
+		const AudioBufferList *abl = abls[i];
+		const AudioBuffer *src = abl->mBuffers;
+		for (UInt32 j = 0; j < abl->mNumberBuffers && nchannels > 0; ++j, --nchannels) {
+			memcpy(*buffers + destOffset, (const Byte *)src->mData + srcOffset, nbytes);
+			++buffers;
+			++src;
+		}
+	}
+}
+
+static void	MRFetchABLs(AudioBufferList * const *abls, UInt32 numABLs, int destOffset, Byte **buffers, int nchannels, int srcOffset, int nbytes)
+{
+	for (UInt32 i = 0; i < numABLs && nchannels > 0; ++i) {
+		AudioBufferList *abl = abls[i];
+		AudioBuffer *dest = abl->mBuffers;
+		for (UInt32 j = 0; j < abl->mNumberBuffers && nchannels > 0; ++j, --nchannels) {
+			memcpy((Byte *)dest->mData + destOffset, *buffers + srcOffset, nbytes);
+			++buffers;
+			++dest;
+		}
+	}
+}
+
+static void	MRZeroABLs(AudioBufferList * const *abls, UInt32 numABLs, int destOffset, int nbytes)
+{
+	for (UInt32 i = 0; i < numABLs; ++i) {
+		AudioBufferList *abl = abls[i];
+		AudioBuffer *dest = abl->mBuffers;
+		for (UInt32 j = 0; j < abl->mNumberBuffers; ++j) {
+			memset((Byte *)dest->mData + destOffset, 0, nbytes);
+			++dest;
+		}
+	}
+}
+
+static void	MRSetDataByteSize(AudioBufferList * const *abls, UInt32 numABLs, UInt32 nbytes)
+{
+	for (UInt32 i = 0; i < numABLs; ++i) {
+		AudioBufferList *abl = abls[i];
+		for (UInt32 j = 0; j < abl->mNumberBuffers; ++j)
+			abl->mBuffers[j].mDataByteSize = nbytes;
+	}
+}
+
+CARingBufferError	CAMultiReaderRingBuffer::Store(const AudioBufferList * const *abls, UInt32 numABLs, UInt32 framesToWrite, SampleTime startWrite)
+{
+	if (framesToWrite > mCapacityFrames)
+		return kCARingBufferError_TooMuch;		// too big!
+
+	SampleTime endWrite = startWrite + framesToWrite;
+	
+	if (startWrite < EndTime()) {
+		// going backwards, throw everything out
+		SetTimeBounds(startWrite, startWrite);
+	} else if (endWrite - StartTime() <= mCapacityFrames) {
+		// the buffer has not yet wrapped and will not need to
+	} else {
+		// advance the start time past the region we are about to overwrite
+		SampleTime newStart = endWrite - mCapacityFrames;	// one buffer of time behind where we're writing
+		SampleTime newEnd = std::max(newStart, EndTime());
+		SetTimeBounds(newStart, newEnd);
+	}
+	
+	// write the new frames
+	Byte **buffers = mBuffers;
+	int nchannels = mNumberChannels;
+	int offset0, offset1, nbytes;
+	SampleTime curEnd = EndTime();
+	
+	if (startWrite > curEnd) {
+		// we are skipping some samples, so zero the range we are skipping
+		offset0 = FrameOffset(curEnd);
+		offset1 = FrameOffset(startWrite);
+		if (offset0 < offset1)
+			MRZeroRange(buffers, nchannels, offset0, offset1 - offset0);
+		else {
+			MRZeroRange(buffers, nchannels, offset0, mCapacityBytes - offset0);
+			MRZeroRange(buffers, nchannels, 0, offset1);
+		}
+		offset0 = offset1;
+	} else {
+		offset0 = FrameOffset(startWrite);
+	}
+
+	offset1 = FrameOffset(endWrite);
+	if (offset0 < offset1)
+		MRStoreABLs(buffers, nchannels, offset0, abls, numABLs, 0, offset1 - offset0);
+	else {
+		nbytes = mCapacityBytes - offset0;
+		MRStoreABLs(buffers, nchannels, offset0, abls, numABLs, 0, nbytes);
+		MRStoreABLs(buffers, nchannels, 0, abls, numABLs, nbytes, offset1);
+	}
+	
+	// now update the end time
+	SetTimeBounds(StartTime(), endWrite);
+	
+	return kCARingBufferError_OK;	// success
+}
+
+void	CAMultiReaderRingBuffer::SetTimeBounds(SampleTime startTime, SampleTime endTime)
+{
+	// only the writer changes the sequence, so the increments cannot collide; the barriers
+	// order the bounds stores between the odd and even sequence values
+	CAAtomicIncrement32Barrier(&mBoundsSequence);
+	mStartTime = startTime;
+	mEndTime = endTime;
+	CAAtomicIncrement32Barrier(&mBoundsSequence);
+}
+
+void	CAMultiReaderRingBuffer::GetTimeBounds(SampleTime &startTime, SampleTime &endTime) const
+{
+	for (;;) {
+		SInt32 seq = mBoundsSequence;
+		if (seq & 1)
+			continue;	// the writer is in the middle of an update
+		CAMemoryBarrier();
+		startTime = mStartTime;
+		endTime = mEndTime;
+		CAMemoryBarrier();
+		if (mBoundsSequence == seq)
+			return;
+	}
+}
+
+CARingBufferError	CAMultiReaderRingBuffer::Fetch(AudioBufferList * const *abls, UInt32 numABLs, UInt32 nFrames, SampleTime startRead)
+{
+	SampleTime endRead = startRead + nFrames;
+	SampleTime startRead0 = startRead;
+	SampleTime endRead0 = endRead;
+	SampleTime startTime, endTime;
+	
+	GetTimeBounds(startTime, endTime);
+	// clip to the valid range, keeping startRead <= endRead within the requested range: a
+	// reader that has fallen entirely behind the writer (or ahead of it) gets all zeroes
+	startRead = std::min(std::max(startRead, startTime), endRead0);
+	endRead = std::max(std::min(endRead, endTime), startRead);
+	
+	int destStartBytes = int(startRead - startRead0) * mBytesPerFrame;
+	int nbytes = int(endRead - startRead) * mBytesPerFrame;
+	int destEndBytes = int(endRead0 - endRead) * mBytesPerFrame;
+	
+	if (destStartBytes > 0)
+		MRZeroABLs(abls, numABLs, 0, destStartBytes);
+	if (destEndBytes > 0)
+		MRZeroABLs(abls, numABLs, destStartBytes + nbytes, destEndBytes);
+	
+	CARingBufferError err = kCARingBufferError_OK;
+	if (nbytes > 0) {
+		Byte **buffers = mBuffers;
+		int offset0 = FrameOffset(startRead);
+		int offset1 = FrameOffset(endRead);
+		
+		if (offset0 < offset1) {
+			MRFetchABLs(abls, numABLs, destStartBytes, buffers, mNumberChannels, offset0, nbytes);
+		} else {
+			int nbytes0 = mCapacityBytes - offset0;
+			MRFetchABLs(abls, numABLs, destStartBytes, buffers, mNumberChannels, offset0, nbytes0);
+			MRFetchABLs(abls, numABLs, destStartBytes + nbytes0, buffers, mNumberChannels, 0, offset1);
+		}
+		
+		// if the writer advanced the start time past where we started reading while we
+		// were copying, part of what we copied may have been overwritten
+		CAMemoryBarrier();
+		GetTimeBounds(startTime, endTime);
+		if (startTime > startRead)
+			err = kCARingBufferError_ReaderOverrun;
+	}
+	
+	MRSetDataByteSize(abls, numABLs, nFrames * mBytesPerFrame);
+	
+	return err;
+}
+
+CAMultiReaderRingBuffer::ReaderID	CAMultiReaderRingBuffer::AddReader()
+{
+	for (UInt32 i = 0; i < kCAMultiReaderRingBufferMaxReaders; ++i) {
+		ReaderCursor &cursor = mReaders[i];
+		if (CAAtomicCompareAndSwap32Barrier(0, 1, &cursor.mActive)) {
+			SampleTime startTime, endTime;
+			GetTimeBounds(startTime, endTime);
+			cursor.mPosition = endTime;
+			cursor.mOverruns = 0;
+			return (ReaderID)i;
+		}
+	}
+	return -1;
+}
+
+void	CAMultiReaderRingBuffer::RemoveReader(ReaderID inReader)
+{
+	if (IsValidReader(inReader))
+		CAAtomicCompareAndSwap32Barrier(1, 0, &mReaders[inReader].mActive);
+}
+
+CARingBufferError	CAMultiReaderRingBuffer::FetchNext(ReaderID inReader, AudioBufferList * const *abls, UInt32 numABLs, UInt32 nFrames)
+{
+	if (!IsValidReader(inReader))
+		return kCARingBufferError_InvalidReader;
+	
+	ReaderCursor &cursor = mReaders[inReader];
+	SampleTime startTime, endTime;
+	GetTimeBounds(startTime, endTime);
+	
+	SampleTime position = cursor.mPosition;
+	if (position < startTime) {
+		// the writer lapped this reader; resume from the oldest frame still in the buffer
+		++cursor.mOverruns;
+		position = startTime;
+	} else if (position > endTime) {
+		// the writer went backwards in time and threw everything out
+		position = endTime;
+	}
+	
+	// a cursor never reads past what has been written; the caller sees how much it got
+	// in mDataByteSize
+	UInt32 framesToRead = (UInt32)std::min(SampleTime(nFrames), endTime - position);
+	if (framesToRead == 0) {
+		MRSetDataByteSize(abls, numABLs, 0);
+		cursor.mPosition = position;
+		return kCARingBufferError_OK;
+	}
+	
+	CARingBufferError err = Fetch(abls, numABLs, framesToRead, position);
+	if (err == kCARingBufferError_ReaderOverrun)
+		++cursor.mOverruns;
+	cursor.mPosition = position + framesToRead;
+	
+	return err;
+}
+
+CAMultiReaderRingBuffer::SampleTime	CAMultiReaderRingBuffer::GetReaderPosition(ReaderID inReader) const
+{
+	return IsValidReader(inReader) ? mReaders[inReader].mPosition : 0;
+}
+
+void	CAMultiReaderRingBuffer::SetReaderPosition(ReaderID inReader, SampleTime inPosition)
+{
+	if (IsValidReader(inReader))
+		mReaders[inReader].mPosition = inPosition;
+}
+
+UInt32	CAMultiReaderRingBuffer::GetReaderOverruns(ReaderID inReader) const
+{
+	return IsValidReader(inReader) ? mReaders[inReader].mOverruns : 0;
+}
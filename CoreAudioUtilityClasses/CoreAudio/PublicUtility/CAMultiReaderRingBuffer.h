@@ -0,0 +1,170 @@
+/*
+     File: CAMultiReaderRingBuffer.h 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.2 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2012 Apple Inc. All Rights Reserved. 
+  
+*/
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <CoreAudio/CoreAudioTypes.h>
+#else
+	#include <CoreAudioTypes.h>
+#endif
+
+#include "CARingBuffer.h"
+
+#ifndef CAMultiReaderRingBuffer_Header
+#define CAMultiReaderRingBuffer_Header
+
+enum {
+	kCARingBufferError_ReaderOverrun = 5,	// the writer overwrote part of the range while it was being fetched
+	kCARingBufferError_InvalidReader = 6	// the reader ID is out of range or not currently registered
+};
+
+const UInt32 kCAMultiReaderRingBufferMaxReaders = 8;
+
+// A single-writer, multi-reader variant of CARingBuffer.
+//
+// The valid time range is published through a sequence counter (seqlock) rather than
+// CARingBuffer's queue of time bounds, so a reader never gives up with
+// kCARingBufferError_CPUOverload: it simply retries until it observes a snapshot that
+// was not being written. The writer section is a handful of stores, so the retry loop
+// is short and bounded in practice by the writer's progress.
+//
+// Each reader may register a cursor with AddReader(). FetchNext() then reads from that
+// reader's own position and advances it, so one writer (typically a device IO proc)
+// can feed several independent consumers, each at its own pace.
+//
+// Store and Fetch also accept an array of AudioBufferLists whose buffers are treated as
+// one concatenated list of channels, so a callback with several input streams can be
+// stored or fetched with a single bounds snapshot.
+class CAMultiReaderRingBuffer {
+public:
+	typedef CARingBuffer::SampleTime SampleTime;
+	typedef SInt32 ReaderID;
+
+	CAMultiReaderRingBuffer();
+	~CAMultiReaderRingBuffer();
+	
+	void					Allocate(int nChannels, UInt32 bytesPerFrame, UInt32 capacityFrames);
+								// capacityFrames will be rounded up to a power of 2
+	void					Deallocate();
+	
+	// writer
+	CARingBufferError		Store(const AudioBufferList *abl, UInt32 nFrames, SampleTime frameNumber)
+								{ return Store(&abl, 1, nFrames, frameNumber); }
+	CARingBufferError		Store(const AudioBufferList * const *abls, UInt32 numABLs, UInt32 nFrames, SampleTime frameNumber);
+								// Same semantics as CARingBuffer::Store. The buffers of all the
+								// lists are stored into consecutive channels of the ring; their
+								// total must not exceed the allocated channel count.
+	
+	// readers, by explicit sample time
+	CARingBufferError		Fetch(AudioBufferList *abl, UInt32 nFrames, SampleTime frameNumber)
+								{ return Fetch(&abl, 1, nFrames, frameNumber); }
+	CARingBufferError		Fetch(AudioBufferList * const *abls, UInt32 numABLs, UInt32 nFrames, SampleTime frameNumber);
+								// will alter mDataByteSize of the buffers. Frames outside the
+								// valid range are zeroed.
+	
+	// readers, by cursor
+	ReaderID				AddReader();
+								// returns -1 if all kCAMultiReaderRingBufferMaxReaders slots are taken.
+								// The new cursor starts at the current end time.
+	void					RemoveReader(ReaderID inReader);
+	
+	CARingBufferError		FetchNext(ReaderID inReader, AudioBufferList *abl, UInt32 nFrames)
+								{ return FetchNext(inReader, &abl, 1, nFrames); }
+	CARingBufferError		FetchNext(ReaderID inReader, AudioBufferList * const *abls, UInt32 numABLs, UInt32 nFrames);
+								// fetches nFrames at the reader's cursor and advances it. If the
+								// writer has already overwritten the cursor position, the cursor
+								// jumps forward to the oldest valid frame and the overrun is counted.
+	
+	SampleTime				GetReaderPosition(ReaderID inReader) const;
+	void					SetReaderPosition(ReaderID inReader, SampleTime inPosition);
+	UInt32					GetReaderOverruns(ReaderID inReader) const;
+	
+	void					GetTimeBounds(SampleTime &startTime, SampleTime &endTime) const;
+								// always succeeds; retries until a consistent snapshot is read
+	
+protected:
+	int						FrameOffset(SampleTime frameNumber) const { return (frameNumber & mCapacityFramesMask) * mBytesPerFrame; }
+	
+	bool					IsValidReader(ReaderID inReader) const { return (inReader >= 0) && (inReader < (ReaderID)kCAMultiReaderRingBufferMaxReaders) && (mReaders[inReader].mActive != 0); }
+	
+	// these should only be called from Store.
+	SampleTime				StartTime() const { return mStartTime; }
+	SampleTime				EndTime() const { return mEndTime; }
+	void					SetTimeBounds(SampleTime startTime, SampleTime endTime);
+	
+private:
+	// prohibited methods: private and unimplemented.
+	CAMultiReaderRingBuffer(const CAMultiReaderRingBuffer &);
+	CAMultiReaderRingBuffer &	operator=(const CAMultiReaderRingBuffer &);
+	
+protected:
+	Byte **					mBuffers;				// allocated in one chunk of memory
+	int						mNumberChannels;
+	UInt32					mBytesPerFrame;			// within one deinterleaved channel
+	UInt32					mCapacityFrames;		// per channel, must be a power of 2
+	UInt32					mCapacityFramesMask;
+	UInt32					mCapacityBytes;			// per channel
+	
+	// range of valid sample time in the buffer, guarded by mBoundsSequence which is odd
+	// while the writer is updating it
+	volatile SInt32			mBoundsSequence;
+	volatile SampleTime		mStartTime;
+	volatile SampleTime		mEndTime;
+	
+	// each cursor fills its own cache line, and the array is allocated on a cache line
+	// boundary away from the writer's fields, so readers don't contend with each other
+	enum { kCacheLineSize = 64 };
+	struct ReaderCursor {
+		volatile SampleTime	mPosition;
+		volatile SInt32		mActive;
+		UInt32				mOverruns;
+		Byte				mPad[kCacheLineSize - sizeof(SampleTime) - sizeof(SInt32) - sizeof(UInt32)];
+	};
+	
+	void *					mReaderStorage;
+	ReaderCursor *			mReaders;				// kCAMultiReaderRingBufferMaxReaders, cache line aligned
+};
+
+#endif
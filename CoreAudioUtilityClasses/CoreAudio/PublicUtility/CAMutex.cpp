@@ -53,13 +53,20 @@
 
 #if TARGET_OS_MAC
 	#include <errno.h>
+	#include <unistd.h>
 #endif
 
 //	PublicUtility Includes
+#include "CAAtomic.h"
 #include "CADebugMacros.h"
 #include "CAException.h"
 #include "CAHostTimeBase.h"
 
+//	Standard Library Includes
+#include <algorithm>
+#include <string.h>
+#include <vector>
+
 //==================================================================================================
 //	Logging
 //==================================================================================================
@@ -71,6 +78,47 @@
 //	#define LongLatencyThreshholdNS	1000000ULL	// nanoseconds
 #endif
 
+//==================================================================================================
+//	Options
+//==================================================================================================
+
+UInt32	CAMutex::sDefaultOptions = 0;
+
+//	a contended Lock() spins for up to twice the recent average before blocking, but never more than this
+#define	kCAMutexMaxSpins	100U
+
+static inline void	CAMutexSpinPause()
+{
+#if defined(__i386__) || defined(__x86_64__)
+	__asm__ __volatile__("pause" : : : "memory");
+#elif defined(__arm__) || defined(__arm64__) || defined(__aarch64__)
+	__asm__ __volatile__("yield" : : : "memory");
+#elif TARGET_OS_WIN32
+	YieldProcessor();
+#endif
+}
+
+//	spinning only helps when the owner can be running on another processor
+static bool	CAMutexCanSpin()
+{
+	static SInt32 sNumberProcessors = 0;
+	if(sNumberProcessors == 0)
+	{
+#if TARGET_OS_MAC
+		sNumberProcessors = (SInt32)sysconf(_SC_NPROCESSORS_ONLN);
+#elif TARGET_OS_WIN32
+		SYSTEM_INFO theSystemInfo;
+		GetSystemInfo(&theSystemInfo);
+		sNumberProcessors = (SInt32)theSystemInfo.dwNumberOfProcessors;
+#endif
+	}
+	return sNumberProcessors > 1;
+}
+
+//	the mutexes created with kStatistics, linked through mNextWithStatistics
+static CAMutex*			sStatisticsList = NULL;
+static CASpinLock		sStatisticsListLock = CA_SPINLOCK_INIT;
+
 //==================================================================================================
 //	CAMutex
 //==================================================================================================
@@ -78,10 +126,48 @@
 CAMutex::CAMutex(const char* inName)
 :
 	mName(inName),
-	mOwner(0)
+	mOwner(0),
+	mOptions(sDefaultOptions),
+	mSpinEstimate(0),
+	mHoldStartTime(0),
+	mNextWithStatistics(NULL)
+{
+	InitMutex();
+}
+
+CAMutex::CAMutex(const char* inName, UInt32 inOptions)
+:
+	mName(inName),
+	mOwner(0),
+	mOptions(inOptions),
+	mSpinEstimate(0),
+	mHoldStartTime(0),
+	mNextWithStatistics(NULL)
 {
+	InitMutex();
+}
+
+void	CAMutex::InitMutex()
+{
+	memset(&mStatistics, 0, sizeof(mStatistics));
+	if(!CAMutexCanSpin())
+	{
+		mOptions &= ~kAdaptiveSpin;
+	}
+	
 #if TARGET_OS_MAC
-	OSStatus theError = pthread_mutex_init(&mMutex, NULL);
+	pthread_mutexattr_t theAttributes;
+	pthread_mutexattr_init(&theAttributes);
+	OSStatus theError = 0;
+	if((mOptions & kPriorityInheritance) != 0)
+	{
+		theError = pthread_mutexattr_setprotocol(&theAttributes, PTHREAD_PRIO_INHERIT);
+	}
+	if(theError == 0)
+	{
+		theError = pthread_mutex_init(&mMutex, &theAttributes);
+	}
+	pthread_mutexattr_destroy(&theAttributes);
 	ThrowIf(theError != 0, CAException(theError), "CAMutex::CAMutex: Could not init the mutex");
 	
 	#if	Log_Ownership
@@ -95,10 +181,33 @@ CAMutex::CAMutex(const char* inName)
 		DebugPrintfRtn(DebugPrintfFileComma "%lu %.4f: CAMutex::CAMutex: creating %s, owner: %lu\n", GetCurrentThreadId(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), mName, mOwner);
 	#endif
 #endif
+
+	if((mOptions & kStatistics) != 0)
+	{
+		CASpinLockLock(&sStatisticsListLock);
+		mNextWithStatistics = sStatisticsList;
+		sStatisticsList = this;
+		CASpinLockUnlock(&sStatisticsListLock);
+	}
 }
 
 CAMutex::~CAMutex()
 {
+	if((mOptions & kStatistics) != 0)
+	{
+		CASpinLockLock(&sStatisticsListLock);
+		CAMutex** theLink = &sStatisticsList;
+		while((*theLink != NULL) && (*theLink != this))
+		{
+			theLink = &(*theLink)->mNextWithStatistics;
+		}
+		if(*theLink != NULL)
+		{
+			*theLink = mNextWithStatistics;
+		}
+		CASpinLockUnlock(&sStatisticsListLock);
+	}
+	
 #if TARGET_OS_MAC
 	#if	Log_Ownership
 		DebugPrintfRtn(DebugPrintfFileComma "%p %.4f: CAMutex::~CAMutex: destroying %s, owner: %p\n", pthread_self(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), mName, mOwner);
@@ -131,7 +240,7 @@ bool	CAMutex::Lock()
 			UInt64 lockTryTime = CAHostTimeBase::GetCurrentTimeInNanos();
 		#endif
 		
-		OSStatus theError = pthread_mutex_lock(&mMutex);
+		OSStatus theError = ((mOptions & (kAdaptiveSpin | kStatistics)) != 0) ? LockWithOptions() : pthread_mutex_lock(&mMutex);
 		ThrowIf(theError != 0, CAException(theError), "CAMutex::Lock: Could not lock the mutex");
 		mOwner = theCurrentThread;
 		theAnswer = true;
@@ -153,7 +262,7 @@ bool	CAMutex::Lock()
 			DebugPrintfRtn(DebugPrintfFileComma "%lu %.4f: CAMutex::Lock: thread %lu is locking %s, owner: %lu\n", GetCurrentThreadId(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), GetCurrentThreadId(), mName, mOwner);
 		#endif
 
-		OSStatus theError = WaitForSingleObject(mMutex, INFINITE);
+		OSStatus theError = ((mOptions & (kAdaptiveSpin | kStatistics)) != 0) ? LockWithOptions() : WaitForSingleObject(mMutex, INFINITE);
 		ThrowIfError(theError, CAException(theError), "CAMutex::Lock: could not lock the mutex");
 		mOwner = GetCurrentThreadId();
 		theAnswer = true;
@@ -176,6 +285,7 @@ void	CAMutex::Unlock()
 			DebugPrintfRtn(DebugPrintfFileComma "%p %.4f: CAMutex::Unlock: thread %p is unlocking %s, owner: %p\n", pthread_self(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), pthread_self(), mName, mOwner);
 		#endif
 
+		StatisticsWillUnlock();
 		mOwner = 0;
 		OSStatus theError = pthread_mutex_unlock(&mMutex);
 		ThrowIf(theError != 0, CAException(theError), "CAMutex::Unlock: Could not unlock the mutex");
@@ -195,6 +305,7 @@ void	CAMutex::Unlock()
 			DebugPrintfRtn(DebugPrintfFileComma "%lu %.4f: CAMutex::Unlock: thread %lu is unlocking %s, owner: %lu\n", GetCurrentThreadId(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), GetCurrentThreadId(), mName, mOwner);
 		#endif
 
+		StatisticsWillUnlock();
 		mOwner = 0;
 		bool wasReleased = ReleaseMutex(mMutex);
 		ThrowIf(!wasReleased, CAException(GetLastError()), "CAMutex::Unlock: Could not unlock the mutex");
@@ -232,6 +343,11 @@ bool	CAMutex::Try(bool& outWasLocked)
 			mOwner = theCurrentThread;
 			theAnswer = true;
 			outWasLocked = true;
+			if((mOptions & kStatistics) != 0)
+			{
+				++mStatistics.mAcquisitions;
+				mHoldStartTime = CAHostTimeBase::GetTheCurrentTime();
+			}
 	
 			#if	Log_Ownership
 				DebugPrintfRtn(DebugPrintfFileComma "%p %.4f: CAMutex::Try: thread %p has locked %s, owner: %p\n", theCurrentThread, ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), theCurrentThread, mName, mOwner);
@@ -275,6 +391,11 @@ bool	CAMutex::Try(bool& outWasLocked)
 			mOwner = GetCurrentThreadId();
 			theAnswer = true;
 			outWasLocked = true;
+			if((mOptions & kStatistics) != 0)
+			{
+				++mStatistics.mAcquisitions;
+				mHoldStartTime = CAHostTimeBase::GetTheCurrentTime();
+			}
 	
 			#if	Log_Ownership
 				DebugPrintfRtn(DebugPrintfFileComma "%lu %.4f: CAMutex::Try: thread %lu has locked %s, owner: %lu\n", GetCurrentThreadId(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), GetCurrentThreadId(), mName, mOwner);
@@ -326,6 +447,184 @@ bool	CAMutex::IsOwnedByCurrentThread() const
 }
 
 
+OSStatus	CAMutex::LockWithOptions()
+{
+	//	this is Lock() without the owner bookkeeping, for a mutex that spins or keeps statistics
+	bool wasContended = false;
+	bool wasTakenWhileSpinning = false;
+	UInt32 theSpins = 0;
+	UInt64 theWaitStartTime = 0;
+	
+#if TARGET_OS_MAC
+	OSStatus theError = pthread_mutex_trylock(&mMutex);
+	if(theError == EBUSY)
+#elif TARGET_OS_WIN32
+	OSStatus theError = WaitForSingleObject(mMutex, 0);
+	if(theError == WAIT_TIMEOUT)
+#endif
+	{
+		wasContended = true;
+		if((mOptions & kStatistics) != 0)
+		{
+			theWaitStartTime = CAHostTimeBase::GetTheCurrentTime();
+		}
+		
+		if((mOptions & kAdaptiveSpin) != 0)
+		{
+			//	the owner is usually about to let go, so spin a while before paying for a context switch
+			UInt32 theMaxSpins = std::min(2 * mSpinEstimate + 10, kCAMutexMaxSpins);
+			while(!wasTakenWhileSpinning && (theSpins < theMaxSpins))
+			{
+				++theSpins;
+				CAMutexSpinPause();
+				if(mOwner == 0)
+				{
+#if TARGET_OS_MAC
+					wasTakenWhileSpinning = pthread_mutex_trylock(&mMutex) == 0;
+#elif TARGET_OS_WIN32
+					wasTakenWhileSpinning = WaitForSingleObject(mMutex, 0) == WAIT_OBJECT_0;
+#endif
+				}
+			}
+		}
+		
+		if(wasTakenWhileSpinning)
+		{
+			theError = 0;
+		}
+		else
+		{
+#if TARGET_OS_MAC
+			theError = pthread_mutex_lock(&mMutex);
+#elif TARGET_OS_WIN32
+			theError = WaitForSingleObject(mMutex, INFINITE);
+#endif
+		}
+	}
+	
+	//	from here on the lock is held, so nothing else writes these members
+	if((theError == 0) && wasContended && ((mOptions & kAdaptiveSpin) != 0))
+	{
+		mSpinEstimate = (mSpinEstimate * 7 + theSpins) / 8;
+	}
+	if((theError == 0) && ((mOptions & kStatistics) != 0))
+	{
+		UInt64 theCurrentTime = CAHostTimeBase::GetTheCurrentTime();
+		++mStatistics.mAcquisitions;
+		if(wasContended)
+		{
+			UInt64 theWaitNanos = CAHostTimeBase::AbsoluteHostDeltaToNanos(theWaitStartTime, theCurrentTime);
+			++mStatistics.mContendedAcquisitions;
+			if(wasTakenWhileSpinning)
+			{
+				++mStatistics.mSpinAcquisitions;
+			}
+			mStatistics.mTotalWaitNanos += theWaitNanos;
+			mStatistics.mMaxWaitNanos = std::max(mStatistics.mMaxWaitNanos, theWaitNanos);
+		}
+		mHoldStartTime = theCurrentTime;
+	}
+	
+	return theError;
+}
+
+void	CAMutex::EndHold()
+{
+	UInt64 theHoldNanos = CAHostTimeBase::AbsoluteHostDeltaToNanos(mHoldStartTime, CAHostTimeBase::GetTheCurrentTime());
+	mStatistics.mTotalHoldNanos += theHoldNanos;
+	mStatistics.mMaxHoldNanos = std::max(mStatistics.mMaxHoldNanos, theHoldNanos);
+}
+
+void	CAMutex::StatisticsDidRelock()
+{
+	if((mOptions & kStatistics) != 0)
+	{
+		mHoldStartTime = CAHostTimeBase::GetTheCurrentTime();
+	}
+}
+
+void	CAMutex::GetStatistics(Statistics& outStatistics) const
+{
+	outStatistics = mStatistics;
+}
+
+void	CAMutex::ResetStatistics()
+{
+	memset(&mStatistics, 0, sizeof(mStatistics));
+}
+
+static void	CAMutexPrintStatistics(FILE* inFile, const char* inName, const CAMutex::Statistics& theStatistics)
+{
+	Float64 theAverageWait = (theStatistics.mContendedAcquisitions > 0) ? (Float64)theStatistics.mTotalWaitNanos / theStatistics.mContendedAcquisitions : 0.0;
+	Float64 theAverageHold = (theStatistics.mAcquisitions > 0) ? (Float64)theStatistics.mTotalHoldNanos / theStatistics.mAcquisitions : 0.0;
+	fprintf(inFile, "%s: %llu acquisitions, %llu contended (%llu while spinning), wait avg %.1f us max %.1f us, hold avg %.1f us max %.1f us\n",
+			(inName != NULL) ? inName : "unnamed mutex",
+			(unsigned long long)theStatistics.mAcquisitions,
+			(unsigned long long)theStatistics.mContendedAcquisitions,
+			(unsigned long long)theStatistics.mSpinAcquisitions,
+			theAverageWait / 1000.0, theStatistics.mMaxWaitNanos / 1000.0,
+			theAverageHold / 1000.0, theStatistics.mMaxHoldNanos / 1000.0);
+}
+
+void	CAMutex::PrintStatistics(FILE* inFile) const
+{
+	Statistics theStatistics;
+	GetStatistics(theStatistics);
+	CAMutexPrintStatistics(inFile, mName, theStatistics);
+}
+
+//	a copy of one mutex's statistics, which stays valid after the mutex is destroyed
+struct CAMutexStatisticsEntry
+{
+	char				mName[64];
+	bool				mHasName;
+	CAMutex::Statistics	mStatistics;
+};
+
+static bool	CAMutexIsMoreContended(const CAMutexStatisticsEntry& inEntry1, const CAMutexStatisticsEntry& inEntry2)
+{
+	return inEntry1.mStatistics.mContendedAcquisitions > inEntry2.mStatistics.mContendedAcquisitions;
+}
+
+void	CAMutex::PrintAllStatistics(FILE* inFile)
+{
+	//	The list lock keeps the mutexes from being destroyed while they are copied, and it is a spin
+	//	lock, so only the copying happens under it. The copies are allocated before taking it, and if
+	//	mutexes were added meanwhile, allocated again.
+	std::vector<CAMutexStatisticsEntry> theEntries;
+	size_t theNumberMutexes = 0;
+	while(true)
+	{
+		theEntries.resize(theNumberMutexes);
+		theNumberMutexes = 0;
+		CASpinLockLock(&sStatisticsListLock);
+		for(const CAMutex* theMutex = sStatisticsList; theMutex != NULL; theMutex = theMutex->mNextWithStatistics)
+		{
+			if(theNumberMutexes < theEntries.size())
+			{
+				CAMutexStatisticsEntry& theEntry = theEntries[theNumberMutexes];
+				theEntry.mHasName = theMutex->mName != NULL;
+				strncpy(theEntry.mName, theEntry.mHasName ? theMutex->mName : "", sizeof(theEntry.mName) - 1);
+				theEntry.mName[sizeof(theEntry.mName) - 1] = 0;
+				theMutex->GetStatistics(theEntry.mStatistics);
+			}
+			++theNumberMutexes;
+		}
+		CASpinLockUnlock(&sStatisticsListLock);
+		if(theNumberMutexes <= theEntries.size())
+		{
+			break;
+		}
+	}
+	theEntries.resize(theNumberMutexes);
+	
+	std::stable_sort(theEntries.begin(), theEntries.end(), CAMutexIsMoreContended);
+	for(std::vector<CAMutexStatisticsEntry>::const_iterator theIterator = theEntries.begin(); theIterator != theEntries.end(); ++theIterator)
+	{
+		CAMutexPrintStatistics(inFile, theIterator->mHasName ? theIterator->mName : NULL, theIterator->mStatistics);
+	}
+}
+
 CAMutex::Unlocker::Unlocker(CAMutex& inMutex)
 :	mMutex(inMutex),
 	mNeedsLock(false)
@@ -65,17 +65,51 @@
 #else
 	#error	Unsupported operating system
 #endif
+#include <stdio.h>
 
 //==================================================================================================
 //	A recursive mutex.
+//
+//	A mutex can be created with options that help locks contended by real time threads.
+//	kPriorityInheritance has the owner run at the priority of its highest priority waiter (Mac
+//	only). kAdaptiveSpin has a contended Lock() spin for a bounded time before blocking; it is
+//	ignored on a single processor. kStatistics counts acquisitions, contention and wait and hold
+//	times, which can be printed for one mutex or for every mutex that keeps them.
+//	CAMutex(inName) uses the process wide default options, which are none unless
+//	SetDefaultOptions() says otherwise, so a whole driver's locks can be measured without
+//	changing where they are created.
 //==================================================================================================
 
 class	CAMutex
 {
+//	Types
+public:
+	enum
+	{
+		kPriorityInheritance	= (1 << 0),
+		kAdaptiveSpin			= (1 << 1),
+		kStatistics				= (1 << 2)
+	};
+	
+	struct Statistics
+	{
+		UInt64		mAcquisitions;				//	not counting recursive locks
+		UInt64		mContendedAcquisitions;		//	another thread held the lock when Lock() was called
+		UInt64		mSpinAcquisitions;			//	contended, but taken while spinning rather than blocking
+		UInt64		mTotalWaitNanos;			//	spent in contended Lock() calls
+		UInt64		mMaxWaitNanos;
+		UInt64		mTotalHoldNanos;
+		UInt64		mMaxHoldNanos;
+	};
+
 //	Construction/Destruction
 public:
 					CAMutex(const char* inName);
+					CAMutex(const char* inName, UInt32 inOptions);
 	virtual			~CAMutex();
+	
+	static UInt32	GetDefaultOptions() { return sDefaultOptions; }
+	static void		SetDefaultOptions(UInt32 inOptions) { sDefaultOptions = inOptions; }
 
 //	Actions
 public:
@@ -85,6 +119,19 @@ public:
 	
 	virtual bool	IsFree() const;
 	virtual bool	IsOwnedByCurrentThread() const;
+	
+//	Statistics
+public:
+	UInt32			GetOptions() const { return mOptions; }
+	
+	//	These read the counters without taking the lock, so a snapshot may be slightly inconsistent.
+	//	They are all zero unless the mutex was created with kStatistics.
+	void			GetStatistics(Statistics& outStatistics) const;
+	void			ResetStatistics();
+	void			PrintStatistics(FILE* inFile) const;
+	
+	//	prints every mutex created with kStatistics that still exists, most contended first
+	static void		PrintAllStatistics(FILE* inFile);
 		
 //	Implementation
 protected:
@@ -96,6 +143,23 @@ protected:
 	UInt32			mOwner;
 	HANDLE			mMutex;
 #endif
+	
+	//	CAGuard calls these around the condition waits that release and retake the lock
+	void			StatisticsWillUnlock() { if((mOptions & kStatistics) != 0) { EndHold(); } }
+	void			StatisticsDidRelock();
+
+private:
+	void			InitMutex();
+	OSStatus		LockWithOptions();
+	void			EndHold();
+	
+	UInt32			mOptions;
+	UInt32			mSpinEstimate;			//	running average of the spins a contended Lock() needed
+	UInt64			mHoldStartTime;
+	Statistics		mStatistics;
+	CAMutex*		mNextWithStatistics;
+	
+	static UInt32	sDefaultOptions;
 
 //	Helper class to manage taking and releasing recursively
 public:
@@ -0,0 +1,319 @@
+/*
+     File: CAPartitionedConvolver.cpp 
+ Abstract:  CAPartitionedConvolver.h  
+  Version: 1.0.2 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2012 Apple Inc. All Rights Reserved. 
+  
+*/
+//=============================================================================
+//	Includes
+//=============================================================================
+
+#include "CAPartitionedConvolver.h"
+#include "CABitOperations.h"
+#include "CARealtimeThreadPool.h"
+#include <string.h>
+
+//=============================================================================
+//	CAPartitionedConvolver
+//=============================================================================
+
+static inline CADSPSplitComplex	StageSpectrum(Float32* inSpectra, UInt32 inIndex, UInt32 inBlockSize)
+{
+	CADSPSplitComplex spectrum;
+	spectrum.realp = inSpectra + 2 * inIndex * inBlockSize;
+	spectrum.imagp = spectrum.realp + inBlockSize;
+	return spectrum;
+}
+
+CAPartitionedConvolver::CAPartitionedConvolver(UInt32 inNumChannels, UInt32 inBlockSize, UInt32 inTailBlockSize)
+	: mNumChannels(inNumChannels),
+	  mBlockSize(NextPowerOfTwo(inBlockSize > 4 ? inBlockSize : 4)),
+	  mTailBlockSize(inTailBlockSize > 0 ? NextPowerOfTwo(std::max(inTailBlockSize, 2 * mBlockSize)) : 0),
+	  mBlockPos(0), mTailPos(0), mTailParity(0),
+	  mBodyFFT(Log2Ceil(2 * mBlockSize)),
+	  mTailPool(NULL), mForkedTailParity(0)
+{
+	if (mTailBlockSize > 0)
+		mTailFFT.set(new CAVectorDSP::RealFFT(Log2Ceil(2 * mTailBlockSize)));
+	mChannels.alloc(mNumChannels);
+	for (UInt32 i = 0; i < mNumChannels; ++i)
+		SetImpulseResponse(i, NULL, 0);
+}
+
+CAPartitionedConvolver::~CAPartitionedConvolver()
+{
+	SetUsesTailThread(false);
+}
+
+OSStatus	CAPartitionedConvolver::SetImpulseResponse(UInt32 inChannel, const Float32* inResponse, UInt32 inLength)
+{
+	if (inChannel >= mNumChannels || (inLength > 0 && inResponse == NULL))
+		return kAudio_ParamError;
+	
+	if (mTailPool)
+		mTailPool->Join();
+
+	Channel& channel = mChannels[inChannel];
+	channel.mLength = inLength;
+	
+	// the head holds the first block of taps reversed, so that each output sample is a dot product
+	// with the last block size input samples
+	UInt32 numHeadTaps = std::min(inLength, mBlockSize);
+	channel.mHead.alloc(mBlockSize, true);
+	for (UInt32 i = 0; i < numHeadTaps; ++i)
+		channel.mHead[mBlockSize - 1 - i] = inResponse[i];
+	
+	UInt32 bodyEnd = mTailBlockSize > 0 ? std::min(inLength, 2 * mTailBlockSize) : inLength;
+	UInt32 numBodyTaps = bodyEnd > mBlockSize ? bodyEnd - mBlockSize : 0;
+	AllocateStage(channel.mBody, mBlockSize, mBodyFFT, numBodyTaps > 0 ? inResponse + mBlockSize : NULL, numBodyTaps, mBlockSize);
+	
+	if (mTailBlockSize > 0) {
+		UInt32 numTailTaps = inLength > 2 * mTailBlockSize ? inLength - 2 * mTailBlockSize : 0;
+		AllocateStage(channel.mTail, mTailBlockSize, *mTailFFT(), numTailTaps > 0 ? inResponse + 2 * mTailBlockSize : NULL, numTailTaps, 2 * mTailBlockSize);
+		channel.mTailFill.alloc(numTailTaps > 0 ? mTailBlockSize : 0, true);
+	}
+	return noErr;
+}
+
+void	CAPartitionedConvolver::AllocateStage(Stage& ioStage, UInt32 inBlockSize, const CAVectorDSP::RealFFT& inFFT, const Float32* inTaps, UInt32 inNumTaps, UInt32 inOutputSize)
+{
+	UInt32 spectrumSize = 2 * inBlockSize;
+	ioStage.mNumPartitions = (inNumTaps + inBlockSize - 1) / inBlockSize;
+	ioStage.mInput.alloc(2 * inBlockSize, true);
+	if (ioStage.mNumPartitions == 0) {
+		ioStage.mResponse.free();
+		ioStage.mDelayLine.free();
+		ioStage.mAccumulator.free();
+		ioStage.mOutput.free();
+		return;
+	}
+	ioStage.mResponse.alloc(ioStage.mNumPartitions * spectrumSize, false);
+	ioStage.mDelayLine.alloc(ioStage.mNumPartitions * spectrumSize, false);
+	ioStage.mAccumulator.alloc(spectrumSize, false);
+	ioStage.mOutput.alloc(inOutputSize, false);
+	
+	// Each partition is zero padded to the FFT size. The forward FFT scales by 2 and the inverse by
+	// the FFT size, so a product of two spectra comes back 4 * FFT size too large; fold that in here.
+	Float32 scale = 0.25f / (Float32)(2 * inBlockSize);
+	Float32* padded = ioStage.mInput();
+	for (UInt32 i = 0; i < ioStage.mNumPartitions; ++i) {
+		UInt32 first = i * inBlockSize;
+		UInt32 numTaps = std::min(inBlockSize, inNumTaps - first);
+		memset(padded, 0, 2 * inBlockSize * sizeof(Float32));
+		memcpy(padded, inTaps + first, numTaps * sizeof(Float32));
+		
+		CADSPSplitComplex response = StageSpectrum(ioStage.mResponse(), i, inBlockSize);
+		CAVectorDSP::Deinterleave(padded, response, inBlockSize);
+		inFFT.Forward(response);
+		CAVectorDSP::Scale(response.realp, scale, response.realp, spectrumSize);
+	}
+	ResetStage(ioStage, inBlockSize, inOutputSize);
+}
+
+void	CAPartitionedConvolver::ResetStage(Stage& ioStage, UInt32 inBlockSize, UInt32 inOutputSize)
+{
+	memset(ioStage.mInput(), 0, 2 * inBlockSize * sizeof(Float32));
+	if (ioStage.mNumPartitions == 0)
+		return;
+	ioStage.mDelayPos = 0;
+	memset(ioStage.mDelayLine(), 0, ioStage.mNumPartitions * 2 * inBlockSize * sizeof(Float32));
+	memset(ioStage.mOutput(), 0, inOutputSize * sizeof(Float32));
+}
+
+void	CAPartitionedConvolver::SetUsesTailThread(bool inUsesTailThread)
+{
+	if (inUsesTailThread && mTailPool == NULL && mTailBlockSize > 0) {
+		mTailPool = new CARealtimeThreadPool(1);
+		if (mTailPool->GetNumWorkers() == 0) {
+			delete mTailPool;
+			mTailPool = NULL;
+		}
+	} else if (!inUsesTailThread && mTailPool != NULL) {
+		// the pool joins a tail block in progress before it goes
+		delete mTailPool;
+		mTailPool = NULL;
+	}
+}
+
+void	CAPartitionedConvolver::Reset()
+{
+	if (mTailPool)
+		mTailPool->Join();
+	mBlockPos = 0;
+	mTailPos = 0;
+	mTailParity = 0;
+	for (UInt32 i = 0; i < mNumChannels; ++i) {
+		Channel& channel = mChannels[i];
+		ResetStage(channel.mBody, mBlockSize, mBlockSize);
+		if (mTailBlockSize > 0) {
+			ResetStage(channel.mTail, mTailBlockSize, 2 * mTailBlockSize);
+			if (channel.mTail.mNumPartitions > 0)
+				memset(channel.mTailFill(), 0, mTailBlockSize * sizeof(Float32));
+		}
+	}
+}
+
+void	CAPartitionedConvolver::Process(UInt32 inNumFrames, const AudioBufferList* inInput, AudioBufferList* outOutput)
+{
+	// work up to the next block boundary at a time; tail block boundaries are also block boundaries
+	UInt32 frame = 0;
+	while (frame < inNumFrames) {
+		UInt32 numFrames = std::min(inNumFrames - frame, mBlockSize - mBlockPos);
+		for (UInt32 i = 0; i < mNumChannels; ++i)
+			ProcessChannel(mChannels[i], (const Float32*)inInput->mBuffers[i].mData + frame, (Float32*)outOutput->mBuffers[i].mData + frame, numFrames);
+		frame += numFrames;
+		mBlockPos += numFrames;
+		if (mTailBlockSize > 0)
+			mTailPos += numFrames;
+		
+		if (mBlockPos == mBlockSize) {
+			for (UInt32 i = 0; i < mNumChannels; ++i) {
+				Channel& channel = mChannels[i];
+				if (channel.mBody.mNumPartitions > 0)
+					RunStage(channel.mBody, mBlockSize, mBodyFFT, channel.mBody.mOutput());
+				memcpy(channel.mBody.mInput(), channel.mBody.mInput() + mBlockSize, mBlockSize * sizeof(Float32));
+			}
+			mBlockPos = 0;
+		}
+		if (mTailBlockSize > 0 && mTailPos == mTailBlockSize) {
+			EndTailBlock();
+			mTailPos = 0;
+		}
+	}
+}
+
+void	CAPartitionedConvolver::ProcessChannel(Channel& ioChannel, const Float32* inInput, Float32* outOutput, UInt32 inNumFrames)
+{
+	// take the input first, so that the output may overwrite it
+	Float32* history = ioChannel.mBody.mInput();
+	memcpy(history + mBlockSize + mBlockPos, inInput, inNumFrames * sizeof(Float32));
+	if (ioChannel.mTail.mNumPartitions > 0)
+		memcpy(ioChannel.mTailFill() + mTailPos, inInput, inNumFrames * sizeof(Float32));
+	
+	if (ioChannel.mLength == 0) {
+		memset(outOutput, 0, inNumFrames * sizeof(Float32));
+		return;
+	}
+	
+	const Float32* head = ioChannel.mHead();
+	for (UInt32 i = 0; i < inNumFrames; ++i)
+		outOutput[i] = CAVectorDSP::DotProduct(history + mBlockPos + i + 1, head, mBlockSize);
+	
+	if (ioChannel.mBody.mNumPartitions > 0)
+		CAVectorDSP::Add(outOutput, ioChannel.mBody.mOutput() + mBlockPos, outOutput, inNumFrames);
+	if (ioChannel.mTail.mNumPartitions > 0)
+		CAVectorDSP::Add(outOutput, ioChannel.mTail.mOutput() + mTailParity * mTailBlockSize + mTailPos, outOutput, inNumFrames);
+}
+
+void	CAPartitionedConvolver::RunStage(Stage& ioStage, UInt32 inBlockSize, const CAVectorDSP::RealFFT& inFFT, Float32* outBlock)
+{
+	// the spectrum of the last two blocks replaces the oldest one in the delay line
+	UInt32 numPartitions = ioStage.mNumPartitions;
+	ioStage.mDelayPos = (ioStage.mDelayPos + 1 < numPartitions) ? ioStage.mDelayPos + 1 : 0;
+	CADSPSplitComplex input = StageSpectrum(ioStage.mDelayLine(), ioStage.mDelayPos, inBlockSize);
+	CAVectorDSP::Deinterleave(ioStage.mInput(), input, inBlockSize);
+	inFFT.Forward(input);
+	
+	// sum the delayed input spectra times the partition spectra, newest with the first partition.
+	// Bin 0 packs the real DC and Nyquist bins, which are multiplied separately.
+	CADSPSplitComplex sum = StageSpectrum(ioStage.mAccumulator(), 0, inBlockSize);
+	memset(ioStage.mAccumulator(), 0, 2 * inBlockSize * sizeof(Float32));
+	Float32 dc = 0.f, nyquist = 0.f;
+	UInt32 slot = ioStage.mDelayPos;
+	for (UInt32 i = 0; i < numPartitions; ++i) {
+		CADSPSplitComplex delayed = StageSpectrum(ioStage.mDelayLine(), slot, inBlockSize);
+		CADSPSplitComplex response = StageSpectrum(ioStage.mResponse(), i, inBlockSize);
+		dc += delayed.realp[0] * response.realp[0];
+		nyquist += delayed.imagp[0] * response.imagp[0];
+		CAVectorDSP::ComplexMultiplyAdd(delayed, response, sum, sum, inBlockSize);
+		slot = (slot > 0) ? slot - 1 : numPartitions - 1;
+	}
+	sum.realp[0] = dc;
+	sum.imagp[0] = nyquist;
+	
+	// overlap-save: only the second half of the circular convolution is valid
+	inFFT.Inverse(sum);
+	UInt32 half = inBlockSize >> 1;
+	CADSPSplitComplex secondHalf = { sum.realp + half, sum.imagp + half };
+	CAVectorDSP::Interleave(secondHalf, outBlock, half);
+}
+
+void	CAPartitionedConvolver::EndTailBlock()
+{
+	// the block before this one must be done: its output plays from now on. Join() finishes on this
+	// thread whatever the worker has not started.
+	if (mTailPool)
+		mTailPool->Join();
+	for (UInt32 i = 0; i < mNumChannels; ++i) {
+		Channel& channel = mChannels[i];
+		if (channel.mTail.mNumPartitions > 0) {
+			Float32* input = channel.mTail.mInput();
+			memcpy(input, input + mTailBlockSize, mTailBlockSize * sizeof(Float32));
+			memcpy(input + mTailBlockSize, channel.mTailFill(), mTailBlockSize * sizeof(Float32));
+		}
+	}
+	
+	// this block's output plays from the tail block after next, in the half that has just finished
+	mForkedTailParity = mTailParity;
+	if (mTailPool == NULL || mTailPool->Fork(RunTailTask, this, mNumChannels) != noErr)
+		RunTail(mTailParity);
+	mTailParity ^= 1;
+}
+
+void	CAPartitionedConvolver::RunTail(UInt32 inParity)
+{
+	for (UInt32 i = 0; i < mNumChannels; ++i)
+		RunTailChannel(mChannels[i], inParity);
+}
+
+void	CAPartitionedConvolver::RunTailChannel(Channel& ioChannel, UInt32 inParity)
+{
+	if (ioChannel.mTail.mNumPartitions > 0)
+		RunStage(ioChannel.mTail, mTailBlockSize, *mTailFFT(), ioChannel.mTail.mOutput() + inParity * mTailBlockSize);
+}
+
+void	CAPartitionedConvolver::RunTailTask(void* inRefCon, UInt32 inChannel, UInt32 /*inThreadIndex*/)
+{
+	CAPartitionedConvolver* THIS = static_cast<CAPartitionedConvolver*>(inRefCon);
+	THIS->RunTailChannel(THIS->mChannels[inChannel], THIS->mForkedTailParity);
+}
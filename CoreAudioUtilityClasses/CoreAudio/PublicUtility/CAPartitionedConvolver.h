@@ -0,0 +1,159 @@
+/*
+     File: CAPartitionedConvolver.h 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.2 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2012 Apple Inc. All Rights Reserved. 
+  
+*/
+#ifndef __CAPartitionedConvolver_h__
+#define __CAPartitionedConvolver_h__
+
+#include <TargetConditionals.h>
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <CoreAudio/CoreAudioTypes.h>
+#else
+	#include <CoreAudioTypes.h>
+#endif
+#include "CAAutoDisposer.h"
+#include "CAVectorDSP.h"
+
+class CARealtimeThreadPool;
+
+//	CAPartitionedConvolver convolves each channel with its own impulse response, without latency.
+//
+//	The response is split into three parts:
+//	- the first block of taps is applied directly, sample by sample (the head);
+//	- the taps up to twice the tail block size are applied by uniformly partitioned overlap-save
+//	  convolution in blocks of the block size, on the render thread at every block boundary (the body);
+//	- the rest is applied in partitions of the tail block size (the tail). A tail block's output is not
+//	  needed until a whole tail block after its input is complete, so it can be forked to a
+//	  CARealtimeThreadPool worker (see SetUsesTailThread) and joined at the next tail block boundary;
+//	  otherwise it is computed inline at the tail block boundary.
+//	Each partitioned stage keeps the spectra of its partitions and a frequency-domain delay line of
+//	input spectra, so a block costs one forward FFT, one complex multiply-add per partition and one
+//	inverse FFT. A tail block size of 0 leaves the whole response to the body (uniform partitioning).
+
+class CAPartitionedConvolver
+{
+public:
+	enum {
+		kDefaultBlockSize = 64,
+		kDefaultTailBlockSize = 2048
+	};
+
+	// the block sizes are rounded up to powers of two, and the tail block size to at least twice the block size
+							CAPartitionedConvolver(UInt32 inNumChannels, UInt32 inBlockSize = kDefaultBlockSize, UInt32 inTailBlockSize = kDefaultTailBlockSize);
+							~CAPartitionedConvolver();
+	
+	// Precomputes the partition spectra and resets the channel. Not real-time safe, and it must not be
+	// called while Process is running. A length of 0 silences the channel.
+	OSStatus				SetImpulseResponse(UInt32 inChannel, const Float32* inResponse, UInt32 inLength);
+	
+	// Computes the tail partitions on a worker thread. Not real-time safe; does nothing if there is no
+	// tail stage or CARealtimeThreadPool has no workers on this platform.
+	void					SetUsesTailThread(bool inUsesTailThread);
+	bool					UsesTailThread() const { return mTailPool != NULL; }
+	
+	void					Reset();
+	
+	// inInput and outOutput may be the same buffers
+	void					Process(UInt32 inNumFrames, const AudioBufferList* inInput, AudioBufferList* outOutput);
+
+	UInt32					NumChannels() const { return mNumChannels; }
+	UInt32					BlockSize() const { return mBlockSize; }
+	UInt32					TailBlockSize() const { return mTailBlockSize; }
+	UInt32					ImpulseResponseLength(UInt32 inChannel) const { return mChannels[inChannel].mLength; }
+	
+private:
+							CAPartitionedConvolver(const CAPartitionedConvolver&);
+	CAPartitionedConvolver&	operator=(const CAPartitionedConvolver&);
+
+	// Uniformly partitioned overlap-save convolution. A spectrum of a 2 * block size FFT is block size
+	// split complex pairs, stored as block size real parts followed by block size imaginary parts.
+	struct Stage
+	{
+		UInt32				mNumPartitions;
+		UInt32				mDelayPos;			// slot of the newest input spectrum
+		CAAutoFree<Float32>	mResponse;			// partition spectra, with the FFT scaling folded in
+		CAAutoFree<Float32>	mDelayLine;			// input spectra of the last mNumPartitions blocks
+		CAAutoFree<Float32>	mInput;				// 2 * block size: the previous block and the current one
+		CAAutoFree<Float32>	mAccumulator;		// one spectrum
+		CAAutoFree<Float32>	mOutput;			// body: one block; tail: two, alternating
+		
+		Stage() : mNumPartitions(0), mDelayPos(0) {}
+	};
+	
+	struct Channel
+	{
+		UInt32				mLength;
+		CAAutoFree<Float32>	mHead;				// block size taps, time reversed
+		Stage				mBody;				// its mInput is also the head's history
+		Stage				mTail;
+		CAAutoFree<Float32>	mTailFill;			// the tail block being gathered
+		
+		Channel() : mLength(0) {}
+	};
+	
+	void					AllocateStage(Stage& ioStage, UInt32 inBlockSize, const CAVectorDSP::RealFFT& inFFT, const Float32* inTaps, UInt32 inNumTaps, UInt32 inOutputSize);
+	void					ResetStage(Stage& ioStage, UInt32 inBlockSize, UInt32 inOutputSize);
+	void					RunStage(Stage& ioStage, UInt32 inBlockSize, const CAVectorDSP::RealFFT& inFFT, Float32* outBlock);
+	void					ProcessChannel(Channel& ioChannel, const Float32* inInput, Float32* outOutput, UInt32 inNumFrames);
+	void					EndTailBlock();
+	void					RunTail(UInt32 inParity);
+	void					RunTailChannel(Channel& ioChannel, UInt32 inParity);
+	static void				RunTailTask(void* inRefCon, UInt32 inChannel, UInt32 inThreadIndex);
+	
+	UInt32					mNumChannels;
+	UInt32					mBlockSize;
+	UInt32					mTailBlockSize;
+	UInt32					mBlockPos;
+	UInt32					mTailPos;
+	UInt32					mTailParity;		// which half of each tail mOutput is being played
+	CAVectorDSP::RealFFT	mBodyFFT;
+	CAAutoDelete<CAVectorDSP::RealFFT>	mTailFFT;
+	CAAutoArrayDelete<Channel>			mChannels;
+	
+	CARealtimeThreadPool*	mTailPool;			// one worker, one task per channel
+	UInt32					mForkedTailParity;
+};
+
+#endif // __CAPartitionedConvolver_h__
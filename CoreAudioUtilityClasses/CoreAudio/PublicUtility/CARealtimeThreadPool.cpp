@@ -0,0 +1,395 @@
+/*
+     File: CARealtimeThreadPool.cpp 
+ Abstract:  CARealtimeThreadPool.h  
+  Version: 1.0.2 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2012 Apple Inc. All Rights Reserved. 
+  
+*/
+//=============================================================================
+//	Includes
+//=============================================================================
+
+#include "CARealtimeThreadPool.h"
+#include "CAAtomic.h"
+#include "CAHostTimeBase.h"
+#include <algorithm>
+#include <stdint.h>
+#include <stdlib.h>
+
+#if TARGET_OS_MAC
+	#include "CAPThread.h"
+	#include <mach/mach.h>
+	#include <mach/semaphore.h>
+	#include <unistd.h>
+#endif
+
+static const UInt32 kCacheLineSize = 64;
+
+// how many times Run() polls for the workers to finish before sleeping on the done semaphore; the last
+// worker signals it either way, so a wait that follows a successful spin returns without sleeping
+static const UInt32 kDoneSpinCount = 4096;
+
+static inline SInt32	PackRange(UInt32 inBegin, UInt32 inEnd)	{ return SInt32(inBegin | (inEnd << 16)); }
+static inline UInt32	RangeBegin(SInt32 inRange)				{ return UInt32(inRange) & 0xFFFF; }
+static inline UInt32	RangeEnd(SInt32 inRange)				{ return UInt32(inRange) >> 16; }
+
+//=============================================================================
+//	CARealtimeThreadPool::Worker
+//=============================================================================
+
+#if TARGET_OS_MAC
+// Sleeps on its own semaphore between jobs. Once woken it takes the tasks of its own queue, steals
+// from the others until none are left and then checks out of the job.
+class CARealtimeThreadPool::Worker
+{
+public:
+	Worker(CARealtimeThreadPool& inPool, UInt32 inThreadIndex, semaphore_t inDoneSemaphore, UInt32 inPeriod, UInt32 inComputation, UInt32 inConstraint);
+	~Worker();
+	
+	bool			IsValid() const { return mStartSemaphore != SEMAPHORE_NULL; }
+	void			Wake() { semaphore_signal(mStartSemaphore); }
+
+private:
+	static void*	Entry(void* inRefCon);
+	void			Loop();
+
+	CARealtimeThreadPool&	mPool;
+	UInt32					mThreadIndex;
+	semaphore_t				mStartSemaphore;
+	semaphore_t				mDoneSemaphore;
+	CAPThread				mThread;
+	volatile bool			mQuit;
+};
+
+CARealtimeThreadPool::Worker::Worker(CARealtimeThreadPool& inPool, UInt32 inThreadIndex, semaphore_t inDoneSemaphore, UInt32 inPeriod, UInt32 inComputation, UInt32 inConstraint)
+	: mPool(inPool), mThreadIndex(inThreadIndex), mStartSemaphore(SEMAPHORE_NULL), mDoneSemaphore(inDoneSemaphore),
+	  mThread(Entry, this, kFixedThreadPriority, true, false, "CARealtimeThreadPool"),
+	  mQuit(false)
+{
+	if (inPeriod > 0)
+		mThread.SetTimeConstraints(inPeriod, inComputation, inConstraint, true);
+	if (semaphore_create(mach_task_self(), &mStartSemaphore, SYNC_POLICY_FIFO, 0) != KERN_SUCCESS)
+		mStartSemaphore = SEMAPHORE_NULL;
+	if (IsValid())
+		mThread.Start();
+}
+
+CARealtimeThreadPool::Worker::~Worker()
+{
+	if (mThread.IsRunning()) {
+		mQuit = true;
+		semaphore_signal(mStartSemaphore);
+		while (mThread.IsRunning())
+			usleep(1000);
+	}
+	if (mStartSemaphore != SEMAPHORE_NULL)
+		semaphore_destroy(mach_task_self(), mStartSemaphore);
+}
+
+void*	CARealtimeThreadPool::Worker::Entry(void* inRefCon)
+{
+	static_cast<Worker*>(inRefCon)->Loop();
+	return NULL;
+}
+
+void	CARealtimeThreadPool::Worker::Loop()
+{
+	while (true) {
+		semaphore_wait(mStartSemaphore);
+		if (mQuit)
+			break;
+		mPool.Work(mThreadIndex);
+		if (CAAtomicDecrement32Barrier(&mPool.mActiveWorkers) == 0)
+			semaphore_signal(mDoneSemaphore);
+	}
+}
+
+//=============================================================================
+//	CARealtimeThreadPool::WorkerSet
+//=============================================================================
+
+class CARealtimeThreadPool::WorkerSet
+{
+public:
+	WorkerSet(CARealtimeThreadPool& inPool, UInt32 inNumWorkers, UInt32 inPeriod, UInt32 inComputation, UInt32 inConstraint);
+	~WorkerSet();
+	
+	UInt32			NumWorkers() const { return mNumWorkers; }
+	void			Wake(UInt32 inNumWorkers) { for (UInt32 i = 0; i < inNumWorkers; ++i) mWorkers[i]->Wake(); }
+	void			WaitUntilDone() { semaphore_wait(mDoneSemaphore); }
+
+private:
+	Worker**		mWorkers;
+	UInt32			mNumWorkers;
+	semaphore_t		mDoneSemaphore;
+};
+
+CARealtimeThreadPool::WorkerSet::WorkerSet(CARealtimeThreadPool& inPool, UInt32 inNumWorkers, UInt32 inPeriod, UInt32 inComputation, UInt32 inConstraint)
+	: mWorkers(NULL), mNumWorkers(0), mDoneSemaphore(SEMAPHORE_NULL)
+{
+	if (inNumWorkers == 0 || semaphore_create(mach_task_self(), &mDoneSemaphore, SYNC_POLICY_FIFO, 0) != KERN_SUCCESS) {
+		mDoneSemaphore = SEMAPHORE_NULL;
+		return;
+	}
+	
+	// keep as many workers as could be started; the pool simply has fewer
+	mWorkers = new Worker*[inNumWorkers];
+	while (mNumWorkers < inNumWorkers) {
+		Worker* worker = new Worker(inPool, mNumWorkers + 1, mDoneSemaphore, inPeriod, inComputation, inConstraint);
+		if (!worker->IsValid()) {
+			delete worker;
+			break;
+		}
+		mWorkers[mNumWorkers++] = worker;
+	}
+}
+
+CARealtimeThreadPool::WorkerSet::~WorkerSet()
+{
+	for (UInt32 i = 0; i < mNumWorkers; ++i)
+		delete mWorkers[i];
+	delete[] mWorkers;
+	if (mDoneSemaphore != SEMAPHORE_NULL)
+		semaphore_destroy(mach_task_self(), mDoneSemaphore);
+}
+#endif
+
+//=============================================================================
+//	CARealtimeThreadPool
+//=============================================================================
+
+CARealtimeThreadPool::CARealtimeThreadPool(UInt32 inNumWorkers, UInt32 inPeriod, UInt32 inComputation, UInt32 inConstraint)
+	: mNumWorkers(0), mWorkerSet(NULL), mQueueStorage(NULL), mQueues(NULL),
+	  mProc(NULL), mRefCon(NULL), mBusy(0), mActiveWorkers(0), mNumWoken(0), mForked(false),
+	  mDeadlineCycles(0), mMissedDeadlines(0), mMaxOverrunNanos(0)
+{
+#if TARGET_OS_MAC
+	mWorkerSet = new WorkerSet(*this, inNumWorkers, inPeriod, inComputation, inConstraint);
+	mNumWorkers = mWorkerSet->NumWorkers();
+#else
+	// no workers: every task runs on the thread that calls Run()
+	(void)inNumWorkers; (void)inPeriod; (void)inComputation; (void)inConstraint;
+#endif
+
+	// one queue per thread, each on its own cache line so that claiming tasks does not false share
+	const UInt32 numQueues = mNumWorkers + 1;
+	mQueueStorage = malloc(numQueues * sizeof(Queue) + kCacheLineSize);
+	mQueues = reinterpret_cast<Queue*>((reinterpret_cast<uintptr_t>(mQueueStorage) + kCacheLineSize - 1) & ~uintptr_t(kCacheLineSize - 1));
+	for (UInt32 i = 0; i < numQueues; ++i)
+		mQueues[i].mRange = PackRange(0, 0);
+}
+
+CARealtimeThreadPool::~CARealtimeThreadPool()
+{
+	Join();
+#if TARGET_OS_MAC
+	delete mWorkerSet;
+#endif
+	free(mQueueStorage);
+}
+
+UInt32	CARealtimeThreadPool::DefaultNumWorkers()
+{
+#if TARGET_OS_MAC
+	long numProcessors = sysconf(_SC_NPROCESSORS_ONLN);
+	return (numProcessors > 1) ? UInt32(numProcessors - 1) : 0;
+#else
+	return 0;
+#endif
+}
+
+OSStatus	CARealtimeThreadPool::Run(TaskProc inProc, void* inRefCon, UInt32 inNumTasks, UInt64 inDeadline)
+{
+	if (inProc == NULL || inNumTasks > kMaxTasksPerRun)
+		return kAudio_ParamError;
+	
+	// the workers, and thread index 0, belong to the Run() in progress
+	if (!CAAtomicCompareAndSwap32Barrier(0, 1, &mBusy))
+		return kAudio_ParamError;
+	
+	if (std::min(mNumWorkers + 1, inNumTasks) <= 1) {
+		for (UInt32 i = 0; i < inNumTasks; ++i)
+			inProc(inRefCon, i, 0);
+		if (inDeadline != 0)
+			NoteDeadline(inDeadline);
+		CAMemoryBarrier();
+		mBusy = 0;
+	} else {
+		Start(inProc, inRefCon, inNumTasks, 0);
+		Finish(inDeadline);
+	}
+	return noErr;
+}
+
+OSStatus	CARealtimeThreadPool::Fork(TaskProc inProc, void* inRefCon, UInt32 inNumTasks)
+{
+	if (inProc == NULL || inNumTasks > kMaxTasksPerRun)
+		return kAudio_ParamError;
+	if (!CAAtomicCompareAndSwap32Barrier(0, 1, &mBusy))
+		return kAudio_ParamError;
+	
+	mForked = true;
+	Start(inProc, inRefCon, inNumTasks, 1);
+	return noErr;
+}
+
+void	CARealtimeThreadPool::Join(UInt64 inDeadline)
+{
+	if (!mForked)
+		return;
+	mForked = false;
+	Finish(inDeadline);
+}
+
+// called with mBusy set; the tasks are spread over the threads from inFirstThread on, or left to
+// thread 0 if there are none
+void	CARealtimeThreadPool::Start(TaskProc inProc, void* inRefCon, UInt32 inNumTasks, UInt32 inFirstThread)
+{
+	mProc = inProc;
+	mRefCon = inRefCon;
+	
+	UInt32 numRanges = std::min(mNumWorkers + 1 - inFirstThread, inNumTasks);
+	if (numRanges == 0) {
+		inFirstThread = 0;
+		numRanges = 1;
+	}
+	
+	// thread inFirstThread + i starts with the i-th of numRanges contiguous ranges; the queues of the
+	// threads that are not needed stay empty
+	for (UInt32 i = 0; i <= mNumWorkers; ++i) {
+		if (i >= inFirstThread && i < inFirstThread + numRanges) {
+			UInt32 range = i - inFirstThread;
+			mQueues[i].mRange = PackRange(UInt32(UInt64(range) * inNumTasks / numRanges), UInt32(UInt64(range + 1) * inNumTasks / numRanges));
+		} else
+			mQueues[i].mRange = PackRange(0, 0);
+	}
+	
+	mNumWoken = inFirstThread + numRanges - 1;
+	mActiveWorkers = mNumWoken;
+	CAMemoryBarrier();
+#if TARGET_OS_MAC
+	mWorkerSet->Wake(mNumWoken);
+#endif
+}
+
+void	CARealtimeThreadPool::Finish(UInt64 inDeadline)
+{
+	Work(0);
+	
+	// every task has been claimed, but the workers may still be running theirs, and a worker that
+	// wakes late must not find the next job's queues with this job's task proc. They are usually
+	// about to finish, so spin briefly before sleeping.
+	if (mNumWoken > 0) {
+		for (UInt32 spin = 0; mActiveWorkers > 0 && spin < kDoneSpinCount; ++spin)
+			CAMemoryBarrier();
+#if TARGET_OS_MAC
+		mWorkerSet->WaitUntilDone();
+#endif
+	}
+	
+	if (inDeadline != 0)
+		NoteDeadline(inDeadline);
+	
+	CAMemoryBarrier();
+	mBusy = 0;
+}
+
+bool	CARealtimeThreadPool::TakeTask(Queue& ioQueue, UInt32& outTask)
+{
+	while (true) {
+		SInt32 range = ioQueue.mRange;
+		UInt32 begin = RangeBegin(range), end = RangeEnd(range);
+		if (begin >= end)
+			return false;
+		if (CAAtomicCompareAndSwap32Barrier(range, PackRange(begin + 1, end), &ioQueue.mRange)) {
+			outTask = begin;
+			return true;
+		}
+	}
+}
+
+bool	CARealtimeThreadPool::StealTask(Queue& ioQueue, UInt32& outTask)
+{
+	while (true) {
+		SInt32 range = ioQueue.mRange;
+		UInt32 begin = RangeBegin(range), end = RangeEnd(range);
+		if (begin >= end)
+			return false;
+		if (CAAtomicCompareAndSwap32Barrier(range, PackRange(begin, end - 1), &ioQueue.mRange)) {
+			outTask = end - 1;
+			return true;
+		}
+	}
+}
+
+void	CARealtimeThreadPool::Work(UInt32 inThreadIndex)
+{
+	const UInt32 numQueues = mNumWorkers + 1;
+	UInt32 task;
+	
+	// own tasks in order from the front, for locality, then steal from the backs of the others
+	while (TakeTask(mQueues[inThreadIndex], task))
+		mProc(mRefCon, task, inThreadIndex);
+	
+	for (UInt32 i = 1; i < numQueues; ++i) {
+		Queue& victim = mQueues[(inThreadIndex + i) % numQueues];
+		while (StealTask(victim, task))
+			mProc(mRefCon, task, inThreadIndex);
+	}
+}
+
+void	CARealtimeThreadPool::NoteDeadline(UInt64 inDeadline)
+{
+	UInt64 now = CAHostTimeBase::GetTheCurrentTime();
+	++mDeadlineCycles;
+	if (now > inDeadline) {
+		++mMissedDeadlines;
+		mMaxOverrunNanos = std::max(mMaxOverrunNanos, CAHostTimeBase::AbsoluteHostDeltaToNanos(inDeadline, now));
+	}
+}
+
+void	CARealtimeThreadPool::ResetDeadlineStatistics()
+{
+	mDeadlineCycles = 0;
+	mMissedDeadlines = 0;
+	mMaxOverrunNanos = 0;
+}
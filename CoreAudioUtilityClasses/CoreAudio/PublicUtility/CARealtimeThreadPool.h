@@ -0,0 +1,159 @@
+/*
+     File: CARealtimeThreadPool.h 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.2 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2012 Apple Inc. All Rights Reserved. 
+  
+*/
+#ifndef __CARealtimeThreadPool_h__
+#define __CARealtimeThreadPool_h__
+
+#include <TargetConditionals.h>
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <CoreAudio/CoreAudioTypes.h>
+#else
+	#include <CoreAudioTypes.h>
+#endif
+
+//	CARealtimeThreadPool runs the parallel parts of a render on a fixed set of real-time worker threads.
+//
+//	Run() is a fork/join: it splits tasks 0 ... n-1 of a job into contiguous ranges, one per thread,
+//	wakes the workers, works through the calling thread's own range and then steals from the others,
+//	and returns when every task has finished. Each range is a cache line sized queue whose owner takes
+//	tasks from the front while other threads steal from the back, both with a single compare-and-swap,
+//	so Run() neither allocates nor takes a lock and can be called from an IO proc or render callback.
+//	The only wait is for the workers that were woken to finish: a short spin, then a semaphore.
+//
+//	The workers are CAPThreads, created up front with the time constraints of the render cycle (or at a
+//	fixed real-time priority), and they sleep between jobs. When Run() is given a deadline it counts the
+//	cycles that finished after it, so the cost of a parallel render can be checked against the IO cycle.
+//	The workers need Mach semaphores; on other platforms there are none and Run() runs every task on the
+//	calling thread.
+//
+//	Fork() and Join() split Run() in two, for work that can overlap the caller's own, like a convolution
+//	tail that is due a block later: Fork() hands the tasks to the workers and returns, and Join() takes
+//	whatever they have not started and returns once every task has finished.
+
+class CARealtimeThreadPool
+{
+public:
+	// inThreadIndex is 0 on the thread that called Run() and 1 ... GetNumWorkers() on the workers, for
+	// tasks that need per-thread scratch space
+	typedef void			(*TaskProc)(void* inRefCon, UInt32 inTaskIndex, UInt32 inThreadIndex);
+	
+	enum {
+		kMaxTasksPerRun = 0xFFFF,
+		kFixedThreadPriority = 47
+	};
+	
+	// The time constraints are in host time units, as for CAPThread::SetTimeConstraints(); an inPeriod of
+	// 0 creates fixed priority workers instead. Not real-time safe.
+							CARealtimeThreadPool(UInt32 inNumWorkers, UInt32 inPeriod = 0, UInt32 inComputation = 0, UInt32 inConstraint = 0);
+							~CARealtimeThreadPool();
+	
+	// one less than the number of processors, so that the calling thread has one to itself
+	static UInt32			DefaultNumWorkers();
+	
+	UInt32					GetNumWorkers() const { return mNumWorkers; }
+	
+	// Runs inProc for every task index below inNumTasks and returns once they have all finished. Only one
+	// Run() can be in progress: one made concurrently, or from inside a task, returns kAudio_ParamError
+	// without running anything. inDeadline is a host time by which the job should be done, or 0 to leave
+	// it out of the deadline statistics.
+	OSStatus				Run(TaskProc inProc, void* inRefCon, UInt32 inNumTasks, UInt64 inDeadline = 0);
+	
+	// Starts a job on the workers alone and returns at once; with no workers, the whole job waits for
+	// Join(). Every successful Fork() must be followed by a Join() from the same thread, and the pool can
+	// run nothing else in between: Run() and Fork() return kAudio_ParamError until then.
+	OSStatus				Fork(TaskProc inProc, void* inRefCon, UInt32 inNumTasks);
+	// Finishes the job started by Fork(), on the calling thread if need be. Does nothing if none was.
+	void					Join(UInt64 inDeadline = 0);
+	bool					IsForked() const { return mForked; }
+	
+	// Deadline statistics, covering the Run() calls that were given a deadline. They are written only by
+	// the thread calling Run(), so another thread may see them slightly out of date.
+	UInt64					GetDeadlineCycleCount() const { return mDeadlineCycles; }
+	UInt64					GetMissedDeadlineCount() const { return mMissedDeadlines; }
+	Float64					GetMissedDeadlineFraction() const { return (mDeadlineCycles > 0) ? Float64(mMissedDeadlines) / Float64(mDeadlineCycles) : 0.0; }
+	UInt64					GetMaxDeadlineOverrunNanos() const { return mMaxOverrunNanos; }
+	void					ResetDeadlineStatistics();
+
+private:
+							CARealtimeThreadPool(const CARealtimeThreadPool&);
+	CARealtimeThreadPool&	operator=(const CARealtimeThreadPool&);
+
+	// the unclaimed tasks [begin, end) of one thread's range, packed as begin | end << 16
+	struct Queue
+	{
+		volatile SInt32		mRange;
+		char				mPad[64 - sizeof(SInt32)];
+	};
+	
+	void					Start(TaskProc inProc, void* inRefCon, UInt32 inNumTasks, UInt32 inFirstThread);
+	void					Finish(UInt64 inDeadline);
+	bool					TakeTask(Queue& ioQueue, UInt32& outTask);
+	bool					StealTask(Queue& ioQueue, UInt32& outTask);
+	void					Work(UInt32 inThreadIndex);
+	void					NoteDeadline(UInt64 inDeadline);
+
+	class Worker;
+	friend class Worker;
+	class WorkerSet;
+	
+	UInt32					mNumWorkers;
+	WorkerSet*				mWorkerSet;			// the threads and their semaphores
+	void*					mQueueStorage;
+	Queue*					mQueues;			// mNumWorkers + 1, cache line aligned
+	
+	TaskProc				mProc;
+	void*					mRefCon;
+	volatile SInt32			mBusy;
+	volatile SInt32			mActiveWorkers;		// woken workers that have not yet finished the job
+	UInt32					mNumWoken;			// workers woken for the job in progress
+	bool					mForked;			// the job in progress was started by Fork()
+	
+	UInt64					mDeadlineCycles;
+	UInt64					mMissedDeadlines;
+	UInt64					mMaxOverrunNanos;
+};
+
+#endif // __CARealtimeThreadPool_h__
@@ -52,10 +52,15 @@
 #include <stdlib.h>
 #include <string.h>
 #include <algorithm>
+#include <math.h>
 #include <libkern/OSAtomic.h>
 
+#if TARGET_CPU_X86 || TARGET_CPU_X86_64
+	#include <emmintrin.h>
+#endif
+
 CARingBuffer::CARingBuffer() :
-	mBuffers(NULL), mNumberChannels(0), mCapacityFrames(0), mCapacityBytes(0)
+	mBuffers(NULL), mNumberChannels(0), mNumberBuffers(0), mInterleaved(false), mCapacityFrames(0), mCapacityBytes(0)
 {
 
 }
@@ -66,25 +71,32 @@ CARingBuffer::~CARingBuffer()
 }
 
 
-void	CARingBuffer::Allocate(int nChannels, UInt32 bytesPerFrame, UInt32 capacityFrames)
+void	CARingBuffer::Allocate(int nChannels, UInt32 bytesPerFrame, UInt32 capacityFrames, bool interleaved)
 {
 	Deallocate();
 	
 	capacityFrames = NextPowerOfTwo(capacityFrames);
 	
+	// an interleaved ring is stored as a single buffer whose frames hold every channel
+	int nBuffers = interleaved ? 1 : nChannels;
+	if (interleaved)
+		bytesPerFrame *= nChannels;
+	
 	mNumberChannels = nChannels;
+	mNumberBuffers = nBuffers;
+	mInterleaved = interleaved;
 	mBytesPerFrame = bytesPerFrame;
 	mCapacityFrames = capacityFrames;
 	mCapacityFramesMask = capacityFrames - 1;
 	mCapacityBytes = bytesPerFrame * capacityFrames;
 
-	// put everything in one memory allocation, first the pointers, then the deinterleaved channels
-	UInt32 allocSize = (mCapacityBytes + sizeof(Byte *)) * nChannels;
+	// put everything in one memory allocation, first the pointers, then the buffers
+	UInt32 allocSize = (mCapacityBytes + sizeof(Byte *)) * nBuffers;
 	Byte *p = (Byte *)CA_malloc(allocSize);
 	memset(p, 0, allocSize);
 	mBuffers = (Byte **)p;
-	p += nChannels * sizeof(Byte *);
-	for (int i = 0; i < nChannels; ++i) {
+	p += nBuffers * sizeof(Byte *);
+	for (int i = 0; i < nBuffers; ++i) {
 		mBuffers[i] = p;
 		p += mCapacityBytes;
 	}
@@ -105,6 +117,7 @@ void	CARingBuffer::Deallocate()
 		mBuffers = NULL;
 	}
 	mNumberChannels = 0;
+	mNumberBuffers = 0;
 	mCapacityBytes = 0;
 	mCapacityFrames = 0;
 }
@@ -171,7 +184,7 @@ CARingBufferError	CARingBuffer::Store(const AudioBufferList *abl, UInt32 framesT
 	
 	// write the new frames
 	Byte **buffers = mBuffers;
-	int nchannels = mNumberChannels;
+	int nchannels = mNumberBuffers;
 	int offset0, offset1, nbytes;
 	SampleTime curEnd = EndTime();
 	
@@ -241,7 +254,9 @@ CARingBufferError	CARingBuffer::ClipTimeBounds(SampleTime& startRead, SampleTime
 	CARingBufferError err = GetTimeBounds(startTime, endTime);
 	if (err) return err;
 	
-	startRead = std::max(startRead, startTime);
+	// keep startRead <= endRead within the requested range, so a read entirely before
+	// startTime comes back as all zeroes rather than as a zero fill longer than the request
+	startRead = std::min(std::max(startRead, startTime), endRead);
 	endRead = std::min(endRead, endTime);
 	endRead = std::max(endRead, startRead);
 	
@@ -294,3 +309,140 @@ CARingBufferError	CARingBuffer::Fetch(AudioBufferList *abl, UInt32 nFrames, Samp
 
 	return noErr;
 }
+
+// Float32 -> clipped integer conversion. The SSE2 versions convert four samples at a time
+// with round-to-nearest, matching lrintf in the scalar versions.
+
+static inline void	ConvertFloat(Float32 x, SInt16 &out)
+{
+	x *= 32768.f;
+	if (x > 32767.f) x = 32767.f;
+	else if (x < -32768.f) x = -32768.f;
+	out = (SInt16)lrintf(x);
+}
+
+static inline void	ConvertFloat(Float32 x, SInt32 &out)
+{
+	// 0.99999994 is the largest float below 1.0; anything larger would overflow SInt32
+	if (x > 0.99999994f) x = 0.99999994f;
+	else if (x < -1.f) x = -1.f;
+	out = (SInt32)lrintf(x * 2147483648.f);
+}
+
+static inline void	ConvertFloats(const Float32 *src, SInt16 *dest, UInt32 count)
+{
+#if TARGET_CPU_X86 || TARGET_CPU_X86_64
+	// clamp before converting: _mm_cvtps_epi32 turns anything beyond the SInt32 range into
+	// 0x80000000, which the saturating pack would then make -32768
+	const __m128 scale = _mm_set1_ps(32768.f);
+	const __m128 maxOut = _mm_set1_ps(32767.f);
+	const __m128 minOut = _mm_set1_ps(-32768.f);
+	for ( ; count >= 8; count -= 8, src += 8, dest += 8) {
+		__m128 lo = _mm_max_ps(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(src), scale), maxOut), minOut);
+		__m128 hi = _mm_max_ps(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(src + 4), scale), maxOut), minOut);
+		_mm_storeu_si128((__m128i *)dest, _mm_packs_epi32(_mm_cvtps_epi32(lo), _mm_cvtps_epi32(hi)));
+	}
+#endif
+	while (count-- > 0)
+		ConvertFloat(*src++, *dest++);
+}
+
+static inline void	ConvertFloats(const Float32 *src, SInt32 *dest, UInt32 count)
+{
+#if TARGET_CPU_X86 || TARGET_CPU_X86_64
+	const __m128 scale = _mm_set1_ps(2147483648.f);
+	const __m128 maxIn = _mm_set1_ps(0.99999994f);
+	const __m128 minIn = _mm_set1_ps(-1.f);
+	for ( ; count >= 4; count -= 4, src += 4, dest += 4) {
+		__m128 x = _mm_max_ps(_mm_min_ps(_mm_loadu_ps(src), maxIn), minIn);
+		_mm_storeu_si128((__m128i *)dest, _mm_cvtps_epi32(_mm_mul_ps(x, scale)));
+	}
+#endif
+	while (count-- > 0)
+		ConvertFloat(*src++, *dest++);
+}
+
+// interleave and convert nFrames starting at srcFrame of each plane
+template <class T>
+static void	ConvertPlanes(Byte **buffers, int nchannels, UInt32 srcFrame, T *dest, UInt32 nFrames)
+{
+	if (nchannels == 1) {
+		ConvertFloats((const Float32 *)buffers[0] + srcFrame, dest, nFrames);
+		return;
+	}
+#if TARGET_CPU_X86 || TARGET_CPU_X86_64
+	if (nchannels == 2) {
+		// interleave four frames of stereo in registers, then convert them together
+		const Float32 *left = (const Float32 *)buffers[0] + srcFrame;
+		const Float32 *right = (const Float32 *)buffers[1] + srcFrame;
+		Float32 interleaved[8];
+		for ( ; nFrames >= 4; nFrames -= 4, left += 4, right += 4, dest += 8) {
+			__m128 l = _mm_loadu_ps(left), r = _mm_loadu_ps(right);
+			_mm_storeu_ps(interleaved, _mm_unpacklo_ps(l, r));
+			_mm_storeu_ps(interleaved + 4, _mm_unpackhi_ps(l, r));
+			ConvertFloats(interleaved, dest, 8);
+		}
+		srcFrame = UInt32(left - (const Float32 *)buffers[0]);
+	}
+#endif
+	for (int ch = 0; ch < nchannels; ++ch) {
+		const Float32 *src = (const Float32 *)buffers[ch] + srcFrame;
+		T *d = dest + ch;
+		for (UInt32 i = 0; i < nFrames; ++i, d += nchannels)
+			ConvertFloat(src[i], *d);
+	}
+}
+
+template <class T>
+CARingBufferError	CARingBuffer::FetchConverted(T *outInterleaved, UInt32 nFrames, SampleTime startRead)
+{
+	if (mBytesPerFrame != (mInterleaved ? mNumberChannels * sizeof(Float32) : sizeof(Float32)))
+		return kAudio_ParamError;
+	
+	SampleTime endRead = startRead + nFrames;
+	SampleTime startRead0 = startRead;
+	SampleTime endRead0 = endRead;
+	
+	CARingBufferError err = ClipTimeBounds(startRead, endRead);
+	if (err) return err;
+	
+	int nchannels = mNumberChannels;
+	UInt32 destStartFrames = std::min(UInt32(startRead - startRead0), nFrames);
+	UInt32 size = UInt32(endRead - startRead);
+	UInt32 destEndFrames = std::min(UInt32(endRead0 - endRead), nFrames - destStartFrames);
+	
+	if (destStartFrames > 0)
+		memset(outInterleaved, 0, destStartFrames * nchannels * sizeof(T));
+	if (destEndFrames > 0)
+		memset(outInterleaved + (destStartFrames + size) * nchannels, 0, destEndFrames * nchannels * sizeof(T));
+	if (size == 0)
+		return kCARingBufferError_OK;
+	
+	T *dest = outInterleaved + destStartFrames * nchannels;
+	UInt32 frame0 = UInt32(startRead & mCapacityFramesMask);
+	UInt32 frame1 = UInt32(endRead & mCapacityFramesMask);
+	UInt32 nframes0 = (frame0 < frame1) ? size : mCapacityFrames - frame0;
+	
+	if (mInterleaved) {
+		const Float32 *src = (const Float32 *)mBuffers[0];
+		ConvertFloats(src + frame0 * nchannels, dest, nframes0 * nchannels);
+		if (nframes0 < size)
+			ConvertFloats(src, dest + nframes0 * nchannels, frame1 * nchannels);
+	} else {
+		ConvertPlanes(mBuffers, nchannels, frame0, dest, nframes0);
+		if (nframes0 < size)
+			ConvertPlanes(mBuffers, nchannels, 0, dest + nframes0 * nchannels, frame1);
+	}
+	
+	return kCARingBufferError_OK;
+}
+
+CARingBufferError	CARingBuffer::Fetch(SInt16 *outInterleaved, UInt32 nFrames, SampleTime startRead)
+{
+	return FetchConverted(outInterleaved, nFrames, startRead);
+}
+
+CARingBufferError	CARingBuffer::Fetch(SInt32 *outInterleaved, UInt32 nFrames, SampleTime startRead)
+{
+	return FetchConverted(outInterleaved, nFrames, startRead);
+}
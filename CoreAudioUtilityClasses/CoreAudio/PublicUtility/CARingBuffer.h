@@ -72,8 +72,11 @@ public:
 	CARingBuffer();
 	~CARingBuffer();
 	
-	void					Allocate(int nChannels, UInt32 bytesPerFrame, UInt32 capacityFrames);
+	void					Allocate(int nChannels, UInt32 bytesPerFrame, UInt32 capacityFrames, bool interleaved = false);
 								// capacityFrames will be rounded up to a power of 2
+								// bytesPerFrame is always per channel. If interleaved is true, the frames of
+								// all channels are stored together in a single buffer, and Store and Fetch
+								// take AudioBufferLists with one interleaved buffer.
 	void					Deallocate();
 	
 	CARingBufferError	Store(const AudioBufferList *abl, UInt32 nFrames, SampleTime frameNumber);
@@ -89,6 +92,15 @@ public:
 	CARingBufferError	Fetch(AudioBufferList *abl, UInt32 nFrames, SampleTime frameNumber);
 								// will alter mNumDataBytes of the buffers
 	
+	CARingBufferError	Fetch(SInt16 *outInterleaved, UInt32 nFrames, SampleTime frameNumber);
+	CARingBufferError	Fetch(SInt32 *outInterleaved, UInt32 nFrames, SampleTime frameNumber);
+								// The buffer must hold Float32 samples (bytesPerFrame == 4). Fetches nFrames
+								// and converts them to interleaved, clipped, full-scale integers in the same
+								// pass as the copy out of the ring, so the caller needs no second conversion.
+								// outInterleaved must have room for nFrames * nChannels samples.
+	
+	bool				IsInterleaved() const { return mInterleaved; }
+	
 	CARingBufferError	GetTimeBounds(SampleTime &startTime, SampleTime &endTime);
 	
 protected:
@@ -97,6 +109,9 @@ protected:
 
 	CARingBufferError		ClipTimeBounds(SampleTime& startRead, SampleTime& endRead);
 	
+	template <class T>
+	CARingBufferError		FetchConverted(T *outInterleaved, UInt32 nFrames, SampleTime startRead);
+	
 	// these should only be called from Store.
 	SampleTime				StartTime() const { return mTimeBoundsQueue[mTimeBoundsQueuePtr & kGeneralRingTimeBoundsQueueMask].mStartTime; }
 	SampleTime				EndTime()   const { return mTimeBoundsQueue[mTimeBoundsQueuePtr & kGeneralRingTimeBoundsQueueMask].mEndTime; }
@@ -105,10 +120,12 @@ protected:
 protected:
 	Byte **					mBuffers;				// allocated in one chunk of memory
 	int						mNumberChannels;
-	UInt32					mBytesPerFrame;			// within one deinterleaved channel
+	int						mNumberBuffers;			// mNumberChannels, or 1 if interleaved
+	bool					mInterleaved;
+	UInt32					mBytesPerFrame;			// within one buffer (all channels when interleaved)
 	UInt32					mCapacityFrames;		// per channel, must be a power of 2
 	UInt32					mCapacityFramesMask;
-	UInt32					mCapacityBytes;			// per channel
+	UInt32					mCapacityBytes;			// per buffer
 	
 	// range of valid sample time in the buffer
 	typedef struct {
@@ -48,9 +48,10 @@
 //#include "AudioFormulas.h"
 #include "CASpectralProcessor.h"
 #include "CABitOperations.h"
+#include <stdio.h>
+#include <string.h>
 
-
-#include <Accelerate/Accelerate.h>
+#include "CARealtimeThreadPool.h"
 
 
 #define OFFSETOF(class, field)((size_t)&((class*)0)->field)
@@ -65,9 +66,13 @@ CASpectralProcessor::CASpectralProcessor(UInt32 inFFTSize, UInt32 inHopSize, UIn
 	mInputSize(0),
 	mInputPos(0), mOutputPos(-mFFTSize & mIOMask), 
 	mInFFTPos(0), mOutFFTPos(0),
-	mSpectralFunction(0), mUserData(0)
+	mMaxHops(mMaxFrames > mHopSize ? (mMaxFrames + mHopSize - 1) / mHopSize : 1),
+	mFFT(mLog2FFTSize),
+	mSpectralFunction(0), mUserData(0),
+	mWorkerPool(NULL), mBatchPass(kBatch_Forward), mBatchHops(0)
 {
 	mWindow.alloc(mFFTSize, false);
+	mSynthesisWindow.alloc(mFFTSize, false);
 	SineWindow(); // set default window.
 	
 	mChannels.alloc(mNumChannels);
@@ -77,22 +82,20 @@ CASpectralProcessor::CASpectralProcessor(UInt32 inFFTSize, UInt32 inHopSize, UIn
 	{
 		mChannels[i].mInputBuf.alloc(mIOBufSize, true);
 		mChannels[i].mOutputBuf.alloc(mIOBufSize, true);
-		mChannels[i].mFFTBuf.alloc(mFFTSize, true);
-		mChannels[i].mSplitFFTBuf.alloc(mFFTSize, true);
+		mChannels[i].mFFTBuf.alloc(mMaxHops * mFFTSize, true);
+		mChannels[i].mSplitFFTBuf.alloc(mMaxHops * mFFTSize, true);
 		mSpectralBufferList->mDSPSplitComplex[i].realp = mChannels[i].mSplitFFTBuf();
 		mSpectralBufferList->mDSPSplitComplex[i].imagp = mChannels[i].mSplitFFTBuf() + (mFFTSize >> 1);
 	}
-
-	mFFTSetup = vDSP_create_fftsetup (mLog2FFTSize, FFT_RADIX2);
-	
 }
 
 CASpectralProcessor::~CASpectralProcessor()
 {
+	SetUsesWorkerThread(false);
 	mWindow.free();
+	mSynthesisWindow.free();
 	mChannels.free();
 	mSpectralBufferList.free();
-	vDSP_destroy_fftsetup(mFFTSetup);
 }
 
 void CASpectralProcessor::Reset()
@@ -106,7 +109,25 @@ void CASpectralProcessor::Reset()
 	{
 		memset(mChannels[i].mInputBuf(), 0, mIOBufSize * sizeof(Float32));
 		memset(mChannels[i].mOutputBuf(), 0, mIOBufSize * sizeof(Float32));
-		memset(mChannels[i].mFFTBuf(), 0, mFFTSize * sizeof(Float32));
+		memset(mChannels[i].mFFTBuf(), 0, mMaxHops * mFFTSize * sizeof(Float32));
+	}
+}
+
+void CASpectralProcessor::SetUsesWorkerThread(bool inUsesWorkerThread)
+{
+	if (inUsesWorkerThread && mWorkerPool == NULL && mNumChannels > 1) {
+		UInt32 numWorkers = CARealtimeThreadPool::DefaultNumWorkers();
+		if (numWorkers > mNumChannels - 1)
+			numWorkers = mNumChannels - 1;
+		mWorkerPool = new CARealtimeThreadPool(numWorkers);
+		if (mWorkerPool->GetNumWorkers() == 0) {
+			// no threads on this platform
+			delete mWorkerPool;
+			mWorkerPool = NULL;
+		}
+	} else if (!inUsesWorkerThread && mWorkerPool != NULL) {
+		delete mWorkerPool;
+		mWorkerPool = NULL;
 	}
 }
 
@@ -137,29 +158,141 @@ void CASpectralProcessor::Process(UInt32 inNumFrames, AudioBufferList* inInput,
 	// copy from buffer list to input buffer
 	CopyInput(inNumFrames, inInput);
 	
-	// if enough input to process, then process.
+	// if enough input to process, then process every hop that is ready in one batch.
 	while (mInputSize >= mFFTSize) 
 	{
-		CopyInputToFFT(); // copy from input buffer to fft buffer
-		DoWindowing();
-		DoFwdFFT();
-		ProcessSpectrum(mFFTSize, mSpectralBufferList());
-		DoInvFFT();
-		DoWindowing();
-		OverlapAddOutput();
+		UInt32 numHops = (mInputSize - mFFTSize) / mHopSize + 1;
+		if (numHops > mMaxHops)
+			numHops = mMaxHops;
+		ProcessBatch(numHops);
 	}
 
 	// copy from output buffer to buffer list
 	CopyOutput(inNumFrames, outOutput);
 }
 
+void CASpectralProcessor::ProcessBatch(UInt32 inNumHops)
+{
+	// the window may have been changed through Window() since the last batch
+	CAVectorDSP::Scale(mWindow(), 0.5f / mFFTSize, mSynthesisWindow(), mFFTSize);
+
+	RunBatch(kBatch_Forward, inNumHops);
+	
+	// the spectral function still sees one hop at a time, in order
+	for (UInt32 hop = 0; hop < inNumHops; ++hop) 
+	{
+		for (UInt32 i = 0; i < mNumChannels; ++i)
+			mSpectralBufferList->mDSPSplitComplex[i] = BatchSpectrum(i, hop);
+		ProcessSpectrum(mFFTSize, mSpectralBufferList());
+	}
+	for (UInt32 i = 0; i < mNumChannels; ++i)
+		mSpectralBufferList->mDSPSplitComplex[i] = BatchSpectrum(i, 0);
+	
+	RunBatch(kBatch_Inverse, inNumHops);
+	
+	mInputSize -= inNumHops * mHopSize;
+	mInFFTPos = (mInFFTPos + inNumHops * mHopSize) & mIOMask;
+	mOutFFTPos = (mOutFFTPos + inNumHops * mHopSize) & mIOMask;
+}
+
+void CASpectralProcessor::RunBatch(UInt32 inPass, UInt32 inNumHops)
+{
+	// channels are independent until the spectral function runs, so the pool can take one each
+	if (mWorkerPool) {
+		mBatchPass = inPass;
+		mBatchHops = inNumHops;
+		if (mWorkerPool->Run(BatchTask, this, mNumChannels) == noErr)
+			return;
+	}
+	if (inPass == kBatch_Forward)
+		BatchForward(inNumHops, 0, mNumChannels);
+	else
+		BatchInverse(inNumHops, 0, mNumChannels);
+}
+
+void CASpectralProcessor::BatchTask(void* inRefCon, UInt32 inChannel, UInt32 /*inThreadIndex*/)
+{
+	CASpectralProcessor* THIS = static_cast<CASpectralProcessor*>(inRefCon);
+	if (THIS->mBatchPass == kBatch_Forward)
+		THIS->BatchForward(THIS->mBatchHops, inChannel, inChannel + 1);
+	else
+		THIS->BatchInverse(THIS->mBatchHops, inChannel, inChannel + 1);
+}
+
+CADSPSplitComplex CASpectralProcessor::BatchSpectrum(UInt32 inChannel, UInt32 inHop) const
+{
+	CADSPSplitComplex spectrum;
+	spectrum.realp = mChannels[inChannel].mSplitFFTBuf() + inHop * mFFTSize;
+	spectrum.imagp = spectrum.realp + (mFFTSize >> 1);
+	return spectrum;
+}
+
+void CASpectralProcessor::BatchForward(UInt32 inNumHops, UInt32 inFirstChannel, UInt32 inEndChannel)
+{
+	UInt32 half = mFFTSize >> 1;
+	const Float32* win = mWindow();
+	for (UInt32 i = inFirstChannel; i < inEndChannel; ++i) 
+	{
+		const Float32* input = mChannels[i].mInputBuf();
+		for (UInt32 hop = 0; hop < inNumHops; ++hop) 
+		{
+			// window straight out of the input buffer rather than copying the frame first
+			Float32* frame = mChannels[i].mFFTBuf() + hop * mFFTSize;
+			UInt32 pos = (mInFFTPos + hop * mHopSize) & mIOMask;
+			UInt32 firstPart = mIOBufSize - pos;
+			if (firstPart < mFFTSize) {
+				CAVectorDSP::Multiply(input + pos, win, frame, firstPart);
+				CAVectorDSP::Multiply(input, win + firstPart, frame + firstPart, mFFTSize - firstPart);
+			} else {
+				CAVectorDSP::Multiply(input + pos, win, frame, mFFTSize);
+			}
+			
+			CADSPSplitComplex spectrum = BatchSpectrum(i, hop);
+			CAVectorDSP::Deinterleave(frame, spectrum, half);
+			mFFT.Forward(spectrum);
+		}
+	}
+}
+
+void CASpectralProcessor::BatchInverse(UInt32 inNumHops, UInt32 inFirstChannel, UInt32 inEndChannel)
+{
+	UInt32 half = mFFTSize >> 1;
+	const Float32* win = mSynthesisWindow();
+	for (UInt32 i = inFirstChannel; i < inEndChannel; ++i) 
+	{
+		for (UInt32 hop = 0; hop < inNumHops; ++hop) 
+		{
+			Float32* frame = mChannels[i].mFFTBuf() + hop * mFFTSize;
+			CADSPSplitComplex spectrum = BatchSpectrum(i, hop);
+			mFFT.Inverse(spectrum);
+			CAVectorDSP::Interleave(spectrum, frame, half);
+			CAVectorDSP::Multiply(frame, win, frame, mFFTSize);
+		}
+		
+		// overlap-add the whole batch while this channel's output is in cache
+		Float32* output = mChannels[i].mOutputBuf();
+		for (UInt32 hop = 0; hop < inNumHops; ++hop) 
+		{
+			const Float32* frame = mChannels[i].mFFTBuf() + hop * mFFTSize;
+			UInt32 pos = (mOutFFTPos + hop * mHopSize) & mIOMask;
+			UInt32 firstPart = mIOBufSize - pos;
+			if (firstPart < mFFTSize) {
+				CAVectorDSP::Add(output + pos, frame, output + pos, firstPart);
+				CAVectorDSP::Add(output, frame + firstPart, output, mFFTSize - firstPart);
+			} else {
+				CAVectorDSP::Add(output + pos, frame, output + pos, mFFTSize);
+			}
+		}
+	}
+}
+
 void CASpectralProcessor::DoWindowing()
 {
 	Float32 *win = mWindow();
 	if (!win) return;
 	for (UInt32 i=0; i<mNumChannels; ++i) {
 		Float32 *x = mChannels[i].mFFTBuf();
-		vDSP_vmul(x, 1, win, 1, x, 1, mFFTSize);
+		CAVectorDSP::Multiply(x, win, x, mFFTSize);
 	}
 	//printf("DoWindowing %g %g\n", mChannels[0].mFFTBuf()[0], mChannels[0].mFFTBuf()[200]);
 }
@@ -220,7 +353,7 @@ void CASpectralProcessor::PrintSpectralBufferList()
 {
 	UInt32 half = mFFTSize >> 1;
 	for (UInt32 i=0; i<mNumChannels; ++i) {
-		DSPSplitComplex	&freqData = mSpectralBufferList->mDSPSplitComplex[i];
+		CADSPSplitComplex	&freqData = mSpectralBufferList->mDSPSplitComplex[i];
 	
 		for (UInt32 j=0; j<half; j++){
 			printf(" bin[%d]: %lf + %lfi\n", (int) j, freqData.realp[j], freqData.imagp[j]);
@@ -258,14 +391,14 @@ void CASpectralProcessor::OverlapAddOutput()
 		UInt32 secondPart = mFFTSize - firstPart;
 		for (UInt32 i=0; i<mNumChannels; ++i) {
 			float* out1 = mChannels[i].mOutputBuf() + mOutFFTPos;
-			vDSP_vadd(out1, 1, mChannels[i].mFFTBuf(), 1, out1, 1, firstPart);
+			CAVectorDSP::Add(out1, mChannels[i].mFFTBuf(), out1, firstPart);
 			float* out2 = mChannels[i].mOutputBuf();
-			vDSP_vadd(out2, 1, mChannels[i].mFFTBuf() + firstPart, 1, out2, 1, secondPart);
+			CAVectorDSP::Add(out2, mChannels[i].mFFTBuf() + firstPart, out2, secondPart);
 		}
 	} else {
 		for (UInt32 i=0; i<mNumChannels; ++i) {
 			float* out1 = mChannels[i].mOutputBuf() + mOutFFTPos;
-			vDSP_vadd(out1, 1, mChannels[i].mFFTBuf(), 1, out1, 1, mFFTSize);
+			CAVectorDSP::Add(out1, mChannels[i].mFFTBuf(), out1, mFFTSize);
 		}
 	}
 	//printf("OverlapAddOutput %g %g\n", mChannels[0].mOutputBuf[mOutFFTPos], mChannels[0].mOutputBuf[(mOutFFTPos + 200) & mIOMask]);
@@ -279,8 +412,8 @@ void CASpectralProcessor::DoFwdFFT()
 	UInt32 half = mFFTSize >> 1;
 	for (UInt32 i=0; i<mNumChannels; ++i) 
 	{
-		vDSP_ctoz((DSPComplex*)mChannels[i].mFFTBuf(), 2, &mSpectralBufferList->mDSPSplitComplex[i], 1, half);
-		vDSP_fft_zrip(mFFTSetup, &mSpectralBufferList->mDSPSplitComplex[i], 1, mLog2FFTSize, FFT_FORWARD);
+		CAVectorDSP::Deinterleave(mChannels[i].mFFTBuf(), mSpectralBufferList->mDSPSplitComplex[i], half);
+		mFFT.Forward(mSpectralBufferList->mDSPSplitComplex[i]);
 	}
 	//printf("<-DoFwdFFT %g %g\n", direction, mChannels[0].mFFTBuf()[0], mChannels[0].mFFTBuf()[200]);
 }
@@ -291,10 +424,10 @@ void CASpectralProcessor::DoInvFFT()
 	UInt32 half = mFFTSize >> 1;
 	for (UInt32 i=0; i<mNumChannels; ++i) 
 	{
-		vDSP_fft_zrip(mFFTSetup, &mSpectralBufferList->mDSPSplitComplex[i], 1, mLog2FFTSize, FFT_INVERSE);
-		vDSP_ztoc(&mSpectralBufferList->mDSPSplitComplex[i], 1, (DSPComplex*)mChannels[i].mFFTBuf(), 2, half);		
+		mFFT.Inverse(mSpectralBufferList->mDSPSplitComplex[i]);
+		CAVectorDSP::Interleave(mSpectralBufferList->mDSPSplitComplex[i], mChannels[i].mFFTBuf(), half);
 		float scale = 0.5 / mFFTSize;
-		vDSP_vsmul(mChannels[i].mFFTBuf(), 1, &scale, mChannels[i].mFFTBuf(), 1, mFFTSize );
+		CAVectorDSP::Scale(mChannels[i].mFFTBuf(), scale, mChannels[i].mFFTBuf(), mFFTSize);
 	}
 	//printf("<-DoInvFFT %g %g\n", direction, mChannels[0].mFFTBuf()[0], mChannels[0].mFFTBuf()[200]);
 }
@@ -317,14 +450,14 @@ void CASpectralProcessor::GetMagnitude(AudioBufferList* list, Float32* min, Floa
 {	
 	UInt32 half = mFFTSize >> 1;	
 	for (UInt32 i=0; i<mNumChannels; ++i) {
-		DSPSplitComplex	&freqData = mSpectralBufferList->mDSPSplitComplex[i];		
+		CADSPSplitComplex	&freqData = mSpectralBufferList->mDSPSplitComplex[i];		
 		
 		Float32* b = (Float32*) list->mBuffers[i].mData;
 		
-		vDSP_zvabs(&freqData,1,b,1,half); 		
+		CAVectorDSP::Magnitudes(freqData, b, half); 		
    
-		vDSP_maxmgv(b, 1, &max[i], half); 
- 		vDSP_minmgv(b, 1, &min[i], half); 
+		max[i] = CAVectorDSP::MaxMagnitude(b, half); 
+ 		min[i] = CAVectorDSP::MinMagnitude(b, half); 
 		
    } 
 }
@@ -55,14 +55,15 @@
 #include <CoreFoundation.h>
 #endif
 
-#include <Accelerate/Accelerate.h>
-
 #include "CAAutoDisposer.h"
+#include "CAVectorDSP.h"
+
+class CARealtimeThreadPool;
 
 struct SpectralBufferList
 {
 	UInt32 mNumberSpectra;
-	DSPSplitComplex mDSPSplitComplex[1];
+	CADSPSplitComplex mDSPSplitComplex[1];
 };
 
 class CASpectralProcessor 
@@ -73,8 +74,17 @@ public:
 	
 	void Reset();
 	
+	// Process gathers every hop that is ready into one batch per call: all of the windowed frames are
+	// transformed, the spectral function is called once per hop in order, and the results are
+	// overlap-added in a single sweep.
 	void Process(UInt32 inNumFrames, AudioBufferList* inInput, AudioBufferList* outOutput);
 	
+	// Lets a pool of worker threads share the channels of each batch with the calling thread. This is
+	// meant for renders with several channels; it creates and destroys threads, so don't call it while
+	// rendering.
+	void SetUsesWorkerThread(bool inUsesWorkerThread);
+	bool UsesWorkerThread() const { return mWorkerPool != NULL; }
+	
 	typedef void (*SpectralFunction)(SpectralBufferList* inSpectra, void* inUserData);
 	
 	void SetSpectralFunction(SpectralFunction inFunction, void* inUserData);
@@ -108,6 +118,14 @@ protected:
 	void CopyOutput(UInt32 inNumFrames, AudioBufferList* inOutput);
 	void ProcessSpectrum(UInt32 inFFTSize, SpectralBufferList* inSpectra);
 	
+	enum { kBatch_Forward, kBatch_Inverse };
+	void ProcessBatch(UInt32 inNumHops);
+	void RunBatch(UInt32 inPass, UInt32 inNumHops);
+	static void BatchTask(void* inRefCon, UInt32 inChannel, UInt32 inThreadIndex);
+	void BatchForward(UInt32 inNumHops, UInt32 inFirstChannel, UInt32 inEndChannel);
+	void BatchInverse(UInt32 inNumHops, UInt32 inFirstChannel, UInt32 inEndChannel);
+	CADSPSplitComplex BatchSpectrum(UInt32 inChannel, UInt32 inHop) const;
+	
 	UInt32 mFFTSize;
 	UInt32 mHopSize;
 	UInt32 mNumChannels;
@@ -123,15 +141,17 @@ protected:
 	UInt32 mOutputPos;
 	UInt32 mInFFTPos;
 	UInt32 mOutFFTPos;
-	FFTSetup mFFTSetup;
+	UInt32 mMaxHops;			// hops that can be ready after one call of at most max frames
+	CAVectorDSP::RealFFT mFFT;
 
 	CAAutoFree<Float32> mWindow;
+	CAAutoFree<Float32> mSynthesisWindow;	// window with the inverse FFT scale folded in
 	struct SpectralChannel 
 	{
 		CAAutoFree<Float32> mInputBuf;		// log2ceil(FFT size + max frames)
 		CAAutoFree<Float32> mOutputBuf;		// log2ceil(FFT size + max frames)
-		CAAutoFree<Float32> mFFTBuf;		// FFT size
-		CAAutoFree<Float32> mSplitFFTBuf;	// FFT size
+		CAAutoFree<Float32> mFFTBuf;		// max hops * FFT size, one frame per hop
+		CAAutoFree<Float32> mSplitFFTBuf;	// max hops * FFT size, one spectrum per hop
 	};
 	CAAutoArrayDelete<SpectralChannel> mChannels;
 
@@ -140,6 +160,9 @@ protected:
 	SpectralFunction mSpectralFunction;
 	void *mUserData;
 	
+	CARealtimeThreadPool* mWorkerPool;
+	UInt32 mBatchPass;			// the pass and hop count of the batch the pool is running
+	UInt32 mBatchHops;
 };
 
 
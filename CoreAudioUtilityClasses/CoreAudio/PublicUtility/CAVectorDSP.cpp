@@ -0,0 +1,241 @@
+/*
+     File: CAVectorDSP.cpp 
+ Abstract:  CAVectorDSP.h  
+  Version: 1.0.2 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2012 Apple Inc. All Rights Reserved. 
+  
+*/
+//=============================================================================
+//	Includes
+//=============================================================================
+
+#include "CAVectorDSP.h"
+
+//=============================================================================
+//	CAVectorDSP
+//=============================================================================
+
+const char*	CAVectorDSP::BackendName()
+{
+#if CA_VECTOR_DSP_USE_ACCELERATE
+	return "Accelerate";
+#elif CA_VECTOR_DSP_SSE
+	return "SSE";
+#elif CA_VECTOR_DSP_NEON
+	return "NEON";
+#else
+	return "scalar";
+#endif
+}
+
+#if CA_VECTOR_DSP_USE_ACCELERATE
+
+CAVectorDSP::RealFFT::RealFFT(UInt32 inLog2Size)
+	: mLog2Size(inLog2Size), mSetup(vDSP_create_fftsetup(inLog2Size, FFT_RADIX2))
+{
+}
+
+CAVectorDSP::RealFFT::~RealFFT()
+{
+	vDSP_destroy_fftsetup(mSetup);
+}
+
+void	CAVectorDSP::RealFFT::Forward(const CADSPSplitComplex& ioData) const
+{
+	vDSP_fft_zrip(mSetup, const_cast<CADSPSplitComplex*>(&ioData), 1, mLog2Size, FFT_FORWARD);
+}
+
+void	CAVectorDSP::RealFFT::Inverse(const CADSPSplitComplex& ioData) const
+{
+	vDSP_fft_zrip(mSetup, const_cast<CADSPSplitComplex*>(&ioData), 1, mLog2Size, FFT_INVERSE);
+}
+
+#else
+
+//	The real FFT of N samples runs as a complex FFT of N/2 points over the even/odd pairs, followed
+//	(forward) or preceded (inverse) by the usual split step that separates the two interleaved
+//	half-length transforms.
+
+CAVectorDSP::RealFFT::RealFFT(UInt32 inLog2Size)
+	: mLog2Size(inLog2Size), mHalfSize(1U << (inLog2Size - 1))
+{
+	const double kTwoPi = 2. * M_PI;
+	UInt32 log2Half = inLog2Size - 1;
+	
+	mBitReverse.resize(mHalfSize);
+	for (UInt32 i = 0; i < mHalfSize; ++i) {
+		UInt32 r = 0;
+		for (UInt32 b = 0; b < log2Half; ++b)
+			r |= ((i >> b) & 1) << (log2Half - 1 - b);
+		mBitReverse[i] = r;
+	}
+	
+	// stage with butterfly span h uses e^(-i pi j / h), j < h; stages are stored h = 1, 2, 4, ...
+	UInt32 numStageTwiddles = std::max(mHalfSize - 1, (UInt32)1);
+	mStageCos.resize(numStageTwiddles);
+	mStageSin.resize(numStageTwiddles);
+	for (UInt32 h = 1, offset = 0; h < mHalfSize; offset += h, h <<= 1) {
+		for (UInt32 j = 0; j < h; ++j) {
+			mStageCos[offset + j] = (Float32)cos(M_PI * j / h);
+			mStageSin[offset + j] = (Float32)sin(M_PI * j / h);
+		}
+	}
+	
+	mRealCos.resize(mHalfSize);
+	mRealSin.resize(mHalfSize);
+	for (UInt32 k = 0; k < mHalfSize; ++k) {
+		mRealCos[k] = (Float32)cos(kTwoPi * k / (2 * mHalfSize));
+		mRealSin[k] = (Float32)sin(kTwoPi * k / (2 * mHalfSize));
+	}
+}
+
+CAVectorDSP::RealFFT::~RealFFT()
+{
+}
+
+void	CAVectorDSP::RealFFT::ComplexFFT(Float32* ioReal, Float32* ioImag, bool inInverse) const
+{
+	// unscaled radix 2, decimation in time
+	for (UInt32 i = 0; i < mHalfSize; ++i) {
+		UInt32 j = mBitReverse[i];
+		if (i < j) {
+			std::swap(ioReal[i], ioReal[j]);
+			std::swap(ioImag[i], ioImag[j]);
+		}
+	}
+	
+	Float32 sign = inInverse ? -1.f : 1.f;
+	for (UInt32 h = 1, offset = 0; h < mHalfSize; offset += h, h <<= 1) {
+		const Float32* wc = &mStageCos[offset];
+		const Float32* ws = &mStageSin[offset];
+		for (UInt32 g = 0; g < mHalfSize; g += 2 * h) {
+			Float32* ar = ioReal + g;
+			Float32* ai = ioImag + g;
+			Float32* br = ar + h;
+			Float32* bi = ai + h;
+			UInt32 j = 0;
+#if CA_VECTOR_DSP_HAS_FLOAT4
+			CAVDSPFloat4 vsign = CAVDSP_Splat(sign);
+			for (; j + 4 <= h; j += 4) {
+				CAVDSPFloat4 c = CAVDSP_Load(wc + j), s = CAVDSP_Mul(CAVDSP_Load(ws + j), vsign);
+				CAVDSPFloat4 xr = CAVDSP_Load(br + j), xi = CAVDSP_Load(bi + j);
+				CAVDSPFloat4 tr = CAVDSP_Add(CAVDSP_Mul(xr, c), CAVDSP_Mul(xi, s));
+				CAVDSPFloat4 ti = CAVDSP_Sub(CAVDSP_Mul(xi, c), CAVDSP_Mul(xr, s));
+				CAVDSPFloat4 yr = CAVDSP_Load(ar + j), yi = CAVDSP_Load(ai + j);
+				CAVDSP_Store(br + j, CAVDSP_Sub(yr, tr));
+				CAVDSP_Store(bi + j, CAVDSP_Sub(yi, ti));
+				CAVDSP_Store(ar + j, CAVDSP_Add(yr, tr));
+				CAVDSP_Store(ai + j, CAVDSP_Add(yi, ti));
+			}
+#endif
+			for (; j < h; ++j) {
+				Float32 c = wc[j], s = sign * ws[j];
+				Float32 tr = br[j] * c + bi[j] * s;
+				Float32 ti = bi[j] * c - br[j] * s;
+				br[j] = ar[j] - tr;
+				bi[j] = ai[j] - ti;
+				ar[j] += tr;
+				ai[j] += ti;
+			}
+		}
+	}
+}
+
+void	CAVectorDSP::RealFFT::Forward(const CADSPSplitComplex& ioData) const
+{
+	Float32* re = ioData.realp;
+	Float32* im = ioData.imagp;
+	UInt32 half = mHalfSize;
+	
+	ComplexFFT(re, im, false);
+	
+	// DC and Nyquist are both real; they share the first bin
+	Float32 z0r = re[0], z0i = im[0];
+	re[0] = 2.f * (z0r + z0i);
+	im[0] = 2.f * (z0r - z0i);
+	
+	// Y[k] = A - i w^k D with A = Z[k] + conj(Z[N/2-k]), D = Z[k] - conj(Z[N/2-k]), w = e^(-2 pi i / N);
+	// Y[N/2-k] follows from the same A and D
+	for (UInt32 k = 1; k <= half / 2; ++k) {
+		UInt32 m = half - k;
+		Float32 ar = re[k] + re[m], ai = im[k] - im[m];
+		Float32 dr = re[k] - re[m], di = im[k] + im[m];
+		Float32 wr = mRealCos[k], wi = -mRealSin[k];
+		Float32 pr = wr * dr - wi * di, pi = wr * di + wi * dr;
+		re[k] = ar + pi;
+		im[k] = ai - pr;
+		if (m != k) {
+			re[m] = ar - pi;
+			im[m] = -ai - pr;
+		}
+	}
+}
+
+void	CAVectorDSP::RealFFT::Inverse(const CADSPSplitComplex& ioData) const
+{
+	Float32* re = ioData.realp;
+	Float32* im = ioData.imagp;
+	UInt32 half = mHalfSize;
+	
+	Float32 y0 = re[0], yn = im[0];
+	re[0] = y0 + yn;
+	im[0] = y0 - yn;
+	
+	// Z[k] = A + i conj(w^k) B with A = Y[k] + conj(Y[N/2-k]), B = Y[k] - conj(Y[N/2-k])
+	for (UInt32 k = 1; k <= half / 2; ++k) {
+		UInt32 m = half - k;
+		Float32 ar = re[k] + re[m], ai = im[k] - im[m];
+		Float32 br = re[k] - re[m], bi = im[k] + im[m];
+		Float32 wr = mRealCos[k], wi = -mRealSin[k];
+		Float32 qr = wr * br + wi * bi, qi = wr * bi - wi * br;
+		re[k] = ar - qi;
+		im[k] = ai + qr;
+		if (m != k) {
+			re[m] = ar + qi;
+			im[m] = -ai + qr;
+		}
+	}
+	
+	ComplexFFT(re, im, true);
+}
+
+#endif
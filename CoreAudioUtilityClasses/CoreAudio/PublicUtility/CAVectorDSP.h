@@ -0,0 +1,462 @@
+/*
+     File: CAVectorDSP.h 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.2 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2012 Apple Inc. All Rights Reserved. 
+  
+*/
+#ifndef __CAVectorDSP_h__
+#define __CAVectorDSP_h__
+
+#if defined(__APPLE__)
+	#include <TargetConditionals.h>
+#endif
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <CoreAudio/CoreAudioTypes.h>
+#else
+	#include <CoreAudioTypes.h>
+#endif
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+//	CAVectorDSP is the small set of vector kernels the AU and utility render paths need, so that they
+//	don't call Accelerate directly. By default Apple builds forward to vDSP; everything else, or an Apple
+//	build with CA_VECTOR_DSP_USE_ACCELERATE defined to 0, gets the portable backend, which uses SSE or
+//	NEON where the compiler targets them and plain loops otherwise. The portable backend needs nothing
+//	beyond the C++ library, so it builds on other platforms too.
+//	The kernels follow the vDSP function they replace, including RealFFT's packing and scaling.
+
+#if !defined(CA_VECTOR_DSP_USE_ACCELERATE)
+	#if defined(__APPLE__) && TARGET_OS_MAC
+		#define CA_VECTOR_DSP_USE_ACCELERATE	1
+	#else
+		#define CA_VECTOR_DSP_USE_ACCELERATE	0
+	#endif
+#endif
+
+#if CA_VECTOR_DSP_USE_ACCELERATE
+	#include <Accelerate/Accelerate.h>
+	typedef DSPSplitComplex CADSPSplitComplex;
+#else
+	struct CADSPSplitComplex
+	{
+		Float32*	realp;
+		Float32*	imagp;
+	};
+	
+	#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+		#include <xmmintrin.h>
+		#define CA_VECTOR_DSP_SSE	1
+	#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+		#include <arm_neon.h>
+		#define CA_VECTOR_DSP_NEON	1
+	#endif
+#endif
+
+#if CA_VECTOR_DSP_SSE
+	typedef __m128 CAVDSPFloat4;
+	static inline CAVDSPFloat4	CAVDSP_Load(const Float32* p) { return _mm_loadu_ps(p); }
+	static inline void			CAVDSP_Store(Float32* p, CAVDSPFloat4 v) { _mm_storeu_ps(p, v); }
+	static inline CAVDSPFloat4	CAVDSP_Splat(Float32 x) { return _mm_set1_ps(x); }
+	static inline CAVDSPFloat4	CAVDSP_Add(CAVDSPFloat4 a, CAVDSPFloat4 b) { return _mm_add_ps(a, b); }
+	static inline CAVDSPFloat4	CAVDSP_Sub(CAVDSPFloat4 a, CAVDSPFloat4 b) { return _mm_sub_ps(a, b); }
+	static inline CAVDSPFloat4	CAVDSP_Mul(CAVDSPFloat4 a, CAVDSPFloat4 b) { return _mm_mul_ps(a, b); }
+	static inline CAVDSPFloat4	CAVDSP_Min(CAVDSPFloat4 a, CAVDSPFloat4 b) { return _mm_min_ps(a, b); }
+	static inline CAVDSPFloat4	CAVDSP_Max(CAVDSPFloat4 a, CAVDSPFloat4 b) { return _mm_max_ps(a, b); }
+	static inline CAVDSPFloat4	CAVDSP_Abs(CAVDSPFloat4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.f), a); }
+	static inline CAVDSPFloat4	CAVDSP_Sqrt(CAVDSPFloat4 a) { return _mm_sqrt_ps(a); }
+	static inline void			CAVDSP_Deinterleave(const Float32* p, CAVDSPFloat4& outEven, CAVDSPFloat4& outOdd)
+	{
+		CAVDSPFloat4 a = _mm_loadu_ps(p), b = _mm_loadu_ps(p + 4);
+		outEven = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+		outOdd = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+	}
+	static inline void			CAVDSP_Interleave(Float32* p, CAVDSPFloat4 inEven, CAVDSPFloat4 inOdd)
+	{
+		_mm_storeu_ps(p, _mm_unpacklo_ps(inEven, inOdd));
+		_mm_storeu_ps(p + 4, _mm_unpackhi_ps(inEven, inOdd));
+	}
+#elif CA_VECTOR_DSP_NEON
+	typedef float32x4_t CAVDSPFloat4;
+	static inline CAVDSPFloat4	CAVDSP_Load(const Float32* p) { return vld1q_f32(p); }
+	static inline void			CAVDSP_Store(Float32* p, CAVDSPFloat4 v) { vst1q_f32(p, v); }
+	static inline CAVDSPFloat4	CAVDSP_Splat(Float32 x) { return vdupq_n_f32(x); }
+	static inline CAVDSPFloat4	CAVDSP_Add(CAVDSPFloat4 a, CAVDSPFloat4 b) { return vaddq_f32(a, b); }
+	static inline CAVDSPFloat4	CAVDSP_Sub(CAVDSPFloat4 a, CAVDSPFloat4 b) { return vsubq_f32(a, b); }
+	static inline CAVDSPFloat4	CAVDSP_Mul(CAVDSPFloat4 a, CAVDSPFloat4 b) { return vmulq_f32(a, b); }
+	static inline CAVDSPFloat4	CAVDSP_Min(CAVDSPFloat4 a, CAVDSPFloat4 b) { return vminq_f32(a, b); }
+	static inline CAVDSPFloat4	CAVDSP_Max(CAVDSPFloat4 a, CAVDSPFloat4 b) { return vmaxq_f32(a, b); }
+	static inline CAVDSPFloat4	CAVDSP_Abs(CAVDSPFloat4 a) { return vabsq_f32(a); }
+	static inline CAVDSPFloat4	CAVDSP_Sqrt(CAVDSPFloat4 a)
+	{
+	#if defined(__aarch64__)
+		return vsqrtq_f32(a);
+	#else
+		Float32 x[4];
+		vst1q_f32(x, a);
+		for (int i = 0; i < 4; ++i) x[i] = sqrtf(x[i]);
+		return vld1q_f32(x);
+	#endif
+	}
+	static inline void			CAVDSP_Deinterleave(const Float32* p, CAVDSPFloat4& outEven, CAVDSPFloat4& outOdd)
+	{
+		float32x4x2_t v = vld2q_f32(p);
+		outEven = v.val[0];
+		outOdd = v.val[1];
+	}
+	static inline void			CAVDSP_Interleave(Float32* p, CAVDSPFloat4 inEven, CAVDSPFloat4 inOdd)
+	{
+		float32x4x2_t v;
+		v.val[0] = inEven;
+		v.val[1] = inOdd;
+		vst2q_f32(p, v);
+	}
+#endif
+
+#if CA_VECTOR_DSP_SSE || CA_VECTOR_DSP_NEON
+	#define CA_VECTOR_DSP_HAS_FLOAT4	1
+	static inline Float32		CAVDSP_Sum(CAVDSPFloat4 v) { Float32 x[4]; CAVDSP_Store(x, v); return (x[0] + x[1]) + (x[2] + x[3]); }
+#endif
+
+class CAVectorDSP
+{
+public:
+	static const char*	BackendName();
+
+	// C = A + B (vDSP_vadd)
+	static void			Add(const Float32* inA, const Float32* inB, Float32* outC, UInt32 inCount);
+	// C = A * B (vDSP_vmul)
+	static void			Multiply(const Float32* inA, const Float32* inB, Float32* outC, UInt32 inCount);
+	// C = A * s (vDSP_vsmul)
+	static void			Scale(const Float32* inA, Float32 inScale, Float32* outC, UInt32 inCount);
+	// C = A * s + B (vDSP_vsma)
+	static void			ScaleAdd(const Float32* inA, Float32 inScale, const Float32* inB, Float32* outC, UInt32 inCount);
+	// C += A * g, with g starting at ioGain and growing by inStep per sample; ioGain gets the next gain (vDSP_vrampmuladd)
+	static void			RampMultiplyAdd(const Float32* inA, Float32& ioGain, Float32 inStep, Float32* ioC, UInt32 inCount);
+	// sum of A * B (vDSP_dotpr)
+	static Float32		DotProduct(const Float32* inA, const Float32* inB, UInt32 inCount);
+	
+	// inCount interleaved (re, im) pairs to split form and back (vDSP_ctoz / vDSP_ztoc)
+	static void			Deinterleave(const Float32* inPairs, const CADSPSplitComplex& outSplit, UInt32 inCount);
+	static void			Interleave(const CADSPSplitComplex& inSplit, Float32* outPairs, UInt32 inCount);
+	// D = A * B + C, complex (vDSP_zvma)
+	static void			ComplexMultiplyAdd(const CADSPSplitComplex& inA, const CADSPSplitComplex& inB, const CADSPSplitComplex& inC, const CADSPSplitComplex& outD, UInt32 inCount);
+	
+	// |z| (vDSP_zvabs)
+	static void			Magnitudes(const CADSPSplitComplex& inSplit, Float32* outMagnitudes, UInt32 inCount);
+	// largest and smallest |A[i]| (vDSP_maxmgv / vDSP_minmgv)
+	static Float32		MaxMagnitude(const Float32* inA, UInt32 inCount);
+	static Float32		MinMagnitude(const Float32* inA, UInt32 inCount);
+
+	// In-place real FFT of 2^log2 samples held as 2^(log2-1) split complex pairs (even samples in realp,
+	// odd in imagp), laid out like vDSP_fft_zrip: the forward result is scaled by 2 and packs the
+	// Nyquist bin into imagp[0]; the inverse is unscaled, so a round trip scales by 2 * 2^log2.
+	class RealFFT
+	{
+	public:
+						RealFFT(UInt32 inLog2Size);
+						~RealFFT();
+		
+		void			Forward(const CADSPSplitComplex& ioData) const;
+		void			Inverse(const CADSPSplitComplex& ioData) const;
+		UInt32			Log2Size() const { return mLog2Size; }
+		
+	private:
+						RealFFT(const RealFFT&);
+		RealFFT&		operator=(const RealFFT&);
+
+		UInt32			mLog2Size;
+	#if CA_VECTOR_DSP_USE_ACCELERATE
+		FFTSetup		mSetup;
+	#else
+		void			ComplexFFT(Float32* ioReal, Float32* ioImag, bool inInverse) const;
+	
+		UInt32					mHalfSize;
+		std::vector<UInt32>		mBitReverse;		// mHalfSize entries
+		std::vector<Float32>	mStageCos;			// complex FFT twiddles, all stages back to back
+		std::vector<Float32>	mStageSin;
+		std::vector<Float32>	mRealCos;			// real/complex split twiddles, mHalfSize entries
+		std::vector<Float32>	mRealSin;
+	#endif
+	};
+};
+
+//=============================================================================
+//	Kernels
+//=============================================================================
+
+inline void	CAVectorDSP::Add(const Float32* inA, const Float32* inB, Float32* outC, UInt32 inCount)
+{
+#if CA_VECTOR_DSP_USE_ACCELERATE
+	vDSP_vadd(inA, 1, inB, 1, outC, 1, inCount);
+#else
+	UInt32 i = 0;
+#if CA_VECTOR_DSP_HAS_FLOAT4
+	for (; i + 4 <= inCount; i += 4)
+		CAVDSP_Store(outC + i, CAVDSP_Add(CAVDSP_Load(inA + i), CAVDSP_Load(inB + i)));
+#endif
+	for (; i < inCount; ++i)
+		outC[i] = inA[i] + inB[i];
+#endif
+}
+
+inline void	CAVectorDSP::Multiply(const Float32* inA, const Float32* inB, Float32* outC, UInt32 inCount)
+{
+#if CA_VECTOR_DSP_USE_ACCELERATE
+	vDSP_vmul(inA, 1, inB, 1, outC, 1, inCount);
+#else
+	UInt32 i = 0;
+#if CA_VECTOR_DSP_HAS_FLOAT4
+	for (; i + 4 <= inCount; i += 4)
+		CAVDSP_Store(outC + i, CAVDSP_Mul(CAVDSP_Load(inA + i), CAVDSP_Load(inB + i)));
+#endif
+	for (; i < inCount; ++i)
+		outC[i] = inA[i] * inB[i];
+#endif
+}
+
+inline void	CAVectorDSP::Scale(const Float32* inA, Float32 inScale, Float32* outC, UInt32 inCount)
+{
+#if CA_VECTOR_DSP_USE_ACCELERATE
+	vDSP_vsmul(inA, 1, &inScale, outC, 1, inCount);
+#else
+	UInt32 i = 0;
+#if CA_VECTOR_DSP_HAS_FLOAT4
+	CAVDSPFloat4 s = CAVDSP_Splat(inScale);
+	for (; i + 4 <= inCount; i += 4)
+		CAVDSP_Store(outC + i, CAVDSP_Mul(CAVDSP_Load(inA + i), s));
+#endif
+	for (; i < inCount; ++i)
+		outC[i] = inA[i] * inScale;
+#endif
+}
+
+inline void	CAVectorDSP::ScaleAdd(const Float32* inA, Float32 inScale, const Float32* inB, Float32* outC, UInt32 inCount)
+{
+#if CA_VECTOR_DSP_USE_ACCELERATE
+	vDSP_vsma(inA, 1, &inScale, inB, 1, outC, 1, inCount);
+#else
+	UInt32 i = 0;
+#if CA_VECTOR_DSP_HAS_FLOAT4
+	CAVDSPFloat4 s = CAVDSP_Splat(inScale);
+	for (; i + 4 <= inCount; i += 4)
+		CAVDSP_Store(outC + i, CAVDSP_Add(CAVDSP_Mul(CAVDSP_Load(inA + i), s), CAVDSP_Load(inB + i)));
+#endif
+	for (; i < inCount; ++i)
+		outC[i] = inA[i] * inScale + inB[i];
+#endif
+}
+
+inline void	CAVectorDSP::RampMultiplyAdd(const Float32* inA, Float32& ioGain, Float32 inStep, Float32* ioC, UInt32 inCount)
+{
+#if CA_VECTOR_DSP_USE_ACCELERATE
+	vDSP_vrampmuladd(inA, 1, &ioGain, &inStep, ioC, 1, inCount);
+#else
+	UInt32 i = 0;
+	Float32 start = ioGain;
+#if CA_VECTOR_DSP_HAS_FLOAT4
+	if (inCount >= 4) {
+		Float32 ramp[4] = { start, start + inStep, start + 2.f * inStep, start + 3.f * inStep };
+		CAVDSPFloat4 g = CAVDSP_Load(ramp), step = CAVDSP_Splat(4.f * inStep);
+		for (; i + 4 <= inCount; i += 4) {
+			CAVDSP_Store(ioC + i, CAVDSP_Add(CAVDSP_Load(ioC + i), CAVDSP_Mul(CAVDSP_Load(inA + i), g)));
+			g = CAVDSP_Add(g, step);
+		}
+	}
+#endif
+	for (; i < inCount; ++i)
+		ioC[i] += inA[i] * (start + (Float32)i * inStep);
+	ioGain = start + (Float32)inCount * inStep;
+#endif
+}
+
+inline Float32	CAVectorDSP::DotProduct(const Float32* inA, const Float32* inB, UInt32 inCount)
+{
+#if CA_VECTOR_DSP_USE_ACCELERATE
+	Float32 result;
+	vDSP_dotpr(inA, 1, inB, 1, &result, inCount);
+	return result;
+#else
+	UInt32 i = 0;
+	Float32 result = 0.f;
+#if CA_VECTOR_DSP_HAS_FLOAT4
+	CAVDSPFloat4 sum = CAVDSP_Splat(0.f);
+	for (; i + 4 <= inCount; i += 4)
+		sum = CAVDSP_Add(sum, CAVDSP_Mul(CAVDSP_Load(inA + i), CAVDSP_Load(inB + i)));
+	result = CAVDSP_Sum(sum);
+#endif
+	for (; i < inCount; ++i)
+		result += inA[i] * inB[i];
+	return result;
+#endif
+}
+
+inline void	CAVectorDSP::Deinterleave(const Float32* inPairs, const CADSPSplitComplex& outSplit, UInt32 inCount)
+{
+#if CA_VECTOR_DSP_USE_ACCELERATE
+	vDSP_ctoz((const DSPComplex*)inPairs, 2, const_cast<CADSPSplitComplex*>(&outSplit), 1, inCount);
+#else
+	UInt32 i = 0;
+#if CA_VECTOR_DSP_HAS_FLOAT4
+	for (; i + 4 <= inCount; i += 4) {
+		CAVDSPFloat4 re, im;
+		CAVDSP_Deinterleave(inPairs + 2 * i, re, im);
+		CAVDSP_Store(outSplit.realp + i, re);
+		CAVDSP_Store(outSplit.imagp + i, im);
+	}
+#endif
+	for (; i < inCount; ++i) {
+		outSplit.realp[i] = inPairs[2 * i];
+		outSplit.imagp[i] = inPairs[2 * i + 1];
+	}
+#endif
+}
+
+inline void	CAVectorDSP::Interleave(const CADSPSplitComplex& inSplit, Float32* outPairs, UInt32 inCount)
+{
+#if CA_VECTOR_DSP_USE_ACCELERATE
+	vDSP_ztoc(&inSplit, 1, (DSPComplex*)outPairs, 2, inCount);
+#else
+	UInt32 i = 0;
+#if CA_VECTOR_DSP_HAS_FLOAT4
+	for (; i + 4 <= inCount; i += 4)
+		CAVDSP_Interleave(outPairs + 2 * i, CAVDSP_Load(inSplit.realp + i), CAVDSP_Load(inSplit.imagp + i));
+#endif
+	for (; i < inCount; ++i) {
+		outPairs[2 * i] = inSplit.realp[i];
+		outPairs[2 * i + 1] = inSplit.imagp[i];
+	}
+#endif
+}
+
+inline void	CAVectorDSP::ComplexMultiplyAdd(const CADSPSplitComplex& inA, const CADSPSplitComplex& inB, const CADSPSplitComplex& inC, const CADSPSplitComplex& outD, UInt32 inCount)
+{
+#if CA_VECTOR_DSP_USE_ACCELERATE
+	vDSP_zvma(const_cast<CADSPSplitComplex*>(&inA), 1, const_cast<CADSPSplitComplex*>(&inB), 1,
+				const_cast<CADSPSplitComplex*>(&inC), 1, const_cast<CADSPSplitComplex*>(&outD), 1, inCount);
+#else
+	UInt32 i = 0;
+#if CA_VECTOR_DSP_HAS_FLOAT4
+	for (; i + 4 <= inCount; i += 4) {
+		CAVDSPFloat4 ar = CAVDSP_Load(inA.realp + i), ai = CAVDSP_Load(inA.imagp + i);
+		CAVDSPFloat4 br = CAVDSP_Load(inB.realp + i), bi = CAVDSP_Load(inB.imagp + i);
+		CAVDSP_Store(outD.realp + i, CAVDSP_Add(CAVDSP_Load(inC.realp + i), CAVDSP_Sub(CAVDSP_Mul(ar, br), CAVDSP_Mul(ai, bi))));
+		CAVDSP_Store(outD.imagp + i, CAVDSP_Add(CAVDSP_Load(inC.imagp + i), CAVDSP_Add(CAVDSP_Mul(ar, bi), CAVDSP_Mul(ai, br))));
+	}
+#endif
+	for (; i < inCount; ++i) {
+		Float32 ar = inA.realp[i], ai = inA.imagp[i], br = inB.realp[i], bi = inB.imagp[i];
+		outD.realp[i] = inC.realp[i] + (ar * br - ai * bi);
+		outD.imagp[i] = inC.imagp[i] + (ar * bi + ai * br);
+	}
+#endif
+}
+
+inline void	CAVectorDSP::Magnitudes(const CADSPSplitComplex& inSplit, Float32* outMagnitudes, UInt32 inCount)
+{
+#if CA_VECTOR_DSP_USE_ACCELERATE
+	vDSP_zvabs(const_cast<CADSPSplitComplex*>(&inSplit), 1, outMagnitudes, 1, inCount);
+#else
+	UInt32 i = 0;
+#if CA_VECTOR_DSP_HAS_FLOAT4
+	for (; i + 4 <= inCount; i += 4) {
+		CAVDSPFloat4 re = CAVDSP_Load(inSplit.realp + i), im = CAVDSP_Load(inSplit.imagp + i);
+		CAVDSP_Store(outMagnitudes + i, CAVDSP_Sqrt(CAVDSP_Add(CAVDSP_Mul(re, re), CAVDSP_Mul(im, im))));
+	}
+#endif
+	for (; i < inCount; ++i)
+		outMagnitudes[i] = sqrtf(inSplit.realp[i] * inSplit.realp[i] + inSplit.imagp[i] * inSplit.imagp[i]);
+#endif
+}
+
+inline Float32	CAVectorDSP::MaxMagnitude(const Float32* inA, UInt32 inCount)
+{
+#if CA_VECTOR_DSP_USE_ACCELERATE
+	Float32 result;
+	vDSP_maxmgv(inA, 1, &result, inCount);
+	return result;
+#else
+	UInt32 i = 0;
+	Float32 result = 0.f;
+#if CA_VECTOR_DSP_HAS_FLOAT4
+	if (inCount >= 4) {
+		CAVDSPFloat4 m = CAVDSP_Splat(0.f);
+		for (; i + 4 <= inCount; i += 4)
+			m = CAVDSP_Max(m, CAVDSP_Abs(CAVDSP_Load(inA + i)));
+		Float32 x[4];
+		CAVDSP_Store(x, m);
+		result = std::max(std::max(x[0], x[1]), std::max(x[2], x[3]));
+	}
+#endif
+	for (; i < inCount; ++i)
+		result = std::max(result, fabsf(inA[i]));
+	return result;
+#endif
+}
+
+inline Float32	CAVectorDSP::MinMagnitude(const Float32* inA, UInt32 inCount)
+{
+#if CA_VECTOR_DSP_USE_ACCELERATE
+	Float32 result;
+	vDSP_minmgv(inA, 1, &result, inCount);
+	return result;
+#else
+	UInt32 i = 0;
+	Float32 result = HUGE_VALF;
+#if CA_VECTOR_DSP_HAS_FLOAT4
+	if (inCount >= 4) {
+		CAVDSPFloat4 m = CAVDSP_Splat(HUGE_VALF);
+		for (; i + 4 <= inCount; i += 4)
+			m = CAVDSP_Min(m, CAVDSP_Abs(CAVDSP_Load(inA + i)));
+		Float32 x[4];
+		CAVDSP_Store(x, m);
+		result = std::min(std::min(x[0], x[1]), std::min(x[2], x[3]));
+	}
+#endif
+	for (; i < inCount; ++i)
+		result = std::min(result, fabsf(inA[i]));
+	return result;
+#endif
+}
+
+#endif // __CAVectorDSP_h__
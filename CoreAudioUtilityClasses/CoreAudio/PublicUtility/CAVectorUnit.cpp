@@ -46,9 +46,9 @@
 */
 #include "CAVectorUnit.h"
 
-#if !TARGET_OS_WIN32
+#if TARGET_OS_MAC
 	#include <sys/sysctl.h>
-#elif HAS_IPP
+#elif TARGET_OS_WIN32 && HAS_IPP
 	#include "ippdefs.h"
 	#include "ippcore.h"
 #endif
@@ -184,6 +184,15 @@ SInt32	CAVectorUnit_Examine()
 		result = kVecNeon;
 	#endif
 	}
+#else
+	// no sysctl to ask, so go by what the compiler was told it can target
+	#if defined(__SSE3__)
+		result = kVecSSE3;
+	#elif defined(__SSE2__)
+		result = kVecSSE2;
+	#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+		result = kVecNeon;
+	#endif
 #endif
 	gCAVectorUnitType = result;
 	return result;
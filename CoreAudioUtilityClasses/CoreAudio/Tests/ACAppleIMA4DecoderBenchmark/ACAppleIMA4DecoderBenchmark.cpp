@@ -0,0 +1,316 @@
+/*
+     File: ACAppleIMA4DecoderBenchmark.cpp 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.2 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2012 Apple Inc. All Rights Reserved. 
+  
+*/
+// ACAppleIMA4DecoderBenchmark checks ACAppleIMA4Decoder against the decoder it replaced, which decoded
+// one channel of one packet at a time, and times the two. The streams are mono and stereo random
+// nibbles whose packet headers mostly carry the state the decoder reaches on its own and otherwise
+// a random one, so that both branches of the header check are taken. The codec is fed through
+// AppendInputData() and drained through ProduceOutputPackets() in requests of varying size.
+// Prints frames decoded per second for each; exits nonzero if any sample differs.
+//
+//	c++ -O2 -I../../PublicUtility -I../../AudioCodecs/ACPublic -I../../AudioUnits/AUPublic/AUBase
+//		-I../../../../AudioCodecSDK -I../../../../AudioCodecSDK/Codecs/IMA4 ACAppleIMA4DecoderBenchmark.cpp
+//		../../../../AudioCodecSDK/Codecs/IMA4/ACAppleIMA4Codec.cpp ../../../../AudioCodecSDK/Codecs/IMA4/ACAppleIMA4Decoder.cpp
+//		../../AudioCodecs/ACPublic/ACBaseCodec.cpp ../../AudioCodecs/ACPublic/ACSimpleCodec.cpp ../../AudioCodecs/ACPublic/ACCodec.cpp
+//		../../AudioCodecs/ACPublic/GetCodecBundle.cpp ../../AudioUnits/AUPublic/AUBase/ComponentBase.cpp
+//		../../PublicUtility/CAStreamBasicDescription.cpp ../../PublicUtility/CABundleLocker.cpp ../../PublicUtility/CADebugPrintf.cpp
+//		-framework AudioToolbox -framework CoreServices -framework CoreFoundation
+
+#include "ACAppleIMA4Decoder.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <vector>
+
+enum {
+	kFramesPerPacket = 64,
+	kBytesPerChannelPacket = 34,
+	kNumCheckPackets = 3000,
+	kNumTimedPackets = 20000,
+	kNumTimedRuns = 5
+};
+
+static double Now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+// the decoder as it was before it decoded every channel of every packet in one pass
+
+static const SInt16	kIndexTable[16] = { -1,-1,-1,-1, 2, 4, 6, 8, -1,-1,-1,-1, 2, 4, 6, 8 };
+static const SInt16	kStepTable[89] = {	    7,     8,     9,    10,    11,    12,    13,    14,    16,    17,
+										   19,    21,    23,    25,    28,    31,    34,    37,    41,    45,
+										   50,    55,    60,    66,    73,    80,    88,    97,   107,   118,
+										  130,   143,   157,   173,   190,   209,   230,   253,   279,   307,
+										  337,   371,   408,   449,   494,   544,   598,   658,   724,   796,
+										  876,   963,  1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+										 2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,
+										 5894,  6484,  7132,  7845,  8630,  9493, 10442, 11487, 12635, 13899,
+										15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767 };
+
+struct ReferenceState
+{
+	SInt32	mPredictedSample;
+	SInt32	mStepTableIndex;
+};
+
+// decodes one channel of one packet into every inStride'th sample of outOutput
+static void ReferenceDecodeChannelPacket(ReferenceState& ioState, const Byte* inPacket, SInt16* outOutput, UInt32 inStride)
+{
+	// use the state stored in the header unless it is close to the one we have
+	SInt16 theHeader = SInt16((inPacket[0] << 8) | inPacket[1]);
+	SInt32 theStoredIndex = theHeader & 0x007F;
+	SInt32 theStoredSample = SInt16(theHeader & 0xFF80);
+	SInt32 theDifference = theStoredSample - ioState.mPredictedSample;
+	if (theStoredIndex != ioState.mStepTableIndex || theDifference > 0x007F || theDifference < -0x007F) {
+		ioState.mPredictedSample = theStoredSample;
+		ioState.mStepTableIndex = theStoredIndex;
+	}
+	
+	const Byte* theInputData = inPacket + 2;
+	SInt32 thePredictedSample = ioState.mPredictedSample;
+	SInt32 theStepTableIndex = ioState.mStepTableIndex;
+	SInt32 theStep = kStepTable[theStepTableIndex];
+	UInt32 theByte = 0;
+	for (UInt32 theSamplesLeft = kFramesPerPacket; theSamplesLeft > 0; --theSamplesLeft) {
+		SInt32 theCode;
+		if (theSamplesLeft & 1)
+			theCode = theByte >> 4;
+		else {
+			theByte = *theInputData++;
+			theCode = theByte & 0x0F;
+		}
+		
+		theDifference = theStep >> 3;
+		if (theCode & 4)
+			theDifference += theStep;
+		if (theCode & 2)
+			theDifference += theStep >> 1;
+		if (theCode & 1)
+			theDifference += theStep >> 2;
+		if (theCode & 8)
+			theDifference = -theDifference;
+		
+		thePredictedSample += theDifference;
+		if (thePredictedSample > 32767)
+			thePredictedSample = 32767;
+		else if (thePredictedSample < -32768)
+			thePredictedSample = -32768;
+		*outOutput = SInt16(thePredictedSample);
+		outOutput += inStride;
+		
+		theStepTableIndex += kIndexTable[theCode];
+		if (theStepTableIndex < 0)
+			theStepTableIndex = 0;
+		else if (theStepTableIndex > 88)
+			theStepTableIndex = 88;
+		theStep = kStepTable[theStepTableIndex];
+	}
+	
+	ioState.mPredictedSample = thePredictedSample;
+	ioState.mStepTableIndex = theStepTableIndex;
+}
+
+static void ReferenceDecode(UInt32 inNumberChannels, const std::vector<Byte>& inStream, std::vector<SInt16>& outSamples)
+{
+	UInt32 theNumberPackets = UInt32(inStream.size()) / (inNumberChannels * kBytesPerChannelPacket);
+	outSamples.resize(theNumberPackets * kFramesPerPacket * inNumberChannels);
+	ReferenceState theStates[kMaxIMA4Channels];
+	memset(theStates, 0, sizeof(theStates));
+	for (UInt32 thePacket = 0; thePacket < theNumberPackets; ++thePacket)
+		for (UInt32 theChannel = 0; theChannel < inNumberChannels; ++theChannel)
+			ReferenceDecodeChannelPacket(theStates[theChannel], &inStream[(thePacket * inNumberChannels + theChannel) * kBytesPerChannelPacket],
+										&outSamples[thePacket * kFramesPerPacket * inNumberChannels + theChannel], inNumberChannels);
+}
+
+static void MakeStream(UInt32 inNumberChannels, UInt32 inNumberPackets, std::vector<Byte>& outStream)
+{
+	outStream.resize(inNumberPackets * inNumberChannels * kBytesPerChannelPacket);
+	std::vector<SInt16> theScratch(kFramesPerPacket);
+	ReferenceState theStates[kMaxIMA4Channels];
+	memset(theStates, 0, sizeof(theStates));
+	for (UInt32 thePacket = 0; thePacket < inNumberPackets; ++thePacket) {
+		for (UInt32 theChannel = 0; theChannel < inNumberChannels; ++theChannel) {
+			Byte* theChannelPacket = &outStream[(thePacket * inNumberChannels + theChannel) * kBytesPerChannelPacket];
+			for (UInt32 i = 2; i < kBytesPerChannelPacket; ++i)
+				theChannelPacket[i] = Byte(rand());
+			UInt16 theHeader;
+			if (rand() % 4 != 0)
+				theHeader = UInt16((theStates[theChannel].mPredictedSample & 0xFF80) | theStates[theChannel].mStepTableIndex);
+			else
+				theHeader = UInt16((rand() & 0xFF80) | (rand() % 89));
+			theChannelPacket[0] = Byte(theHeader >> 8);
+			theChannelPacket[1] = Byte(theHeader);
+			ReferenceDecodeChannelPacket(theStates[theChannel], theChannelPacket, &theScratch[0], 1);
+		}
+	}
+}
+
+// the codec under test, given the subtype that its component would have
+class TestDecoder : public ACAppleIMA4Decoder
+{
+public:
+	TestDecoder(UInt32 inNumberChannels)
+		: ACAppleIMA4Decoder(kAudioFormatAppleIMA4)
+	{
+		mCodecSubType = kAudioFormatAppleIMA4;
+		
+		AudioStreamBasicDescription theInputFormat;
+		memset(&theInputFormat, 0, sizeof(theInputFormat));
+		theInputFormat.mSampleRate = 44100.;
+		theInputFormat.mFormatID = kAudioFormatAppleIMA4;
+		theInputFormat.mBytesPerPacket = inNumberChannels * kBytesPerChannelPacket;
+		theInputFormat.mFramesPerPacket = kFramesPerPacket;
+		theInputFormat.mChannelsPerFrame = inNumberChannels;
+		
+		AudioStreamBasicDescription theOutputFormat;
+		memset(&theOutputFormat, 0, sizeof(theOutputFormat));
+		theOutputFormat.mSampleRate = 44100.;
+		theOutputFormat.mFormatID = kAudioFormatLinearPCM;
+		theOutputFormat.mFormatFlags = kLinearPCMFormatFlagIsSignedInteger | kAudioFormatFlagsNativeEndian | kAudioFormatFlagIsPacked;
+		theOutputFormat.mBytesPerPacket = theOutputFormat.mBytesPerFrame = inNumberChannels * sizeof(SInt16);
+		theOutputFormat.mFramesPerPacket = 1;
+		theOutputFormat.mChannelsPerFrame = inNumberChannels;
+		theOutputFormat.mBitsPerChannel = 16;
+		
+		Initialize(&theInputFormat, &theOutputFormat, NULL, 0);
+	}
+};
+
+// inMaxRequest of 0 asks for every packet that is left
+static void CodecDecode(UInt32 inNumberChannels, const std::vector<Byte>& inStream, std::vector<SInt16>& outSamples, UInt32 inMaxRequest)
+{
+	TestDecoder theDecoder(inNumberChannels);
+	UInt32 thePacketBytes = inNumberChannels * kBytesPerChannelPacket;
+	UInt32 theNumberPackets = UInt32(inStream.size()) / thePacketBytes;
+	outSamples.assign(theNumberPackets * kFramesPerPacket * inNumberChannels, 0);
+	
+	UInt32 theAppended = 0, theDecoded = 0, theRequest = 1;
+	while (theDecoded < theNumberPackets) {
+		UInt32 theNumberToAppend = theNumberPackets - theAppended;
+		UInt32 theByteSize = theNumberToAppend * thePacketBytes;
+		if (theNumberToAppend > 0) {
+			theDecoder.AppendInputData(&inStream[theAppended * thePacketBytes], theByteSize, theNumberToAppend, NULL);
+			theAppended += theNumberToAppend;
+		}
+		
+		UInt32 theNumberToDecode = theNumberPackets - theDecoded;
+		if (inMaxRequest > 0) {
+			theRequest = theRequest * 7 % inMaxRequest + 1;
+			if (theNumberToDecode > theRequest)
+				theNumberToDecode = theRequest;
+		}
+		UInt32 theOutputByteSize = theNumberToDecode * kFramesPerPacket * inNumberChannels * sizeof(SInt16);
+		theDecoder.ProduceOutputPackets(&outSamples[theDecoded * kFramesPerPacket * inNumberChannels], theOutputByteSize, theNumberToDecode, NULL);
+		theDecoded += theNumberToDecode;
+	}
+}
+
+static bool Check(UInt32 inNumberChannels, UInt32 inMaxRequest)
+{
+	char theRequests[32];
+	if (inMaxRequest > 0)
+		snprintf(theRequests, sizeof(theRequests), "up to %u packet(s)", (unsigned)inMaxRequest);
+	else
+		snprintf(theRequests, sizeof(theRequests), "all of the packets");
+	
+	std::vector<Byte> theStream;
+	std::vector<SInt16> theExpected, theDecoded;
+	MakeStream(inNumberChannels, kNumCheckPackets, theStream);
+	ReferenceDecode(inNumberChannels, theStream, theExpected);
+	CodecDecode(inNumberChannels, theStream, theDecoded, inMaxRequest);
+	
+	for (size_t i = 0; i < theExpected.size(); ++i) {
+		if (theDecoded[i] != theExpected[i]) {
+			printf("FAIL: %u channel(s), requests for %s: sample %u is %d, expected %d\n", (unsigned)inNumberChannels,
+					theRequests, (unsigned)i, theDecoded[i], theExpected[i]);
+			return false;
+		}
+	}
+	printf("%u channel(s), requests for %s: identical\n", (unsigned)inNumberChannels, theRequests);
+	return true;
+}
+
+int main()
+{
+	srand(1);
+	try {
+		const UInt32 kMaxRequests[] = { 1, 5, 37, 0 };
+		for (UInt32 theNumberChannels = 1; theNumberChannels <= kMaxIMA4Channels; ++theNumberChannels)
+			for (size_t i = 0; i < sizeof(kMaxRequests) / sizeof(kMaxRequests[0]); ++i)
+				if (!Check(theNumberChannels, kMaxRequests[i]))
+					return 1;
+		
+		printf("\n%u packets, best of %u runs\n", (unsigned)kNumTimedPackets, (unsigned)kNumTimedRuns);
+		printf("channels   per channel Mframes/s   codec Mframes/s\n");
+		for (UInt32 theNumberChannels = 1; theNumberChannels <= kMaxIMA4Channels; ++theNumberChannels) {
+			std::vector<Byte> theStream;
+			std::vector<SInt16> theSamples;
+			MakeStream(theNumberChannels, kNumTimedPackets, theStream);
+			double theReferenceTime = 1e9, theCodecTime = 1e9;
+			for (UInt32 theRun = 0; theRun < kNumTimedRuns; ++theRun) {
+				double theStart = Now();
+				ReferenceDecode(theNumberChannels, theStream, theSamples);
+				double theMiddle = Now();
+				CodecDecode(theNumberChannels, theStream, theSamples, 0);
+				double theEnd = Now();
+				theReferenceTime = std::min(theReferenceTime, theMiddle - theStart);
+				theCodecTime = std::min(theCodecTime, theEnd - theMiddle);
+			}
+			double theFrames = double(kNumTimedPackets) * kFramesPerPacket;
+			printf("%8u   %21.1f   %15.1f\n", (unsigned)theNumberChannels, theFrames / theReferenceTime * 1e-6, theFrames / theCodecTime * 1e-6);
+		}
+	} catch (OSStatus inError) {
+		printf("FAIL: the codec threw %d\n", (int)inError);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,222 @@
+/*
+     File: ACAppleIMA4EncoderParallelTest.cpp 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.2 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2012 Apple Inc. All Rights Reserved. 
+  
+*/
+// ACAppleIMA4EncoderParallelTest checks that a parallel encode with ACAppleIMA4Encoder, with
+// kIMA4EncoderPropertyParallelBitExact left on, writes exactly the bytes of a serial encode. It
+// encodes mono and stereo signals that stress the seams between segments differently: a wavering
+// tone with noise, full scale white noise, and full scale square bursts between silences. Each is
+// encoded serially and then with 2 to 16 segments, in one request and in requests of 3000 packets.
+// Prints the time of each encode, and for reference how many packets differ when the seams are not
+// reconciled; exits nonzero if a bit-exact parallel encode differs from the serial one.
+//
+//	c++ -O2 -I../../PublicUtility -I../../AudioCodecs/ACPublic -I../../AudioUnits/AUPublic/AUBase
+//		-I../../../../AudioCodecSDK -I../../../../AudioCodecSDK/Codecs/IMA4 ACAppleIMA4EncoderParallelTest.cpp
+//		../../../../AudioCodecSDK/Codecs/IMA4/ACAppleIMA4Codec.cpp ../../../../AudioCodecSDK/Codecs/IMA4/ACAppleIMA4Encoder.cpp
+//		../../AudioCodecs/ACPublic/ACBaseCodec.cpp ../../AudioCodecs/ACPublic/ACSimpleCodec.cpp ../../AudioCodecs/ACPublic/ACCodec.cpp
+//		../../AudioCodecs/ACPublic/GetCodecBundle.cpp ../../AudioUnits/AUPublic/AUBase/ComponentBase.cpp
+//		../../PublicUtility/CAStreamBasicDescription.cpp ../../PublicUtility/CABundleLocker.cpp ../../PublicUtility/CADebugPrintf.cpp
+//		../../PublicUtility/CARealtimeThreadPool.cpp ../../PublicUtility/CAPThread.cpp ../../PublicUtility/CAHostTimeBase.cpp
+//		-framework AudioToolbox -framework CoreAudio -framework CoreServices -framework CoreFoundation
+
+#include "ACAppleIMA4Encoder.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <vector>
+
+enum {
+	kFramesPerPacket = 64,
+	kBytesPerChannelPacket = 34,
+	kNumPackets = 8192,
+	kRequestPackets = 3000
+};
+
+enum { kSignal_Tone, kSignal_Noise, kSignal_Bursts, kNumSignals };
+static const char* const kSignalNames[kNumSignals] = { "tone", "noise", "bursts" };
+
+static double Now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static void MakeSignal(UInt32 inSignal, UInt32 inNumberChannels, std::vector<SInt16>& outSamples)
+{
+	outSamples.resize(kNumPackets * kFramesPerPacket * inNumberChannels);
+	double thePhase = 0.;
+	for (size_t i = 0; i < outSamples.size(); ++i) {
+		double theValue;
+		switch (inSignal) {
+			case kSignal_Tone:
+				thePhase += 0.03 + 0.02 * sin(i * 1e-4);
+				theValue = 12000. * sin(thePhase) + (rand() % 2001 - 1000);
+				break;
+			case kSignal_Noise:
+				theValue = rand() % 65536 - 32768;
+				break;
+			default:
+				theValue = ((i / 7000) % 2) ? (((i / 3) % 2) ? 32767. : -32768.) : 0.;
+				break;
+		}
+		outSamples[i] = SInt16(std::max(-32768., std::min(32767., theValue)));
+	}
+}
+
+// the codec under test, given the subtype that its component would have
+class TestEncoder : public ACAppleIMA4Encoder
+{
+public:
+	TestEncoder(UInt32 inNumberChannels, UInt32 inParallelSegments, bool inParallelBitExact)
+		: ACAppleIMA4Encoder(kAudioFormatAppleIMA4)
+	{
+		mCodecSubType = kAudioFormatAppleIMA4;
+		
+		UInt32 theBitExact = inParallelBitExact ? 1 : 0;
+		SetProperty(kIMA4EncoderPropertyParallelSegments, sizeof(inParallelSegments), &inParallelSegments);
+		SetProperty(kIMA4EncoderPropertyParallelBitExact, sizeof(theBitExact), &theBitExact);
+		
+		AudioStreamBasicDescription theInputFormat;
+		memset(&theInputFormat, 0, sizeof(theInputFormat));
+		theInputFormat.mSampleRate = 44100.;
+		theInputFormat.mFormatID = kAudioFormatLinearPCM;
+		theInputFormat.mFormatFlags = kAudioFormatFlagsNativeEndian | kAudioFormatFlagIsSignedInteger | kAudioFormatFlagIsPacked;
+		theInputFormat.mBytesPerPacket = theInputFormat.mBytesPerFrame = inNumberChannels * sizeof(SInt16);
+		theInputFormat.mFramesPerPacket = 1;
+		theInputFormat.mChannelsPerFrame = inNumberChannels;
+		theInputFormat.mBitsPerChannel = 16;
+		
+		AudioStreamBasicDescription theOutputFormat;
+		memset(&theOutputFormat, 0, sizeof(theOutputFormat));
+		theOutputFormat.mSampleRate = 44100.;
+		theOutputFormat.mFormatID = kAudioFormatAppleIMA4;
+		theOutputFormat.mBytesPerPacket = inNumberChannels * kBytesPerChannelPacket;
+		theOutputFormat.mFramesPerPacket = kFramesPerPacket;
+		theOutputFormat.mChannelsPerFrame = inNumberChannels;
+		
+		Initialize(&theInputFormat, &theOutputFormat, NULL, 0);
+	}
+};
+
+// returns the seconds spent encoding; inRequestPackets of 0 asks for every packet that has been appended
+static double CodecEncode(UInt32 inNumberChannels, UInt32 inParallelSegments, bool inParallelBitExact, UInt32 inRequestPackets,
+						const std::vector<SInt16>& inSamples, std::vector<Byte>& outStream)
+{
+	TestEncoder theEncoder(inNumberChannels, inParallelSegments, inParallelBitExact);
+	UInt32 theNumberFrames = UInt32(inSamples.size()) / inNumberChannels;
+	UInt32 theNumberPackets = theNumberFrames / kFramesPerPacket;
+	outStream.assign(theNumberPackets * inNumberChannels * kBytesPerChannelPacket, 0);
+	
+	double theStart = Now();
+	UInt32 theAppendedFrames = 0, theEncodedPackets = 0;
+	while (theEncodedPackets < theNumberPackets) {
+		UInt32 theNumberToAppend = theNumberFrames - theAppendedFrames;
+		if (theNumberToAppend > 0) {
+			UInt32 theByteSize = theNumberToAppend * inNumberChannels * sizeof(SInt16);
+			theEncoder.AppendInputData(&inSamples[theAppendedFrames * inNumberChannels], theByteSize, theNumberToAppend, NULL);
+			theAppendedFrames += theNumberToAppend;
+		}
+		
+		UInt32 theNumberToEncode = theNumberPackets - theEncodedPackets;
+		if (inRequestPackets > 0 && theNumberToEncode > inRequestPackets)
+			theNumberToEncode = inRequestPackets;
+		UInt32 theOutputByteSize = theNumberToEncode * inNumberChannels * kBytesPerChannelPacket;
+		theEncoder.ProduceOutputPackets(&outStream[theEncodedPackets * inNumberChannels * kBytesPerChannelPacket], theOutputByteSize, theNumberToEncode, NULL);
+		theEncodedPackets += theNumberToEncode;
+	}
+	return Now() - theStart;
+}
+
+static UInt32 CountDifferentPackets(UInt32 inNumberChannels, const std::vector<Byte>& inExpected, const std::vector<Byte>& inActual)
+{
+	UInt32 thePacketBytes = inNumberChannels * kBytesPerChannelPacket;
+	UInt32 theCount = 0;
+	for (size_t thePacket = 0; thePacket < inExpected.size() / thePacketBytes; ++thePacket)
+		if (memcmp(&inExpected[thePacket * thePacketBytes], &inActual[thePacket * thePacketBytes], thePacketBytes) != 0)
+			++theCount;
+	return theCount;
+}
+
+int main()
+{
+	srand(3);
+	try {
+		const UInt32 kRequests[] = { 0, kRequestPackets };
+		printf("%u packets per signal; request of 0 packets means all of them\n", (unsigned)kNumPackets);
+		printf("channels   signal   request   segments   serial ms   parallel ms   unreconciled packets that differ\n");
+		for (UInt32 theNumberChannels = 1; theNumberChannels <= kMaxIMA4Channels; ++theNumberChannels) {
+			for (UInt32 theSignal = 0; theSignal < kNumSignals; ++theSignal) {
+				std::vector<SInt16> theSamples;
+				MakeSignal(theSignal, theNumberChannels, theSamples);
+				for (size_t theRequestIndex = 0; theRequestIndex < sizeof(kRequests) / sizeof(kRequests[0]); ++theRequestIndex) {
+					UInt32 theRequest = kRequests[theRequestIndex];
+					std::vector<Byte> theSerial, theParallel, theUnreconciled;
+					double theSerialTime = CodecEncode(theNumberChannels, 1, true, theRequest, theSamples, theSerial);
+					for (UInt32 theSegments = 2; theSegments <= 16; theSegments *= 2) {
+						double theParallelTime = CodecEncode(theNumberChannels, theSegments, true, theRequest, theSamples, theParallel);
+						CodecEncode(theNumberChannels, theSegments, false, theRequest, theSamples, theUnreconciled);
+						UInt32 theDifferences = CountDifferentPackets(theNumberChannels, theSerial, theParallel);
+						printf("%8u   %-6s   %7u   %8u   %9.2f   %11.2f   %u\n", (unsigned)theNumberChannels, kSignalNames[theSignal], (unsigned)theRequest,
+								(unsigned)theSegments, theSerialTime * 1e3, theParallelTime * 1e3,
+								(unsigned)CountDifferentPackets(theNumberChannels, theSerial, theUnreconciled));
+						if (theDifferences > 0) {
+							printf("FAIL: %u packets of the bit-exact parallel encode differ from the serial encode\n", (unsigned)theDifferences);
+							return 1;
+						}
+					}
+				}
+			}
+		}
+	} catch (OSStatus inError) {
+		printf("FAIL: the codec threw %d\n", (int)inError);
+		return 1;
+	}
+	return 0;
+}
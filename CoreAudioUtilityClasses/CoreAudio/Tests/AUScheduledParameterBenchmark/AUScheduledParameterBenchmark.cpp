@@ -0,0 +1,258 @@
+/*
+     File: AUScheduledParameterBenchmark.cpp 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.2 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2012 Apple Inc. All Rights Reserved. 
+  
+*/
+// AUScheduledParameterBenchmark drives AUBase's scheduled parameter queue with 1,000 automation events
+// per 512 frame buffer: a quarter of them ramps, the rest immediate changes, spread over 16 parameters.
+// Each buffer schedules its events with ScheduleParameter(), takes them the way DoRender() does, and
+// renders them with ProcessForScheduledParams(). The events arrive in time order, in reverse and
+// shuffled, and each order is also run through the sorted insert ScheduleParameter() used to do, a
+// binary search followed by shifting the rest of the list up. Prints microseconds per buffer spent
+// scheduling and in total; exits nonzero if the two queues order a buffer's events differently, or
+// if events beyond GetMaxScheduledParameterEvents() are not dropped and counted.
+//
+//	c++ -O2 -I../../PublicUtility -I../../AudioUnits/AUPublic/AUBase -I../../AudioUnits/AUPublic/Utility
+//		AUScheduledParameterBenchmark.cpp ../../AudioUnits/AUPublic/AUBase/*.cpp ../../AudioUnits/AUPublic/Utility/*.cpp
+//		../../PublicUtility/CA*.cpp -framework AudioToolbox -framework AudioUnit -framework CoreServices
+
+#include "AUBase.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <vector>
+
+static const UInt32		kFramesPerBuffer = 512;
+static const UInt32		kEventsPerBuffer = 1000;
+static const UInt32		kNumParameters = 16;
+static const UInt32		kNumBuffers = 2000;
+
+static double Now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static SInt32 StartOffset(const AudioUnitParameterEvent &inEvent)
+{
+	return inEvent.eventType == kParameterEvent_Immediate ? SInt32(inEvent.eventValues.immediate.bufferOffset) : inEvent.eventValues.ramp.startBufferOffset;
+}
+
+static bool StartsEarlier(const AudioUnitParameterEvent &inEvent1, const AudioUnitParameterEvent &inEvent2)
+{
+	return StartOffset(inEvent1) < StartOffset(inEvent2);
+}
+
+// an AUBase with no buses, just parameters, whose slices only read them
+class BenchUnit : public AUBase
+{
+public:
+	typedef ParameterEventList	EventList;
+	
+	BenchUnit() : AUBase(NULL, 0, 0), mNumSlices(0), mSum(0.f)
+	{
+		CreateElements();
+		Globals()->UseIndexedParameters(kNumParameters);
+	}
+	
+	virtual bool		StreamFormatWritable(AudioUnitScope, AudioUnitElement) { return false; }
+	
+	virtual OSStatus	ProcessScheduledSlice(void *, UInt32, UInt32, UInt32)
+	{
+		++mNumSlices;
+		for (UInt32 i = 0; i < kNumParameters; ++i)
+			mSum += Globals()->GetParameter(i);
+		return noErr;
+	}
+	
+	// what ScheduleParameter() did before the heap: find the place after any events at the same time,
+	// then insert there, moving everything after it
+	void				ScheduleSorted(const AudioUnitParameterEvent *inEvents, UInt32 inNumEvents)
+	{
+		for (UInt32 i = 0; i < inNumEvents; ++i) {
+			const AudioUnitParameterEvent &event = inEvents[i];
+			if (event.eventType == kParameterEvent_Immediate)
+				SetParameter(event.parameter, event.scope, event.element, event.eventValues.immediate.value, event.eventValues.immediate.bufferOffset);
+			ParameterEventList::iterator pos = std::upper_bound(mParamList.begin(), mParamList.end(), event, StartsEarlier);
+			mParamListSequences.insert(mParamListSequences.begin() + (pos - mParamList.begin()), SInt32(i));
+			mParamList.insert(pos, event);
+		}
+	}
+	
+	// the part of DoRender() that concerns scheduled parameters
+	void				TakeScheduled() { TakeScheduledParameterEvents(); }
+	void				Render()
+	{
+		ProcessForScheduledParams(mParamList, kFramesPerBuffer, NULL);
+		mParamList.clear();
+		mParamListSequences.clear();
+	}
+	
+	const EventList &	ScheduledEvents() const { return mParamList; }
+	
+	UInt32				mNumSlices;
+	Float32				mSum;
+};
+
+enum EventOrder { kOrder_InTime, kOrder_Reversed, kOrder_Shuffled };
+static const char *kOrderNames[] = { "in time order", "reversed", "shuffled" };
+
+static void MakeEvents(std::vector<AudioUnitParameterEvent> &outEvents, EventOrder inOrder)
+{
+	outEvents.resize(kEventsPerBuffer);
+	for (UInt32 i = 0; i < kEventsPerBuffer; ++i) {
+		AudioUnitParameterEvent &event = outEvents[i];
+		memset(&event, 0, sizeof(event));
+		event.scope = kAudioUnitScope_Global;
+		event.element = 0;
+		event.parameter = rand() % kNumParameters;
+		UInt32 offset = rand() % kFramesPerBuffer;
+		if (i % 4 == 0) {
+			event.eventType = kParameterEvent_Ramped;
+			event.eventValues.ramp.startBufferOffset = offset;
+			event.eventValues.ramp.durationInFrames = 1 + rand() % 64;
+			event.eventValues.ramp.startValue = Float32(rand()) / Float32(RAND_MAX);
+			event.eventValues.ramp.endValue = Float32(rand()) / Float32(RAND_MAX);
+		} else {
+			event.eventType = kParameterEvent_Immediate;
+			event.eventValues.immediate.bufferOffset = offset;
+			event.eventValues.immediate.value = Float32(rand()) / Float32(RAND_MAX);
+		}
+	}
+	if (inOrder != kOrder_Shuffled)
+		std::stable_sort(outEvents.begin(), outEvents.end(), StartsEarlier);
+	if (inOrder == kOrder_Reversed)
+		std::reverse(outEvents.begin(), outEvents.end());
+}
+
+static bool CheckOrder(EventOrder inOrder)
+{
+	std::vector<AudioUnitParameterEvent> events;
+	MakeEvents(events, inOrder);
+	BenchUnit heapUnit, sortedUnit;
+	heapUnit.ScheduleParameter(&events[0], kEventsPerBuffer);
+	heapUnit.TakeScheduled();
+	sortedUnit.ScheduleSorted(&events[0], kEventsPerBuffer);
+	
+	const BenchUnit::EventList &heapList = heapUnit.ScheduledEvents(), &sortedList = sortedUnit.ScheduledEvents();
+	if (heapList.size() != sortedList.size() || memcmp(&heapList[0], &sortedList[0], heapList.size() * sizeof(heapList[0])) != 0) {
+		printf("%s: the heap and the sorted insert order the events differently\n", kOrderNames[inOrder]);
+		return false;
+	}
+	return true;
+}
+
+static bool CheckOverflow()
+{
+	BenchUnit unit;
+	const UInt32 extra = 100, numEvents = unit.GetMaxScheduledParameterEvents() + extra;
+	std::vector<AudioUnitParameterEvent> events;
+	while (events.size() < numEvents) {
+		std::vector<AudioUnitParameterEvent> more;
+		MakeEvents(more, kOrder_Shuffled);
+		events.insert(events.end(), more.begin(), more.end());
+	}
+	unit.ScheduleParameter(&events[0], numEvents);
+	unit.TakeScheduled();
+	if (unit.ScheduledEvents().size() != unit.GetMaxScheduledParameterEvents() || unit.GetDroppedParameterEventCount() != extra) {
+		printf("overflow: %u events queued and %u dropped, expected %u and %u\n", (unsigned)unit.ScheduledEvents().size(),
+				(unsigned)unit.GetDroppedParameterEventCount(), (unsigned)unit.GetMaxScheduledParameterEvents(), (unsigned)extra);
+		return false;
+	}
+	return true;
+}
+
+static void TimeQueue(EventOrder inOrder, bool inSorted, double &outScheduleSeconds, double &outTotalSeconds)
+{
+	std::vector<AudioUnitParameterEvent> events;
+	MakeEvents(events, inOrder);
+	BenchUnit unit;
+	outScheduleSeconds = outTotalSeconds = 0.;
+	for (UInt32 buffer = 0; buffer < kNumBuffers; ++buffer) {
+		double start = Now();
+		if (inSorted) {
+			unit.ScheduleSorted(&events[0], kEventsPerBuffer);
+		} else {
+			unit.ScheduleParameter(&events[0], kEventsPerBuffer);
+			unit.TakeScheduled();
+		}
+		double scheduled = Now();
+		unit.Render();
+		double end = Now();
+		outScheduleSeconds += scheduled - start;
+		outTotalSeconds += end - start;
+	}
+	outScheduleSeconds /= kNumBuffers;
+	outTotalSeconds /= kNumBuffers;
+}
+
+int main()
+{
+	srand(1);
+	for (int order = kOrder_InTime; order <= kOrder_Shuffled; ++order) {
+		if (!CheckOrder(EventOrder(order))) {
+			printf("FAIL: scheduled events out of order\n");
+			return 1;
+		}
+	}
+	if (!CheckOverflow()) {
+		printf("FAIL: events beyond the queue's capacity not dropped\n");
+		return 1;
+	}
+	
+	printf("%u events per %u frame buffer, us per buffer\n", (unsigned)kEventsPerBuffer, (unsigned)kFramesPerBuffer);
+	printf("arrival order     queue            schedule      total\n");
+	for (int order = kOrder_InTime; order <= kOrder_Shuffled; ++order) {
+		for (int sorted = 1; sorted >= 0; --sorted) {
+			double schedule, total;
+			TimeQueue(EventOrder(order), sorted != 0, schedule, total);
+			printf("%-17s %-14s %10.1f %10.1f\n", kOrderNames[order], sorted ? "sorted insert" : "append + heap", schedule * 1e6, total * 1e6);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,246 @@
+/*
+     File: CAMixMapRendererBenchmark.cpp 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.2 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2012 Apple Inc. All Rights Reserved. 
+  
+*/
+// CAMixMapRendererBenchmark measures AUPannerBase's bypass mix: CAMixMapRenderer against the loop it
+// replaced, which cleared every output and ran a ScaleAdd for each cross point. It renders 512 frame
+// slices through bypass matrices from mono to stereo up to 64 x 64 identity, diagonal, sparse and
+// dense routings, and prints the time per slice, the speedup and the bytes of active input and output
+// moved per second. The dense 64 x 64 matrix is also timed with a new matrix ramped in every slice.
+// Before timing, it checks that both mixes agree for every matrix.
+// Exits with a nonzero status if the check fails.
+//
+//	c++ -O2 -I../../PublicUtility CAMixMapRendererBenchmark.cpp ../../PublicUtility/CAMixMapRenderer.cpp
+//		../../PublicUtility/CAVectorDSP.cpp -framework Accelerate -framework CoreAudio
+
+#include "CAMixMapRenderer.h"
+#include "CAVectorDSP.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <vector>
+
+static const UInt32		kFramesPerSlice = 512;
+static const UInt32		kNumSlices = 4000;
+
+static double Now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+struct Routing
+{
+	const char*				mName;
+	UInt32					mNumIns;
+	UInt32					mNumOuts;
+	std::vector<Float32>	mMatrix;	// NumIns rows of NumOuts gains, as in CAMixMap
+	
+	Routing(const char* inName, UInt32 inNumIns, UInt32 inNumOuts)
+		: mName(inName), mNumIns(inNumIns), mNumOuts(inNumOuts), mMatrix(inNumIns * inNumOuts, 0.f) {}
+	Float32& Gain(UInt32 inIn, UInt32 inOut) { return mMatrix[inIn * mNumOuts + inOut]; }
+	
+	UInt32 ActiveInputs() const
+	{
+		UInt32 count = 0;
+		for (UInt32 in = 0; in < mNumIns; ++in)
+			for (UInt32 out = 0; out < mNumOuts; ++out)
+				if (mMatrix[in * mNumOuts + out] != 0.f) {
+					++count;
+					break;
+				}
+		return count;
+	}
+};
+
+static void MakeRoutings(std::vector<Routing>& outRoutings)
+{
+	const Float32 kMinus3dB = 0.70710678f;
+	
+	Routing mono("mono to stereo", 1, 2);
+	mono.Gain(0, 0) = mono.Gain(0, 1) = kMinus3dB;
+	outRoutings.push_back(mono);
+	
+	Routing stereo("stereo identity", 2, 2);
+	stereo.Gain(0, 0) = stereo.Gain(1, 1) = 1.f;
+	outRoutings.push_back(stereo);
+	
+	// L R C LFE Ls Rs to L R, dropping the LFE
+	Routing downmix("5.1 to stereo", 6, 2);
+	downmix.Gain(0, 0) = downmix.Gain(1, 1) = 1.f;
+	downmix.Gain(2, 0) = downmix.Gain(2, 1) = kMinus3dB;
+	downmix.Gain(4, 0) = downmix.Gain(5, 1) = kMinus3dB;
+	outRoutings.push_back(downmix);
+	
+	Routing identity("64 x 64 identity", 64, 64);
+	Routing diagonal("64 x 64 diagonal", 64, 64);
+	Routing sparse("64 x 64 sparse", 64, 64);
+	Routing dense("64 x 64 dense", 64, 64);
+	for (UInt32 in = 0; in < 64; ++in) {
+		identity.Gain(in, in) = 1.f;
+		diagonal.Gain(in, in) = 0.5f + in / 128.f;
+		// each output takes its own input and a neighbour's, the last 16 outputs are silent
+		if (in < 48) {
+			sparse.Gain(in, in) = 0.8f;
+			sparse.Gain((in + 1) % 64, in) = 0.2f;
+		}
+		for (UInt32 out = 0; out < 64; ++out)
+			dense.Gain(in, out) = Float32(rand()) / Float32(RAND_MAX) / 64.f;
+	}
+	outRoutings.push_back(identity);
+	outRoutings.push_back(diagonal);
+	outRoutings.push_back(sparse);
+	outRoutings.push_back(dense);
+}
+
+// the loop AUPannerBase::BypassRender ran before CAMixMapRenderer
+static void NaiveMix(const Routing& inRouting, Float32* const* inInputs, Float32* const* outOutputs, UInt32 inNumFrames)
+{
+	for (UInt32 out = 0; out < inRouting.mNumOuts; ++out)
+		memset(outOutputs[out], 0, inNumFrames * sizeof(Float32));
+	for (UInt32 out = 0; out < inRouting.mNumOuts; ++out) {
+		for (UInt32 in = 0; in < inRouting.mNumIns; ++in) {
+			Float32 amp = inRouting.mMatrix[in * inRouting.mNumOuts + out];
+			CAVectorDSP::ScaleAdd(inInputs[in], amp, outOutputs[out], outOutputs[out], inNumFrames);
+		}
+	}
+}
+
+class Buffers
+{
+public:
+	Buffers(UInt32 inNumChannels, bool inFillWithNoise)
+		: mData(inNumChannels * kFramesPerSlice), mChannels(inNumChannels)
+	{
+		for (UInt32 i = 0; i < mData.size(); ++i)
+			mData[i] = inFillWithNoise ? Float32(rand()) / Float32(RAND_MAX) - 0.5f : 0.f;
+		for (UInt32 c = 0; c < inNumChannels; ++c)
+			mChannels[c] = &mData[c * kFramesPerSlice];
+	}
+	Float32* const*	Channels() { return &mChannels[0]; }
+	
+private:
+	std::vector<Float32>	mData;
+	std::vector<Float32*>	mChannels;
+};
+
+static bool Check(const Routing& inRouting)
+{
+	Buffers inputs(inRouting.mNumIns, true), expected(inRouting.mNumOuts, false), actual(inRouting.mNumOuts, false);
+	CAMixMapRenderer renderer;
+	renderer.SetMatrix(&inRouting.mMatrix[0], inRouting.mNumIns, inRouting.mNumOuts);
+	NaiveMix(inRouting, inputs.Channels(), expected.Channels(), kFramesPerSlice);
+	renderer.Render(inputs.Channels(), actual.Channels(), kFramesPerSlice);
+	
+	double maxError = 0.;
+	for (UInt32 out = 0; out < inRouting.mNumOuts; ++out)
+		for (UInt32 i = 0; i < kFramesPerSlice; ++i)
+			maxError = std::max(maxError, fabs(double(expected.Channels()[out][i]) - actual.Channels()[out][i]));
+	if (maxError > 1e-6) {
+		printf("%s: max error %g\n", inRouting.mName, maxError);
+		return false;
+	}
+	return true;
+}
+
+static double TimeNaive(const Routing& inRouting)
+{
+	Buffers inputs(inRouting.mNumIns, true), outputs(inRouting.mNumOuts, false);
+	double start = Now();
+	for (UInt32 slice = 0; slice < kNumSlices; ++slice)
+		NaiveMix(inRouting, inputs.Channels(), outputs.Channels(), kFramesPerSlice);
+	return (Now() - start) / kNumSlices;
+}
+
+static double TimeRenderer(const Routing& inRouting, const Routing* inRampTo)
+{
+	Buffers inputs(inRouting.mNumIns, true), outputs(inRouting.mNumOuts, false);
+	CAMixMapRenderer renderer;
+	renderer.SetMatrix(&inRouting.mMatrix[0], inRouting.mNumIns, inRouting.mNumOuts);
+	double start = Now();
+	for (UInt32 slice = 0; slice < kNumSlices; ++slice) {
+		if (inRampTo) {
+			const Routing& target = (slice & 1) ? inRouting : *inRampTo;
+			renderer.SetMatrix(&target.mMatrix[0], target.mNumIns, target.mNumOuts, kFramesPerSlice);
+		}
+		renderer.Render(inputs.Channels(), outputs.Channels(), kFramesPerSlice);
+	}
+	return (Now() - start) / kNumSlices;
+}
+
+static void PrintRow(const char* inName, const Routing& inRouting, double inNaive, double inRenderer)
+{
+	double bytes = double(inRouting.ActiveInputs() + inRouting.mNumOuts) * kFramesPerSlice * sizeof(Float32);
+	printf("%-24s %12.2f %12.2f %8.1fx %10.2f\n", inName, inNaive * 1e6, inRenderer * 1e6, inNaive / inRenderer, bytes / inRenderer * 1e-9);
+}
+
+int main()
+{
+	srand(1);
+	std::vector<Routing> routings;
+	MakeRoutings(routings);
+	for (size_t i = 0; i < routings.size(); ++i) {
+		if (!Check(routings[i])) {
+			printf("FAIL: CAMixMapRenderer differs from the naive bypass mix\n");
+			return 1;
+		}
+	}
+	printf("%u frame slices, us per slice\n", (unsigned)kFramesPerSlice);
+	printf("matrix                          naive     renderer  speedup   GB/s mixed\n");
+	for (size_t i = 0; i < routings.size(); ++i)
+		PrintRow(routings[i].mName, routings[i], TimeNaive(routings[i]), TimeRenderer(routings[i], NULL));
+	
+	// ramping between two dense matrices every slice: every gain changes, every frame
+	const Routing& dense = routings.back();
+	Routing other("64 x 64 dense, other", 64, 64);
+	for (UInt32 i = 0; i < other.mMatrix.size(); ++i)
+		other.mMatrix[i] = Float32(rand()) / Float32(RAND_MAX) / 64.f;
+	PrintRow("64 x 64 dense, ramping", dense, TimeNaive(dense), TimeRenderer(dense, &other));
+	return 0;
+}
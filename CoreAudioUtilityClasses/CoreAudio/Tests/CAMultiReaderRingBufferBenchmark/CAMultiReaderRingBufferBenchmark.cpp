@@ -0,0 +1,194 @@
+/*
+     File: CAMultiReaderRingBufferBenchmark.cpp 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.2 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2012 Apple Inc. All Rights Reserved. 
+  
+*/
+// CAMultiReaderRingBufferBenchmark compares the throughput of CAMultiReaderRingBuffer with that of
+// CARingBuffer for one writer and 1 to 8 readers. Each pass stores a 512 frame stereo Float32
+// slice and then has every reader fetch it: from CARingBuffer by explicit sample time, as
+// readers of it must track their own positions, and from CAMultiReaderRingBuffer both by
+// explicit time and through each reader's cursor. Prints millions of frames moved per second
+// (stored plus fetched). Exits with a nonzero status if any fetch returns the wrong data.
+//
+//	c++ -O2 -I../../PublicUtility CAMultiReaderRingBufferBenchmark.cpp ../../PublicUtility/CAMultiReaderRingBuffer.cpp
+//		../../PublicUtility/CARingBuffer.cpp
+
+#include "CAMultiReaderRingBuffer.h"
+#include "CARingBuffer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <vector>
+
+static const int		kNumChannels = 2;
+static const UInt32		kFramesPerSlice = 512;
+static const UInt32		kCapacityFrames = 8192;
+static const UInt32		kNumSlices = 40000;
+
+typedef CARingBuffer::SampleTime SampleTime;
+
+static double Now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+// a deinterleaved stereo buffer list over its own storage
+class SliceBufferList {
+public:
+	SliceBufferList() : mStorage(kNumChannels * kFramesPerSlice), mList((AudioBufferList *)calloc(1, offsetof(AudioBufferList, mBuffers) + kNumChannels * sizeof(AudioBuffer)))
+	{
+		mList->mNumberBuffers = kNumChannels;
+		for (int i = 0; i < kNumChannels; ++i) {
+			mList->mBuffers[i].mNumberChannels = 1;
+			mList->mBuffers[i].mData = &mStorage[i * kFramesPerSlice];
+		}
+		Reset();
+	}
+	~SliceBufferList() { free(mList); }
+	
+	void				Reset()
+	{
+		for (int i = 0; i < kNumChannels; ++i)
+			mList->mBuffers[i].mDataByteSize = kFramesPerSlice * sizeof(Float32);
+	}
+	Float32 *			Channel(int inChannel) { return (Float32 *)mList->mBuffers[inChannel].mData; }
+	AudioBufferList *	List() { return mList; }
+	
+private:
+	std::vector<Float32>	mStorage;
+	AudioBufferList *		mList;
+};
+
+static void FillSlice(SliceBufferList &ioSlice, SampleTime inFrame)
+{
+	for (int ch = 0; ch < kNumChannels; ++ch) {
+		Float32 *data = ioSlice.Channel(ch);
+		for (UInt32 i = 0; i < kFramesPerSlice; ++i)
+			data[i] = Float32((inFrame + i) % 100000) + ch * 0.5f;
+	}
+}
+
+// checks the first and last frame of a fetched slice, which is enough to catch a misplaced range
+static bool SliceMatches(SliceBufferList &inSlice, SampleTime inFrame)
+{
+	for (int ch = 0; ch < kNumChannels; ++ch) {
+		const Float32 *data = inSlice.Channel(ch);
+		if (data[0] != Float32(inFrame % 100000) + ch * 0.5f
+				|| data[kFramesPerSlice - 1] != Float32((inFrame + kFramesPerSlice - 1) % 100000) + ch * 0.5f)
+			return false;
+	}
+	return true;
+}
+
+enum Mode { kRingBufferFetch, kMultiReaderFetch, kMultiReaderFetchNext };
+
+static double TimeMode(Mode inMode, UInt32 inNumReaders, bool &outCorrect)
+{
+	CARingBuffer ring;
+	CAMultiReaderRingBuffer multiRing;
+	CAMultiReaderRingBuffer::ReaderID readers[kCAMultiReaderRingBufferMaxReaders];
+	if (inMode == kRingBufferFetch)
+		ring.Allocate(kNumChannels, sizeof(Float32), kCapacityFrames);
+	else {
+		multiRing.Allocate(kNumChannels, sizeof(Float32), kCapacityFrames);
+		for (UInt32 r = 0; r < inNumReaders; ++r)
+			readers[r] = multiRing.AddReader();
+	}
+	
+	SliceBufferList in, out;
+	FillSlice(in, 0);
+	outCorrect = true;
+	double start = Now();
+	for (UInt32 slice = 0; slice < kNumSlices; ++slice) {
+		SampleTime frame = SampleTime(slice) * kFramesPerSlice;
+		// refill only now and then, so the benchmark mostly measures the ring
+		if ((slice & 63) == 0)
+			FillSlice(in, frame);
+		if (inMode == kRingBufferFetch)
+			ring.Store(in.List(), kFramesPerSlice, frame);
+		else
+			multiRing.Store(in.List(), kFramesPerSlice, frame);
+		
+		for (UInt32 r = 0; r < inNumReaders; ++r) {
+			out.Reset();
+			CARingBufferError err;
+			if (inMode == kRingBufferFetch)
+				err = ring.Fetch(out.List(), kFramesPerSlice, frame);
+			else if (inMode == kMultiReaderFetch)
+				err = multiRing.Fetch(out.List(), kFramesPerSlice, frame);
+			else
+				err = multiRing.FetchNext(readers[r], out.List(), kFramesPerSlice);
+			if (err != kCARingBufferError_OK || ((slice & 63) == 0 && !SliceMatches(out, frame)))
+				outCorrect = false;
+		}
+	}
+	double seconds = Now() - start;
+	return double(kNumSlices) * kFramesPerSlice * (1 + inNumReaders) / seconds;
+}
+
+int main()
+{
+	static const char * const kModeNames[] = { "CARingBuffer Fetch", "CAMultiReaderRingBuffer Fetch", "CAMultiReaderRingBuffer FetchNext" };
+	
+	printf("%u frame stereo Float32 slices, capacity %u frames; millions of frames stored and fetched per second\n", (unsigned)kFramesPerSlice, (unsigned)kCapacityFrames);
+	printf("readers   %-20s %-31s %s\n", kModeNames[0], kModeNames[1], kModeNames[2]);
+	bool failed = false;
+	const UInt32 kReaderCounts[] = { 1, 2, 4, 8 };
+	for (size_t i = 0; i < sizeof(kReaderCounts) / sizeof(kReaderCounts[0]); ++i) {
+		double rates[3];
+		for (int mode = kRingBufferFetch; mode <= kMultiReaderFetchNext; ++mode) {
+			bool correct;
+			rates[mode] = TimeMode(Mode(mode), kReaderCounts[i], correct);
+			if (!correct) {
+				printf("FAIL: %s with %u readers fetched the wrong frames\n", kModeNames[mode], (unsigned)kReaderCounts[i]);
+				failed = true;
+			}
+		}
+		printf("%7u   %-20.1f %-31.1f %.1f\n", (unsigned)kReaderCounts[i], rates[0] * 1e-6, rates[1] * 1e-6, rates[2] * 1e-6);
+	}
+	return failed ? 1 : 0;
+}
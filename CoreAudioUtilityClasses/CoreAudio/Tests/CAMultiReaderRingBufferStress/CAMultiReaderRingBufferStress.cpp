@@ -0,0 +1,292 @@
+/*
+     File: CAMultiReaderRingBufferStress.cpp 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.2 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2012 Apple Inc. All Rights Reserved. 
+  
+*/
+// CAMultiReaderRingBufferStress runs one writer thread against several cursor readers of a
+// CAMultiReaderRingBuffer, each reading at its own pace, and checks that every frame a reader
+// gets is the frame the writer stored at that time. It also fetches ranges far behind and
+// ahead of the writer, which must come back zeroed without writing past the caller's buffers.
+// Exits with a nonzero status on the first failure.
+//
+//	c++ -O2 -I../../PublicUtility CAMultiReaderRingBufferStress.cpp ../../PublicUtility/CAMultiReaderRingBuffer.cpp -lpthread
+
+#include "CAMultiReaderRingBuffer.h"
+#include "CAAtomic.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+static const int		kNumChannels = 2;
+static const UInt32		kCapacityFrames = 1024;
+static const UInt32		kMaxChunkFrames = 300;
+static const UInt32		kNumReaders = 4;
+static const UInt32		kGuardFrames = 16;
+static const UInt32		kGuardValue = 0xDEADBEEF;
+
+typedef CAMultiReaderRingBuffer::SampleTime SampleTime;
+
+// each frame holds its own sample time plus one, so zero fill is never mistaken for data
+static inline UInt32 FrameValue(SampleTime inFrame, int inChannel) { return UInt32(inFrame + 1) * kNumChannels + inChannel; }
+
+// a two channel buffer list over storage with guard frames past the end of each buffer
+class TestBufferList {
+public:
+	TestBufferList(UInt32 inFrames) : mFrames(inFrames), mStorage(kNumChannels * (inFrames + kGuardFrames)), mList((AudioBufferList *)calloc(1, offsetof(AudioBufferList, mBuffers) + kNumChannels * sizeof(AudioBuffer)))
+	{
+		mList->mNumberBuffers = kNumChannels;
+		for (int i = 0; i < kNumChannels; ++i) {
+			mList->mBuffers[i].mNumberChannels = 1;
+			mList->mBuffers[i].mData = &mStorage[i * (inFrames + kGuardFrames)];
+		}
+		Prepare(inFrames);
+	}
+	~TestBufferList() { free(mList); }
+	
+	void Prepare(UInt32 inFrames)
+	{
+		for (int i = 0; i < kNumChannels; ++i) {
+			mList->mBuffers[i].mDataByteSize = inFrames * sizeof(UInt32);
+			UInt32 *data = Channel(i);
+			for (UInt32 j = 0; j < mFrames; ++j) data[j] = 0x55555555;
+			for (UInt32 j = 0; j < kGuardFrames; ++j) data[mFrames + j] = kGuardValue;
+		}
+	}
+	bool GuardsIntact()
+	{
+		for (int i = 0; i < kNumChannels; ++i)
+			for (UInt32 j = 0; j < kGuardFrames; ++j)
+				if (Channel(i)[mFrames + j] != kGuardValue) return false;
+		return true;
+	}
+	UInt32 *			Channel(int inChannel) { return (UInt32 *)mList->mBuffers[inChannel].mData; }
+	UInt32				FrameCount() const { return mList->mBuffers[0].mDataByteSize / sizeof(UInt32); }
+	AudioBufferList *	List() { return mList; }
+	
+private:
+	UInt32					mFrames;
+	std::vector<UInt32>		mStorage;
+	AudioBufferList *		mList;
+};
+
+struct ReaderState {
+	CAMultiReaderRingBuffer *	mRing;
+	CAMultiReaderRingBuffer::ReaderID mReader;
+	UInt32						mChunkFrames;
+	UInt32						mPauseMicroseconds;
+	volatile SInt32 *			mStop;
+	UInt64						mFramesRead;
+	UInt32						mOverrunErrors;
+	UInt32						mFailures;
+};
+
+static volatile SInt32 sWriterDone = 0;
+
+static void * ReaderThread(void *inState)
+{
+	ReaderState &state = *(ReaderState *)inState;
+	TestBufferList buffers(state.mChunkFrames);
+	
+	while (!*state.mStop) {
+		SampleTime position = state.mRing->GetReaderPosition(state.mReader);
+		UInt32 overrunsBefore = state.mRing->GetReaderOverruns(state.mReader);
+		buffers.Prepare(state.mChunkFrames);
+		CARingBufferError err = state.mRing->FetchNext(state.mReader, buffers.List(), state.mChunkFrames);
+		UInt32 frames = buffers.FrameCount();
+		
+		if (!buffers.GuardsIntact()) {
+			fprintf(stderr, "reader %d: FetchNext wrote past the end of the buffer\n", (int)state.mReader);
+			++state.mFailures;
+			break;
+		}
+		if (err == kCARingBufferError_ReaderOverrun) {
+			// the writer overwrote the range while it was copied; the contents are undefined
+			++state.mOverrunErrors;
+			continue;
+		}
+		if (err != kCARingBufferError_OK) {
+			fprintf(stderr, "reader %d: FetchNext returned %d\n", (int)state.mReader, (int)err);
+			++state.mFailures;
+			break;
+		}
+		if (frames == 0) {
+			if (sWriterDone) break;
+			sched_yield();
+			continue;
+		}
+		
+		// if the cursor was lapped it resumed at the oldest frame, so read the first frame's time back
+		// from the data rather than trusting the position sampled before the fetch
+		SampleTime first = position;
+		if (state.mRing->GetReaderOverruns(state.mReader) != overrunsBefore)
+			first = SampleTime(buffers.Channel(0)[0] / kNumChannels) - 1;
+		for (UInt32 i = 0; i < frames && state.mFailures == 0; ++i)
+			for (int ch = 0; ch < kNumChannels; ++ch)
+				if (buffers.Channel(ch)[i] != FrameValue(first + i, ch)) {
+					fprintf(stderr, "reader %d: frame %lld channel %d is 0x%08X, expected 0x%08X\n", (int)state.mReader, (long long)(first + i), ch, (unsigned)buffers.Channel(ch)[i], (unsigned)FrameValue(first + i, ch));
+					++state.mFailures;
+				}
+		if (state.mFailures) break;
+		if (state.mRing->GetReaderPosition(state.mReader) != first + frames) {
+			fprintf(stderr, "reader %d: cursor is at %lld after reading %u frames from %lld\n", (int)state.mReader, (long long)state.mRing->GetReaderPosition(state.mReader), (unsigned)frames, (long long)first);
+			++state.mFailures;
+			break;
+		}
+		state.mFramesRead += frames;
+		if (state.mPauseMicroseconds)
+			usleep(state.mPauseMicroseconds);
+	}
+	return NULL;
+}
+
+// explicit fetches entirely behind, entirely ahead of and straddling the valid range
+static UInt32 CheckClipping(CAMultiReaderRingBuffer &ring)
+{
+	UInt32 failures = 0;
+	const UInt32 nFrames = 256;
+	TestBufferList buffers(nFrames);
+	SampleTime startTime, endTime;
+	ring.GetTimeBounds(startTime, endTime);
+	
+	const SampleTime starts[] = { startTime - 100000, startTime - nFrames / 2, endTime - nFrames / 2, endTime + 100000 };
+	for (size_t i = 0; i < sizeof(starts) / sizeof(starts[0]); ++i) {
+		buffers.Prepare(nFrames);
+		ring.Fetch(buffers.List(), nFrames, starts[i]);
+		if (!buffers.GuardsIntact()) {
+			fprintf(stderr, "Fetch at %lld (valid %lld..%lld) wrote past the end of the buffer\n", (long long)starts[i], (long long)startTime, (long long)endTime);
+			++failures;
+		}
+		if (buffers.FrameCount() != nFrames) {
+			fprintf(stderr, "Fetch at %lld returned %u frames\n", (long long)starts[i], (unsigned)buffers.FrameCount());
+			++failures;
+		}
+		for (UInt32 j = 0; j < nFrames; ++j) {
+			SampleTime t = starts[i] + j;
+			UInt32 expected = (t >= startTime && t < endTime) ? FrameValue(t, 0) : 0;
+			if (buffers.Channel(0)[j] != expected) {
+				fprintf(stderr, "Fetch at %lld: frame %lld is 0x%08X, expected 0x%08X\n", (long long)starts[i], (long long)t, (unsigned)buffers.Channel(0)[j], (unsigned)expected);
+				++failures;
+				break;
+			}
+		}
+	}
+	return failures;
+}
+
+int main(int argc, char **argv)
+{
+	const UInt64 totalFrames = (argc > 1) ? strtoull(argv[1], NULL, 10) : 20000000;
+	
+	CAMultiReaderRingBuffer ring;
+	ring.Allocate(kNumChannels, sizeof(UInt32), kCapacityFrames);
+	
+	// readers with different chunk sizes and paces, so some keep up and some get lapped
+	static const UInt32 chunks[kNumReaders] = { 64, 128, 511, 1000 };
+	static const UInt32 pauses[kNumReaders] = { 0, 0, 50, 200 };
+	volatile SInt32 stop = 0;
+	ReaderState states[kNumReaders];
+	pthread_t threads[kNumReaders];
+	for (UInt32 i = 0; i < kNumReaders; ++i) {
+		ReaderState &state = states[i];
+		memset(&state, 0, sizeof(state));
+		state.mRing = &ring;
+		state.mReader = ring.AddReader();
+		state.mChunkFrames = chunks[i];
+		state.mPauseMicroseconds = pauses[i];
+		state.mStop = &stop;
+		if (state.mReader < 0) {
+			fprintf(stderr, "AddReader failed\n");
+			return 1;
+		}
+	}
+	for (UInt32 i = 0; i < kNumReaders; ++i)
+		pthread_create(&threads[i], NULL, ReaderThread, &states[i]);
+	
+	// the writer stores chunks of varying size back to back
+	TestBufferList input(kMaxChunkFrames);
+	SampleTime writeTime = 0;
+	UInt32 failures = 0;
+	UInt32 chunkIndex = 0;
+	while (UInt64(writeTime) < totalFrames) {
+		UInt32 nFrames = 1 + (chunkIndex * 97) % kMaxChunkFrames;
+		for (int ch = 0; ch < kNumChannels; ++ch)
+			for (UInt32 i = 0; i < nFrames; ++i)
+				input.Channel(ch)[i] = FrameValue(writeTime + i, ch);
+		for (int ch = 0; ch < kNumChannels; ++ch)
+			input.List()->mBuffers[ch].mDataByteSize = nFrames * sizeof(UInt32);
+		if (ring.Store(input.List(), nFrames, writeTime) != kCARingBufferError_OK) {
+			fprintf(stderr, "Store of %u frames at %lld failed\n", (unsigned)nFrames, (long long)writeTime);
+			++failures;
+			break;
+		}
+		writeTime += nFrames;
+		if (++chunkIndex % 1024 == 0) {
+			failures += CheckClipping(ring);
+			sched_yield();
+		}
+	}
+	sWriterDone = 1;
+	CAMemoryBarrier();
+	
+	// give the readers a moment to drain, then stop any that are still behind
+	usleep(200000);
+	stop = 1;
+	for (UInt32 i = 0; i < kNumReaders; ++i)
+		pthread_join(threads[i], NULL);
+	
+	for (UInt32 i = 0; i < kNumReaders; ++i) {
+		ReaderState &state = states[i];
+		printf("reader %u: chunk %4u, %10llu frames read, %6u cursor overruns, %6u fetch overruns%s\n", (unsigned)i, (unsigned)state.mChunkFrames,
+				(unsigned long long)state.mFramesRead, (unsigned)ring.GetReaderOverruns(state.mReader), (unsigned)state.mOverrunErrors, state.mFailures ? ", FAILED" : "");
+		failures += state.mFailures;
+		ring.RemoveReader(state.mReader);
+	}
+	printf("%llu frames written; %s\n", (unsigned long long)writeTime, failures ? "FAILED" : "passed");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,172 @@
+/*
+     File: CAPartitionedConvolverBenchmark.cpp 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.2 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2012 Apple Inc. All Rights Reserved. 
+  
+*/
+// CAPartitionedConvolverBenchmark measures the CPU cost of CAPartitionedConvolver per channel for
+// impulse responses of 0.5 to 10 seconds at 96 kHz, rendering in 512 frame slices. It prints the
+// time per slice and the fraction of real time one channel takes, with the tail computed inline
+// and, where the platform has a worker, on it. Before timing, it checks the convolver against
+// direct convolution for a short response with taps in the head, the body and the tail.
+// Exits with a nonzero status if the check fails.
+//
+//	c++ -O2 -I../../PublicUtility CAPartitionedConvolverBenchmark.cpp ../../PublicUtility/CAPartitionedConvolver.cpp
+//		../../PublicUtility/CAVectorDSP.cpp ../../PublicUtility/CARealtimeThreadPool.cpp ../../PublicUtility/CAPThread.cpp
+//		../../PublicUtility/CAHostTimeBase.cpp ../../PublicUtility/CADebugPrintf.cpp -framework Accelerate -framework CoreAudio -framework CoreFoundation
+
+#include "CAPartitionedConvolver.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <vector>
+
+static const Float64	kSampleRate = 96000.;
+static const UInt32		kFramesPerSlice = 512;
+static const Float64	kSecondsRendered = 10.;
+
+static double Now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static void MakeResponse(std::vector<Float32>& outResponse, UInt32 inLength)
+{
+	// decaying noise, like a reverb tail
+	outResponse.resize(inLength);
+	Float32 decay = Float32(log(1000.) / inLength);
+	for (UInt32 i = 0; i < inLength; ++i)
+		outResponse[i] = (Float32(rand()) / Float32(RAND_MAX) - 0.5f) * expf(-decay * i);
+}
+
+static void SetBuffer(AudioBufferList& ioList, Float32* inData, UInt32 inNumFrames)
+{
+	ioList.mNumberBuffers = 1;
+	ioList.mBuffers[0].mNumberChannels = 1;
+	ioList.mBuffers[0].mDataByteSize = inNumFrames * sizeof(Float32);
+	ioList.mBuffers[0].mData = inData;
+}
+
+// slices of varying sizes, so that they cross block and tail block boundaries at every offset
+static bool CheckAgainstDirect(bool inUsesTailThread)
+{
+	const UInt32 kLength = 3000, kNumFrames = 12000;
+	std::vector<Float32> response, input(kNumFrames), output(kNumFrames);
+	MakeResponse(response, kLength);
+	for (UInt32 i = 0; i < kNumFrames; ++i)
+		input[i] = Float32(rand()) / Float32(RAND_MAX) - 0.5f;
+	
+	CAPartitionedConvolver convolver(1, 32, 256);
+	convolver.SetImpulseResponse(0, &response[0], kLength);
+	convolver.SetUsesTailThread(inUsesTailThread);
+	
+	AudioBufferList in, out;
+	for (UInt32 frame = 0, slice = 1; frame < kNumFrames; slice = slice * 7 % 97 + 1) {
+		UInt32 numFrames = std::min(slice, kNumFrames - frame);
+		SetBuffer(in, &input[frame], numFrames);
+		SetBuffer(out, &output[frame], numFrames);
+		convolver.Process(numFrames, &in, &out);
+		frame += numFrames;
+	}
+	
+	double maxError = 0.;
+	for (UInt32 n = 0; n < kNumFrames; ++n) {
+		double expected = 0.;
+		for (UInt32 k = 0; k < kLength && k <= n; ++k)
+			expected += double(response[k]) * input[n - k];
+		maxError = std::max(maxError, fabs(expected - output[n]));
+	}
+	printf("check against direct convolution (%s tail): max error %g\n", convolver.UsesTailThread() ? "worker" : "inline", maxError);
+	return maxError < 1e-4;
+}
+
+static double TimeConvolver(UInt32 inLength, bool inUsesTailThread, bool& outUsedTailThread)
+{
+	std::vector<Float32> response, buffer(kFramesPerSlice);
+	MakeResponse(response, inLength);
+	for (UInt32 i = 0; i < kFramesPerSlice; ++i)
+		buffer[i] = Float32(rand()) / Float32(RAND_MAX) - 0.5f;
+	
+	CAPartitionedConvolver convolver(1);
+	convolver.SetImpulseResponse(0, &response[0], inLength);
+	convolver.SetUsesTailThread(inUsesTailThread);
+	outUsedTailThread = convolver.UsesTailThread();
+	
+	AudioBufferList list;
+	SetBuffer(list, &buffer[0], kFramesPerSlice);
+	UInt32 numSlices = UInt32(kSecondsRendered * kSampleRate / kFramesPerSlice);
+	double start = Now();
+	for (UInt32 slice = 0; slice < numSlices; ++slice)
+		convolver.Process(kFramesPerSlice, &list, &list);
+	return (Now() - start) / numSlices;
+}
+
+int main()
+{
+	srand(1);
+	if (!CheckAgainstDirect(false) || !CheckAgainstDirect(true)) {
+		printf("FAIL: convolver output differs from direct convolution\n");
+		return 1;
+	}
+	
+	printf("\n%u frame slices at %g Hz, one channel\n", (unsigned)kFramesPerSlice, kSampleRate);
+	printf("IR seconds   tail       us per slice   fraction of real time\n");
+	const Float64 kResponseSeconds[] = { 0.5, 1., 2., 5., 10. };
+	for (size_t i = 0; i < sizeof(kResponseSeconds) / sizeof(kResponseSeconds[0]); ++i) {
+		UInt32 length = UInt32(kResponseSeconds[i] * kSampleRate);
+		for (int threaded = 0; threaded < 2; ++threaded) {
+			bool usedTailThread;
+			double seconds = TimeConvolver(length, threaded != 0, usedTailThread);
+			if (threaded && !usedTailThread)
+				break;		// no worker on this platform
+			printf("%10.1f   %-8s %14.1f   %21.4f\n", kResponseSeconds[i], usedTailThread ? "worker" : "inline",
+					seconds * 1e6, seconds * kSampleRate / kFramesPerSlice);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,193 @@
+/*
+     File: CARingBufferFetchConvertedTest.cpp 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.2 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2012 Apple Inc. All Rights Reserved. 
+  
+*/
+// CARingBufferFetchConvertedTest checks CARingBuffer's converting Fetch to interleaved SInt16 and
+// SInt32 against a scalar reference, for 1, 2, 3 and 5 channels stored deinterleaved and
+// interleaved, so that the vector paths for one and two channels and the generic path all run.
+// Each fetch lies entirely before the valid range, partly over its start, inside it, partly over
+// its end or entirely after it; frames outside the range must come back zero, and guard samples
+// after the caller's buffer must be left alone. The stored samples include values past full scale.
+// Exits with a nonzero status on the first failure.
+//
+//	c++ -O2 -I../../PublicUtility CARingBufferFetchConvertedTest.cpp ../../PublicUtility/CARingBuffer.cpp
+
+#include "CARingBuffer.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+static const UInt32		kCapacityFrames = 1024;
+static const UInt32		kFramesStored = 3000;
+static const UInt32		kStoreSliceFrames = 100;
+static const UInt32		kGuardSamples = 64;
+
+typedef CARingBuffer::SampleTime SampleTime;
+
+static void ReferenceConvert(Float32 x, SInt16 &out)
+{
+	x *= 32768.f;
+	if (x > 32767.f) x = 32767.f;
+	else if (x < -32768.f) x = -32768.f;
+	out = (SInt16)lrintf(x);
+}
+
+static void ReferenceConvert(Float32 x, SInt32 &out)
+{
+	if (x > 0.99999994f) x = 0.99999994f;
+	else if (x < -1.f) x = -1.f;
+	out = (SInt32)lrintf(x * 2147483648.f);
+}
+
+static Float32 Sample(SampleTime inFrame, int inChannel)
+{
+	// mostly in range, with a few samples well past full scale in either direction
+	UInt32 hash = UInt32(inFrame * 2654435761u) ^ UInt32(inChannel * 40503u);
+	hash ^= hash >> 15;
+	Float32 x = Float32(hash % 20001) / 10000.f - 1.f;
+	if (hash % 29 == 0) x *= 3.f;
+	return x;
+}
+
+static void StoreAll(CARingBuffer &ioRing, int inNumChannels, bool inInterleaved)
+{
+	std::vector<Float32> storage(inNumChannels * kStoreSliceFrames);
+	std::vector<Byte> listStorage(offsetof(AudioBufferList, mBuffers) + inNumChannels * sizeof(AudioBuffer));
+	AudioBufferList *abl = (AudioBufferList *)&listStorage[0];
+	
+	for (SampleTime frame = 0; frame < kFramesStored; frame += kStoreSliceFrames) {
+		if (inInterleaved) {
+			abl->mNumberBuffers = 1;
+			abl->mBuffers[0].mNumberChannels = inNumChannels;
+			abl->mBuffers[0].mDataByteSize = inNumChannels * kStoreSliceFrames * sizeof(Float32);
+			abl->mBuffers[0].mData = &storage[0];
+			for (UInt32 i = 0; i < kStoreSliceFrames; ++i)
+				for (int ch = 0; ch < inNumChannels; ++ch)
+					storage[i * inNumChannels + ch] = Sample(frame + i, ch);
+		} else {
+			abl->mNumberBuffers = inNumChannels;
+			for (int ch = 0; ch < inNumChannels; ++ch) {
+				abl->mBuffers[ch].mNumberChannels = 1;
+				abl->mBuffers[ch].mDataByteSize = kStoreSliceFrames * sizeof(Float32);
+				abl->mBuffers[ch].mData = &storage[ch * kStoreSliceFrames];
+				for (UInt32 i = 0; i < kStoreSliceFrames; ++i)
+					storage[ch * kStoreSliceFrames + i] = Sample(frame + i, ch);
+			}
+		}
+		ioRing.Store(abl, kStoreSliceFrames, frame);
+	}
+}
+
+template <class T>
+static bool CheckFetch(CARingBuffer &inRing, int inNumChannels, UInt32 inNumFrames, SampleTime inStart, const char *inWhat)
+{
+	const T kGuard = T(0x5A5A);
+	SampleTime startTime, endTime;
+	inRing.GetTimeBounds(startTime, endTime);
+	
+	UInt32 numSamples = inNumFrames * inNumChannels;
+	std::vector<T> out(numSamples + kGuardSamples, kGuard);
+	CARingBufferError err = inRing.Fetch(&out[0], inNumFrames, inStart);
+	if (err != kCARingBufferError_OK) {
+		printf("FAIL: %s fetch of %u frames from %lld returned %d\n", inWhat, (unsigned)inNumFrames, (long long)inStart, (int)err);
+		return false;
+	}
+	for (UInt32 i = 0; i < kGuardSamples; ++i)
+		if (out[numSamples + i] != kGuard) {
+			printf("FAIL: %s fetch of %u frames from %lld wrote past the end of the buffer\n", inWhat, (unsigned)inNumFrames, (long long)inStart);
+			return false;
+		}
+	for (UInt32 i = 0; i < inNumFrames; ++i) {
+		SampleTime frame = inStart + i;
+		for (int ch = 0; ch < inNumChannels; ++ch) {
+			T expected = 0;
+			if (frame >= startTime && frame < endTime)
+				ReferenceConvert(Sample(frame, ch), expected);
+			if (out[i * inNumChannels + ch] != expected) {
+				printf("FAIL: %s fetch from %lld: frame %lld channel %d is %lld, expected %lld\n", inWhat, (long long)inStart,
+						(long long)frame, ch, (long long)out[i * inNumChannels + ch], (long long)expected);
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+int main()
+{
+	const int kChannelCounts[] = { 1, 2, 3, 5 };
+	const UInt32 kFrameCounts[] = { 37, 256 };
+	int numChecks = 0;
+	
+	for (size_t c = 0; c < sizeof(kChannelCounts) / sizeof(kChannelCounts[0]); ++c) {
+		int numChannels = kChannelCounts[c];
+		for (int interleaved = 0; interleaved < 2; ++interleaved) {
+			CARingBuffer ring;
+			ring.Allocate(numChannels, sizeof(Float32), kCapacityFrames, interleaved != 0);
+			StoreAll(ring, numChannels, interleaved != 0);
+			SampleTime startTime, endTime;
+			ring.GetTimeBounds(startTime, endTime);
+			
+			for (size_t f = 0; f < sizeof(kFrameCounts) / sizeof(kFrameCounts[0]); ++f) {
+				SInt64 n = kFrameCounts[f];
+				// entirely before, partly before, inside (across the wrap), partly after and entirely after the valid range
+				const SampleTime starts[] = { startTime - 100000, startTime - n, startTime - n / 2, startTime + 1, endTime - n - 3,
+												endTime - n / 2, endTime, endTime + 100000 };
+				for (size_t s = 0; s < sizeof(starts) / sizeof(starts[0]); ++s) {
+					char what[64];
+					snprintf(what, sizeof(what), "%d channel %s", numChannels, interleaved ? "interleaved" : "deinterleaved");
+					if (!CheckFetch<SInt16>(ring, numChannels, UInt32(n), starts[s], what)
+							|| !CheckFetch<SInt32>(ring, numChannels, UInt32(n), starts[s], what))
+						return 1;
+					numChecks += 2;
+				}
+			}
+		}
+	}
+	printf("PASS: %d fetches\n", numChecks);
+	return 0;
+}
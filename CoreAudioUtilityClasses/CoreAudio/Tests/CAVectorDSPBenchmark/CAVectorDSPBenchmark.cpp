@@ -0,0 +1,233 @@
+/*
+     File: CAVectorDSPBenchmark.cpp 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.2 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2012 Apple Inc. All Rights Reserved. 
+  
+*/
+// CAVectorDSPBenchmark times the CAVectorDSP kernels the render paths use against the plain loops
+// they replace, on slice-sized buffers, and times RealFFT at the sizes the spectral processor and
+// the convolver use. The loops are built with the same flags, so where the compiler vectorizes
+// them itself the comparison shows what the explicit kernels add on top. Prints nanoseconds per
+// sample (per transform for the FFT); exits nonzero if a kernel's result differs from its loop.
+//
+//	c++ -O2 -I../../PublicUtility CAVectorDSPBenchmark.cpp ../../PublicUtility/CAVectorDSP.cpp -framework Accelerate
+//	c++ -O2 -D__COREAUDIO_USE_FLAT_INCLUDES__ -I<dir with CoreAudioTypes.h> -I../../PublicUtility CAVectorDSPBenchmark.cpp ../../PublicUtility/CAVectorDSP.cpp
+
+#include "CAVectorDSP.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <vector>
+
+static const UInt32	kCount = 512;
+static const UInt32	kIterations = 200000;
+
+static double Now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static int sFailures = 0;
+
+// the loops the kernels replace; noinline so the timing loop can't hoist or merge them
+#if defined(__GNUC__)
+	#define BENCH_NOINLINE	__attribute__((noinline))
+#else
+	#define BENCH_NOINLINE
+#endif
+
+BENCH_NOINLINE static void LoopScaleAdd(const Float32 *a, Float32 s, const Float32 *b, Float32 *c, UInt32 n)
+{
+	for (UInt32 i = 0; i < n; ++i) c[i] = a[i] * s + b[i];
+}
+
+BENCH_NOINLINE static void LoopRampMultiplyAdd(const Float32 *a, Float32 &g, Float32 step, Float32 *c, UInt32 n)
+{
+	for (UInt32 i = 0; i < n; ++i) {
+		c[i] += a[i] * g;
+		g += step;
+	}
+}
+
+BENCH_NOINLINE static Float32 LoopDotProduct(const Float32 *a, const Float32 *b, UInt32 n)
+{
+	Float32 sum = 0.f;
+	for (UInt32 i = 0; i < n; ++i) sum += a[i] * b[i];
+	return sum;
+}
+
+BENCH_NOINLINE static void LoopComplexMultiplyAdd(const CADSPSplitComplex &a, const CADSPSplitComplex &b, const CADSPSplitComplex &c, const CADSPSplitComplex &d, UInt32 n)
+{
+	for (UInt32 i = 0; i < n; ++i) {
+		Float32 ar = a.realp[i], ai = a.imagp[i], br = b.realp[i], bi = b.imagp[i];
+		d.realp[i] = c.realp[i] + (ar * br - ai * bi);
+		d.imagp[i] = c.imagp[i] + (ar * bi + ai * br);
+	}
+}
+
+BENCH_NOINLINE static Float32 LoopMaxMagnitude(const Float32 *a, UInt32 n)
+{
+	Float32 m = 0.f;
+	for (UInt32 i = 0; i < n; ++i) m = std::max(m, fabsf(a[i]));
+	return m;
+}
+
+static void Report(const char *inName, double inLoopSeconds, double inKernelSeconds)
+{
+	double scale = 1e9 / (double(kIterations) * kCount);
+	printf("%-22s loop %7.3f ns   kernel %7.3f ns   %5.2fx\n", inName, inLoopSeconds * scale, inKernelSeconds * scale, inLoopSeconds / inKernelSeconds);
+}
+
+static void Compare(const char *inName, const Float32 *inExpected, const Float32 *inActual, UInt32 inCount, Float32 inTolerance)
+{
+	for (UInt32 i = 0; i < inCount; ++i) {
+		if (!(fabsf(inExpected[i] - inActual[i]) <= inTolerance * std::max(1.f, fabsf(inExpected[i])))) {
+			printf("FAIL %s: index %u: loop %.9g, kernel %.9g\n", inName, (unsigned)i, inExpected[i], inActual[i]);
+			++sFailures;
+			return;
+		}
+	}
+}
+
+int main()
+{
+	printf("CAVectorDSP backend: %s, %u samples, %u iterations\n", CAVectorDSP::BackendName(), (unsigned)kCount, (unsigned)kIterations);
+	
+	std::vector<Float32> a(kCount), b(kCount), c(kCount), d(kCount), e(kCount), f(kCount);
+	const UInt32 n = UInt32(a.size());
+	for (UInt32 i = 0; i < n; ++i) {
+		a[i] = sinf(0.01f * i);
+		b[i] = cosf(0.013f * i);
+	}
+	const Float32 s = 0.7f, step = 1e-9f;
+	double t0, loop, kernel;
+	Float32 sink = 0.f;
+	
+	t0 = Now();
+	for (UInt32 it = 0; it < kIterations; ++it) LoopScaleAdd(&a[0], s, &b[0], &c[0], n);
+	loop = Now() - t0;
+	t0 = Now();
+	for (UInt32 it = 0; it < kIterations; ++it) CAVectorDSP::ScaleAdd(&a[0], s, &b[0], &d[0], n);
+	kernel = Now() - t0;
+	Report("ScaleAdd", loop, kernel);
+	Compare("ScaleAdd", &c[0], &d[0], n, 1e-6f);
+	
+	// accumulates into c and d, so both start from zero and see the same gains
+	memset(&c[0], 0, n * sizeof(Float32));
+	memset(&d[0], 0, n * sizeof(Float32));
+	Float32 g = 0.f;
+	t0 = Now();
+	for (UInt32 it = 0; it < kIterations; ++it) { g = 0.25f; LoopRampMultiplyAdd(&a[0], g, step, &c[0], n); }
+	loop = Now() - t0;
+	t0 = Now();
+	for (UInt32 it = 0; it < kIterations; ++it) { g = 0.25f; CAVectorDSP::RampMultiplyAdd(&a[0], g, step, &d[0], n); }
+	kernel = Now() - t0;
+	Report("RampMultiplyAdd", loop, kernel);
+	Compare("RampMultiplyAdd", &c[0], &d[0], n, 1e-3f);
+	
+	Float32 loopDot = 0.f, kernelDot = 0.f;
+	t0 = Now();
+	for (UInt32 it = 0; it < kIterations; ++it) loopDot += LoopDotProduct(&a[0], &b[0], n);
+	loop = Now() - t0;
+	t0 = Now();
+	for (UInt32 it = 0; it < kIterations; ++it) kernelDot += CAVectorDSP::DotProduct(&a[0], &b[0], n);
+	kernel = Now() - t0;
+	Report("DotProduct", loop, kernel);
+	Compare("DotProduct", &loopDot, &kernelDot, 1, 1e-3f);
+	
+	CADSPSplitComplex ca = { &a[0], &b[0] }, cb = { &b[0], &a[0] }, cc = { &a[0], &a[0] };
+	CADSPSplitComplex cd = { &c[0], &d[0] }, ce = { &e[0], &f[0] };
+	t0 = Now();
+	for (UInt32 it = 0; it < kIterations; ++it) LoopComplexMultiplyAdd(ca, cb, cc, cd, n);
+	loop = Now() - t0;
+	t0 = Now();
+	for (UInt32 it = 0; it < kIterations; ++it) CAVectorDSP::ComplexMultiplyAdd(ca, cb, cc, ce, n);
+	kernel = Now() - t0;
+	Report("ComplexMultiplyAdd", loop, kernel);
+	Compare("ComplexMultiplyAdd real", &c[0], &e[0], n, 1e-6f);
+	Compare("ComplexMultiplyAdd imag", &d[0], &f[0], n, 1e-6f);
+	
+	Float32 loopMax = 0.f, kernelMax = 0.f;
+	t0 = Now();
+	for (UInt32 it = 0; it < kIterations; ++it) loopMax = std::max(loopMax, LoopMaxMagnitude(&a[0], n));
+	loop = Now() - t0;
+	t0 = Now();
+	for (UInt32 it = 0; it < kIterations; ++it) kernelMax = std::max(kernelMax, CAVectorDSP::MaxMagnitude(&a[0], n));
+	kernel = Now() - t0;
+	Report("MaxMagnitude", loop, kernel);
+	Compare("MaxMagnitude", &loopMax, &kernelMax, 1, 0.f);
+	
+	for (UInt32 log2Size = 8; log2Size <= 12; ++log2Size) {
+		UInt32 size = 1U << log2Size, half = size / 2;
+		CAVectorDSP::RealFFT fft(log2Size);
+		std::vector<Float32> re(half), im(half);
+		for (UInt32 i = 0; i < half; ++i) {
+			re[i] = sinf(0.1f * i);
+			im[i] = cosf(0.07f * i);
+		}
+		CADSPSplitComplex split = { &re[0], &im[0] };
+		UInt32 transforms = kIterations * kCount / (size * log2Size) + 1;
+		t0 = Now();
+		for (UInt32 it = 0; it < transforms; ++it) {
+			fft.Forward(split);
+			fft.Inverse(split);
+			CAVectorDSP::Scale(&re[0], 1.f / (2.f * size), &re[0], half);
+			CAVectorDSP::Scale(&im[0], 1.f / (2.f * size), &im[0], half);
+		}
+		double seconds = Now() - t0;
+		printf("RealFFT %5u            %9.1f ns per forward + inverse\n", (unsigned)size, seconds * 1e9 / transforms);
+		sink += re[1];
+	}
+	
+	if (sink != sink) printf("\n");		// keeps the FFT loops from being discarded
+	if (sFailures) {
+		printf("%d failures\n", sFailures);
+		return 1;
+	}
+	return 0;
+}
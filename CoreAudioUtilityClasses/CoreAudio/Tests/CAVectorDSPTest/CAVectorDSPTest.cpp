@@ -0,0 +1,256 @@
+/*
+     File: CAVectorDSPTest.cpp 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.2 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2012 Apple Inc. All Rights Reserved. 
+  
+*/
+// CAVectorDSPTest checks each CAVectorDSP kernel against a plain scalar loop, for every length up to
+// a few vectors past the SIMD width and with buffers that start off the 16 byte boundary, and checks
+// RealFFT's packing and scaling against a direct DFT. It tests whichever backend the build selects;
+// define CA_VECTOR_DSP_USE_ACCELERATE=0 on an Apple build to test the portable one.
+// Exits with a nonzero status on the first failure.
+//
+//	c++ -O2 -I../../PublicUtility CAVectorDSPTest.cpp ../../PublicUtility/CAVectorDSP.cpp -framework Accelerate
+//	c++ -O2 -D__COREAUDIO_USE_FLAT_INCLUDES__ -I<dir with CoreAudioTypes.h> -I../../PublicUtility CAVectorDSPTest.cpp ../../PublicUtility/CAVectorDSP.cpp
+
+#include "CAVectorDSP.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <complex>
+#include <vector>
+
+static const UInt32	kMaxCount = 70;
+static const UInt32	kMisalign = 1;		// floats; puts every buffer off the 16 byte boundary
+
+static int sFailures = 0;
+
+static void Fail(const char *inKernel, UInt32 inCount, UInt32 inIndex, double inExpected, double inActual)
+{
+	if (sFailures++ < 20)
+		printf("FAIL %s: count %u, index %u: expected %.9g, got %.9g\n", inKernel, (unsigned)inCount, (unsigned)inIndex, inExpected, inActual);
+}
+
+static void Check(const char *inKernel, UInt32 inCount, UInt32 inIndex, double inExpected, double inActual, double inTolerance)
+{
+	if (!(fabs(inExpected - inActual) <= inTolerance * std::max(1., fabs(inExpected))))
+		Fail(inKernel, inCount, inIndex, inExpected, inActual);
+}
+
+static Float32 Random()
+{
+	return Float32(rand()) / Float32(RAND_MAX) * 2.f - 1.f;
+}
+
+// a buffer that starts kMisalign floats past a vector's start, with guard values on either side
+class TestBuffer
+{
+public:
+	TestBuffer(UInt32 inCount) : mCount(inCount), mStorage(inCount + kMisalign + 8)
+	{
+		for (size_t i = 0; i < mStorage.size(); ++i) mStorage[i] = kGuard;
+		for (UInt32 i = 0; i < inCount; ++i) Data()[i] = Random();
+	}
+	
+	Float32 *		Data() { return &mStorage[kMisalign + 4]; }
+	bool			GuardsIntact() const
+	{
+		for (UInt32 i = 0; i < kMisalign + 4; ++i) if (mStorage[i] != kGuard) return false;
+		for (size_t i = kMisalign + 4 + mCount; i < mStorage.size(); ++i) if (mStorage[i] != kGuard) return false;
+		return true;
+	}
+	
+private:
+	static const Float32	kGuard;
+	UInt32					mCount;
+	std::vector<Float32>	mStorage;
+};
+
+const Float32 TestBuffer::kGuard = 12345.f;
+
+static void CheckGuards(const char *inKernel, UInt32 inCount, const TestBuffer &inBuffer)
+{
+	if (!inBuffer.GuardsIntact()) Fail(inKernel, inCount, inCount, 0., 1.);
+}
+
+static void TestElementwise(UInt32 n)
+{
+	// one rounding per operation, two where the backend may fuse a multiply and add
+	const double kTolerance = 1e-6;
+	TestBuffer a(n), b(n), c(n), d(n);
+	Float32 s = Random();
+	
+	CAVectorDSP::Add(a.Data(), b.Data(), c.Data(), n);
+	for (UInt32 i = 0; i < n; ++i) Check("Add", n, i, a.Data()[i] + b.Data()[i], c.Data()[i], kTolerance);
+	CheckGuards("Add", n, c);
+	
+	CAVectorDSP::Multiply(a.Data(), b.Data(), c.Data(), n);
+	for (UInt32 i = 0; i < n; ++i) Check("Multiply", n, i, a.Data()[i] * b.Data()[i], c.Data()[i], kTolerance);
+	CheckGuards("Multiply", n, c);
+	
+	CAVectorDSP::Scale(a.Data(), s, c.Data(), n);
+	for (UInt32 i = 0; i < n; ++i) Check("Scale", n, i, a.Data()[i] * s, c.Data()[i], kTolerance);
+	CheckGuards("Scale", n, c);
+	
+	CAVectorDSP::ScaleAdd(a.Data(), s, b.Data(), c.Data(), n);
+	for (UInt32 i = 0; i < n; ++i) Check("ScaleAdd", n, i, a.Data()[i] * s + b.Data()[i], c.Data()[i], kTolerance);
+	CheckGuards("ScaleAdd", n, c);
+	
+	// the ramp is accumulated per vector, so allow for a few roundings of the gain
+	Float32 gain = Random(), step = Random() * 0.01f;
+	Float32 startGain = gain;
+	memcpy(d.Data(), c.Data(), n * sizeof(Float32));
+	CAVectorDSP::RampMultiplyAdd(a.Data(), gain, step, c.Data(), n);
+	for (UInt32 i = 0; i < n; ++i)
+		Check("RampMultiplyAdd", n, i, d.Data()[i] + a.Data()[i] * (startGain + double(i) * step), c.Data()[i], 1e-5);
+	Check("RampMultiplyAdd gain", n, n, startGain + double(n) * step, gain, 1e-5);
+	CheckGuards("RampMultiplyAdd", n, c);
+	
+	double dot = 0., dotBound = 0.;
+	for (UInt32 i = 0; i < n; ++i) {
+		dot += double(a.Data()[i]) * b.Data()[i];
+		dotBound += fabs(double(a.Data()[i]) * b.Data()[i]);
+	}
+	Float32 result = CAVectorDSP::DotProduct(a.Data(), b.Data(), n);
+	if (!(fabs(result - dot) <= 1e-6 * (n + 1) * std::max(1., dotBound))) Fail("DotProduct", n, 0, dot, result);
+	
+	Float32 maxMag = 0.f, minMag = HUGE_VALF;
+	for (UInt32 i = 0; i < n; ++i) {
+		maxMag = std::max(maxMag, fabsf(a.Data()[i]));
+		minMag = std::min(minMag, fabsf(a.Data()[i]));
+	}
+	if (CAVectorDSP::MaxMagnitude(a.Data(), n) != maxMag) Fail("MaxMagnitude", n, 0, maxMag, CAVectorDSP::MaxMagnitude(a.Data(), n));
+	if (n && CAVectorDSP::MinMagnitude(a.Data(), n) != minMag) Fail("MinMagnitude", n, 0, minMag, CAVectorDSP::MinMagnitude(a.Data(), n));
+}
+
+static void TestComplex(UInt32 n)
+{
+	const double kTolerance = 1e-6;
+	TestBuffer pairs(2 * n), re(n), im(n), back(2 * n);
+	CADSPSplitComplex split = { re.Data(), im.Data() };
+	
+	CAVectorDSP::Deinterleave(pairs.Data(), split, n);
+	for (UInt32 i = 0; i < n; ++i) {
+		if (re.Data()[i] != pairs.Data()[2 * i]) Fail("Deinterleave real", n, i, pairs.Data()[2 * i], re.Data()[i]);
+		if (im.Data()[i] != pairs.Data()[2 * i + 1]) Fail("Deinterleave imag", n, i, pairs.Data()[2 * i + 1], im.Data()[i]);
+	}
+	CheckGuards("Deinterleave", n, re);
+	CheckGuards("Deinterleave", n, im);
+	
+	CAVectorDSP::Interleave(split, back.Data(), n);
+	if (memcmp(back.Data(), pairs.Data(), 2 * n * sizeof(Float32))) Fail("Interleave", n, 0, 0., 1.);
+	CheckGuards("Interleave", n, back);
+	
+	TestBuffer ar(n), ai(n), br(n), bi(n), cr(n), ci(n), dr(n), di(n);
+	CADSPSplitComplex a = { ar.Data(), ai.Data() }, b = { br.Data(), bi.Data() }, c = { cr.Data(), ci.Data() }, d = { dr.Data(), di.Data() };
+	CAVectorDSP::ComplexMultiplyAdd(a, b, c, d, n);
+	for (UInt32 i = 0; i < n; ++i) {
+		std::complex<double> expected = std::complex<double>(a.realp[i], a.imagp[i]) * std::complex<double>(b.realp[i], b.imagp[i])
+											+ std::complex<double>(c.realp[i], c.imagp[i]);
+		Check("ComplexMultiplyAdd real", n, i, expected.real(), d.realp[i], 4. * kTolerance);
+		Check("ComplexMultiplyAdd imag", n, i, expected.imag(), d.imagp[i], 4. * kTolerance);
+	}
+	CheckGuards("ComplexMultiplyAdd", n, dr);
+	CheckGuards("ComplexMultiplyAdd", n, di);
+	
+	TestBuffer mags(n);
+	CAVectorDSP::Magnitudes(split, mags.Data(), n);
+	for (UInt32 i = 0; i < n; ++i)
+		Check("Magnitudes", n, i, sqrt(double(re.Data()[i]) * re.Data()[i] + double(im.Data()[i]) * im.Data()[i]), mags.Data()[i], 2. * kTolerance);
+	CheckGuards("Magnitudes", n, mags);
+}
+
+static void TestRealFFT(UInt32 inLog2Size)
+{
+	UInt32 size = 1U << inLog2Size, half = size / 2;
+	TestBuffer signal(size), re(half), im(half);
+	CADSPSplitComplex split = { re.Data(), im.Data() };
+	CAVectorDSP::Deinterleave(signal.Data(), split, half);
+	
+	CAVectorDSP::RealFFT fft(inLog2Size);
+	fft.Forward(split);
+	
+	// forward: 2 * X[k] for k < N/2, with the real X[N/2] in imagp[0]
+	double tolerance = 1e-5 * inLog2Size * sqrt(double(size));
+	for (UInt32 k = 0; k <= half; ++k) {
+		std::complex<double> x(0., 0.);
+		for (UInt32 t = 0; t < size; ++t)
+			x += double(signal.Data()[t]) * std::polar(1., -2. * M_PI * double(k) * t / size);
+		x *= 2.;
+		std::complex<double> y = k == 0 ? std::complex<double>(re.Data()[0], 0.)
+								: k == half ? std::complex<double>(im.Data()[0], 0.)
+								: std::complex<double>(re.Data()[k], im.Data()[k]);
+		if (!(std::abs(x - y) <= tolerance)) Fail("RealFFT::Forward", size, k, std::abs(x), std::abs(y));
+	}
+	
+	// inverse is unscaled, so a round trip scales by 2N
+	fft.Inverse(split);
+	TestBuffer roundTrip(size);
+	CAVectorDSP::Interleave(split, roundTrip.Data(), half);
+	for (UInt32 t = 0; t < size; ++t)
+		Check("RealFFT round trip", size, t, signal.Data()[t], roundTrip.Data()[t] / (2. * size), 1e-5 * inLog2Size);
+	CheckGuards("RealFFT", size, re);
+	CheckGuards("RealFFT", size, im);
+}
+
+int main()
+{
+	printf("CAVectorDSP backend: %s\n", CAVectorDSP::BackendName());
+	srand(1);
+	
+	for (UInt32 n = 0; n <= kMaxCount; ++n) {
+		TestElementwise(n);
+		TestComplex(n);
+	}
+	for (UInt32 log2Size = 1; log2Size <= 12; ++log2Size)
+		TestRealFFT(log2Size);
+	
+	if (sFailures) {
+		printf("%d failures\n", sFailures);
+		return 1;
+	}
+	printf("all passed\n");
+	return 0;
+}
@@ -0,0 +1,174 @@
+/*
+     File: CompressedPacketTableBenchmark.cpp 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.2 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2012 Apple Inc. All Rights Reserved. 
+  
+*/
+// CompressedPacketTableBenchmark times seeks in a CompressedPacketTable by frame and by byte offset, with
+// the checkpoint index (FirstPacketAtOrAfterFrame and FirstPacketAtOrAfterByte) and without it, using
+// std::lower_bound over the table's iterator as AudioFileObject did before. Tables of an hour of AAC-like
+// packets are built with contiguous, discontiguous and variable-frame packet descriptions. Prints
+// nanoseconds per seek; exits nonzero if the two ways of seeking ever disagree.
+//
+//	c++ -O2 -I../../PublicUtility -I../../AudioFile/AFPublic CompressedPacketTableBenchmark.cpp
+//		../../AudioFile/AFPublic/CompressedPacketTable.cpp -framework CoreFoundation
+
+#include "CompressedPacketTable.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <vector>
+
+static const UInt32		kFramesPerPacket = 1024;
+static const SInt64		kNumPackets = 44100 * 3600 / kFramesPerPacket;
+static const UInt32		kNumSeeks = 200000;
+
+static double Now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+inline bool byte_less_than (const AudioStreamPacketDescriptionExtended& a, const AudioStreamPacketDescriptionExtended& b)
+{
+	return a.mStartOffset < b.mStartOffset;
+}
+
+enum {
+	kContiguous,
+	kDiscontiguous,
+	kVariableFrames,
+	kNumLayouts
+};
+
+static const char * const kLayoutNames[kNumLayouts] = { "contiguous", "discontig", "variable" };
+
+// fills outTable with kNumPackets packets; returns the total frames and bytes through outFrames and outBytes
+static void BuildTable(int inLayout, CompressedPacketTable &outTable, SInt64 &outFrames, SInt64 &outBytes)
+{
+	srandom(inLayout + 1);
+	SInt64 offset = 4096, frame = 0;
+	for (SInt64 packet = 0; packet < kNumPackets; ++packet) {
+		AudioStreamPacketDescriptionExtended desc;
+		memset(&desc, 0, sizeof(desc));
+		desc.mStartOffset = offset;
+		desc.mDataByteSize = 200 + UInt32(random() % 400);
+		desc.mVariableFramesInPacket = inLayout == kVariableFrames ? 512 + UInt32(random() % 1024) : 0;
+		desc.mFrameOffset = frame;
+		outTable.push_back(desc);
+		
+		offset += desc.mDataByteSize;
+		if (inLayout == kDiscontiguous && (random() & 7) == 0)
+			offset += 8;	// padding between packets
+		frame += inLayout == kVariableFrames ? desc.mVariableFramesInPacket : kFramesPerPacket;
+	}
+	outFrames = frame;
+	outBytes = offset;
+}
+
+static SInt64 LowerBoundFrame(const CompressedPacketTable &inTable, SInt64 inFrame)
+{
+	AudioStreamPacketDescriptionExtended pext;
+	memset(&pext, 0, sizeof(pext));
+	pext.mFrameOffset = inFrame;
+	return std::lower_bound(inTable.begin(), inTable.end(), pext) - inTable.begin();
+}
+
+static SInt64 LowerBoundByte(const CompressedPacketTable &inTable, SInt64 inByteOffset)
+{
+	AudioStreamPacketDescriptionExtended pext;
+	memset(&pext, 0, sizeof(pext));
+	pext.mStartOffset = inByteOffset;
+	return std::lower_bound(inTable.begin(), inTable.end(), pext, byte_less_than) - inTable.begin();
+}
+
+// seeks to each of inTargets; returns seconds and the packet found for each seek in outPackets
+static double Seek(const CompressedPacketTable &inTable, bool inByByte, bool inUseCheckpoints, 
+					const std::vector<SInt64> &inTargets, std::vector<SInt64> &outPackets)
+{
+	outPackets.resize(inTargets.size());
+	double start = Now();
+	for (size_t i = 0; i < inTargets.size(); ++i) {
+		if (inByByte)
+			outPackets[i] = inUseCheckpoints ? inTable.FirstPacketAtOrAfterByte(inTargets[i]) : LowerBoundByte(inTable, inTargets[i]);
+		else
+			outPackets[i] = inUseCheckpoints ? inTable.FirstPacketAtOrAfterFrame(inTargets[i]) : LowerBoundFrame(inTable, inTargets[i]);
+	}
+	return Now() - start;
+}
+
+int main()
+{
+	std::vector<SInt64> targets(kNumSeeks), searched, indexed;
+	int status = 0;
+	
+	printf("%8d packets\n", (int)kNumPackets);
+	printf("%12s %6s %16s %16s %8s\n", "layout", "seek", "lower_bound ns", "checkpoint ns", "speedup");
+	for (int layout = 0; layout < kNumLayouts; ++layout) {
+		CompressedPacketTable table(layout == kVariableFrames ? 0 : kFramesPerPacket);
+		SInt64 numFrames, numBytes;
+		BuildTable(layout, table, numFrames, numBytes);
+		
+		for (int byByte = 0; byByte < 2; ++byByte) {
+			// random seeks over the whole file, a few of them past either end
+			SInt64 range = byByte ? numBytes : numFrames;
+			for (UInt32 i = 0; i < kNumSeeks; ++i)
+				targets[i] = SInt64((double(random()) / RAND_MAX) * (range + 2000)) - 1000;
+			
+			double search = Seek(table, byByte, false, targets, searched);
+			double index = Seek(table, byByte, true, targets, indexed);
+			if (searched != indexed) {
+				fprintf(stderr, "FAILED: %s %s seeks found different packets\n", kLayoutNames[layout], byByte ? "byte" : "frame");
+				status = 1;
+			}
+			
+			printf("%12s %6s %16.1f %16.1f %7.1fx\n", kLayoutNames[layout], byByte ? "byte" : "frame",
+					search * 1e9 / kNumSeeks, index * 1e9 / kNumSeeks, search / index);
+		}
+	}
+	return status;
+}
@@ -0,0 +1,247 @@
+/*
+     File: ConvertFileThroughputBenchmark.cpp 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.2 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2012 Apple Inc. All Rights Reserved. 
+  
+*/
+// ConvertFileThroughputBenchmark times a ConvertFile style transcode through ACSimpleCodec's input
+// ring: a minute of stereo 16 bit audio is encoded to IMA4 with ACAppleIMA4Encoder and decoded back
+// with ACAppleIMA4Decoder. As in ConvertFile, the source is handed over in 32 KB reads and the output
+// is pulled into a 32 KB buffer, and whatever the codec can't take yet is offered again on the next
+// pass, so the ring wraps at every alignment. The codecs' default input buffer sizes are timed and
+// so are a few odd ones. Prints megabytes of audio per second and whether the ring was mirrored;
+// exits nonzero if any input buffer size gives a different encoding or decoding. Build it against
+// the ACSimpleCodec.cpp from before the mirrored ring to get the numbers to compare against.
+//
+//	c++ -O2 -I../../PublicUtility -I../../AudioCodecs/ACPublic -I../../AudioUnits/AUPublic/AUBase
+//		-I../../../../AudioCodecSDK -I../../../../AudioCodecSDK/Codecs/IMA4 ConvertFileThroughputBenchmark.cpp
+//		../../../../AudioCodecSDK/Codecs/IMA4/ACAppleIMA4Codec.cpp ../../../../AudioCodecSDK/Codecs/IMA4/ACAppleIMA4Encoder.cpp
+//		../../../../AudioCodecSDK/Codecs/IMA4/ACAppleIMA4Decoder.cpp
+//		../../AudioCodecs/ACPublic/ACBaseCodec.cpp ../../AudioCodecs/ACPublic/ACSimpleCodec.cpp ../../AudioCodecs/ACPublic/ACCodec.cpp
+//		../../AudioCodecs/ACPublic/GetCodecBundle.cpp ../../AudioUnits/AUPublic/AUBase/ComponentBase.cpp
+//		../../PublicUtility/CAStreamBasicDescription.cpp ../../PublicUtility/CABundleLocker.cpp ../../PublicUtility/CADebugPrintf.cpp
+//		../../PublicUtility/CARealtimeThreadPool.cpp ../../PublicUtility/CAPThread.cpp ../../PublicUtility/CAHostTimeBase.cpp
+//		-framework AudioToolbox -framework CoreAudio -framework CoreServices -framework CoreFoundation
+
+#include "ACAppleIMA4Encoder.h"
+#include "ACAppleIMA4Decoder.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <vector>
+
+enum {
+	kNumberChannels = 2,
+	kFramesPerPacket = 64,
+	kBytesPerChannelPacket = 34,
+	kNumberFrames = 44100 * 60,
+	kFileBufferByteSize = 32768,	// ConvertFile's source and destination buffer size
+	kNumTimedRuns = 3
+};
+
+static const UInt32 kPCMPacketByteSize = kFramesPerPacket * kNumberChannels * sizeof(SInt16);
+static const UInt32 kIMA4PacketByteSize = kNumberChannels * kBytesPerChannelPacket;
+
+static double Now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static void MakeSignal(std::vector<SInt16>& outSamples)
+{
+	outSamples.resize(kNumberFrames * kNumberChannels);
+	double thePhase = 0.;
+	for (size_t i = 0; i < outSamples.size(); ++i) {
+		thePhase += 0.03 + 0.02 * sin(i * 1e-4);
+		outSamples[i] = SInt16(12000. * sin(thePhase) + (rand() % 2001 - 1000));
+	}
+}
+
+static void GetFormats(AudioStreamBasicDescription& outPCMFormat, AudioStreamBasicDescription& outIMA4Format)
+{
+	memset(&outPCMFormat, 0, sizeof(outPCMFormat));
+	outPCMFormat.mSampleRate = 44100.;
+	outPCMFormat.mFormatID = kAudioFormatLinearPCM;
+	outPCMFormat.mFormatFlags = kAudioFormatFlagsNativeEndian | kAudioFormatFlagIsSignedInteger | kAudioFormatFlagIsPacked;
+	outPCMFormat.mBytesPerPacket = outPCMFormat.mBytesPerFrame = kNumberChannels * sizeof(SInt16);
+	outPCMFormat.mFramesPerPacket = 1;
+	outPCMFormat.mChannelsPerFrame = kNumberChannels;
+	outPCMFormat.mBitsPerChannel = 16;
+	
+	memset(&outIMA4Format, 0, sizeof(outIMA4Format));
+	outIMA4Format.mSampleRate = 44100.;
+	outIMA4Format.mFormatID = kAudioFormatAppleIMA4;
+	outIMA4Format.mBytesPerPacket = kIMA4PacketByteSize;
+	outIMA4Format.mFramesPerPacket = kFramesPerPacket;
+	outIMA4Format.mChannelsPerFrame = kNumberChannels;
+}
+
+// the codecs under test, given the subtype that their components would have; an input buffer size of 0 keeps the default
+class TestEncoder : public ACAppleIMA4Encoder
+{
+public:
+	TestEncoder(UInt32 inInputBufferByteSize)
+		: ACAppleIMA4Encoder(kAudioFormatAppleIMA4)
+	{
+		mCodecSubType = kAudioFormatAppleIMA4;
+		if (inInputBufferByteSize > 0)
+			SetProperty(kAudioCodecPropertyInputBufferSize, sizeof(inInputBufferByteSize), &inInputBufferByteSize);
+		AudioStreamBasicDescription thePCMFormat, theIMA4Format;
+		GetFormats(thePCMFormat, theIMA4Format);
+		Initialize(&thePCMFormat, &theIMA4Format, NULL, 0);
+	}
+	bool	IsMirrored() const { return InputBufferIsMirrored(); }
+	UInt32	InputBytesPerPacket() const { return mInputFormat.mBytesPerPacket; }
+};
+
+class TestDecoder : public ACAppleIMA4Decoder
+{
+public:
+	TestDecoder(UInt32 inInputBufferByteSize)
+		: ACAppleIMA4Decoder(kAudioFormatAppleIMA4)
+	{
+		mCodecSubType = kAudioFormatAppleIMA4;
+		if (inInputBufferByteSize > 0)
+			SetProperty(kAudioCodecPropertyInputBufferSize, sizeof(inInputBufferByteSize), &inInputBufferByteSize);
+		AudioStreamBasicDescription thePCMFormat, theIMA4Format;
+		GetFormats(thePCMFormat, theIMA4Format);
+		Initialize(&theIMA4Format, &thePCMFormat, NULL, 0);
+	}
+	bool	IsMirrored() const { return InputBufferIsMirrored(); }
+	UInt32	InputBytesPerPacket() const { return mInputFormat.mBytesPerPacket; }
+};
+
+// Converts inSource, whose packets are inInputPacketByteSize bytes, into outDestination the way an
+// AudioConverter driven by ConvertFile feeds a codec: append from the current source buffer until the
+// codec is full, then pull a destination buffer's worth of packets, and read the next source buffer
+// once the current one has been taken.
+template <class Codec>
+static void Convert(Codec& inCodec, UInt32 inInputPacketByteSize, UInt32 inOutputPacketByteSize, const Byte* inSource, UInt32 inSourceByteSize, std::vector<Byte>& outDestination)
+{
+	UInt32 theNumberPackets = inSourceByteSize / inInputPacketByteSize;
+	UInt32 theReadByteSize = kFileBufferByteSize - kFileBufferByteSize % inInputPacketByteSize;	// files are read in whole packets
+	outDestination.resize(theNumberPackets * inOutputPacketByteSize);
+	
+	UInt32 theReadOffset = 0, theBufferOffset = 0, theBufferByteSize = 0, theProducedPackets = 0;
+	while (theProducedPackets < theNumberPackets) {
+		if (theBufferOffset == theBufferByteSize && theReadOffset < inSourceByteSize) {
+			// the next file read
+			theBufferOffset = theReadOffset;
+			theBufferByteSize = theReadOffset + std::min(theReadByteSize, inSourceByteSize - theReadOffset);
+			theReadOffset = theBufferByteSize;
+		}
+		if (theBufferOffset < theBufferByteSize) {
+			UInt32 theByteSize = theBufferByteSize - theBufferOffset;
+			UInt32 theNumberToAppend = theByteSize / inCodec.InputBytesPerPacket();
+			inCodec.AppendInputData(inSource + theBufferOffset, theByteSize, theNumberToAppend, NULL);
+			theBufferOffset += theByteSize;
+		}
+		
+		UInt32 theNumberToProduce = std::min(kFileBufferByteSize / inOutputPacketByteSize, theNumberPackets - theProducedPackets);
+		UInt32 theOutputByteSize = theNumberToProduce * inOutputPacketByteSize;
+		inCodec.ProduceOutputPackets(&outDestination[theProducedPackets * inOutputPacketByteSize], theOutputByteSize, theNumberToProduce, NULL);
+		theProducedPackets += theNumberToProduce;
+	}
+}
+
+int main()
+{
+	// 0 is each codec's default; the others don't divide into packets or pages
+	static const UInt32 kInputBufferByteSizes[] = { 0, 5000, 20000, 66000 };
+	
+	srand(5);
+	std::vector<SInt16> theSamples;
+	MakeSignal(theSamples);
+	UInt32 thePCMByteSize = UInt32(theSamples.size() * sizeof(SInt16));
+	thePCMByteSize -= thePCMByteSize % kPCMPacketByteSize;
+	const double theMegabytes = thePCMByteSize / (1024. * 1024.);
+	
+	std::vector<Byte> theReferenceStream, theReferenceSamples;
+	try {
+		printf("input buffer   mirrored   encode MB/s   decode MB/s   transcode MB/s\n");
+		for (size_t theSizeIndex = 0; theSizeIndex < sizeof(kInputBufferByteSizes) / sizeof(kInputBufferByteSizes[0]); ++theSizeIndex) {
+			UInt32 theInputBufferByteSize = kInputBufferByteSizes[theSizeIndex];
+			std::vector<Byte> theStream, theDecoded;
+			double theEncodeTime = 1e9, theDecodeTime = 1e9;
+			bool theMirrored = false;
+			for (UInt32 theRun = 0; theRun < kNumTimedRuns; ++theRun) {
+				TestEncoder theEncoder(theInputBufferByteSize);
+				double theStart = Now();
+				Convert(theEncoder, kPCMPacketByteSize, kIMA4PacketByteSize, reinterpret_cast<const Byte*>(&theSamples[0]), thePCMByteSize, theStream);
+				theEncodeTime = std::min(theEncodeTime, Now() - theStart);
+				
+				TestDecoder theDecoder(theInputBufferByteSize);
+				theStart = Now();
+				Convert(theDecoder, kIMA4PacketByteSize, kPCMPacketByteSize, &theStream[0], UInt32(theStream.size()), theDecoded);
+				theDecodeTime = std::min(theDecodeTime, Now() - theStart);
+				theMirrored = theEncoder.IsMirrored() && theDecoder.IsMirrored();
+			}
+			
+			if (theSizeIndex == 0) {
+				theReferenceStream = theStream;
+				theReferenceSamples = theDecoded;
+			} else if (theStream != theReferenceStream || theDecoded != theReferenceSamples) {
+				printf("FAIL: an input buffer of %u bytes changes the %s\n", (unsigned)theInputBufferByteSize, 
+						theStream != theReferenceStream ? "encoding" : "decoding");
+				return 1;
+			}
+			
+			if (theInputBufferByteSize == 0)
+				printf("%12s", "default");
+			else
+				printf("%12u", (unsigned)theInputBufferByteSize);
+			printf("   %8s   %11.1f   %11.1f   %14.1f\n", theMirrored ? "yes" : "no", theMegabytes / theEncodeTime,
+					theMegabytes / theDecodeTime, theMegabytes / (theEncodeTime + theDecodeTime));
+		}
+	} catch (OSStatus inError) {
+		printf("FAIL: the codec threw %d\n", (int)inError);
+		return 1;
+	}
+	return 0;
+}
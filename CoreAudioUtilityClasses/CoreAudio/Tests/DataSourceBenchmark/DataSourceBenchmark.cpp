@@ -0,0 +1,181 @@
+/*
+     File: DataSourceBenchmark.cpp 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.2 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2012 Apple Inc. All Rights Reserved. 
+  
+*/
+// DataSourceBenchmark times reads from a file opened read-only through MMap_DataSource, which
+// AudioFileObject now uses for such files, against Cached_DataSource over UnixFile_DataSource, which it
+// used before. Each source reads the whole of a 64 MB scratch file front to back and then at random
+// offsets, in packet-sized and buffer-sized requests; the mapped source is also read through
+// GetBytePointer without copying. Prints nanoseconds per read; exits nonzero if any read returns the
+// wrong bytes.
+//
+//	c++ -O2 -I../../PublicUtility -I../../AudioFile/AFPublic DataSourceBenchmark.cpp
+//		../../AudioFile/AFPublic/DataSource.cpp ../../PublicUtility/CAMutex.cpp ../../PublicUtility/CAHostTimeBase.cpp
+//		../../PublicUtility/CADebugMacros.cpp ../../PublicUtility/CADebugPrintf.cpp
+//		-framework AudioToolbox -framework CoreFoundation -framework CoreServices
+
+#include "DataSource.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <vector>
+
+static const UInt32		kFileSize = 64 * 1024 * 1024;
+static const UInt32		kNumRandomReads = 100000;
+
+static double Now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static inline UInt8 ExpectedByte(SInt64 inOffset)
+{
+	return UInt8(inOffset * 7 + (inOffset >> 12));
+}
+
+enum {
+	kCached,
+	kMapped,
+	kMappedPointer,
+	kNumSources
+};
+
+// reads inCount bytes at each of inOffsets; returns seconds, or -1 if a read came back wrong
+static double TimeReads(int inSource, const char *inPath, const std::vector<SInt64> &inOffsets, UInt32 inCount, std::vector<UInt8> &ioBuffer)
+{
+	int fd = open(inPath, O_RDONLY);
+	if (fd < 0) return -1.;
+	DataSource *source = inSource == kCached 
+							? (DataSource *)new Cached_DataSource(new UnixFile_DataSource(fd, kAudioFileReadPermission, true))
+							: (DataSource *)new MMap_DataSource(fd, kAudioFileReadPermission, true);
+	
+	bool ok = true;
+	double start = Now();
+	for (size_t i = 0; i < inOffsets.size(); ++i) {
+		const UInt8 *bytes;
+		if (inSource == kMappedPointer)
+			bytes = (const UInt8 *)source->GetBytePointer(inOffsets[i], inCount);
+		else {
+			UInt32 actualCount = 0;
+			if (source->ReadBytes(SEEK_SET, inOffsets[i], inCount, &ioBuffer[0], &actualCount) || actualCount != inCount)
+				ok = false;
+			bytes = &ioBuffer[0];
+		}
+		// touch the first and last byte of every read, as a parser would
+		if (!bytes || bytes[0] != ExpectedByte(inOffsets[i]) || bytes[inCount - 1] != ExpectedByte(inOffsets[i] + inCount - 1))
+			ok = false;
+	}
+	double elapsed = Now() - start;
+	
+	delete source;
+	return ok ? elapsed : -1.;
+}
+
+int main()
+{
+	static const UInt32 kReadSizes[] = { 512, 4096, 65536 };
+	static const char * const kSourceNames[kNumSources] = { "cached", "mapped", "pointer" };
+	
+	char path[] = "/tmp/DataSourceBenchmark.XXXXXX";
+	int fd = mkstemp(path);
+	if (fd < 0) {
+		fprintf(stderr, "FAILED: can't create a scratch file\n");
+		return 1;
+	}
+	std::vector<UInt8> data(kFileSize);
+	for (UInt32 i = 0; i < kFileSize; ++i)
+		data[i] = ExpectedByte(i);
+	bool written = write(fd, &data[0], kFileSize) == (ssize_t)kFileSize;
+	close(fd);
+	if (!written) {
+		fprintf(stderr, "FAILED: can't write the scratch file\n");
+		unlink(path);
+		return 1;
+	}
+	
+	int status = 0;
+	std::vector<UInt8> buffer(kReadSizes[sizeof(kReadSizes) / sizeof(kReadSizes[0]) - 1]);
+	printf("%8s %8s %12s %12s %12s %8s\n", "pattern", "bytes", kSourceNames[kCached], kSourceNames[kMapped], kSourceNames[kMappedPointer], "speedup");
+	for (int randomReads = 0; randomReads < 2; ++randomReads) {
+		for (UInt32 i = 0; i < sizeof(kReadSizes) / sizeof(kReadSizes[0]); ++i) {
+			UInt32 readSize = kReadSizes[i];
+			std::vector<SInt64> offsets;
+			if (randomReads) {
+				srandom(readSize);
+				for (UInt32 n = 0; n < kNumRandomReads; ++n)
+					offsets.push_back(random() % (kFileSize - readSize));
+			} else {
+				for (SInt64 offset = 0; offset + readSize <= kFileSize; offset += readSize)
+					offsets.push_back(offset);
+			}
+			
+			double seconds[kNumSources];
+			for (int source = 0; source < kNumSources; ++source) {
+				// the first pass brings the file into the page cache, so every source sees the same warm file
+				TimeReads(source, path, offsets, readSize, buffer);
+				seconds[source] = TimeReads(source, path, offsets, readSize, buffer);
+				if (seconds[source] < 0.) {
+					fprintf(stderr, "FAILED: %s %s reads of %u bytes returned the wrong data\n", kSourceNames[source], 
+							randomReads ? "random" : "sequential", (unsigned)readSize);
+					status = 1;
+				}
+			}
+			
+			printf("%8s %8u", randomReads ? "random" : "sequent", (unsigned)readSize);
+			for (int source = 0; source < kNumSources; ++source)
+				printf(" %12.1f", seconds[source] * 1e9 / offsets.size());
+			printf(" %7.1fx\n", seconds[kCached] / seconds[kMapped]);
+		}
+	}
+	
+	unlink(path);
+	return status;
+}
@@ -0,0 +1,213 @@
+/*
+     File: SynthEventQueueBenchmark.cpp 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.2 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2012 Apple Inc. All Rights Reserved. 
+  
+*/
+// SynthEventQueueBenchmark times the instrument event queue under contention. Several producer threads
+// queue note-on SynthEvents the way concurrent StartNote calls do, while a consumer thread drains them the
+// way PerformEvents does. LockFreeMPMCFIFOWithFree takes the producers as they are; the single-writer
+// LockFreeFIFOWithFree it replaced needs the producers serialized, here with a mutex. Prints nanoseconds
+// per event and how often producers found the queue full; exits nonzero if any event is lost, repeated or
+// delivered out of order for its producer.
+//
+//	c++ -O2 -I../../PublicUtility -I../../AudioUnits/AUPublic/AUBase -I../../AudioUnits/AUPublic/OtherBases
+//		-I../../AudioUnits/AUPublic/Utility -I../../AudioUnits/AUPublic/AUInstrumentBase SynthEventQueueBenchmark.cpp
+//		-framework AudioToolbox -framework AudioUnit -framework CoreServices
+
+#include "SynthEvent.h"
+#include "LockFreeFIFO.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <sys/time.h>
+#include <vector>
+
+static const UInt32		kQueueSize = 1024;	// as AUInstrumentBase
+static const UInt32		kEventsPerProducer = 200000;
+
+static double Now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+// the queue AUInstrumentBase used before, with a lock to keep its producers one at a time
+struct SerializedQueue
+{
+	SerializedQueue() : mQueue(kQueueSize) { pthread_mutex_init(&mWriteLock, NULL); }
+	~SerializedQueue() { pthread_mutex_destroy(&mWriteLock); }
+	
+	SynthEvent *	WriteItem(UInt32 &)
+	{
+		pthread_mutex_lock(&mWriteLock);
+		SynthEvent *event = mQueue.WriteItem();
+		if (!event)
+			pthread_mutex_unlock(&mWriteLock);
+		return event;
+	}
+	void			AdvanceWritePtr(UInt32) { mQueue.AdvanceWritePtr(); pthread_mutex_unlock(&mWriteLock); }
+	SynthEvent *	ReadItem(UInt32 &) { return mQueue.ReadItem(); }
+	void			AdvanceReadPtr(UInt32) { mQueue.AdvanceReadPtr(); }
+	
+	LockFreeFIFOWithFree<SynthEvent>	mQueue;
+	pthread_mutex_t						mWriteLock;
+};
+
+struct ConcurrentQueue
+{
+	ConcurrentQueue() : mQueue(kQueueSize) {}
+	
+	SynthEvent *	WriteItem(UInt32 &outSlot) { return mQueue.WriteItem(outSlot); }
+	void			AdvanceWritePtr(UInt32 inSlot) { mQueue.AdvanceWritePtr(inSlot); }
+	SynthEvent *	ReadItem(UInt32 &outSlot) { return mQueue.ReadItem(outSlot); }
+	void			AdvanceReadPtr(UInt32 inSlot) { mQueue.AdvanceReadPtr(inSlot); }
+	
+	LockFreeMPMCFIFOWithFree<SynthEvent>	mQueue;
+};
+
+template <class Queue>
+struct Producer
+{
+	Queue *				mQueue;
+	UInt32				mIndex;
+	volatile bool *		mGo;
+	UInt32				mFullCount;
+	
+	static void *		Run(void *inRefCon)
+	{
+		Producer *self = static_cast<Producer *>(inRefCon);
+		while (!*self->mGo)
+			sched_yield();
+		
+		MusicDeviceNoteParams params;
+		params.argCount = 2;
+		params.mPitch = 60.f;
+		params.mVelocity = 100.f;
+		for (UInt32 n = 0; n < kEventsPerProducer; ) {
+			UInt32 slot;
+			SynthEvent *event = self->mQueue->WriteItem(slot);
+			if (!event) {
+				++self->mFullCount;
+				sched_yield();
+				continue;
+			}
+			event->Set(SynthEvent::kEventType_NoteOn, self->mIndex, n, n & 511, &params);
+			self->mQueue->AdvanceWritePtr(slot);
+			++n;
+		}
+		return NULL;
+	}
+};
+
+// runs inNumProducers producers against a draining consumer; returns seconds, or -1 if delivery was wrong
+template <class Queue>
+static double RunContention(UInt32 inNumProducers, UInt32 &outFullCount)
+{
+	Queue queue;
+	volatile bool go = false;
+	std::vector<Producer<Queue> > producers(inNumProducers);
+	std::vector<pthread_t> threads(inNumProducers);
+	for (UInt32 p = 0; p < inNumProducers; ++p) {
+		Producer<Queue> producer = { &queue, p, &go, 0 };
+		producers[p] = producer;
+		pthread_create(&threads[p], NULL, Producer<Queue>::Run, &producers[p]);
+	}
+	
+	std::vector<UInt32> nextNoteID(inNumProducers, 0);
+	UInt64 remaining = UInt64(inNumProducers) * kEventsPerProducer;
+	bool ok = true;
+	
+	double start = Now();
+	go = true;
+	while (remaining) {
+		UInt32 slot;
+		SynthEvent *event = queue.ReadItem(slot);
+		if (!event) {
+			sched_yield();
+			continue;
+		}
+		UInt32 producer = event->GetGroupID();
+		if (producer >= inNumProducers || event->GetNoteID() != nextNoteID[producer] || event->GetNote() != 60.f)
+			ok = false;
+		else
+			++nextNoteID[producer];
+		queue.AdvanceReadPtr(slot);
+		--remaining;
+	}
+	double elapsed = Now() - start;
+	
+	outFullCount = 0;
+	for (UInt32 p = 0; p < inNumProducers; ++p) {
+		pthread_join(threads[p], NULL);
+		outFullCount += producers[p].mFullCount;
+	}
+	return ok ? elapsed : -1.;
+}
+
+int main()
+{
+	static const UInt32 kProducerCounts[] = { 1, 2, 4, 8 };
+	int status = 0;
+	
+	printf("%10s %14s %10s %14s %10s %8s\n", "producers", "locked ns", "full", "mpmc ns", "full", "speedup");
+	for (UInt32 i = 0; i < sizeof(kProducerCounts) / sizeof(kProducerCounts[0]); ++i) {
+		UInt32 numProducers = kProducerCounts[i];
+		UInt32 lockedFull, mpmcFull;
+		double locked = RunContention<SerializedQueue>(numProducers, lockedFull);
+		double mpmc = RunContention<ConcurrentQueue>(numProducers, mpmcFull);
+		if (locked < 0. || mpmc < 0.) {
+			fprintf(stderr, "FAILED: %u producers, events lost or out of order (%s)\n", (unsigned)numProducers, 
+					mpmc < 0. ? "mpmc" : "locked");
+			status = 1;
+			continue;
+		}
+		
+		double events = double(numProducers) * kEventsPerProducer;
+		printf("%10u %14.1f %10u %14.1f %10u %7.1fx\n", (unsigned)numProducers, locked * 1e9 / events, (unsigned)lockedFull,
+				mpmc * 1e9 / events, (unsigned)mpmcFull, locked / mpmc);
+	}
+	return status;
+}
@@ -0,0 +1,168 @@
+/*
+     File: SynthNoteStealingBenchmark.cpp 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.2 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2012 Apple Inc. All Rights Reserved. 
+  
+*/
+// SynthNoteStealingBenchmark times voice stealing in SynthNoteList with and without the indexed heaps
+// that SetCapacity turns on. A full list of attacked notes decays a little every slice, as rendering
+// would, and then takes a burst of MIDI note-ons at the start of the slice; each note-on steals the
+// most quiet (or the oldest) note and restarts it at full amplitude. Prints nanoseconds per steal for
+// each polyphony up to 256 voices; exits nonzero if the two lists ever steal different notes.
+//
+//	c++ -O2 -I../../PublicUtility -I../../AudioUnits/AUPublic/AUBase -I../../AudioUnits/AUPublic/OtherBases
+//		-I../../AudioUnits/AUPublic/Utility -I../../AudioUnits/AUPublic/AUInstrumentBase SynthNoteStealingBenchmark.cpp
+//		../../AudioUnits/AUPublic/AUInstrumentBase/*.cpp ../../AudioUnits/AUPublic/AUBase/*.cpp
+//		../../AudioUnits/AUPublic/OtherBases/MusicDeviceBase.cpp ../../AudioUnits/AUPublic/Utility/*.cpp
+//		../../PublicUtility/CA*.cpp -framework AudioToolbox -framework AudioUnit -framework CoreServices
+
+#include "SynthNoteList.h"
+
+#include <stdio.h>
+#include <sys/time.h>
+#include <vector>
+
+static const UInt32		kFramesPerSlice = 512;
+static const UInt32		kNumSlices = 2000;
+static const UInt32		kBurstSize = 64;
+static const Float32	kDecay = 0.97f;
+static const Float32	kFloor = 1e-6f;
+
+static double Now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+// a note that needs no audio unit; its amplitude is set by the benchmark instead of by rendering
+struct BenchNote : public SynthNote
+{
+	BenchNote() : mIndex(0), mAmp(0.f) {}
+	
+	virtual OSStatus	Render(UInt64, UInt32, AudioBufferList**, UInt32) { return noErr; }
+	virtual bool		Attack(const MusicDeviceNoteParams &) { return true; }
+	virtual Float32		Amplitude() { return mAmp; }
+	
+	UInt32				mIndex;
+	Float32				mAmp;
+};
+
+// a cheap deterministic amplitude for note-on number inCount, so both lists see the same notes
+static Float32 StartAmplitude(UInt32 inCount)
+{
+	return 0.25f + Float32((inCount * 2654435761U) >> 8) / Float32(1 << 24) * 0.75f;
+}
+
+// runs the burst pattern on a list of inNumVoices notes; appends the index of every stolen note to outStolen
+static double RunBursts(UInt32 inNumVoices, bool inUseHeaps, bool inStealOldest, std::vector<UInt32> &outStolen)
+{
+	std::vector<BenchNote> notes(inNumVoices);
+	SynthNoteList list;
+	list.mState = kNoteState_Attacked;
+	if (inUseHeaps)
+		list.SetCapacity(inNumVoices);
+	
+	MusicDeviceNoteParams params;
+	params.argCount = 2;
+	params.mPitch = 60.f;
+	params.mVelocity = 100.f;
+	
+	UInt32 noteOns = 0;
+	for (UInt32 v = 0; v < inNumVoices; ++v) {
+		notes[v].mIndex = v;
+		notes[v].AttackNote(NULL, NULL, noteOns, v, 0, params);
+		notes[v].mAmp = StartAmplitude(noteOns++);
+		list.AddNote(&notes[v]);
+	}
+	
+	outStolen.clear();
+	outStolen.reserve(kNumSlices * kBurstSize);
+	double elapsed = 0.;
+	UInt64 sliceStart = inNumVoices;
+	for (UInt32 slice = 0; slice < kNumSlices; ++slice, sliceStart += kFramesPerSlice) {
+		// what rendering the previous slice did to the sounding notes
+		for (UInt32 v = 0; v < inNumVoices; ++v)
+			notes[v].mAmp = std::max(notes[v].mAmp * kDecay, kFloor);
+		list.AmplitudesChanged();
+		
+		double start = Now();
+		for (UInt32 n = 0; n < kBurstSize; ++n) {
+			BenchNote *victim = static_cast<BenchNote *>(inStealOldest ? list.FindOldestNote() : list.FindMostQuietNote());
+			victim->Kill(n);
+			list.RemoveNote(victim);
+			victim->AttackNote(NULL, NULL, noteOns, sliceStart + n, n, params);
+			victim->mAmp = StartAmplitude(noteOns++);
+			list.AddNote(victim);
+			outStolen.push_back(victim->mIndex);
+		}
+		elapsed += Now() - start;
+	}
+	return elapsed;
+}
+
+int main()
+{
+	static const UInt32 kPolyphonies[] = { 32, 64, 128, 256 };
+	std::vector<UInt32> scanned, indexed;
+	int status = 0;
+	
+	printf("%8s %8s %14s %14s %8s\n", "voices", "steal", "scan ns", "heap ns", "speedup");
+	for (int oldest = 0; oldest < 2; ++oldest) {
+		for (UInt32 i = 0; i < sizeof(kPolyphonies) / sizeof(kPolyphonies[0]); ++i) {
+			UInt32 numVoices = kPolyphonies[i];
+			double scan = RunBursts(numVoices, false, oldest, scanned);
+			double heap = RunBursts(numVoices, true, oldest, indexed);
+			
+			if (scanned != indexed) {
+				fprintf(stderr, "FAILED: %u voices, %s stealing chose different notes\n", (unsigned)numVoices, oldest ? "oldest" : "quietest");
+				status = 1;
+			}
+			
+			double steals = double(kNumSlices) * kBurstSize;
+			printf("%8u %8s %14.1f %14.1f %7.1fx\n", (unsigned)numVoices, oldest ? "oldest" : "quiet",
+					scan * 1e9 / steals, heap * 1e9 / steals, scan / heap);
+		}
+	}
+	return status;
+}
@@ -0,0 +1,220 @@
+/*
+     File: SynthVoicePoolBenchmark.cpp 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.2 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2012 Apple Inc. All Rights Reserved. 
+  
+*/
+// SynthVoicePoolBenchmark times SynthVoicePool against the per-note rendering it replaces, where
+// each note has a virtual Render that calls sinf() for every sample. Both render the same number
+// of sine voices with a linear attack into a stereo buffer. A second pass restarts a quarter of the
+// voices at scattered offsets every slice, to show what splitting the slice at note starts costs.
+// Prints nanoseconds per voice per frame for each polyphony; exits nonzero if the pooled mix does
+// not match the per-note mix.
+//
+//	c++ -O2 -I../../PublicUtility -I../../AudioUnits/AUPublic/AUBase -I../../AudioUnits/AUPublic/OtherBases
+//		-I../../AudioUnits/AUPublic/Utility -I../../AudioUnits/AUPublic/AUInstrumentBase SynthVoicePoolBenchmark.cpp
+//		../../AudioUnits/AUPublic/AUInstrumentBase/*.cpp ../../AudioUnits/AUPublic/AUBase/*.cpp
+//		../../AudioUnits/AUPublic/OtherBases/MusicDeviceBase.cpp ../../AudioUnits/AUPublic/Utility/*.cpp
+//		../../PublicUtility/CA*.cpp -framework AudioToolbox -framework AudioUnit -framework CoreServices
+
+#include "SynthVoicePool.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <vector>
+
+static const UInt32		kFramesPerSlice = 512;
+static const UInt32		kNumSlices = 400;
+static const Float64	kSampleRate = 44100.;
+static const Float32	kMaxAmp = 0.05f;
+static const Float32	kAttackSlope = 0.0005f;
+
+static double Now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+// the per-note rendering a SynthNote subclass does without the pool
+struct ScalarVoice
+{
+	ScalarVoice() : mPhase(0.f), mPhaseIncrement(0.f), mAmp(0.f) {}
+	virtual				~ScalarVoice() {}
+	
+	virtual void		Render(Float32 *outLeft, Float32 *outRight, UInt32 inStartFrame, UInt32 inNumFrames)
+	{
+		for (UInt32 frame = inStartFrame; frame < inNumFrames; ++frame) {
+			mAmp = std::min(mAmp + kAttackSlope, kMaxAmp);
+			Float32 out = mAmp * sinf(mPhase);
+			outLeft[frame] += out;
+			outRight[frame] += out;
+			mPhase += mPhaseIncrement;
+			if (mPhase >= Float32(M_PI)) mPhase -= Float32(2. * M_PI);
+		}
+	}
+	
+	Float32				mPhase;
+	Float32				mPhaseIncrement;
+	Float32				mAmp;
+};
+
+// a pooled note that needs no audio unit: it is started on the pool directly and ends itself
+struct BenchNote : public SynthPooledNote
+{
+	BenchNote() : mBenchPool(NULL) {}
+	
+	virtual bool		Attack(const MusicDeviceNoteParams &inParams) { return true; }
+	virtual void		NoteEnded(UInt32 inFrame) { mBenchPool->StopVoice(this); }
+	
+	SynthVoicePool *	mBenchPool;
+};
+
+static Float32 PhaseIncrement(UInt32 inVoice)
+{
+	return Float32(2. * M_PI * (110. + 7.3 * inVoice) / kSampleRate);
+}
+
+// per-note rendering; every fourth voice restarts each slice at a scattered offset if inRestart
+static double RenderScalar(UInt32 inNumVoices, bool inRestart, Float32 *outLeft, Float32 *outRight)
+{
+	std::vector<ScalarVoice *> voices(inNumVoices);
+	for (UInt32 v = 0; v < inNumVoices; ++v) {
+		voices[v] = new ScalarVoice;
+		voices[v]->mPhaseIncrement = PhaseIncrement(v);
+	}
+	
+	double start = Now();
+	for (UInt32 slice = 0; slice < kNumSlices; ++slice) {
+		memset(outLeft, 0, kFramesPerSlice * sizeof(Float32));
+		memset(outRight, 0, kFramesPerSlice * sizeof(Float32));
+		for (UInt32 v = 0; v < inNumVoices; ++v) {
+			UInt32 offset = 0;
+			if (inRestart && (v & 3) == 0) {
+				offset = (v * 37 + slice * 101) % kFramesPerSlice;
+				voices[v]->mPhase = 0.f;
+				voices[v]->mAmp = 0.f;
+			}
+			voices[v]->Render(outLeft, outRight, offset, kFramesPerSlice);
+		}
+	}
+	double elapsed = Now() - start;
+	
+	for (UInt32 v = 0; v < inNumVoices; ++v)
+		delete voices[v];
+	return elapsed;
+}
+
+static double RenderPooled(UInt32 inNumVoices, bool inRestart, Float32 *outLeft, Float32 *outRight)
+{
+	SynthVoicePool pool;
+	pool.Allocate(inNumVoices, kFramesPerSlice);
+	pool.SetTracksPitchBend(false);
+	std::vector<BenchNote> notes(inNumVoices);
+	for (UInt32 v = 0; v < inNumVoices; ++v) {
+		notes[v].mBenchPool = &pool;
+		pool.StartVoice(&notes[v], PhaseIncrement(v), kMaxAmp, kAttackSlope);
+	}
+	
+	struct {
+		AudioBufferList		mList;
+		AudioBuffer			mRight;
+	} stereo;
+	stereo.mList.mNumberBuffers = 2;
+	stereo.mList.mBuffers[0].mNumberChannels = 1;
+	stereo.mList.mBuffers[0].mDataByteSize = kFramesPerSlice * sizeof(Float32);
+	stereo.mList.mBuffers[0].mData = outLeft;
+	stereo.mRight = stereo.mList.mBuffers[0];
+	stereo.mRight.mData = outRight;
+	AudioBufferList *buses[1] = { &stereo.mList };
+	
+	double start = Now();
+	for (UInt32 slice = 0; slice < kNumSlices; ++slice) {
+		memset(outLeft, 0, kFramesPerSlice * sizeof(Float32));
+		memset(outRight, 0, kFramesPerSlice * sizeof(Float32));
+		if (inRestart) {
+			for (UInt32 v = 0; v < inNumVoices; v += 4) {
+				pool.StopVoice(&notes[v]);
+				pool.StartVoice(&notes[v], PhaseIncrement(v), kMaxAmp, kAttackSlope, (v * 37 + slice * 101) % kFramesPerSlice);
+			}
+		}
+		pool.Render(buses, 1, kFramesPerSlice, 1.f);
+	}
+	return Now() - start;
+}
+
+int main()
+{
+	static const UInt32 kPolyphonies[] = { 8, 32, 128, 512 };
+	std::vector<Float32> scalarLeft(kFramesPerSlice), scalarRight(kFramesPerSlice);
+	std::vector<Float32> pooledLeft(kFramesPerSlice), pooledRight(kFramesPerSlice);
+	int status = 0;
+	
+	printf("%8s %8s %14s %14s %8s %10s\n", "voices", "restart", "per-note ns", "pooled ns", "speedup", "max diff");
+	for (int restart = 0; restart < 2; ++restart) {
+		for (UInt32 i = 0; i < sizeof(kPolyphonies) / sizeof(kPolyphonies[0]); ++i) {
+			UInt32 numVoices = kPolyphonies[i];
+			double scalar = RenderScalar(numVoices, restart, &scalarLeft[0], &scalarRight[0]);
+			double pooled = RenderPooled(numVoices, restart, &pooledLeft[0], &pooledRight[0]);
+			
+			// the pool's sine approximation is within about 0.001 of sinf for each voice
+			Float32 maxDiff = 0.f;
+			for (UInt32 frame = 0; frame < kFramesPerSlice; ++frame) {
+				maxDiff = std::max(maxDiff, fabsf(scalarLeft[frame] - pooledLeft[frame]));
+				maxDiff = std::max(maxDiff, fabsf(pooledLeft[frame] - pooledRight[frame]));
+			}
+			if (maxDiff > 0.002f * kMaxAmp * numVoices) {
+				fprintf(stderr, "FAILED: %u voices, mixes differ by %g\n", (unsigned)numVoices, maxDiff);
+				status = 1;
+			}
+			
+			double voiceFrames = double(numVoices) * kFramesPerSlice * kNumSlices;
+			printf("%8u %8s %14.2f %14.2f %7.1fx %10.2g\n", (unsigned)numVoices, restart ? "yes" : "no",
+					scalar * 1e9 / voiceFrames, pooled * 1e9 / voiceFrames, scalar / pooled, maxDiff);
+		}
+	}
+	return status;
+}
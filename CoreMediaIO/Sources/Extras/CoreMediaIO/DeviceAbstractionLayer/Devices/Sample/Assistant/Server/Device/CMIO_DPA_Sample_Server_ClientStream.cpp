@@ -52,9 +52,6 @@
 // Self Include
 #include "CMIO_DPA_Sample_Server_ClientStream.h"
 
-// Internal Includes
-#include "CMIO_DPA_Sample_Server_Frame.h"
-
 // Public Utility Includes
 #include "CMIODebugMacros.h"
 
@@ -72,7 +69,7 @@ namespace CMIO { namespace DPA { namespace Sample { namespace Server
 	// ClientStream()
 	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 	ClientStream::ClientStream(Client client, mach_port_t messagePort, CAGuard& frameAvailableGuard) :
-		mQueue(CMA::SimpleQueue<Frame*>::Create(NULL, 30)),
+		mQueue(kQueueCapacity),
 		mDiscontinuityFlags(kCMIOSampleBufferNoDiscontinuities),
 		mExtendedFrameHostTime(0),
 		mExtendedFrameTimingInfo(),
@@ -154,13 +151,14 @@ namespace CMIO { namespace DPA { namespace Sample { namespace Server
 		while (not clientStream.mStopMessageLoop)
 		{
 			// Message any frames in the queue to the client
-			if (0 != clientStream.mQueue.GetCount())
+			Frame* frame = clientStream.mQueue.GetHead();
+			if (NULL != frame)
 			{
 				// Message the frame to the client
-				clientStream.SendFrameArrivedMessage(clientStream.mMessagePort, *clientStream.mQueue.GetHead());
+				clientStream.SendFrameArrivedMessage(clientStream.mMessagePort, *frame);
 				
-				// Pop it off the queue
-				(void) clientStream.mQueue.Dequeue();
+				// Pop it off the queue, which releases this client's reference to it
+				clientStream.mQueue.Dequeue();
 			}
 			else
 			{
@@ -185,6 +183,10 @@ namespace CMIO { namespace DPA { namespace Sample { namespace Server
 	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 	void ClientStream::SendFrameArrivedMessage(mach_port_t& recipient, Frame& frame)
 	{
+		// If any frames were dropped because this client's queue was full, mark the discontinuity so it is passed on with this frame (or the next one if this send fails)
+		if (0 != mQueue.TakeDroppedFrameCount())
+			SetDiscontinuityFlags(GetDiscontinuityFlags() | kCMIOSampleBufferDiscontinuityFlag_DataWasDropped);
+
 		// Setup the message
 		FrameArrivedMessage message =
 		{
@@ -206,7 +208,7 @@ namespace CMIO { namespace DPA { namespace Sample { namespace Server
 			frame.GetHostTime(),															// mHostTime
 			frame.GetTimingInfo(),															// mTimingInfo
 			frame.GetDiscontinuityFlags() | GetDiscontinuityFlags(),						// mDiscontinuityFlags
-			frame.GetDroppedFrameCount(),													// mDroppedFrameCount
+			frame.GetDroppedFrameCount() + GetDroppedFrameCount(),							// mDroppedFrameCount
 			frame.GetFirstFrameTime()														// mFirstFrameTime
 		};
 
@@ -277,8 +279,5 @@ namespace CMIO { namespace DPA { namespace Sample { namespace Server
 				}
 			}
 		}
-		
-		// Remove this client from the set of the native frame needs to message
-		frame.RemoveClient(mClient);
 	}
 }}}}
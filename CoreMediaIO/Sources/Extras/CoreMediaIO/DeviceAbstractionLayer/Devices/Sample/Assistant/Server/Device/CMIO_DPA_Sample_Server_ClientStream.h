@@ -54,11 +54,9 @@
 
 // Internal Includes
 #include "CMIO_DPA_Sample_Server_Common.h"
+#include "CMIO_DPA_Sample_Server_Frame.h"
 #include "CMIO_DPA_Sample_Shared.h"
 
-// Public Utilities
-#include "CMIO_CMA_SimpleQueue.h"
-
 // CA Public Utilities
 #include "CAGuard.h"
 #include "CAPThread.h"
@@ -66,8 +64,6 @@
 
 namespace CMIO { namespace DPA { namespace Sample { namespace Server
 {
-	class Frame;
-	
 	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 	// ClientStream
 	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -80,10 +76,12 @@ namespace CMIO { namespace DPA { namespace Sample { namespace Server
 
 	// Queue
 	public:
-		CMA::SimpleQueue<Frame*>&		GetQueue() { return mQueue; }
+		FrameRing&						GetQueue() { return mQueue; }
+		UInt32							GetDroppedFrameCount() const { return mQueue.GetTotalDroppedFrameCount(); }
 
 	private:
-		CMA::SimpleQueue<Frame*>		mQueue;
+		enum { kQueueCapacity = 32 };
+		FrameRing						mQueue;						// Frames waiting to be messaged to the client
 
 	// Attributes
 	public:
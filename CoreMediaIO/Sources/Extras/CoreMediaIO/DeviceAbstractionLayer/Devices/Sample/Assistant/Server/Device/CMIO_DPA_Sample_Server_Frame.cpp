@@ -52,25 +52,34 @@
 // Self Include
 #include "CMIO_DPA_Sample_Server_Frame.h"
 
+// Public Utility Includes
+#include "CMIODebugMacros.h"
+
+// CA Public Utility Includes
+#include "CAException.h"
+
+// System Includes
+#include <CoreMediaIO/CMIOHardware.h>
+
 
 namespace CMIO { namespace DPA { namespace Sample { namespace Server
 {
 	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 	// Frame
 	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-	Frame::Frame(IOStreamRef stream, FrameType frameType, UInt64 hostTime, const CMA::SampleBuffer::TimingInfo& timingInfo, UInt32 discontinuityFlags, UInt32 droppedFrameCount, UInt64 firstFrameTime, IOStreamBufferID bufferID, size_t size, void* data) :
-		mStream(stream),
-		mFrameType(frameType),
-		mHostTime(hostTime),
-		mTimingInfo(timingInfo),
-		mDiscontinuityFlags(discontinuityFlags),
-		mDroppedFrameCount(droppedFrameCount),
-		mFirstFrameTime(firstFrameTime),
-		mBufferID(bufferID),
-		mSize(size),
-		mFrameData(data),
-		mClients(),
-		mClientsMutex("frame clients mutex")
+	Frame::Frame(FramePool& pool) :
+		mPool(pool),
+		mNext(NULL),
+		mFrameType(),
+		mHostTime(0),
+		mTimingInfo(),
+		mDiscontinuityFlags(kCMIOSampleBufferNoDiscontinuities),
+		mDroppedFrameCount(0),
+		mFirstFrameTime(0),
+		mBufferID(0),
+		mSize(0),
+		mFrameData(NULL),
+		mRetainCount(0)
 	{
 	}
 
@@ -79,46 +88,239 @@ namespace CMIO { namespace DPA { namespace Sample { namespace Server
 	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 	Frame::~Frame()
 	{
-		// Return the frame to the queue
-		(**mStream).EnqueueInputBuffer(mStream, mBufferID, 0, 0, 0, 0);
-		(**mStream).SendInputNotification(mStream, 0xAA);
 	}
 	
 	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-	// AddClient()
+	// Fill()
+	//	Load the frame with the description of a newly arrived buffer.  Only invoked by the producer on a frame it has just acquired from the pool.
+	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	void Frame::Fill(FrameType frameType, UInt64 hostTime, const CMA::SampleBuffer::TimingInfo& timingInfo, UInt32 discontinuityFlags, UInt32 droppedFrameCount, UInt64 firstFrameTime, IOStreamBufferID bufferID, size_t size, void* data)
+	{
+		mFrameType			= frameType;
+		mHostTime			= hostTime;
+		mTimingInfo			= timingInfo;
+		mDiscontinuityFlags	= discontinuityFlags;
+		mDroppedFrameCount	= droppedFrameCount;
+		mFirstFrameTime		= firstFrameTime;
+		mBufferID			= bufferID;
+		mSize				= size;
+		mFrameData			= data;
+	}
+
+	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	// Release()
 	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-	void Frame::AddClient(Client client)
+	void Frame::Release()
 	{
-		// Grab the mutex for the the set of clients
-		CAMutex::Locker locker(mClientsMutex);
+		DebugMessageLevel(4, "Frame::Release: frame (%x) - releasing with count: %d", this, mRetainCount - 1);
+		
+		// If there are still references, simply return
+		if (0 != CAAtomicDecrement32Barrier(&mRetainCount))
+			return;
+			
+		// Clear the discontinuity flags
+		SetDiscontinuityFlags(kCMIOSampleBufferNoDiscontinuities);
 
-		// Add the client to the set of that will be messaged with the frame
-		DebugMessageLevel(4, "Frame::AddClient: frame (%x) - Adding client - %d with count: %d", this, client, mClients.size() + 1);
-		mClients.insert(client);
+		// This frame is no longer needed so return it to the pool
+		mPool.Recycle(*this);
 	}
-	
+
+	#pragma mark -
+	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	// FramePool()
+	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	FramePool::FramePool(RecycleProc recycleProc, void* refCon) :
+		mRecycleProc(recycleProc),
+		mRecycleRefCon(refCon),
+		mFrames(),
+		mFreeFrames(),
+		mOutstandingFrameCount(0)
+	{
+	}
+
+	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	// ~FramePool()
+	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	FramePool::~FramePool()
+	{
+		DebugMessageIf(0 != mOutstandingFrameCount, "FramePool::~FramePool: %d frames are still in flight", mOutstandingFrameCount);
+		Deallocate();
+	}
+
 	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-	// RemoveClient()
+	// Allocate()
+	//	Size the pool to hold frameCount frames.  This may only be done while every frame is in the pool, so the producer must be quiescent.
 	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-	void Frame::RemoveClient(Client client)
+	void FramePool::Allocate(UInt32 frameCount)
 	{
+		// Nothing needs to be done if the pool is already the right size
+		if (frameCount == GetFrameCount())
+			return;
+		
+		// Resizing the pool deletes its frames, which can't happen while any are in flight
+		ThrowIf(0 != mOutstandingFrameCount, CAException(kCMIOHardwareIllegalOperationError), "FramePool::Allocate: frames are still in flight");
+		
+		Deallocate();
+		
+		mFrames.reserve(frameCount);
+		for (UInt32 i = 0 ; i < frameCount ; ++i)
 		{
-			// Grab the mutex for the the set of clients
-			CAMutex::Locker locker(mClientsMutex);
+			Frame* frame = new Frame(*this);
+			mFrames.push_back(frame);
+			mFreeFrames.push_NA(frame);
+		}
+	}
 
-			// Remove the client from the to-be-messaged set
-			mClients.erase(client);
-			DebugMessageLevel(4, "Frame::RemoveClient: Native frame (%x) - Removing client - %d with count: %d", this, client, mClients.size());
-			
-			// If there are still clients, simply return
-			if (not mClients.empty())
-				return;
+	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	// Deallocate()
+	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	void FramePool::Deallocate()
+	{
+		while (NULL != mFreeFrames.pop_NA())
+			;
+		
+		for (std::vector<Frame*>::iterator i = mFrames.begin() ; i != mFrames.end() ; std::advance(i, 1))
+			delete *i;
+		
+		mFrames.clear();
+	}
+
+	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	// Acquire()
+	//	Take a frame from the pool with a retain count of one, or NULL if every frame is in flight.  Only the producer's thread may invoke this, since the free list is only safe
+	//	against the ABA problem with a single reader.
+	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	Frame* FramePool::Acquire()
+	{
+		Frame* frame = mFreeFrames.pop_atomic_single_reader();
+		if (NULL == frame)
+			return NULL;
+		
+		(void) CAAtomicIncrement32Barrier(&mOutstandingFrameCount);
+		frame->Retain();
+		return frame;
+	}
+
+	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	// Recycle()
+	//	Invoked by Frame::Release() when the last reference goes away.  The frame goes back on the free list before its buffer is handed back, so that a buffer which is immediately
+	//	redelivered always finds a frame waiting for it.
+	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	void FramePool::Recycle(Frame& frame)
+	{
+		// Grab the buffer ID first, since the producer may refill the frame as soon as it is back on the free list
+		IOStreamBufferID bufferID = frame.GetBufferID();
+		
+		(void) CAAtomicDecrement32Barrier(&mOutstandingFrameCount);
+		mFreeFrames.push_atomic(&frame);
+		
+		if (NULL != mRecycleProc)
+			(*mRecycleProc)(mRecycleRefCon, bufferID);
+	}
+
+	#pragma mark -
+	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	// FrameRing()
+	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	FrameRing::FrameRing(UInt32 capacity) :
+		mFrames(NULL),
+		mMask(0),
+		mWriteIndex(0),
+		mReadIndex(0),
+		mPendingDroppedFrameCount(0),
+		mTotalDroppedFrameCount(0)
+	{
+		// Round the capacity up to a power of 2 so the indices can simply be masked
+		UInt32 roundedCapacity = 2;
+		while (roundedCapacity < capacity)
+			roundedCapacity <<= 1;
+		
+		mFrames = new Frame*[roundedCapacity];
+		mMask = roundedCapacity - 1;
+	}
+
+	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	// ~FrameRing()
+	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	FrameRing::~FrameRing()
+	{
+		// Release any frames which were never delivered
+		while (NULL != GetHead())
+			Dequeue();
+
+		delete [] mFrames;
+	}
+
+	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	// Deliver()
+	//	Add a reference to the frame and append it to the ring.  If the ring is full the frame is not added and the drop is counted against the client.
+	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	bool FrameRing::Deliver(Frame& frame)
+	{
+		if (GetCount() > mMask)
+		{
+			CountDroppedFrame();
+			return false;
 		}
-			
-		// Clear the discontinuity flags
-		SetDiscontinuityFlags(kCMIOSampleBufferNoDiscontinuities);
+		
+		frame.Retain();
+		mFrames[mWriteIndex & mMask] = &frame;
+		
+		// Make sure the slot is visible to the consumer before the index which publishes it
+		CAMemoryBarrier();
+		mWriteIndex = mWriteIndex + 1;
+		return true;
+	}
 
-		// This frame is no longer needed so delete it
-		delete this;
+	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	// CountDroppedFrame()
+	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	void FrameRing::CountDroppedFrame()
+	{
+		(void) CAAtomicIncrement32Barrier(&mPendingDroppedFrameCount);
+		(void) CAAtomicIncrement32Barrier(&mTotalDroppedFrameCount);
+	}
+
+	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	// GetHead()
+	//	Return the oldest frame in the ring without removing it, or NULL if the ring is empty.
+	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	Frame* FrameRing::GetHead()
+	{
+		if (mReadIndex == mWriteIndex)
+			return NULL;
+		
+		// Pairs with the barrier in Deliver()
+		CAMemoryBarrier();
+		return mFrames[mReadIndex & mMask];
+	}
+
+	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	// Dequeue()
+	//	Release the oldest frame and remove it from the ring.  The frame is released first so that a ring whose count has reached zero no longer references any frames.
+	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	void FrameRing::Dequeue()
+	{
+		mFrames[mReadIndex & mMask]->Release();
+		
+		// Make sure the slot has been read before the producer is allowed to reuse it
+		CAMemoryBarrier();
+		mReadIndex = mReadIndex + 1;
+	}
+
+	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	// TakeDroppedFrameCount()
+	//	Return the number of frames dropped since the last call and reset it to zero.
+	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	UInt32 FrameRing::TakeDroppedFrameCount()
+	{
+		SInt32 droppedFrameCount;
+		do
+		{
+			droppedFrameCount = mPendingDroppedFrameCount;
+		}
+		while (not CAAtomicCompareAndSwap32Barrier(droppedFrameCount, 0, &mPendingDroppedFrameCount));
+		
+		return static_cast<UInt32>(droppedFrameCount);
 	}
 }}}}
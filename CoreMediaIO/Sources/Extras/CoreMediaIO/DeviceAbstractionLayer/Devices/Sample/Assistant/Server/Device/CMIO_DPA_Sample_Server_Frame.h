@@ -60,14 +60,31 @@
 #include "CMIO_CMA_SampleBuffer.h"
 
 // CA Public Utility Includes
-#include "CAMutex.h"
+#include "CAAtomic.h"
+#include "CAAtomicStack.h"
 
 // System Includes
 #include <IOKit/stream/IOStreamLib.h>
 #include <CoreMediaIO/CMIOSampleBuffer.h>
 
+// Standard Library Includes
+#include <vector>
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+//	Frame fan-out
+//
+//	Frames are preallocated by a FramePool, one per IOStream buffer, and recycled rather than deleted.  When a buffer arrives the producer acquires a Frame, which starts out with
+//	a reference count of one, and hands it to each client's FrameRing.  A successful Deliver() adds a reference that the client's message thread drops once it has sent the frame;
+//	a full ring counts the drop against that client instead.  The producer then releases its own reference, and whoever drops the last one returns the Frame to the pool, which
+//	hands the buffer back to its owner through the pool's RecycleProc.
+//
+//	None of this touches IOKit or Mach, so the fan-out can be exercised without a device by a synthetic producer that supplies its own RecycleProc.
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
 namespace CMIO { namespace DPA { namespace Sample { namespace Server
 {
+	class FramePool;
+	
 	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 	// Frame
 	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -75,13 +92,19 @@ namespace CMIO { namespace DPA { namespace Sample { namespace Server
 	{		
 	public:
 	// Construction/Destruction
-										Frame(IOStreamRef stream, FrameType frameType, UInt64 hostTime, const CMA::SampleBuffer::TimingInfo& timingInfo, UInt32 discontinuityFlags, UInt32 droppedFrameCount, UInt64 firstFrameTime, IOStreamBufferID bufferID, size_t size, void* data);
+										Frame(FramePool& pool);
 		virtual							~Frame();										
 		
+		void							Fill(FrameType frameType, UInt64 hostTime, const CMA::SampleBuffer::TimingInfo& timingInfo, UInt32 discontinuityFlags, UInt32 droppedFrameCount, UInt64 firstFrameTime, IOStreamBufferID bufferID, size_t size, void* data);
+
 	private:
-		IOStreamRef						mStream;
+		FramePool&						mPool;
+		Frame*							mNext;					// Link in the pool's free list
 		Frame&							operator=(Frame& that);							// Unimplemented - don't allow copying
 
+	public:
+		Frame*&							next() { return mNext; }	// Required by TAtomicStack
+
 	// Attributes
 	public:
 		FrameType						GetFrameType() const { return mFrameType; }
@@ -128,20 +151,100 @@ namespace CMIO { namespace DPA { namespace Sample { namespace Server
 	public:
 		UInt32							Size() { return mSize; }
 		void*							Get() { return mFrameData; }
+		IOStreamBufferID				GetBufferID() const { return mBufferID; }
 
 	protected:
 		IOStreamBufferID				mBufferID;
 		UInt32							mSize;
 		void*							mFrameData;
 
-	// Clients
+	// Reference Counting
 	public:
-		void							AddClient(Client client);
-		void							RemoveClient(Client client);
+		void							Retain() { (void) CAAtomicIncrement32Barrier(&mRetainCount); }
+		void							Release();
+		SInt32							GetRetainCount() const { return mRetainCount; }
 
 	protected:
-		Clients							mClients;				// Clients to send the message frame to
-		CAMutex							mClientsMutex;			// Protect state of the set of clients
+		volatile SInt32					mRetainCount;			// One for the producer while it is fanning the frame out, plus one for each client ring holding it
+	};
+
+	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	// FramePool
+	//	A fixed set of Frames.  Acquire() may only be called from one thread (the one frames arrive on), but frames can be released back to the pool from any thread.
+	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	class FramePool
+	{
+	public:
+		typedef void					(*RecycleProc)(void* refCon, IOStreamBufferID bufferID);
+
+	// Construction/Destruction
+	public:
+										FramePool(RecycleProc recycleProc, void* refCon);
+		virtual							~FramePool();
+
+		void							Allocate(UInt32 frameCount);
+
+	private:
+		FramePool&						operator=(FramePool& that);						// Unimplemented - don't allow copying
+		void							Deallocate();
+
+	// Attributes
+	public:
+		UInt32							GetFrameCount() const { return static_cast<UInt32>(mFrames.size()); }
+		UInt32							GetOutstandingFrameCount() const { return static_cast<UInt32>(mOutstandingFrameCount); }
+
+	// Operations
+	public:
+		Frame*							Acquire();
+		void							Recycle(Frame& frame);
+
+	private:
+		RecycleProc						mRecycleProc;
+		void*							mRecycleRefCon;
+		std::vector<Frame*>				mFrames;				// Every frame the pool owns
+		TAtomicStack<Frame>				mFreeFrames;			// Frames not currently in flight
+		volatile SInt32					mOutstandingFrameCount;
+	};
+
+	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	// FrameRing
+	//	A single producer, single consumer ring of Frames awaiting delivery to one client.  Deliver() is only called by the producer; GetHead(), Dequeue() and TakeDroppedFrameCount()
+	//	only by the consumer.  Neither side blocks.
+	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	class FrameRing
+	{
+	// Construction/Destruction
+	public:
+										FrameRing(UInt32 capacity);
+		virtual							~FrameRing();
+
+	private:
+		FrameRing&						operator=(FrameRing& that);						// Unimplemented - don't allow copying
+
+	// Attributes
+	public:
+		UInt32							Capacity() const { return mMask + 1; }
+		UInt32							GetCount() const { return mWriteIndex - mReadIndex; }
+
+	// Producer Operations
+	public:
+		bool							Deliver(Frame& frame);
+		void							CountDroppedFrame();
+
+	// Consumer Operations
+	public:
+		Frame*							GetHead();
+		void							Dequeue();
+		UInt32							TakeDroppedFrameCount();
+		UInt32							GetTotalDroppedFrameCount() const { return static_cast<UInt32>(mTotalDroppedFrameCount); }
+
+	private:
+		Frame**							mFrames;
+		UInt32							mMask;
+		volatile UInt32					mWriteIndex;			// Only advanced by the producer
+		volatile UInt32					mReadIndex;				// Only advanced by the consumer
+		volatile SInt32					mPendingDroppedFrameCount;	// Drops not yet reported to the client
+		volatile SInt32					mTotalDroppedFrameCount;
 	};
 }}}}
 
@@ -114,6 +114,7 @@ namespace CMIO { namespace DPA { namespace Sample { namespace Server
 		mClientStreams(),
 		mClientStreamsMutex("CMIO::DPA::Sample::Server::Stream client streams mutex"),
 		mFrameAvailableGuard("frame available guard"),
+		mFramePool(RecycleFrameBufferCallback, this),
 		mDeck(*this)
 	{
 		mStreamDictionary = streamDictionary;
@@ -1164,6 +1165,9 @@ namespace CMIO { namespace DPA { namespace Sample { namespace Server
 			{
 				if (IsInput())
 				{
+					// Make sure there is a Frame for every buffer the IOStream can deliver
+					mFramePool.Allocate(mIOSAStream.GetBufferCount());
+
 					// Start the stream
 					mIOSAStream.Start();
 				}
@@ -1471,44 +1475,39 @@ namespace CMIO { namespace DPA { namespace Sample { namespace Server
 		// Create the timing information
 		CMA::SampleBuffer::TimingInfo timingInfo(GetNominalFrameDuration(), presentationTimeStamp, kCMTimeInvalid);
 		
-		// Wrap the entry in a Frame
-		Frame* frame = new Frame(mIOSAStream, GetFrameType(), theBufferControl->vbiTime, timingInfo, GetDiscontinuityFlags(), theBufferControl->droppedFrameCount, theBufferControl->firstVBITime, entry.bufferID, entry.dataLength, mIOSAStream.GetDataBuffer(entry.bufferID));
+		// Wrap the entry in a Frame from the pool
+		Frame* frame = mFramePool.Acquire();
+		if (NULL != frame)
+		{
+			frame->Fill(GetFrameType(), theBufferControl->vbiTime, timingInfo, GetDiscontinuityFlags(), theBufferControl->droppedFrameCount, theBufferControl->firstVBITime, entry.bufferID, entry.dataLength, mIOSAStream.GetDataBuffer(entry.bufferID));
 
-		// Clear the discontinuity flags since any accumulated discontinuties have passed onward with the frame
-		SetDiscontinuityFlags(kCMIOSampleBufferNoDiscontinuities);
-	
-		// Create a queue of client queues into which the frame should be inserted
-		std::vector<CMA::SimpleQueue<Frame*>*> queues;
+			// Clear the discontinuity flags since any accumulated discontinuties have passed onward with the frame
+			SetDiscontinuityFlags(kCMIOSampleBufferNoDiscontinuities);
+		}
+		else
+		{
+			// This should never be hit since the pool has a frame for every IOStream buffer, but if it is, return the buffer and count the drop against every client below
+			DebugMessage("Stream::FrameArrived: no free frames in the pool of %d, dropping buffer %d", mFramePool.GetFrameCount(), entry.bufferID);
+			RecycleFrameBuffer(*this, entry.bufferID);
+		}
 		
-		// Grab the ClientStreams mutex so they won't be altered in the midst of this routine
-		CAMutex::Locker clientStreamsLocker(mClientStreamsMutex);
-
-		// Insert the frame into each client's queue
-		for (ClientStreamMap::iterator i = mClientStreams.begin() ; i != mClientStreams.end() ; std::advance(i, 1))
 		{
-			if (1.0 != (*i).second->GetQueue().Fullness())
-			{
-				// Add the client to the set of clients to which this frame will be messaged
-				frame->AddClient((*i).first);
-				queues.push_back(&(*i).second->GetQueue());
-			}
-			else
+			// Grab the ClientStreams mutex so they won't be altered in the midst of the fan-out
+			CAMutex::Locker clientStreamsLocker(mClientStreamsMutex);
+
+			// Insert the frame into each client's queue; queues which are full count the drop and send a discontinuity with the client's next frame
+			for (ClientStreamMap::iterator i = mClientStreams.begin() ; i != mClientStreams.end() ; std::advance(i, 1))
 			{
-				// This condition should never be hit, but if that assumption proves false then some code changes would be necessary to properly record the dropped frame.
-				DebugMessage("Stream::FrameArrived: client (%d) queue full <---------- NEED TO EXTEND", (*i).first);
+				if (NULL == frame)
+					(*i).second->GetQueue().CountDroppedFrame();
+				else if (not (*i).second->GetQueue().Deliver(*frame))
+					DebugMessageLevel(2, "Stream::FrameArrived: client (%d) queue full, dropped frame (%d dropped so far)", (*i).first, (*i).second->GetDroppedFrameCount());
 			}
 		}
 
-		// Enqueue all the frame for all the clients that had room
-		for (std::vector<CMA::SimpleQueue<Frame*>*>::iterator i = queues.begin() ; i != queues.end() ; std::advance(i, 1))
-			(**i).Enqueue(frame);
-
-		// Make sure at least one client wanted the message
-		if (queues.empty())
-		{
-			// There were no clients to message this too, so invoke RemoveClient(MACH_PORT_NULL) on the frame to make it available for refilling 
-			frame->RemoveClient(MACH_PORT_NULL);
-		}
+		// Release the reference acquired from the pool.  If no client took the frame, this makes it (and its IOStream buffer) available for refilling.
+		if (NULL != frame)
+			frame->Release();
 		
 		if (true)
 		{
@@ -1519,6 +1518,25 @@ namespace CMIO { namespace DPA { namespace Sample { namespace Server
 		mFrameAvailableGuard.NotifyAll();		
 	}
 
+	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	// RecycleFrameBuffer()
+	//	Invoked by the FramePool when the last reference to a frame has been released, so its buffer can be returned to the IOStream for refilling
+	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	void Stream::RecycleFrameBuffer(Stream& stream, IOStreamBufferID bufferID)
+	{
+		(**stream.mIOSAStream).EnqueueInputBuffer(stream.mIOSAStream, bufferID, 0, 0, 0, 0);
+		(**stream.mIOSAStream).SendInputNotification(stream.mIOSAStream, 0xAA);
+	}
+
+	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	// RecycleFrameBufferCallback()
+	//	The FramePool's RecycleProc, whose refCon is the Stream
+	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	void Stream::RecycleFrameBufferCallback(void* refCon, IOStreamBufferID bufferID)
+	{
+		RecycleFrameBuffer(*static_cast<Stream*>(refCon), bufferID);
+	}
+
 	#pragma mark -
 	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 	// GetOutputBuffer()
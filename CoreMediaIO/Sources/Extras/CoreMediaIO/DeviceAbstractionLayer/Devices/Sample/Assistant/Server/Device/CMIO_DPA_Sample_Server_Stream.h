@@ -54,6 +54,7 @@
 
 // Internal Includes
 #include "CMIO_DPA_Sample_Server_Deck.h"
+#include "CMIO_DPA_Sample_Server_Frame.h"
 
 // Public Utility Includes
 #include "CMIO_CMA_BlockBuffer.h"
@@ -192,6 +193,8 @@ namespace CMIO { namespace DPA { namespace Sample { namespace Server
 		static void						StreamOutputCallback(IOStreamRef /*streamRef*/, Stream& stream);
 	
 		void							FrameArrived(IOStreamBufferQueueEntry& entry);
+		static void						RecycleFrameBuffer(Stream& stream, IOStreamBufferID bufferID);
+		static void						RecycleFrameBufferCallback(void* refCon, IOStreamBufferID bufferID);
 		void							GetOutputBuffer(mach_port_t& recipient);
 		static void						ReleaseOutputBufferCallBack(void* refCon, void *doomedMemoryBlock, size_t sizeInBytes);
 		static void						ReleasePixelBufferCallback(void* refCon, void *doomedMemoryBlock, size_t sizeInBytes);
@@ -220,6 +223,7 @@ namespace CMIO { namespace DPA { namespace Sample { namespace Server
 		ClientStreamMap					mClientStreams;				// Ports to message when a frame arrives
 		CAMutex							mClientStreamsMutex;		// Mutex to protect mClientStreams when adding/removing items to the map
 		CAGuard							mFrameAvailableGuard;
+		FramePool						mFramePool;					// One Frame per IOStream buffer, recycled as the clients finish with them
 
 		typedef std::list<IOStreamBufferQueueEntry> IOStreamBufferQueueEntryFreeList;
 		IOStreamBufferQueueEntryFreeList	mFreeList;
@@ -0,0 +1,309 @@
+/*
+	    File: CMIO_DPA_Sample_Server_FrameFanOutHarness.cpp
+	Abstract: n/a
+	 Version: 1.2
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple
+	Inc. ("Apple") in consideration of your agreement to the following
+	terms, and your use, installation, modification or redistribution of
+	this Apple software constitutes acceptance of these terms.  If you do
+	not agree with these terms, please do not use, install, modify or
+	redistribute this Apple software.
+	
+	In consideration of your agreement to abide by the following terms, and
+	subject to these terms, Apple grants you a personal, non-exclusive
+	license, under Apple's copyrights in this original Apple software (the
+	"Apple Software"), to use, reproduce, modify and redistribute the Apple
+	Software, with or without modifications, in source and/or binary forms;
+	provided that if you redistribute the Apple Software in its entirety and
+	without modifications, you must retain this notice and the following
+	text and disclaimers in all such redistributions of the Apple Software.
+	Neither the name, trademarks, service marks or logos of Apple Inc. may
+	be used to endorse or promote products derived from the Apple Software
+	without specific prior written permission from Apple.  Except as
+	expressly stated in this notice, no other rights or licenses, express or
+	implied, are granted by Apple herein, including but not limited to any
+	patent rights that may be infringed by your derivative works or by other
+	works in which the Apple Software may be incorporated.
+	
+	The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+	MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+	THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+	FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+	OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+	
+	IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+	OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+	SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+	INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+	MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+	AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+	STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+	POSSIBILITY OF SUCH DAMAGE.
+	
+	Copyright (C) 2012 Apple Inc. All Rights Reserved.
+	
+*/
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+//	CMIO_DPA_Sample_Server_FrameFanOutHarness
+//
+//	Exercises the FramePool / FrameRing fan-out without a device.  A synthetic producer owns a handful of buffers and, like Stream::FrameArrived(), acquires a Frame for each buffer it
+//	"receives", delivers it to every client's ring and releases its own reference.  Each client drains its ring on its own thread, one of them deliberately slowly so that its ring fills
+//	and frames are dropped against it.  The pool's RecycleProc hands buffers back to the producer.
+//
+//	Fails (exiting nonzero) if a client ever sees a frame whose buffer is not checked out or whose contents don't match its buffer, if a client's received plus dropped frames don't add
+//	up to the number produced, if the pending drop count doesn't match the total, if the pool ever runs dry, or if any buffer is still outstanding at the end.
+//
+//	c++ -O2 -I../Device -I.. -I../.. -I../../../../../../PublicUtility -I../../../../../../PublicUtility/CoreMediaAssistant -I$CA/PublicUtility
+//		CMIO_DPA_Sample_Server_FrameFanOutHarness.cpp ../Device/CMIO_DPA_Sample_Server_Frame.cpp
+//		-framework CoreMediaIO -framework CoreMedia -framework IOKit -framework CoreFoundation
+//
+//	where $CA is CoreAudioUtilityClasses/CoreAudio.
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Includes
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Internal Includes
+#include "CMIO_DPA_Sample_Server_Frame.h"
+
+// System Includes
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Standard Library Includes
+#include <deque>
+#include <vector>
+
+using namespace CMIO::DPA::Sample;
+using namespace CMIO::DPA::Sample::Server;
+
+namespace
+{
+	enum
+	{
+		kBufferCount		= 8,			// Buffers the synthetic device cycles through
+		kRingCapacity		= 4,			// Frames each client can have queued
+		kClientCount		= 3,
+		kFrameCount			= 200000,
+		kSlowClientDelay	= 3				// Maximum microseconds the slow client waits per frame
+	};
+
+	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	// BufferOwner
+	//	Stands in for the IOStream: tracks which buffers are checked out to frames and which are free for the producer to "fill" next.
+	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	class BufferOwner
+	{
+	public:
+		BufferOwner() : mCheckedOut(kBufferCount, false), mErrorCount(0)
+		{
+			pthread_mutex_init(&mMutex, NULL);
+			for (UInt32 i = 0 ; i < kBufferCount ; ++i)
+				mFreeBuffers.push_back(i);
+		}
+		
+		~BufferOwner() { pthread_mutex_destroy(&mMutex); }
+		
+		bool CheckOut(IOStreamBufferID& bufferID)
+		{
+			pthread_mutex_lock(&mMutex);
+			bool gotOne = not mFreeBuffers.empty();
+			if (gotOne)
+			{
+				bufferID = mFreeBuffers.front();
+				mFreeBuffers.pop_front();
+				mCheckedOut[bufferID] = true;
+			}
+			pthread_mutex_unlock(&mMutex);
+			return gotOne;
+		}
+		
+		void CheckIn(IOStreamBufferID bufferID)
+		{
+			pthread_mutex_lock(&mMutex);
+			if (not mCheckedOut[bufferID])
+				++mErrorCount;
+			mCheckedOut[bufferID] = false;
+			mFreeBuffers.push_back(bufferID);
+			pthread_mutex_unlock(&mMutex);
+		}
+		
+		bool IsCheckedOut(IOStreamBufferID bufferID)
+		{
+			pthread_mutex_lock(&mMutex);
+			bool checkedOut = mCheckedOut[bufferID];
+			pthread_mutex_unlock(&mMutex);
+			return checkedOut;
+		}
+		
+		UInt32 GetFreeBufferCount()
+		{
+			pthread_mutex_lock(&mMutex);
+			UInt32 count = static_cast<UInt32>(mFreeBuffers.size());
+			pthread_mutex_unlock(&mMutex);
+			return count;
+		}
+		
+		UInt32 GetErrorCount() const { return mErrorCount; }
+		
+		static void Recycle(void* refCon, IOStreamBufferID bufferID) { static_cast<BufferOwner*>(refCon)->CheckIn(bufferID); }
+
+		static void* BufferData(IOStreamBufferID bufferID) { return reinterpret_cast<void*>(static_cast<uintptr_t>(0x1000 + bufferID)); }
+
+	private:
+		pthread_mutex_t					mMutex;
+		std::deque<IOStreamBufferID>	mFreeBuffers;
+		std::vector<bool>				mCheckedOut;
+		UInt32							mErrorCount;		// Buffers recycled that were not checked out
+	};
+
+	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	// SyntheticClient
+	//	Stands in for a client's message thread: drains its ring, checking each frame before dequeuing it.
+	//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	class SyntheticClient
+	{
+	public:
+		SyntheticClient(BufferOwner& owner, UInt32 delay, unsigned int seed) : mRing(kRingCapacity), mOwner(owner), mDelay(delay), mSeed(seed), mStop(false), mReceivedFrameCount(0), mErrorCount(0) {}
+		
+		static void* Drain(void* refCon)
+		{
+			SyntheticClient& client = *static_cast<SyntheticClient*>(refCon);
+			for (;;)
+			{
+				Frame* frame = client.mRing.GetHead();
+				if (NULL == frame)
+				{
+					if (client.mStop)
+						break;
+					sched_yield();
+					continue;
+				}
+				
+				if (frame->GetRetainCount() < 1 or not client.mOwner.IsCheckedOut(frame->GetBufferID()) or frame->Get() != BufferOwner::BufferData(frame->GetBufferID()))
+					++client.mErrorCount;
+				
+				if (0 != client.mDelay)
+					usleep(rand_r(&client.mSeed) % client.mDelay);
+					
+				++client.mReceivedFrameCount;
+				client.mRing.Dequeue();
+			}
+			return NULL;
+		}
+		
+		FrameRing				mRing;
+		BufferOwner&			mOwner;
+		UInt32					mDelay;
+		unsigned int			mSeed;
+		volatile bool			mStop;				// Set by the producer once it has delivered its last frame
+		UInt32					mReceivedFrameCount;
+		UInt32					mErrorCount;		// Frames that weren't what the producer delivered
+	};
+}
+
+int main()
+{
+	BufferOwner owner;
+	FramePool pool(BufferOwner::Recycle, &owner);
+	pool.Allocate(kBufferCount);
+	
+	SyntheticClient* clients[kClientCount];
+	pthread_t threads[kClientCount];
+	for (UInt32 i = 0 ; i < kClientCount ; ++i)
+	{
+		clients[i] = new SyntheticClient(owner, (1 == i) ? kSlowClientDelay : 0, i + 1);
+		pthread_create(&threads[i], NULL, SyntheticClient::Drain, clients[i]);
+	}
+	
+	// Produce frames as fast as buffers come back, fanning each one out to every client
+	UInt32 emptyPoolCount = 0;
+	for (UInt32 produced = 0 ; produced < kFrameCount ; )
+	{
+		IOStreamBufferID bufferID;
+		if (not owner.CheckOut(bufferID))
+		{
+			sched_yield();
+			continue;
+		}
+		
+		Frame* frame = pool.Acquire();
+		if (NULL == frame)
+		{
+			// There is a frame per buffer, so this should never happen; account for it the way Stream::FrameArrived() does so the totals still add up
+			++emptyPoolCount;
+			owner.CheckIn(bufferID);
+			for (UInt32 i = 0 ; i < kClientCount ; ++i)
+				clients[i]->mRing.CountDroppedFrame();
+			++produced;
+			continue;
+		}
+		
+		frame->Fill(kYUV422_720x480, produced, CMIO::CMA::SampleBuffer::TimingInfo(), 0, 0, 0, bufferID, 16, BufferOwner::BufferData(bufferID));
+		for (UInt32 i = 0 ; i < kClientCount ; ++i)
+			(void) clients[i]->mRing.Deliver(*frame);
+		frame->Release();
+		++produced;
+	}
+	
+	for (UInt32 i = 0 ; i < kClientCount ; ++i)
+	{
+		clients[i]->mStop = true;
+		pthread_join(threads[i], NULL);
+	}
+	
+	bool failed = false;
+	for (UInt32 i = 0 ; i < kClientCount ; ++i)
+	{
+		SyntheticClient& client = *clients[i];
+		UInt32 droppedFrameCount = client.mRing.GetTotalDroppedFrameCount();
+		UInt32 pendingDroppedFrameCount = client.mRing.TakeDroppedFrameCount();
+		printf("client %u: received %u, dropped %u\n", (unsigned int)i, (unsigned int)client.mReceivedFrameCount, (unsigned int)droppedFrameCount);
+		
+		if (kFrameCount != client.mReceivedFrameCount + droppedFrameCount)
+		{
+			printf("FAIL: client %u accounted for %u of %u frames\n", (unsigned int)i, (unsigned int)(client.mReceivedFrameCount + droppedFrameCount), (unsigned int)kFrameCount);
+			failed = true;
+		}
+		if (droppedFrameCount != pendingDroppedFrameCount)
+		{
+			printf("FAIL: client %u has %u drops pending but %u in total\n", (unsigned int)i, (unsigned int)pendingDroppedFrameCount, (unsigned int)droppedFrameCount);
+			failed = true;
+		}
+		if (0 != client.mErrorCount)
+		{
+			printf("FAIL: client %u saw %u bad frames\n", (unsigned int)i, (unsigned int)client.mErrorCount);
+			failed = true;
+		}
+	}
+	
+	printf("outstanding frames %u, free buffers %u of %u, empty pool %u\n", (unsigned int)pool.GetOutstandingFrameCount(), (unsigned int)owner.GetFreeBufferCount(), (unsigned int)kBufferCount, (unsigned int)emptyPoolCount);
+	if (0 != pool.GetOutstandingFrameCount() or kBufferCount != owner.GetFreeBufferCount())
+	{
+		printf("FAIL: frames or buffers were not returned\n");
+		failed = true;
+	}
+	if (0 != owner.GetErrorCount())
+	{
+		printf("FAIL: %u buffers were recycled twice\n", (unsigned int)owner.GetErrorCount());
+		failed = true;
+	}
+	if (0 != emptyPoolCount)
+	{
+		printf("FAIL: the pool ran out of frames\n");
+		failed = true;
+	}
+	
+	for (UInt32 i = 0 ; i < kClientCount ; ++i)
+		delete clients[i];
+
+	printf(failed ? "FAIL\n" : "PASS\n");
+	return failed ? 1 : 0;
+}
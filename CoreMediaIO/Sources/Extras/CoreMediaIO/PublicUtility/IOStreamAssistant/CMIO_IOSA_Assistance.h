@@ -132,6 +132,7 @@ namespace CMIO { namespace IOSA
 		void		Stop() { IOReturn ioReturn = (**mStream).StopStream(mStream); DebugMessageIfError(ioReturn, "CMIO::IOSA::Stream::Stop() failed"); }
 		void*		GetDataBuffer(IOStreamBufferID bufferID) { return (**mStream).GetDataBuffer(mStream, bufferID); }
 		void*		GetControlBuffer(IOStreamBufferID bufferID) { return (**mStream).GetControlBuffer(mStream, bufferID); }
+		UInt32		GetBufferCount() { return (**mStream).GetBufferCount(mStream); }
 
 	// Value Access
 	public:
@@ -61,6 +61,7 @@
 AUEffectBase::AUEffectBase(	AudioComponentInstance	audioUnit,
 							bool					inProcessesInPlace ) :
 	AUBase(audioUnit, 1, 1),		// 1 in bus, 1 out bus
+	mMultiChannelKernel(NULL),
 	mBypassEffect(false),
 	mParamSRDep (false),
 	mProcessesInPlace(inProcessesInPlace),
@@ -86,6 +87,8 @@ void AUEffectBase::Cleanup()
 		delete *it;
 		
 	mKernelList.clear();
+	delete mMultiChannelKernel;
+	mMultiChannelKernel = NULL;
 	mMainOutput = NULL;
 	mMainInput = NULL;
 }
@@ -171,6 +174,8 @@ OSStatus			AUEffectBase::Reset(		AudioUnitScope 		inScope,
 		if (kernel != NULL)
 			kernel->Reset();
 	}
+	if (mMultiChannelKernel != NULL)
+		mMultiChannelKernel->Reset();
 	
 	return AUBase::Reset(inScope, inElement);
 }
@@ -256,6 +261,18 @@ void	AUEffectBase::MaintainKernels()
 	UInt32 nKernels = GetNumberOfChannels();
 #endif
 	
+	if (mMultiChannelKernel == NULL)
+		mMultiChannelKernel = NewMultiChannelKernel();
+	if (mMultiChannelKernel != NULL) {
+		// a multichannel kernel replaces the per-channel kernels
+		UInt32 nChannels = GetNumberOfChannels();
+		mMultiChannelKernel->SetNumberOfChannels(nChannels);
+		mMultiChannelFloat32.Resize(nChannels);
+		mMultiChannelSInt32.Resize(nChannels);
+		mMultiChannelSInt16.Resize(nChannels);
+		nKernels = 0;
+	}
+	
 	if (mKernelList.size() < nKernels) {
 		mKernelList.reserve(nKernels);
 		for (UInt32 i = mKernelList.size(); i < nKernels; ++i)
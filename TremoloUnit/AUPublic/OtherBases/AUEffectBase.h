@@ -52,6 +52,7 @@
 #include "CAException.h"
 
 class AUKernelBase;
+class AUMultiChannelKernelBase;
 
 //	Base class for an effect with one input stream, one output stream,
 //	any number of channels.
@@ -119,6 +120,13 @@ public:
 	/*! @method NewKernel */
 	virtual AUKernelBase *		NewKernel() { return NULL; }
 
+	// If your unit processes N to N channels with no interactions between channels, but wants to
+	// see all of the channels at once (e.g. to process several channels per vector register), it
+	// can override NewMultiChannelKernel instead of NewKernel. A single object is created and is
+	// handed every channel on each render. If both are overridden, the multichannel kernel is used.
+	/*! @method NewMultiChannelKernel */
+	virtual AUMultiChannelKernelBase *	NewMultiChannelKernel() { return NULL; }
+
 	/*! @method ProcessBufferLists */
 	virtual OSStatus			ProcessBufferLists(
 											AudioUnitRenderActionFlags &	ioActionFlags,
@@ -224,6 +232,11 @@ protected:
 
 	AUKernelBase* GetKernel(UInt32 index) { return mKernelList[index]; }
 
+	/*! @var mMultiChannelKernel */
+	AUMultiChannelKernelBase *		mMultiChannelKernel;
+
+	AUMultiChannelKernelBase* GetMultiChannelKernel() { return mMultiChannelKernel; }
+
 	/*! @method IsInputSilent */
 	bool 							IsInputSilent (AudioUnitRenderActionFlags 	inActionFlags, UInt32 inFramesToProcess)
 									{
@@ -273,8 +286,32 @@ private:
 	/*! @var mCommonPCMFormat */
 	CAStreamBasicDescription::CommonPCMFormat		mCommonPCMFormat;
 	UInt32							mBytesPerFrame;
+	
+	// per-channel pointers handed to the multichannel kernel, one set per sample type,
+	// sized in MaintainKernels
+	template <typename T>
+	struct MultiChannelPointers {
+		std::vector<const T *>		mInputs;
+		std::vector<T *>			mOutputs;
+		
+		void						Resize(UInt32 inNumChannels) { mInputs.resize(inNumChannels); mOutputs.resize(inNumChannels); }
+	};
+	
+	template <typename T>
+	MultiChannelPointers<T> &		GetMultiChannelPointers();
+	
+	MultiChannelPointers<Float32>	mMultiChannelFloat32;
+	MultiChannelPointers<SInt32>	mMultiChannelSInt32;
+	MultiChannelPointers<SInt16>	mMultiChannelSInt16;
 };
 
+template <>
+inline AUEffectBase::MultiChannelPointers<Float32> &	AUEffectBase::GetMultiChannelPointers<Float32>() { return mMultiChannelFloat32; }
+template <>
+inline AUEffectBase::MultiChannelPointers<SInt32> &	AUEffectBase::GetMultiChannelPointers<SInt32>() { return mMultiChannelSInt32; }
+template <>
+inline AUEffectBase::MultiChannelPointers<SInt16> &	AUEffectBase::GetMultiChannelPointers<SInt16>() { return mMultiChannelSInt16; }
+
 
 //	Base class for a "kernel", an object that performs DSP on one channel of an interleaved stream.
 	/*! @class AUKernelBase */
@@ -333,6 +370,73 @@ protected:
 
 };
 
+//	Base class for a kernel that performs DSP on all the channels of a stream in one call.
+//	Each element of inSourceP/inDestP points at the first sample of one channel; successive
+//	samples of a channel are inStride samples apart. For the deinterleaved (canonical) formats
+//	inStride is 1, so each channel is a contiguous plane.
+	/*! @class AUMultiChannelKernelBase */
+class AUMultiChannelKernelBase {
+public:
+	/*! @ctor AUMultiChannelKernelBase */
+								AUMultiChannelKernelBase(AUEffectBase *inAudioUnit ) :
+									mAudioUnit(inAudioUnit), mNumberOfChannels(0) { }
+
+	/*! @dtor ~AUMultiChannelKernelBase */
+	virtual						~AUMultiChannelKernelBase() { }
+
+	/*! @method Reset */
+	virtual void				Reset() { }
+
+	/*! @method SetNumberOfChannels */
+	// called from AUEffectBase::MaintainKernels when the unit is initialized; allocate
+	// any per-channel state here, not in Process
+	virtual void				SetNumberOfChannels(UInt32 inNumChannels) { mNumberOfChannels = inNumChannels; }
+
+	/*! @method GetNumberOfChannels */
+	UInt32						GetNumberOfChannels() const { return mNumberOfChannels; }
+
+	/*! @method Process */
+	virtual void 				Process(	const Float32 * const *				inSourceP,
+											Float32 * const *					inDestP,
+											UInt32								inNumChannels,
+											UInt32								inFramesToProcess,
+											UInt32								inStride,
+											bool &								ioSilence) { throw CAException(kAudio_UnimplementedError ); }
+
+	/*! @method Process */
+	virtual void 				Process(	const SInt32 * const *				inSourceP,
+											SInt32 * const *					inDestP,
+											UInt32								inNumChannels,
+											UInt32								inFramesToProcess,
+											UInt32								inStride,
+											bool &								ioSilence) { throw CAException(kAudio_UnimplementedError ); }
+
+	/*! @method Process */
+	virtual void 				Process(	const SInt16 * const *				inSourceP,
+											SInt16 * const *					inDestP,
+											UInt32								inNumChannels,
+											UInt32								inFramesToProcess,
+											UInt32								inStride,
+											bool &								ioSilence) { throw CAException(kAudio_UnimplementedError ); }
+
+	/*! @method GetSampleRate */
+	Float64						GetSampleRate()
+								{
+									return mAudioUnit->GetSampleRate();
+								}
+								
+	/*! @method GetParameter */
+	AudioUnitParameterValue		GetParameter (AudioUnitParameterID	paramID) 
+								{
+									return mAudioUnit->GetParameter(paramID);
+								}
+	
+protected:
+	/*! @var mAudioUnit */
+	AUEffectBase * 		mAudioUnit;
+	UInt32				mNumberOfChannels;
+};
+
 template <typename T>
 void	AUEffectBase::ProcessBufferListsT(
 									AudioUnitRenderActionFlags &	ioActionFlags,
@@ -345,6 +449,44 @@ void	AUEffectBase::ProcessBufferListsT(
 	bool silentInput = IsInputSilent (ioActionFlags, inFramesToProcess);
 	ioActionFlags |= kAudioUnitRenderAction_OutputIsSilence;
 
+	if (mMultiChannelKernel != NULL) {
+		// hand every channel to the one kernel
+		MultiChannelPointers<T> &pointers = GetMultiChannelPointers<T>();
+		UInt32 numChannels = mMultiChannelKernel->GetNumberOfChannels();
+		if (numChannels > pointers.mInputs.size()) numChannels = UInt32(pointers.mInputs.size());
+		UInt32 stride;
+		if (inBuffer.mNumberBuffers == 1) {
+			stride = inBuffer.mBuffers[0].mNumberChannels;
+			if (numChannels > stride) numChannels = stride;
+			for (UInt32 channel = 0; channel < numChannels; ++channel) {
+				pointers.mInputs[channel] = (const T *)inBuffer.mBuffers[0].mData + channel;
+				pointers.mOutputs[channel] = (T *)outBuffer.mBuffers[0].mData + channel;
+			}
+		} else {
+			stride = 1;
+			if (numChannels > inBuffer.mNumberBuffers) numChannels = inBuffer.mNumberBuffers;
+			for (UInt32 channel = 0; channel < numChannels; ++channel) {
+				pointers.mInputs[channel] = (const T *)inBuffer.mBuffers[channel].mData;
+				pointers.mOutputs[channel] = (T *)outBuffer.mBuffers[channel].mData;
+			}
+		}
+		
+		if (numChannels > 0) {
+			ioSilence = silentInput;
+			mMultiChannelKernel->Process(
+				pointers.mInputs.data(),
+				pointers.mOutputs.data(),
+				numChannels,
+				inFramesToProcess,
+				stride,
+				ioSilence);
+			
+			if (!ioSilence)
+				ioActionFlags &= ~kAudioUnitRenderAction_OutputIsSilence;
+		}
+		return;
+	}
+
 	// call the kernels to handle either interleaved or deinterleaved
 	if (inBuffer.mNumberBuffers == 1) {
 		for (UInt32 channel = 0; channel < mKernelList.size(); ++channel) {
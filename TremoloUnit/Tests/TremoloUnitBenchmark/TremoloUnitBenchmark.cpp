@@ -0,0 +1,318 @@
+/*
+     File: TremoloUnitBenchmark.cpp
+ Abstract: TremoloUnitBenchmark.cpp
+  Version: 1.1
+ 
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple
+ Inc. ("Apple") in consideration of your agreement to the following
+ terms, and your use, installation, modification or redistribution of
+ this Apple software constitutes acceptance of these terms.  If you do
+ not agree with these terms, please do not use, install, modify or
+ redistribute this Apple software.
+ 
+ In consideration of your agreement to abide by the following terms, and
+ subject to these terms, Apple grants you a personal, non-exclusive
+ license, under Apple's copyrights in this original Apple software (the
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple
+ Software, with or without modifications, in source and/or binary forms;
+ provided that if you redistribute the Apple Software in its entirety and
+ without modifications, you must retain this notice and the following
+ text and disclaimers in all such redistributions of the Apple Software.
+ Neither the name, trademarks, service marks or logos of Apple Inc. may
+ be used to endorse or promote products derived from the Apple Software
+ without specific prior written permission from Apple.  Except as
+ expressly stated in this notice, no other rights or licenses, express or
+ implied, are granted by Apple herein, including but not limited to any
+ patent rights that may be infringed by your derivative works or by other
+ works in which the Apple Software may be incorporated.
+ 
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+ 
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+ 
+ Copyright (C) 2012 Apple Inc. All Rights Reserved.
+// TremoloUnitBenchmark times TremoloUnit's multichannel kernel against the per-channel kernel it
+// replaced, rendering 2, 8 and 32 channels of noise through the audio unit in 512 frame slices.
+// Both units are registered in-process and driven through AudioUnitRender, so the timings include
+// AUEffectBase's dispatch to the kernels. The per-channel version is TremoloUnit with NewKernel
+// returning a copy of the original kernel. Prints nanoseconds per sample for each, and exits with
+// a nonzero status if the two units' output differs.
+//
+//	c++ -O2 -I../.. -I../../AUPublic/AUBase -I../../AUPublic/OtherBases -I../../AUPublic/Utility -I../../PublicUtility
+//		TremoloUnitBenchmark.cpp ../../TremoloUnit.cpp ../../AUPublic/AUBase/*.cpp ../../AUPublic/OtherBases/*.cpp
+//		../../AUPublic/Utility/*.cpp ../../PublicUtility/*.cpp -framework AudioToolbox -framework AudioUnit
+//		-framework CoreAudio -framework CoreServices -framework CoreFoundation
+
+#include "TremoloUnit.h"
+
+#include <AudioToolbox/AudioToolbox.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <vector>
+
+static const UInt32		kFramesPerSlice = 512;
+static const UInt32		kNumSlices = 2000;
+static const Float64	kSampleRate = 44100.;
+
+static double Now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// PerChannelTremoloUnit
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// TremoloUnit as it was before it moved to the multichannel kernel: one AUKernelBase per channel,
+// each computing the tremolo gain for every sample of its channel.
+class PerChannelTremoloUnit : public TremoloUnit {
+public:
+	PerChannelTremoloUnit (AudioUnit component) : TremoloUnit (component) {}
+	
+	virtual AUMultiChannelKernelBase *NewMultiChannelKernel () {return NULL;}
+	virtual AUKernelBase *NewKernel () {return new PerChannelKernel(this);}
+
+private:
+	class PerChannelKernel : public AUKernelBase {
+	public:
+		PerChannelKernel (AUEffectBase *inAudioUnit) : AUKernelBase (inAudioUnit), mSamplesProcessed (0), mCurrentScale (0), mNextScale (0)
+		{
+			for (int i = 0; i < kWaveArraySize; ++i) {
+				double radians = i * 2.0 * M_PI / kWaveArraySize;
+				mSine [i] = (sin (radians) + 1.0) * 0.5;
+			}
+			for (int i = 0; i < kWaveArraySize; ++i) {
+				double radians = i * 2.0 * M_PI / kWaveArraySize + 0.32;
+				mSquare [i] = (sin (radians) + 0.3 * sin (3 * radians) + 0.15 * sin (5 * radians) + 0.075 * sin (7 * radians)
+								+ 0.0375 * sin (9 * radians) + 0.01875 * sin (11 * radians) + 0.009375 * sin (13 * radians) + 0.8) * 0.63;
+			}
+			mSampleFrequency = GetSampleRate ();
+		}
+		
+		virtual void Reset ()
+		{
+			mCurrentScale		= 0;
+			mSamplesProcessed	= 0;
+		}
+		
+		virtual void Process (const Float32 *inSourceP, Float32 *inDestP, UInt32 inFramesToProcess, UInt32, bool &ioSilence)
+		{
+			if (ioSilence)
+				return;
+			
+			Float32 tremoloFrequency = GetParameter (kParameter_Frequency);
+			Float32 tremoloDepth = GetParameter (kParameter_Depth);
+			int tremoloWaveform = (int) GetParameter (kParameter_Waveform);
+			const float *waveArrayPointer = (tremoloWaveform == kSquareWave_Tremolo_Waveform) ? &mSquare [0] : &mSine [0];
+			
+			if (tremoloFrequency < kMinimumValue_Tremolo_Freq) tremoloFrequency = kMinimumValue_Tremolo_Freq;
+			if (tremoloFrequency > kMaximumValue_Tremolo_Freq) tremoloFrequency = kMaximumValue_Tremolo_Freq;
+			if (tremoloDepth < kMinimumValue_Tremolo_Depth) tremoloDepth = kMinimumValue_Tremolo_Depth;
+			if (tremoloDepth > kMaximumValue_Tremolo_Depth) tremoloDepth = kMaximumValue_Tremolo_Depth;
+			
+			Float32 samplesPerTremoloCycle = mSampleFrequency / tremoloFrequency;
+			mNextScale = kWaveArraySize / samplesPerTremoloCycle;
+			
+			for (int i = inFramesToProcess; i > 0; --i) {
+				int index = static_cast<long>(mSamplesProcessed * mCurrentScale) % kWaveArraySize;
+				if ((mNextScale != mCurrentScale) && (index == 0)) {
+					mCurrentScale = mNextScale;
+					mSamplesProcessed = 0;
+				}
+				if ((mSamplesProcessed >= sampleLimit) && (index == 0))
+					mSamplesProcessed = 0;
+				
+				Float32 tremoloGain = (waveArrayPointer [index] * tremoloDepth - tremoloDepth + 100.0) * 0.01;
+				*inDestP++ = *inSourceP++ * tremoloGain;
+				mSamplesProcessed += 1;
+			}
+		}
+		
+	private:
+		enum	{kWaveArraySize = 2000};
+		enum	{sampleLimit = (int) 10E6};
+		float	mSine [kWaveArraySize];
+		float	mSquare [kWaveArraySize];
+		Float32	mSampleFrequency;
+		long	mSamplesProcessed;
+		float	mCurrentScale;
+		float	mNextScale;
+	};
+};
+
+AUDIOCOMPONENT_ENTRY(AUBaseFactory, PerChannelTremoloUnit)
+
+extern "C" void * TremoloUnitFactory(const AudioComponentDescription *inDesc);
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Rendering
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// the input: one slice of noise per channel, repeated
+struct NoiseSource {
+	std::vector<Float32>	mSamples;
+	UInt32					mNumChannels;
+};
+
+static OSStatus RenderNoise (void *inRefCon, AudioUnitRenderActionFlags *, const AudioTimeStamp *, UInt32, UInt32 inNumberFrames, AudioBufferList *ioData)
+{
+	const NoiseSource &source = *static_cast<const NoiseSource *>(inRefCon);
+	for (UInt32 i = 0; i < ioData->mNumberBuffers && i < source.mNumChannels; ++i)
+		memcpy(ioData->mBuffers[i].mData, &source.mSamples[i * kFramesPerSlice], inNumberFrames * sizeof(Float32));
+	return noErr;
+}
+
+class BenchmarkUnit {
+public:
+	BenchmarkUnit (AudioComponent inComponent, NoiseSource &inSource) : mUnit(NULL), mOutput(NULL), mSampleTime(0)
+	{
+		UInt32 numChannels = inSource.mNumChannels;
+		Check(AudioComponentInstanceNew(inComponent, &mUnit), "AudioComponentInstanceNew");
+		
+		AudioStreamBasicDescription format;
+		memset(&format, 0, sizeof(format));
+		format.mSampleRate = kSampleRate;
+		format.mFormatID = kAudioFormatLinearPCM;
+		format.mFormatFlags = kAudioFormatFlagsNativeFloatPacked | kAudioFormatFlagIsNonInterleaved;
+		format.mBytesPerPacket = format.mBytesPerFrame = sizeof(Float32);
+		format.mFramesPerPacket = 1;
+		format.mChannelsPerFrame = numChannels;
+		format.mBitsPerChannel = 32;
+		Check(AudioUnitSetProperty(mUnit, kAudioUnitProperty_StreamFormat, kAudioUnitScope_Input, 0, &format, sizeof(format)), "set input format");
+		Check(AudioUnitSetProperty(mUnit, kAudioUnitProperty_StreamFormat, kAudioUnitScope_Output, 0, &format, sizeof(format)), "set output format");
+		
+		UInt32 maxFrames = kFramesPerSlice;
+		Check(AudioUnitSetProperty(mUnit, kAudioUnitProperty_MaximumFramesPerSlice, kAudioUnitScope_Global, 0, &maxFrames, sizeof(maxFrames)), "set maximum frames");
+		
+		AURenderCallbackStruct callback = { RenderNoise, &inSource };
+		Check(AudioUnitSetProperty(mUnit, kAudioUnitProperty_SetRenderCallback, kAudioUnitScope_Input, 0, &callback, sizeof(callback)), "set render callback");
+		Check(AudioUnitInitialize(mUnit), "AudioUnitInitialize");
+		
+		mOutputStorage.resize(numChannels * kFramesPerSlice);
+		mOutput = (AudioBufferList *)calloc(1, offsetof(AudioBufferList, mBuffers) + numChannels * sizeof(AudioBuffer));
+		mOutput->mNumberBuffers = numChannels;
+		for (UInt32 i = 0; i < numChannels; ++i) {
+			mOutput->mBuffers[i].mNumberChannels = 1;
+			mOutput->mBuffers[i].mData = &mOutputStorage[i * kFramesPerSlice];
+		}
+	}
+	
+	~BenchmarkUnit ()
+	{
+		free(mOutput);
+		AudioUnitUninitialize(mUnit);
+		AudioComponentInstanceDispose(mUnit);
+	}
+	
+	void Render ()
+	{
+		for (UInt32 i = 0; i < mOutput->mNumberBuffers; ++i)
+			mOutput->mBuffers[i].mDataByteSize = kFramesPerSlice * sizeof(Float32);
+		
+		AudioUnitRenderActionFlags flags = 0;
+		AudioTimeStamp timeStamp;
+		memset(&timeStamp, 0, sizeof(timeStamp));
+		timeStamp.mSampleTime = mSampleTime;
+		timeStamp.mFlags = kAudioTimeStampSampleTimeValid;
+		Check(AudioUnitRender(mUnit, &flags, &timeStamp, 0, kFramesPerSlice, mOutput), "AudioUnitRender");
+		mSampleTime += kFramesPerSlice;
+	}
+	
+	void SetParameter (AudioUnitParameterID inID, AudioUnitParameterValue inValue)
+	{
+		Check(AudioUnitSetParameter(mUnit, inID, kAudioUnitScope_Global, 0, inValue, 0), "AudioUnitSetParameter");
+	}
+	
+	const std::vector<Float32> &	Output () const { return mOutputStorage; }
+
+private:
+	static void Check (OSStatus inError, const char *inWhat)
+	{
+		if (inError != noErr) {
+			printf("FAIL: %s returned %d\n", inWhat, (int)inError);
+			exit(1);
+		}
+	}
+	
+	AudioUnit				mUnit;
+	AudioBufferList *		mOutput;
+	std::vector<Float32>	mOutputStorage;
+	Float64					mSampleTime;
+};
+
+// renders both units with the parameters changing now and then, and compares every slice
+static bool OutputsMatch (AudioComponent inMultiChannel, AudioComponent inPerChannel, NoiseSource &inSource)
+{
+	BenchmarkUnit multiChannel(inMultiChannel, inSource), perChannel(inPerChannel, inSource);
+	for (UInt32 slice = 0; slice < 200; ++slice) {
+		if (slice % 17 == 5) {
+			multiChannel.SetParameter(kParameter_Frequency, 0.5f + (slice % 40) * 0.5f);
+			perChannel.SetParameter(kParameter_Frequency, 0.5f + (slice % 40) * 0.5f);
+		}
+		if (slice % 31 == 9) {
+			multiChannel.SetParameter(kParameter_Waveform, 1 + (slice / 31) % 2);
+			perChannel.SetParameter(kParameter_Waveform, 1 + (slice / 31) % 2);
+		}
+		multiChannel.Render();
+		perChannel.Render();
+		if (multiChannel.Output() != perChannel.Output()) {
+			printf("FAIL: %u channel output differs from the per-channel kernels at slice %u\n", (unsigned)inSource.mNumChannels, (unsigned)slice);
+			return false;
+		}
+	}
+	return true;
+}
+
+static double TimeUnit (AudioComponent inComponent, NoiseSource &inSource)
+{
+	BenchmarkUnit unit(inComponent, inSource);
+	unit.Render();
+	double start = Now();
+	for (UInt32 slice = 0; slice < kNumSlices; ++slice)
+		unit.Render();
+	return (Now() - start) / (double(kNumSlices) * kFramesPerSlice * inSource.mNumChannels);
+}
+
+int main()
+{
+	AudioComponentDescription desc = { kAudioUnitType_Effect, 'trbm', 'Demo', 0, 0 };
+	AudioComponent multiChannel = AudioComponentRegister(&desc, CFSTR("TremoloUnit"), kTremoloUnitVersion, (AudioComponentFactoryFunction)TremoloUnitFactory);
+	desc.componentSubType = 'trbp';
+	AudioComponent perChannel = AudioComponentRegister(&desc, CFSTR("TremoloUnit per-channel"), kTremoloUnitVersion, (AudioComponentFactoryFunction)PerChannelTremoloUnitFactory);
+	if (multiChannel == NULL || perChannel == NULL) {
+		printf("FAIL: could not register the audio units\n");
+		return 1;
+	}
+	
+	printf("%u frame slices at %g Hz; nanoseconds per sample\n", (unsigned)kFramesPerSlice, kSampleRate);
+	printf("channels   per-channel kernels   multichannel kernel\n");
+	const UInt32 kChannelCounts[] = { 2, 8, 32 };
+	for (size_t i = 0; i < sizeof(kChannelCounts) / sizeof(kChannelCounts[0]); ++i) {
+		NoiseSource source;
+		source.mNumChannels = kChannelCounts[i];
+		source.mSamples.resize(source.mNumChannels * kFramesPerSlice);
+		for (size_t j = 0; j < source.mSamples.size(); ++j)
+			source.mSamples[j] = Float32(rand()) / Float32(RAND_MAX) - 0.5f;
+		
+		if (!OutputsMatch(multiChannel, perChannel, source))
+			return 1;
+		double perChannelSeconds = TimeUnit(perChannel, source);
+		double multiChannelSeconds = TimeUnit(multiChannel, source);
+		printf("%8u   %19.2f   %19.2f\n", (unsigned)source.mNumChannels, perChannelSeconds * 1e9, multiChannelSeconds * 1e9);
+	}
+	return 0;
+}
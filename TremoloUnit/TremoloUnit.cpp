@@ -370,8 +370,9 @@ OSStatus TremoloUnit::NewFactoryPresetSet (
 //	TremoloUnit::TremoloUnitKernel::TremoloUnitKernel()
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // This is the constructor for the TremoloUnitKernel helper class, which holds the DSP code 
-//  for the audio unit. TremoloUnit is an n-to-n audio unit; one kernel object gets built for 
-//  each channel in the audio unit.
+//  for the audio unit. TremoloUnit is an n-to-n audio unit; one multichannel kernel object 
+//  processes every channel, so the tremolo gain is computed once per frame rather than once 
+//  per frame per channel.
 //
 // The first line of the method consists of the constructor method declarator and constructor-
 //  initializer. In addition to calling the appropriate superclasses, this code initializes two 
@@ -384,7 +385,7 @@ OSStatus TremoloUnit::NewFactoryPresetSet (
 //						to be continuous over data input buffer boundaries
 //
 // (In the Xcode template, the header file contains the call to the superclass constructor.)
-TremoloUnit::TremoloUnitKernel::TremoloUnitKernel (AUEffectBase *inAudioUnit ) : AUKernelBase (inAudioUnit),
+TremoloUnit::TremoloUnitKernel::TremoloUnitKernel (AUEffectBase *inAudioUnit ) : AUMultiChannelKernelBase (inAudioUnit),
 	mSamplesProcessed (0), mCurrentScale (0)
 {	
 	// Generates a wave table that represents one cycle of a sine wave, normalized so that
@@ -435,28 +436,21 @@ void TremoloUnit::TremoloUnitKernel::Reset() {
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // This method contains the DSP code. 
 void TremoloUnit::TremoloUnitKernel::Process (
-	const Float32 	*inSourceP,			// The audio sample input buffer.
-	Float32		 	*inDestP,			// The audio sample output buffer.
-	UInt32 			inSamplesToProcess,	// The number of samples in the input buffer.
-	UInt32			inNumChannels,		// The number of input channels. This is always equal to 1 
-										//   because there is always one kernel object instantiated
-										//   per channel of audio.
-	bool			&ioSilence			// A Boolean flag indicating whether the input to the audio 
-										//   unit consists of silence, with a TRUE value indicating 
-										//   silence.
+	const Float32 * const	*inSourceP,			// The audio sample input buffers, one per channel.
+	Float32 * const			*inDestP,			// The audio sample output buffers, one per channel.
+	UInt32					inNumChannels,		// The number of channels to process.
+	UInt32 					inSamplesToProcess,	// The number of samples in each channel's input buffer.
+	UInt32					inStride,			// The distance between successive samples of a channel: 1 
+												//   for the canonical format, in which each channel has its
+												//   own buffer, or the channel count for interleaved audio.
+	bool					&ioSilence			// A Boolean flag indicating whether the input to the audio 
+												//   unit consists of silence, with a TRUE value indicating 
+												//   silence.
 ) {
 	// Ignores the request to perform the Process method if the input to the audio unit is silence.
 	if (!ioSilence) {
 
-		// Assigns a pointer variable to the start of the audio sample input buffer.
-		const Float32 *sourceP = inSourceP;
-
-		// Assigns a pointer variable to the start of the audio sample output buffer.
-		Float32	*destP = inDestP,
-				inputSample,			// The current audio sample to process.
-				outputSample,			// The current audio output sample resulting from one iteration of the
-										//   processing loop.
-				tremoloFrequency,		// The tremolo frequency requested by the user via the audio unit's view.
+		Float32	tremoloFrequency,		// The tremolo frequency requested by the user via the audio unit's view.
 				tremoloDepth,			// The tremolo depth requested by the user via the audio unit's view.
 				samplesPerTremoloCycle,	// The number of audio samples in one cycle of the tremolo waveform.
 				rawTremoloGain,			// The tremolo gain for the current audio sample, as stored in the wave table.
@@ -525,57 +519,70 @@ void TremoloUnit::TremoloUnitKernel::Process (
 			need to make use of the same point in the wave table.
 		*/
 			
-		// The sample processing loop: processes the current batch of samples, one sample at a time.
-		for (int i = inSamplesToProcess; i > 0; --i) {
+		// Processes the buffer in blocks of frames. For each block, first calculates the tremolo gain 
+		// of every frame, which all channels share, then applies those gains to each channel in turn.
+		for (UInt32 blockStart = 0; blockStart < inSamplesToProcess; blockStart += kGainBlockSize) {
+			UInt32 blockFrames = inSamplesToProcess - blockStart;
+			if (blockFrames > kGainBlockSize)
+				blockFrames = kGainBlockSize;
+
+			// The gain calculation loop: one frame at a time, for all channels at once.
+			for (UInt32 frame = 0; frame < blockFrames; ++frame) {
 		
-			// The following statement calculates the position in the wave table ("index") to 
-			// use for the current sample. This position, along with the calculation of 
-			// mNextScale, is the only subtle math for this audio unit.
-			//
-			// "index" is the position marker in the wave table. The wave table is an array; 
-			//		index varies from 0 to kWaveArraySize.
-			//
-			//	"index" is also the number of samples processed since the last 
-			//	counter reset, divided by the number of samples that play during one pass 
-			//	through the wave table, modulo the size of the wave table (see "An explanation...",
-			//  above).
-			int index = static_cast<long>(mSamplesProcessed * mCurrentScale) % kWaveArraySize;
-
-			// If the user has moved the tremolo frequency slider, changes the scale factor
-			// at the next positive zero crossing of the tremolo sine wave and resets the 
-			// mSamplesProcessed value so it stays in sync with the index position.
-			if ((mNextScale != mCurrentScale) && (index == 0)) {
-				mCurrentScale = mNextScale;
-				mSamplesProcessed = 0;
-			}
+				// The following statement calculates the position in the wave table ("index") to 
+				// use for the current sample. This position, along with the calculation of 
+				// mNextScale, is the only subtle math for this audio unit.
+				//
+				// "index" is the position marker in the wave table. The wave table is an array; 
+				//		index varies from 0 to kWaveArraySize.
+				//
+				//	"index" is also the number of samples processed since the last 
+				//	counter reset, divided by the number of samples that play during one pass 
+				//	through the wave table, modulo the size of the wave table (see "An explanation...",
+				//  above).
+				int index = static_cast<long>(mSamplesProcessed * mCurrentScale) % kWaveArraySize;
+
+				// If the user has moved the tremolo frequency slider, changes the scale factor
+				// at the next positive zero crossing of the tremolo sine wave and resets the 
+				// mSamplesProcessed value so it stays in sync with the index position.
+				if ((mNextScale != mCurrentScale) && (index == 0)) {
+					mCurrentScale = mNextScale;
+					mSamplesProcessed = 0;
+				}
 
-			// If the audio unit runs for a long time without the user moving the
-			// tremolo frequency slider, resets the mSamplesProcessed value at the 
-			// next positive zero crossing of the tremolo sine wave.
-			if ((mSamplesProcessed >= sampleLimit) && (index == 0))
-				mSamplesProcessed = 0;
+				// If the audio unit runs for a long time without the user moving the
+				// tremolo frequency slider, resets the mSamplesProcessed value at the 
+				// next positive zero crossing of the tremolo sine wave.
+				if ((mSamplesProcessed >= sampleLimit) && (index == 0))
+					mSamplesProcessed = 0;
 
-			// Gets the raw tremolo gain from the appropriate wave table.
-			rawTremoloGain = waveArrayPointer [index];
+				// Gets the raw tremolo gain from the appropriate wave table.
+				rawTremoloGain = waveArrayPointer [index];
 
-			// Calculates the final tremolo gain according to the depth setting.
-			tremoloGain			= (rawTremoloGain * tremoloDepth - tremoloDepth + 100.0) * 0.01;
-			
-			// Gets the next input sample.
-			inputSample			= *sourceP;
-			
-			// Calculates the next output sample.
-			outputSample		= (inputSample * tremoloGain);
-			
-			// Stores the output sample in the output buffer.
-			*destP				= outputSample;
-			
-			// Advances to the next sample location in the input and output buffers.
-			sourceP				+= 1;
-			destP				+= 1;
-			
-			// Increments the global samples counter.
-			mSamplesProcessed	+= 1;
+				// Calculates the final tremolo gain according to the depth setting.
+				tremoloGain			= (rawTremoloGain * tremoloDepth - tremoloDepth + 100.0) * 0.01;
+				
+				// Stores the gain for this frame.
+				mGain [frame]		= tremoloGain;
+				
+				// Increments the global samples counter.
+				mSamplesProcessed	+= 1;
+			}
+
+			// The sample processing loop: scales each channel's samples in the block by the frame gains.
+			for (UInt32 channel = 0; channel < inNumChannels; ++channel) {
+				const Float32	*sourceP	= inSourceP [channel] + blockStart * inStride;
+				Float32			*destP		= inDestP [channel] + blockStart * inStride;
+				
+				if (inStride == 1) {
+					// Contiguous samples; the compiler can process several frames per vector here.
+					for (UInt32 frame = 0; frame < blockFrames; ++frame)
+						destP [frame] = sourceP [frame] * mGain [frame];
+				} else {
+					for (UInt32 frame = 0; frame < blockFrames; ++frame)
+						destP [frame * inStride] = sourceP [frame * inStride] * mGain [frame];
+				}
+			}
 		}
 	}
 }
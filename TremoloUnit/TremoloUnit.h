@@ -149,7 +149,7 @@ public:
 	virtual ~TremoloUnit () {delete mDebugDispatcher;}
 #endif
 	
-	virtual AUKernelBase *NewKernel () {return new TremoloUnitKernel(this);}
+	virtual AUMultiChannelKernelBase *NewMultiChannelKernel () {return new TremoloUnitKernel(this);}
 	
 	virtual	ComponentResult GetParameterValueStrings (
 		AudioUnitScope			inScope,
@@ -199,24 +199,27 @@ public:
 	);
 
 protected:
-	class TremoloUnitKernel : public AUKernelBase {
+	class TremoloUnitKernel : public AUMultiChannelKernelBase {
 		public:
 			TremoloUnitKernel (AUEffectBase *inAudioUnit);
 			
 			// *Required* overides for the process method for this effect
-			// processes one channel of interleaved samples
+			// processes every channel at once; the tremolo gain is the same for all of them
 			virtual void Process (
-				const Float32 	*inSourceP,
-				Float32		 	*inDestP,
-				UInt32 			inFramesToProcess,
-				UInt32			inNumChannels, // equal to 1
-				bool			&ioSilence
+				const Float32 * const	*inSourceP,
+				Float32 * const			*inDestP,
+				UInt32					inNumChannels,
+				UInt32					inFramesToProcess,
+				UInt32					inStride,	// 1 for the canonical, deinterleaved format
+				bool					&ioSilence
 		);
 		
         virtual void Reset ();
 		
 		private:
 			enum	{kWaveArraySize = 2000};	// The number of points in the wave table.
+			enum	{kGainBlockSize = 256};		// The number of frames whose gains are computed before applying them.
+			float	mGain [kGainBlockSize];		// The tremolo gain of each frame in the current block, shared by all channels.
 			float	mSine [kWaveArraySize];		// The wave table for the tremolo sine wave.
 			float	mSquare [kWaveArraySize];	// The wave table for the tremolo square wave.
 			float	*waveArrayPointer;			// Points to the wave table to use for the current audio input buffer.